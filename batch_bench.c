@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "includes/apu.h"
+#include "includes/nes.h"
+#include "includes/batch.h"
+#include "includes/controllers.h"
+#include "includes/util.h"
+
+/**
+ * Headless batch benchmark. Loads a rom into many instances, steps them all one frame at a time
+ * with batch_step while pressing a different pseudo random button pattern on each, and reports
+ * how many instance frames a second the host manages. The hash printed at the end covers every
+ * instance's last frame and ram, so runs with different thread counts can be checked to agree.
+ *
+ * usage: BudgetNES_batch_bench <rom path> [instances] [frames] [threads]
+*/
+
+#define DEFAULT_BATCH_INSTANCES 64
+#define DEFAULT_BATCH_FRAMES    300
+
+static double batch_bench_now_seconds(void);
+
+int main(int argc, char *argv[])
+{
+   if (argc < 2)
+   {
+      printf("usage: %s <rom path> [instances] [frames] [threads]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   long instance_count = (argc > 2) ? strtol(argv[2], NULL, 10) : DEFAULT_BATCH_INSTANCES;
+   long frames = (argc > 3) ? strtol(argv[3], NULL, 10) : DEFAULT_BATCH_FRAMES;
+   long threads = (argc > 4) ? strtol(argv[4], NULL, 10) : 0;
+   if (instance_count <= 0 || frames <= 0 || threads < 0)
+   {
+      printf("Invalid arguments!\n");
+      return EXIT_FAILURE;
+   }
+
+   if (!apu_init())
+   {
+      return EXIT_FAILURE;
+   }
+
+   nes_t** instances = calloc(instance_count, sizeof(nes_t*));
+   Batch_Input_t* inputs = calloc(instance_count, sizeof(Batch_Input_t));
+   if (instances == NULL || inputs == NULL)
+   {
+      printf("Failed to allocate memory for instances!\n");
+      return EXIT_FAILURE;
+   }
+
+   bool loaded = true;
+   for (long i = 0; i < instance_count && loaded; ++i)
+   {
+      instances[i] = nes_create();
+      if (instances[i] == NULL)
+      {
+         loaded = false;
+         break;
+      }
+
+      nes_bind(instances[i]);
+      loaded = nes_load_rom(argv[1]);
+   }
+   nes_bind(NULL);
+
+   if (loaded && batch_init( (uint32_t) threads ))
+   {
+      const Batch_Output_t* output = NULL;
+      uint32_t seed = 1;
+
+      double start = batch_bench_now_seconds();
+      for (long frame = 0; frame < frames && loaded; ++frame)
+      {
+         for (long i = 0; i < instance_count; ++i)
+         {
+            seed = seed * 1664525u + 1013904223u;
+            inputs[i].joypad1 = (uint8_t) (seed >> 24) & (uint8_t) ~(BUTTON_START | BUTTON_SELECT);
+         }
+
+         output = batch_step(instances, inputs, (uint32_t) instance_count, 1);
+         loaded = output != NULL;
+      }
+      double elapsed = batch_bench_now_seconds() - start;
+
+      if (loaded)
+      {
+         uint64_t hash = fnv1a_64(FNV1A_64_OFFSET_BASIS, output->frames, (size_t) output->count * BATCH_FRAME_SIZE);
+         hash = fnv1a_64(hash, output->ram, (size_t) output->count * BATCH_RAM_SIZE);
+
+         double instance_frames = (double) instance_count * frames;
+
+         printf("\n");
+         printf("Instances:         %ld\n", instance_count);
+         printf("Threads:           %u\n", batch_get_thread_count());
+         printf("Frames each:       %ld\n", frames);
+         printf("Host time:         %.3f s\n", elapsed);
+         printf("Instance frames/s: %.0f\n", instance_frames / elapsed);
+         printf("Output hash:       %016llx\n", (unsigned long long) hash);
+      }
+
+      batch_shutdown();
+   }
+
+   for (long i = 0; i < instance_count; ++i)
+   {
+      nes_destroy(instances[i]);
+   }
+   free(instances);
+   free(inputs);
+   apu_shutdown();
+
+   return loaded ? 0 : EXIT_FAILURE;
+}
+
+static double batch_bench_now_seconds(void)
+{
+   struct timespec ts;
+   timespec_get(&ts, TIME_UTC);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "includes/apu.h"
+#include "includes/cpu.h"
+#include "includes/cartridge.h"
+#include "includes/log.h"
+#include "includes/movie.h"
+
+/**
+ * Headless throughput benchmark. Runs a rom for a fixed number of frames as fast as
+ * the host allows, with video and audio output going to null sinks, and reports
+ * emulation speed.
+ *
+ * Given a movie it plays the movie back instead, stopping early if the movie ends first
+ * (a frame count of 0 plays the whole movie), and can write a hash of every frame to a
+ * log for comparing runs between builds.
+ *
+ * usage: BudgetNES_bench <rom path> [frames] [movie path] [hash log path]
+*/
+
+#define DEFAULT_BENCH_FRAMES 600
+#define NES_FRAME_RATE 60.0988
+
+static double bench_now_seconds(void);
+
+int main(int argc, char *argv[])
+{
+   if (argc < 2)
+   {
+      printf("usage: %s <rom path> [frames] [movie path] [hash log path]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   const char* movie_path = (argc > 3) ? argv[3] : NULL;
+   const char* hash_log_path = (argc > 4) ? argv[4] : NULL;
+
+   long frames = DEFAULT_BENCH_FRAMES;
+   if (argc > 2)
+   {
+      frames = strtol(argv[2], NULL, 10);
+      if (frames < 0 || (frames == 0 && movie_path == NULL))
+      {
+         printf("Invalid frame count: %s\n", argv[2]);
+         return EXIT_FAILURE;
+      }
+   }
+
+   if (!apu_init())
+   {
+      return EXIT_FAILURE;
+   }
+
+   cartridge_set_battery_save_writes(false); // a benchmark run never overwrites the player's save
+   if (!cartridge_load(argv[1]))
+   {
+      apu_shutdown();
+      return EXIT_FAILURE;
+   }
+
+   cpu_init();
+
+   if (movie_path != NULL)
+   {
+      if (!movie_play(movie_path, hash_log_path))
+      {
+         apu_shutdown();
+         cartridge_free_memory();
+         return EXIT_FAILURE;
+      }
+
+      if (frames == 0)
+      {
+         frames = movie_get_length();
+      }
+   }
+
+   cpu_6502_t* cpu = get_cpu();
+   long start_cycles = cpu->cycle_count;
+
+   double start = bench_now_seconds();
+   long frames_run = 0;
+   for (; frames_run < frames; ++frames_run)
+   {
+      if (!movie_begin_frame())
+      {
+         break; // movie ended
+      }
+      cpu_run_frame();
+      movie_end_frame();
+   }
+   double elapsed = bench_now_seconds() - start;
+   frames = frames_run;
+
+   double cycles = (double) frames * CPU_CYCLES_PER_FRAME + (cpu->cycle_count - start_cycles);
+   double fps = frames / elapsed;
+
+   printf("\n");
+   printf("Frames:          %ld\n", frames);
+   printf("Host time:       %.3f s\n", elapsed);
+   printf("Emulated fps:    %.2f (%.2fx realtime)\n", fps, fps / NES_FRAME_RATE);
+   printf("Host ns/frame:   %.0f\n", elapsed * 1e9 / frames);
+   printf("CPU cycles/sec:  %.0f\n", cycles / elapsed);
+
+   movie_stop();
+   apu_shutdown();
+   log_free();
+   cartridge_free_memory();
+
+   return 0;
+}
+
+static double bench_now_seconds(void)
+{
+   struct timespec ts;
+   timespec_get(&ts, TIME_UTC);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -4,6 +4,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "savestate.h"
+
+#define APU_SAMPLE_RATE             44100
+#define APU_SAMPLES_PER_FRAME       735 // 44100 / 60
+#define APU_DEFAULT_LATENCY_FRAMES  3
+#define APU_MAX_LATENCY_FRAMES      8
+
 // https://www.nesdev.org/wiki/2A03
 
 typedef struct Framecounter_t
@@ -69,8 +76,6 @@ typedef struct Noise_t
 	uint16_t shift_register;
 
 	uint8_t  raw_sample;
-	uint8_t  raw_samples[41];
-	size_t   raw_sample_index;
 	uint8_t  out;
 } Noise_t;
 
@@ -96,12 +101,31 @@ typedef struct Dmc_t
 	uint8_t out;
 } Dmc_t;
 
+typedef struct Apu_Context_t Apu_Context_t; // channels, frame counter and blip buffer of one emulator instance, see nes.h
+
 /**
  * Initialze audio device.
  * @returns false on fail, otherwise return true.
  */
 bool apu_init(void);
 
+/// <summary>
+/// Allocates apu state and a blip buffer for a new emulator instance. apu_init has to have run first,
+/// the audio device and mixer tables it sets up are shared by every instance.
+/// </summary>
+/// <returns>NULL on fail</returns>
+Apu_Context_t* apu_context_create(void);
+
+/// <summary>
+/// Frees apu state made by apu_context_create.
+/// </summary>
+void apu_context_destroy(Apu_Context_t* context);
+
+/// <summary>
+/// Makes the apu functions called from this thread act on context, NULL binds the default instance.
+/// </summary>
+void apu_bind(Apu_Context_t* context);
+
 /// <summary>
 /// Resets states of certain apu channels and flags when loading in new cartridge.
 /// </summary>
@@ -125,7 +149,30 @@ void apu_write(uint16_t position, uint8_t data);
  */
 uint8_t apu_read_status(void);
 
-void apu_tick(long audio_time);
+/**
+ * Runs the apu up to the cpu's current cycle. The apu is not clocked by the cpu every cycle, instead
+ * anything that can observe it (register writes, status reads, interrupt polling, the end of a frame)
+ * catches it up first. Stretches where no channel timer expires and the frame counter does not step
+ * are skipped in one go since no output can change during them.
+ */
+void apu_catch_up(void);
+
+/**
+ * Moves the cpu cycle the apu is synced to when the cpu rebases its cycle counter.
+ * The apu must be caught up before the counter changes.
+ * @param cycle_count new cpu cycle count
+ */
+void apu_rebase_cpu_cycle(long cycle_count);
+
+/**
+ * Writes the channel, frame counter and interrupt state into the APU chunk of a save state, see savestate.h.
+*/
+void apu_save_state(State_Buffer_t* buffer);
+
+/**
+ * Restores the channel, frame counter and interrupt state from the APU chunk of a save state.
+*/
+void apu_load_state(State_Buffer_t* buffer);
 
 /// <summary>
 /// Pauses the audio playback. Video output is synced to the apu so pausing
@@ -135,26 +182,49 @@ void apu_tick(long audio_time);
 void apu_pause(bool flag);
 
 /// <summary>
-/// Returns number of bytes queued for playing.
+/// Mutes the apu's output without affecting emulation. Nothing is mixed or queued while muted and the
+/// blip buffer is left exactly as it was, so frames that will be thrown away can run without being heard.
 /// </summary>
-/// <returns>Returns number of bytes (not samples) queued for playing</returns>
+/// <param name="flag">True := Mute, False := Unmute</param>
+void apu_mute(bool flag);
+
+/// <summary>
+/// Returns number of samples queued for playing.
+/// </summary>
+/// <returns>Returns number of samples (not bytes) queued for playing</returns>
 uint32_t apu_get_queued_audio(void);
 
+/// <summary>
+/// Sets how many frames of audio are kept queued ahead of playback. The emulator runs a frame
+/// whenever the queue drops below this, so it is also what paces emulation.
+/// </summary>
+/// <param name="frames">target latency in frames, 1 to APU_MAX_LATENCY_FRAMES</param>
+void apu_set_audio_latency(uint32_t frames);
+
+/// <summary>
+/// Returns the target audio latency in frames.
+/// </summary>
+uint32_t apu_get_audio_latency(void);
+
+/// <summary>
+/// Returns the number of queued samples the emulator tops the audio queue up to.
+/// </summary>
+uint32_t apu_get_audio_latency_samples(void);
+
 /// <summary>
 /// Read a frame of audio samples from internal buffer and queues them for playing.
 /// </summary>
 void apu_queue_audio_frame(long audio_frame_length);
 
 /// <summary>
-/// Clears any queued audio as well as samples in internal buffers.
+/// Queues a frame of silence, used to keep the audio device paced while frames are not being emulated.
 /// </summary>
-/// <param name=""></param>
-void apu_clear_queued_audio(void);
+void apu_queue_silent_frame(void);
 
 /// <summary>
-/// Check if apu is signaling a irq from the frame counter or the dmc channel.
+/// Clears any queued audio as well as samples in internal buffers.
 /// </summary>
-/// <returns>True if either the frame or dmc interrupt flag is set. False otherwise.</returns>
-bool apu_is_triggering_irq(void);
+/// <param name=""></param>
+void apu_clear_queued_audio(void);
 
 #endif
@@ -0,0 +1,65 @@
+#ifndef AUDIO_DEVICE_H
+#define AUDIO_DEVICE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * audio_device.h is the sink that the apu hands its finished audio frames to.
+ * audio_device.c buffers the samples in a ring that an sdl audio callback pulls from while
+ * audio_device_null.c discards them for headless builds.
+*/
+
+/**
+ * Open the audio device for signed 16 bit mono playback.
+ * @param sample_rate samples per second the apu will produce
+ * @returns false on fail, otherwise return true.
+ */
+bool audio_device_open(int sample_rate);
+
+/**
+ * Closes the audio device.
+ */
+void audio_device_close(void);
+
+/**
+ * Pauses or resumes playback of queued samples.
+ * @param flag true pauses, false unpauses
+ */
+void audio_device_pause(bool flag);
+
+/**
+ * @returns number of samples waiting in the ring buffer to be played, i.e. its fill level.
+ */
+uint32_t audio_device_get_queued(void);
+
+/**
+ * Queues samples for playing.
+ * @param samples buffer of signed 16 bit samples
+ * @param count number of samples (not bytes) inside the buffer
+ */
+void audio_device_queue(const short* samples, uint32_t count);
+
+/**
+ * Drops all samples that are queued but not yet played.
+ */
+void audio_device_clear(void);
+
+/**
+ * Sets how many samples the emulator should keep queued ahead of playback.
+ * Lower values cut latency at the risk of underruns.
+ * @param samples target number of queued samples
+ */
+void audio_device_set_latency(uint32_t samples);
+
+/**
+ * @returns the target number of queued samples.
+ */
+uint32_t audio_device_get_latency(void);
+
+/**
+ * @returns how many times playback ran out of queued samples since the device was opened.
+ */
+uint32_t audio_device_get_underruns(void);
+
+#endif
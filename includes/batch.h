@@ -0,0 +1,76 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "nes.h"
+#include "ppu.h"
+
+/**
+ * batch.h steps many emulator instances (see nes.h) in parallel on a pool of worker threads, for
+ * automated play testing and search workloads that want thousands of instance frames a second.
+ * It only uses the core, never the display, audio device or gui.
+ *
+ * Instances are split into one contiguous range per thread. A thread works through its own range
+ * first and then steals instances from the ranges of threads that are still busy, so a few slow
+ * instances do not leave the other cores idle.
+ *
+ * Results come back as structure of arrays: every instance's last frame packed one after another in
+ * one array and every instance's cpu ram in another. The worker that finishes an instance copies its
+ * frame and ram into the instance's slots once, the caller reads the arrays in place.
+*/
+
+#define BATCH_FRAME_SIZE  (PPU_FRAME_W * PPU_FRAME_H) // bytes in one frame, 6 bit system palette indices as ppu_get_frame
+#define BATCH_RAM_SIZE    (1024 * 2)                  // bytes of cpu ram in one snapshot
+#define BATCH_MAX_THREADS 256
+
+/**
+ * Buttons held on both controllers while an instance is stepped, JOYPAD_BUTTONS bits.
+*/
+typedef struct Batch_Input_t
+{
+   uint8_t joypad1;
+   uint8_t joypad2;
+} Batch_Input_t;
+
+/**
+ * Results of the last batch_step. The arrays stay valid until the next batch_step or batch_shutdown.
+*/
+typedef struct Batch_Output_t
+{
+   uint32_t       count;  // instances stepped
+   const uint8_t* frames; // count frames of BATCH_FRAME_SIZE bytes, instance i's at frames + i * BATCH_FRAME_SIZE
+   const uint8_t* ram;    // count snapshots of BATCH_RAM_SIZE bytes, instance i's at ram + i * BATCH_RAM_SIZE
+} Batch_Output_t;
+
+/**
+ * Starts the worker threads.
+ * @param thread_count threads to step instances on including the caller's, 0 for one per host core
+ * @returns false on fail, otherwise return true.
+*/
+bool batch_init(uint32_t thread_count);
+
+/**
+ * Stops the worker threads and frees the output arrays.
+*/
+void batch_shutdown(void);
+
+/**
+ * @returns threads instances are stepped on including the caller's, 0 before batch_init
+*/
+uint32_t batch_get_thread_count(void);
+
+/**
+ * Runs every instance for n_frames frames in parallel and returns their last frame and cpu ram.
+ * The calling thread steps instances too and keeps whichever instance it had bound. None of the
+ * instances may be bound to another thread while the batch runs.
+ * @param instances instances made by nes_create with a rom loaded
+ * @param inputs buttons held for each instance during all n_frames frames, NULL leaves them as they are
+ * @param count number of instances
+ * @param n_frames frames to run each instance for
+ * @returns output arrays, NULL on fail
+*/
+const Batch_Output_t* batch_step(nes_t* const instances[], const Batch_Input_t inputs[], uint32_t count, uint32_t n_frames);
+
+#endif
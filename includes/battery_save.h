@@ -0,0 +1,72 @@
+#ifndef BATTERY_SAVE_H
+#define BATTERY_SAVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * battery_save.h keeps the .sav files of cartridges with battery backed prg-ram on disk. The cartridge
+ * tracks when the game writes to its battery ram and hands a copy of it over here at most once every
+ * save interval, so a crash or a killed process only loses the last few seconds of progress.
+ *
+ * Copies are written on a background thread, the emulation thread never waits for the disk. A file
+ * is written to a temporary file first and renamed over the old .sav once it is complete, so a .sav
+ * on disk is always either the old save or the new one and never half of each.
+ *
+ * Without battery_save_init no thread is started and saves are written right away when a cartridge is
+ * unloaded, like the headless tools do.
+*/
+
+#define BATTERY_SAVE_DIRECTORY        "sav"
+#define BATTERY_SAVE_DEFAULT_INTERVAL 5  // seconds between writes of battery ram that changed
+#define BATTERY_SAVE_MAX_INTERVAL     60
+
+/**
+ * Starts the thread that writes saves.
+ * @param interval seconds between writes of battery ram that changed, 0 only writes when a cartridge is unloaded
+ * @returns false on fail, otherwise return true.
+*/
+bool battery_save_init(uint32_t interval);
+
+/**
+ * Writes every save still queued and stops the thread.
+*/
+void battery_save_shutdown(void);
+
+/**
+ * @param interval seconds between writes of battery ram that changed, 0 only writes when a cartridge is unloaded
+*/
+void battery_save_set_interval(uint32_t interval);
+
+/**
+ * @returns seconds between writes of battery ram that changed, 0 before battery_save_init
+*/
+uint32_t battery_save_get_interval(void);
+
+/**
+ * @returns seconds on a clock that save intervals are measured against
+*/
+double battery_save_get_time(void);
+
+/**
+ * Copies battery ram and queues it to be written to the .sav file of a rom. Never waits for the disk
+ * while the thread is running, a newer copy for the same rom replaces one that was not written yet.
+ * Writes right away when battery_save_init was not called.
+ * @param rom_name name of the rom without directory or extension, names the .sav file
+ * @param data battery ram to save
+ * @param size bytes of data
+ * @returns false on fail, otherwise return true.
+*/
+bool battery_save_queue(const char* rom_name, const uint8_t* data, size_t size);
+
+/**
+ * Reads the save of a rom, including a copy that is queued but not written yet.
+ * @param rom_name name of the rom without directory or extension, names the .sav file
+ * @param data battery ram to fill, left as is when there is no save
+ * @param size bytes of data
+ * @returns false if there is no save, otherwise return true.
+*/
+bool battery_save_read(const char* rom_name, uint8_t* data, size_t size);
+
+#endif
@@ -3,9 +3,54 @@
 
 #include <stdint.h>
 
+#include "savestate.h"
+
+// cpu address space is split into 1kb pages for the read page table
+
+#define CPU_PAGE_SHIFT 10
+#define CPU_PAGE_SIZE  (1 << CPU_PAGE_SHIFT)
+#define CPU_PAGE_COUNT (0x10000 >> CPU_PAGE_SHIFT)
+
+typedef struct Bus_Context_t Bus_Context_t; // cpu ram and read page table of one emulator instance, see nes.h
+
+/**
+ * Allocates cpu ram and a read page table for a new emulator instance, ram starts cleared.
+ * @returns NULL on fail
+*/
+Bus_Context_t* bus_context_create(void);
+
+/**
+ * Frees bus state made by bus_context_create.
+*/
+void bus_context_destroy(Bus_Context_t* context);
+
+/**
+ * Makes the bus functions called from this thread act on context, NULL binds the default instance.
+*/
+void bus_bind(Bus_Context_t* context);
+
 uint8_t cpu_bus_read(uint16_t position);
 void cpu_bus_write(uint16_t position, uint8_t data);
 void cpu_clear_ram(void);
+const uint8_t* cpu_get_ram(void);
 uint8_t DEBUG_cpu_bus_read(uint16_t position);
 
+/**
+ * Writes the cpu ram and open bus value into the RAM chunk of a save state, see savestate.h.
+*/
+void bus_save_state(State_Buffer_t* buffer);
+
+/**
+ * Restores the cpu ram and open bus value from the RAM chunk of a save state.
+*/
+void bus_load_state(State_Buffer_t* buffer);
+
+/**
+ * Points a 1kb page of the cpu address space directly at host memory so reads from that
+ * page become a single indexed load instead of going through the cartridge mapper.
+ * @param page index of the page, cpu address >> CPU_PAGE_SHIFT
+ * @param memory start of the 1kb block of memory backing the page, NULL to fall back to the read handlers
+*/
+void cpu_bus_map_read_page(uint8_t page, const uint8_t* memory);
+
 #endif
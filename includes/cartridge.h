@@ -3,6 +3,9 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
+
+#include "savestate.h"
 
 // enum to signify which device on the cartridge is being accessed
 typedef enum cartridge_access_mode_t
@@ -17,14 +20,40 @@ typedef enum cartridge_access_mode_t
 typedef struct nes_header_t 
 {
    uint8_t trainer;
-   uint32_t prg_rom_size;         // in 16kb units
-   uint32_t prg_ram_size;         // in 8kb units
-   uint32_t chr_rom_size;         // in 8kb units
-   uint16_t mapper_id;
+   uint32_t prg_rom_size;         // in 16kb units, rounded up for NES 2.0 sizes that are not whole units
+   uint32_t chr_rom_size;         // in 8kb units, rounded up like prg_rom_size
+   size_t prg_rom_bytes;          // exact rom sizes in bytes
+   size_t chr_rom_bytes;
+   size_t prg_ram_bytes;          // volatile prg-ram in bytes
+   size_t prg_nvram_bytes;        // battery backed prg-ram in bytes, kept in the .sav file
+   size_t chr_ram_bytes;          // volatile chr-ram in bytes
+   size_t chr_nvram_bytes;        // battery backed chr-ram in bytes
+   uint16_t mapper_id;            // 12 bits in NES 2.0, 8 bits in iNES 1.0
+   uint8_t submapper_id;          // NES 2.0 only, 0 otherwise
    uint8_t nametable_arrangement; // 0: horizontal mirroring, 1: vertical mirroring
 	bool    battery_backed_ram;
+   bool    is_nes20;              // header was in NES 2.0 format
 } nes_header_t;
 
+typedef struct Cartridge_Context_t Cartridge_Context_t; // loaded rom, its memory and mapper of one emulator instance, see nes.h
+
+/**
+ * Allocates cartridge state for a new emulator instance, with no rom loaded.
+ * @returns NULL on fail
+*/
+Cartridge_Context_t* cartridge_context_create(void);
+
+/**
+ * Frees cartridge state made by cartridge_context_create. The rom has to be freed with
+ * cartridge_free_memory while the context is bound first.
+*/
+void cartridge_context_destroy(Cartridge_Context_t* context);
+
+/**
+ * Makes the cartridge functions called from this thread act on context, NULL binds the default instance.
+*/
+void cartridge_bind(Cartridge_Context_t* context);
+
 /**
  * Allocates memory for cartridge data and loads data into allocated memory.
  */
@@ -62,10 +91,80 @@ uint8_t cartridge_ppu_read(uint16_t position);
 void cartridge_ppu_write(uint16_t position, uint8_t data);
 
 /**
- * Frees the allocated memory for program and chr rom/ram.
+ * Rebuilds the cpu read page table entries covering a range of cartridge space. Mappers call this
+ * whenever a register write switches prg banks or enables/disables prg ram so that the bus can read
+ * prg memory directly without going through the mapper.
+ * @param start first address of the range
+ * @param end last address of the range
+*/
+void cartridge_update_cpu_pages(uint16_t start, uint16_t end);
+
+/**
+ * Rebuilds the ppu page table entries for the pattern tables and nametables covering a range of
+ * ppu addresses ($0000 - $2FFF). Mappers call this when chr banks or nametable mirroring change.
+ * @param start first address of the range
+ * @param end last address of the range
+*/
+void cartridge_update_ppu_pages(uint16_t start, uint16_t end);
+
+/**
+ * Frees the allocated memory for program and chr rom/ram, queueing battery backed prg-ram to be
+ * saved first if the game changed it and save writes are on.
 */
 void cartridge_free_memory(void);
 
-bool cartridge_is_triggering_irq(void);
+/**
+ * Schedules the earliest cpu cycle the mapper could raise its irq at, so the cpu only catches the ppu up
+ * for mapper irqs once that cycle has passed. Called after anything that can move the mapper's irq counter.
+*/
+void cartridge_update_irq_deadline(void);
+
+/**
+ * Hands battery backed prg-ram to battery_save_queue if the game changed it and the save interval has
+ * passed since it was last handed over, see battery_save.h. Called by the emulation thread between frames.
+*/
+void cartridge_update_battery_save(void);
+
+/**
+ * Turns writing battery backed prg-ram to the .sav file on or off. The .sav is still read when a rom
+ * is loaded either way, so tools that run a game without a player never overwrite the player's save.
+ * Kept across rom loads.
+ * @param flag true to write saves (the default), false to never write them
+*/
+void cartridge_set_battery_save_writes(bool flag);
+
+/**
+ * Puts the cartridge back into its power on state: mapper registers are reinitialized and vram,
+ * chr-ram and prg-ram are cleared. Battery backed prg-ram holds the player's save and is kept.
+*/
+void cartridge_power_on(void);
+
+/**
+ * @returns 64 bit FNV-1a hash of the prg and chr rom, identifies the loaded game
+*/
+uint64_t cartridge_get_rom_hash(void);
+
+/**
+ * @returns 64 bit FNV-1a hash of battery backed prg-ram, 0 if the cartridge has none
+*/
+uint64_t cartridge_get_battery_ram_hash(void);
+
+/**
+ * Writes the cartridge identity, vram, prg ram, chr ram and mapper registers into the CART chunk
+ * of a save state, see savestate.h. Rom contents are not saved.
+*/
+void cartridge_save_state(State_Buffer_t* buffer);
+
+/**
+ * Restores cartridge memory and mapper registers from the CART chunk of a save state and remaps
+ * the cpu and ppu pages to match.
+*/
+void cartridge_load_state(State_Buffer_t* buffer);
+
+/**
+ * Checks that a CART chunk was saved with the currently loaded cartridge.
+ * @returns false if mapper or memory sizes differ
+*/
+bool cartridge_validate_state(State_Buffer_t* buffer);
 
 #endif
@@ -0,0 +1,49 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * checksum.h computes the CRC32 and SHA-1 that rom databases identify dumps by, see rom_library.h.
+ * CRC32 is the zlib/IEEE one, computed eight bytes at a time with slicing tables.
+*/
+
+#define SHA1_DIGEST_SIZE 20
+
+typedef struct Sha1_Context_t
+{
+   uint32_t state[5];
+   uint64_t length;    // bytes hashed so far
+   uint8_t block[64];  // bytes of the block being filled
+} Sha1_Context_t;
+
+/**
+ * Builds the CRC32 tables. Called by crc32_update when needed, but has to be called once before
+ * crc32_update is used from several threads at the same time.
+*/
+void checksum_init(void);
+
+/**
+ * Continues a CRC32 over a block of memory.
+ * @param crc crc so far, 0 to start a new one
+ * @param data memory to hash
+ * @param size bytes to hash
+ * @returns updated crc
+*/
+uint32_t crc32_update(uint32_t crc, const void* data, size_t size);
+
+void sha1_init(Sha1_Context_t* context);
+
+/**
+ * Continues a SHA-1 over a block of memory.
+*/
+void sha1_update(Sha1_Context_t* context, const void* data, size_t size);
+
+/**
+ * Finishes a SHA-1, the context has to be initialized again to be reused.
+ * @param digest filled with SHA1_DIGEST_SIZE bytes
+*/
+void sha1_final(Sha1_Context_t* context, uint8_t digest[SHA1_DIGEST_SIZE]);
+
+#endif
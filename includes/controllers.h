@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+#include "savestate.h"
+
 typedef enum JOYPAD_BUTTONS
 {
    BUTTON_A =      1 << 0,
@@ -15,6 +17,24 @@ typedef enum JOYPAD_BUTTONS
    BUTTON_RIGHT =  1 << 7,
 } JOYPAD_BUTTONS;
 
+typedef struct Controllers_Context_t Controllers_Context_t; // controller state of one emulator instance, see nes.h
+
+/**
+ * Allocates controller state for a new emulator instance, with no buttons held.
+ * @returns NULL on fail
+*/
+Controllers_Context_t* controllers_context_create(void);
+
+/**
+ * Frees controller state made by controllers_context_create.
+*/
+void controllers_context_destroy(Controllers_Context_t* context);
+
+/**
+ * Makes the controller functions called from this thread act on context, NULL binds the default instance.
+*/
+void controllers_bind(Controllers_Context_t* context);
+
 /**
  * Set the value of the strobe bit in the controller to signal continuous reloading of input shift registers.
 */
@@ -46,4 +66,29 @@ void controller1_set_button_down(JOYPAD_BUTTONS button);
 */
 void controller1_set_button_up(JOYPAD_BUTTONS button);
 
+/**
+ * Gets the buttons currently held on both controllers as JOYPAD_BUTTONS bits.
+*/
+void controllers_get_buttons(uint8_t* joypad1, uint8_t* joypad2);
+
+/**
+ * Replaces the buttons held on both controllers, used to feed recorded input back in.
+*/
+void controllers_set_buttons(uint8_t joypad1, uint8_t joypad2);
+
+/**
+ * Releases every button and clears the shift registers and strobe, as at power on.
+*/
+void controllers_reset(void);
+
+/**
+ * Writes the controller shift registers and strobe into the CTRL chunk of a save state, see savestate.h.
+*/
+void controllers_save_state(State_Buffer_t* buffer);
+
+/**
+ * Restores the controller shift registers and strobe from the CTRL chunk of a save state.
+*/
+void controllers_load_state(State_Buffer_t* buffer);
+
 #endif
@@ -2,12 +2,36 @@
 #define INSTRUCTIONS_6502_H
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "savestate.h"
+
+#define CPU_CYCLES_PER_FRAME 29780 // ntsc cpu clock cycles in one video frame
+
+// devices that can pull the shared irq line low, each owns one bit of cpu_6502_t.irq_line
+typedef enum Cpu_Irq_Source_t
+{
+   CPU_IRQ_FRAME_COUNTER = 0x1,
+   CPU_IRQ_DMC           = 0x2,
+   CPU_IRQ_MAPPER        = 0x4,
+} Cpu_Irq_Source_t;
+
+// cycles at which a lazily run device may raise an interrupt and has to be caught up before the cpu polls
+typedef enum Cpu_Event_t
+{
+   CPU_EVENT_PPU_NMI,    // vblank nmi
+   CPU_EVENT_MAPPER_IRQ, // mapper irq clocked by ppu fetches
+   CPU_EVENT_APU_IRQ,    // frame counter or dmc irq
+   CPU_EVENT_COUNT,
+} Cpu_Event_t;
 
 typedef struct cpu_6502_t
 {
    bool nmi_flip_flop;
 	bool get_put_cycle; // cpu alternate between get/put cycles. True: get cycle, False: put cycle
    long cycle_count;
+   long next_event_cycle; // earliest cycle of any scheduled Cpu_Event_t
+   uint8_t irq_line;      // Cpu_Irq_Source_t bits of the sources currently asserting an irq
 
    uint8_t ac;  // accumulator
    uint8_t X;   // x index register
@@ -25,6 +49,8 @@ typedef struct cpu_6502_t
    // 1st bit - zero
    // 0th bit - carry
    uint8_t status_flags;
+
+   long event_cycles[CPU_EVENT_COUNT]; // cycle each Cpu_Event_t is due at, LONG_MAX when not scheduled
 } cpu_6502_t;
 
 typedef enum address_modes_t
@@ -47,15 +73,36 @@ typedef enum address_modes_t
 typedef struct instruction_t
 {
    char* mnemonic;                    // 3 character mnemonic of the a instruction
-   uint8_t (*opcode_function) (void); // pointer to a function that contain the execution code of a instruction, may return extra cycle if branching occurs
    address_modes_t mode;              // enum that represents the addressing mode of the instruction
    uint8_t cycles;                    // number of base clock cycles this instruction takes
 } instruction_t;
 
 void cpu_emulate_instruction(void);
 void cpu_run_for_one_sample(void);
+void cpu_run_frame(void);
 void cpu_run_without_audio(float* delta_time);
-void cpu_run_with_audio(float *delta_time);
+void cpu_run_with_audio(void);
+
+#define CPU_MAX_RUN_AHEAD_FRAMES 4
+
+/**
+ * Sets how many frames past the real timeline are run and shown every time cpu_run_with_audio
+ * emulates, so games that react to input a frame or more late respond sooner. 0 turns it off.
+ * @param frames frames to run ahead, clamped to CPU_MAX_RUN_AHEAD_FRAMES
+*/
+void cpu_set_run_ahead(uint32_t frames);
+
+/**
+ * @returns frames currently run ahead
+*/
+uint32_t cpu_get_run_ahead(void);
+
+/**
+ * Estimates how many frames the host could run ahead and still keep up with 60 frames a second,
+ * from the measured cost of emulating a frame and of saving and restoring a state.
+ * @returns sustainable run ahead frames, 0 until something has been measured
+*/
+uint32_t cpu_get_run_ahead_capacity(void);
 void cpu_reset(void);
 void cpu_init(void);
 void cpu_IRQ(void);
@@ -64,6 +111,53 @@ void cpu_tick(void);
 void cpu_read_tick(void);
 void cpu_write_tick(void);
 cpu_6502_t* get_cpu(void);
+
+/**
+ * Allocates cpu registers for a new emulator instance, see nes.h. cpu_init powers them on.
+ * @returns NULL on fail
+*/
+cpu_6502_t* cpu_context_create(void);
+
+/**
+ * Frees cpu registers made by cpu_context_create.
+*/
+void cpu_context_destroy(cpu_6502_t* context);
+
+/**
+ * Makes the cpu functions called from this thread act on context, NULL binds the default instance.
+*/
+void cpu_bind(cpu_6502_t* context);
+
+/**
+ * Pulls the irq line low on behalf of a source, the irq is taken at the next instruction boundary
+ * with the interrupt flag clear for as long as any source holds the line.
+ * @param source device asserting the irq
+*/
+void cpu_irq_assert(Cpu_Irq_Source_t source);
+
+/**
+ * Lets go of the irq line on behalf of a source.
+ * @param source device that acknowledged or disabled its irq
+*/
+void cpu_irq_release(Cpu_Irq_Source_t source);
+
+/**
+ * Schedules the cycle an interrupt source has to be caught up by, replacing the source's previous event.
+ * The cpu checks a single cycle count between instructions and only catches up sources that are due.
+ * @param event which source the event belongs to
+ * @param cycle cpu cycle count the event is due at, LONG_MAX if nothing is pending
+*/
+void cpu_schedule_event(Cpu_Event_t event, long cycle);
+
+/**
+ * Writes the cpu registers and scheduled events into the CPU chunk of a save state, see savestate.h.
+*/
+void cpu_save_state(State_Buffer_t* buffer);
+
+/**
+ * Restores the cpu registers and scheduled events from the CPU chunk of a save state.
+*/
+void cpu_load_state(State_Buffer_t* buffer);
 const instruction_t* get_instruction_lookup_entry(uint8_t position);
 void update_disassembly(uint8_t next);
 
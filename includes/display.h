@@ -3,8 +3,8 @@
 
 #include <stdbool.h>
 #include <stdint.h>
-#include <vec4.h>
-#include <SDL.h>
+
+struct SDL_Window;
 
 /**
  * display.h handles setting up and shutting down all sdl
@@ -45,8 +45,8 @@ void display_update(void);
 void display_shutdown(void);
 void display_update_color_buffer(void);
 void display_process_event(bool* done);
-void set_viewport_pixel_color(uint32_t row, uint32_t col, vec3 color);
+void display_update_palette(void);
 Emulator_State_t* get_emulator_state(void);
-SDL_Window* display_get_window(void);
+struct SDL_Window* display_get_window(void);
 
 #endif
@@ -0,0 +1,62 @@
+#ifndef EMU_THREAD_H
+#define EMU_THREAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * emu_thread.h runs the emulator core on its own thread so that vsync stalls and slow buffer
+ * swaps on the gui thread do not hold up emulation or audio queueing. The gui thread talks to it
+ * through a single producer single consumer command queue, finished frames come back through
+ * display_update_color_buffer.
+*/
+
+typedef enum Emu_Command_Type_t
+{
+   EMU_COMMAND_BUTTON_DOWN,   // value is the JOYPAD_BUTTONS button of controller 1 that was pressed
+   EMU_COMMAND_BUTTON_UP,     // value is the JOYPAD_BUTTONS button of controller 1 that was released
+   EMU_COMMAND_RUN_STATE,     // value is the new Emulator_Run_State_t set by the gui
+   EMU_COMMAND_STEP,          // execute a single instruction, only while paused
+   EMU_COMMAND_RESET_TIMERS,  // drop the time that passed while the gui was blocked
+   EMU_COMMAND_REWIND,        // value is 1 while the rewind key is held and 0 once it is released
+   EMU_COMMAND_RUN_AHEAD,     // value is the number of frames to run ahead, 0 turns run ahead off
+   EMU_COMMAND_SAVE_INTERVAL, // value is the number of seconds between battery saves, 0 only saves when the rom is unloaded
+} Emu_Command_Type_t;
+
+typedef struct Emu_Command_t
+{
+   Emu_Command_Type_t type;
+   uint8_t value;
+} Emu_Command_t;
+
+/**
+ * Starts the emulation thread with the run state currently held in the emulator state struct.
+ * @returns false on fail, otherwise return true.
+*/
+bool emu_thread_start(void);
+
+/**
+ * Asks the emulation thread to exit and waits for it.
+*/
+void emu_thread_stop(void);
+
+/**
+ * Queues a command for the emulation thread, must only be called from the gui thread.
+ * @param type what the command does
+ * @param value argument of the command, unused by some commands
+ * @returns false if the queue is full and the command was dropped
+*/
+bool emu_thread_send(Emu_Command_Type_t type, uint8_t value);
+
+/**
+ * Waits until the emulation thread is between frames and keeps it there until emu_thread_unlock.
+ * Anything on the gui thread that reads or changes core state (loading roms, debug viewers) must hold the lock.
+*/
+void emu_thread_lock(void);
+
+/**
+ * Lets the emulation thread continue after emu_thread_lock.
+*/
+void emu_thread_unlock(void);
+
+#endif
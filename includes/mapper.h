@@ -5,25 +5,73 @@
 #include <stdbool.h>
 
 #include "cartridge.h"
+#include "mapper_001.h"
+#include "mapper_002.h"
+#include "mapper_004.h"
+#include "mapper_007.h"
+#include "mapper_009.h"
+
+/**
+ * mapper.h holds the registry of supported mappers. Every mapper is one descriptor in a static table
+ * in mapper.c, adding a mapper means adding its descriptor there and its registers to
+ * mapper_registers_t.
+*/
+
+#define MAPPER_ANY_SUBMAPPER 0xFF // descriptor used for every submapper without a descriptor of its own
+
+/**
+ * What a mapper does beyond mapping reads and writes, the core skips the work for what it does not.
+*/
+typedef enum mapper_capability_t
+{
+   MAPPER_GENERATES_IRQ      = 1 << 0, // raises irqs, irq_deadline is set
+   MAPPER_OBSERVES_PPU_FETCH = 1 << 1, // watches the ppu address bus, ppu_fetch is set
+   MAPPER_SWITCHES_PPU       = 1 << 2, // register writes change chr banks or mirroring, the ppu is caught up before them
+} mapper_capability_t;
+
+/**
+ * Registers of any mapper, kept in the instance's cartridge instead of the heap.
+*/
+typedef union mapper_registers_t
+{
+   Registers_001 mapper001;
+   Registers_002 mapper002;
+   Registers_004 mapper004;
+   Registers_007 mapper007;
+   Registers_009 mapper009;
+} mapper_registers_t;
 
 typedef struct mapper_t
 {
+   uint16_t mapper_id;
+   uint8_t  submapper_id;   // MAPPER_ANY_SUBMAPPER or the one submapper the descriptor is for
+   uint32_t capabilities;   // mapper_capability_t bits
+   size_t   registers_size; // bytes of mapper_registers_t the mapper uses, copied as is into save states
+
    cartridge_access_mode_t (*cpu_read)     (nes_header_t *header, uint16_t position, size_t *mapped_addr, void* internal_registers);
    cartridge_access_mode_t (*ppu_read)     (nes_header_t *header, uint16_t position, size_t *mapped_addr, void* internal_registers);
    // cpu write function takes in data parameter which is the data to write, this can be intercepted by cartridge mapper to do stuff like bank switching for example
    cartridge_access_mode_t (*cpu_write)    (nes_header_t *header, uint16_t position, uint8_t data, size_t *mapped_addr, void* internal_registers);
    cartridge_access_mode_t (*ppu_write)    (nes_header_t *header, uint16_t position, size_t *mapped_addr, void* internal_registers);
    void                    (*init)         (nes_header_t* header, void* internal_registers); // function to initialize a mapper's register if necessary
-	bool                    (*irq_signaled) (void* internal_registers);
+	// MAPPER_GENERATES_IRQ only, fewest cpu cycles before the mapper could raise its irq (LONG_MAX if it cannot right now)
+	long                    (*irq_deadline) (void* internal_registers);
+	// MAPPER_OBSERVES_PPU_FETCH only, called with the address of every ppu read
+	void                    (*ppu_fetch)    (nes_header_t* header, uint16_t position, void* internal_registers);
 } mapper_t;
 
 /**
- * Loads correct mapper that contains pointers to cpu/ppu read/write
- * function depending on the iNES header.
- * @param mapper_id id of mapper to load
- * @param mapper pointer to mapper struct that will contain loaded function pointer for reads/writes
- * @param mapper_registers pointer to struct that will contain a mapper's internal registers
+ * Finds the descriptor of a mapper, preferring one made for the submapper over the generic one.
+ * @param mapper_id id of mapper to find
+ * @param submapper_id NES 2.0 submapper, 0 for iNES 1.0 roms
+ * @returns NULL if the mapper is not supported
+*/
+const mapper_t* mapper_find(uint16_t mapper_id, uint8_t submapper_id);
+
+/**
+ * @param mapper_id id of mapper to check
+ * @returns true if the registry has a descriptor for the mapper
 */
-bool load_mapper(uint32_t mapper_id, mapper_t *mapper, void** mapper_registers);
+bool mapper_is_supported(uint16_t mapper_id);
 
 #endif
@@ -38,7 +38,17 @@ cartridge_access_mode_t mapper004_cpu_write(nes_header_t* header, uint16_t posit
 cartridge_access_mode_t mapper004_ppu_read(nes_header_t* header, uint16_t position, size_t* mapped_addr, void* internal_registers);
 cartridge_access_mode_t mapper004_ppu_write(nes_header_t* header, uint16_t position, size_t* mapped_addr, void* internal_registers);
 
-bool mapper004_irq_signaled(void* internal_registers);
+/**
+ * Watches the ppu address bus for rising edges of A12 to clock the scanline irq counter.
+ * Called after every ppu read and write.
+ */
+void mapper004_ppu_fetch(nes_header_t* header, uint16_t position, void* internal_registers);
+
+/**
+ * The irq counter is clocked at most once every 3 cpu cycles (the M2 filter on A12), so the irq
+ * cannot fire sooner than 3 cycles for every clock it still needs after the next one.
+ */
+long mapper004_irq_deadline(void* internal_registers);
 
 void mapper004_init(nes_header_t* header, void* internal_registers);
 
@@ -28,6 +28,11 @@ cartridge_access_mode_t mapper009_cpu_write(nes_header_t* header, uint16_t posit
 cartridge_access_mode_t mapper009_ppu_read(nes_header_t* header, uint16_t position, size_t* mapped_addr, void* internal_registers);
 cartridge_access_mode_t mapper009_ppu_write(nes_header_t* header, uint16_t position, size_t* mapped_addr, void* internal_registers);
 
+/**
+ * Updates the chr latches when the ppu reads one of the latch trigger tiles.
+ */
+void mapper009_ppu_fetch(nes_header_t* header, uint16_t position, void* internal_registers);
+
 
 void mapper009_init(nes_header_t* header, void* internal_registers);
 
@@ -0,0 +1,83 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * movie.h records the buttons held on both controllers every frame from power on, and plays them
+ * back to reproduce a session exactly. Playback can write a hash of every frame to a log so long
+ * sessions replayed at full speed can be compared between builds to find where they diverge.
+ *
+ * File layout, integers little endian:
+ *    "BNMV"   4 byte magic
+ *    uint32   MOVIE_VERSION
+ *    uint64   cartridge_get_rom_hash of the game it was recorded with
+ *    uint64   cartridge_get_battery_ram_hash when recording started
+ *    frames   2 bytes each, JOYPAD_BUTTONS of controller 1 then controller 2, until the end of the file
+ *
+ * Hash log lines are "<frame> <hash>" with the hash as 16 hex digits, see movie_hash_frame.
+*/
+
+#define MOVIE_VERSION 1
+
+typedef enum Movie_Mode_t
+{
+   MOVIE_OFF,
+   MOVIE_RECORDING,
+   MOVIE_PLAYING,
+} Movie_Mode_t;
+
+/**
+ * Power cycles the machine and starts recording input into a new movie file.
+ * @param path file to record into, replaced if it exists
+ * @returns false on fail, otherwise return true.
+*/
+bool movie_record(const char* path);
+
+/**
+ * Power cycles the machine and starts playing a movie back.
+ * @param path movie file to play
+ * @param hash_log_path file to write a hash of every frame played to, NULL for none
+ * @returns false if the movie cannot be read or was recorded with a different rom
+*/
+bool movie_play(const char* path, const char* hash_log_path);
+
+/**
+ * Stops recording or playback and closes any open files.
+*/
+void movie_stop(void);
+
+/**
+ * @returns whether a movie is being recorded, played or neither
+*/
+Movie_Mode_t movie_get_mode(void);
+
+/**
+ * @returns frames recorded or played so far
+*/
+uint32_t movie_get_frame(void);
+
+/**
+ * @returns frames in the movie being played, or recorded so far
+*/
+uint32_t movie_get_length(void);
+
+/**
+ * Called before every frame of the real timeline. While recording the held buttons are appended to
+ * the movie, while playing the movie's buttons for this frame replace them.
+ * @returns false once playback has run out of frames, playback is stopped at that point
+*/
+bool movie_begin_frame(void);
+
+/**
+ * Called after every frame of the real timeline, writes the frame's hash to the hash log if there is one.
+*/
+void movie_end_frame(void);
+
+/**
+ * @returns 64 bit FNV-1a hash of the last rendered frame's pixels followed by cpu ram
+*/
+uint64_t movie_hash_frame(void);
+
+#endif
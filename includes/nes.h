@@ -0,0 +1,58 @@
+#ifndef NES_H
+#define NES_H
+
+#include <stdbool.h>
+
+/**
+ * nes.h lets one process host many independent consoles. An nes_t holds everything one machine
+ * has: cpu registers and scheduled events, cpu ram and its read page table, the ppu, the apu
+ * channels and blip buffer, the cartridge with its mapper, and the controllers.
+ *
+ * The core functions (cpu_run_frame, ppu_get_frame, cartridge_load, state_save, ...) act on the
+ * instance bound to the calling thread, so the existing single machine api works unchanged for
+ * any instance. Every thread starts out bound to the default instance, which is the one the gui
+ * and the benchmark drive without ever creating an nes_t. Different threads can run different
+ * instances at the same time, an instance must only be bound to one thread at a time.
+ *
+ * Instances made by nes_create are headless: their frames are read with ppu_get_frame instead of
+ * being published to the display, their apu is muted and they read .sav files but never write them,
+ * see ppu_set_frame_output, apu_mute and cartridge_set_battery_save_writes.
+ * Rewind, movies and run ahead are front end features that stay with the default instance.
+*/
+
+typedef struct nes_t nes_t;
+
+/**
+ * Allocates a new instance with no rom loaded. apu_init has to have run once before, it sets up
+ * the audio device and tables every instance shares.
+ * @returns NULL on fail
+*/
+nes_t* nes_create(void);
+
+/**
+ * Frees an instance and its rom. Battery backed ram is not written to disk unless the instance was
+ * bound and cartridge_set_battery_save_writes(true) called on it.
+ * If the instance is bound to the calling thread the default instance is bound in its place.
+ * @param nes instance made by nes_create, NULL does nothing
+*/
+void nes_destroy(nes_t* nes);
+
+/**
+ * Makes the core functions called from this thread act on an instance.
+ * @param nes instance to bind, NULL binds the default instance
+*/
+void nes_bind(nes_t* nes);
+
+/**
+ * @returns the instance bound to the calling thread, NULL for the default instance
+*/
+nes_t* nes_get_bound(void);
+
+/**
+ * Loads a rom into the bound instance and powers it on, replacing any rom it already had.
+ * @param path path to the .nes file
+ * @returns false on fail, otherwise return true.
+*/
+bool nes_load_rom(const char* path);
+
+#endif
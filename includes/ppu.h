@@ -3,7 +3,9 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "vec4.h"
+#include "vec3.h"
+
+#include "savestate.h"
 
 typedef struct input_sprite_t
 {
@@ -23,6 +25,24 @@ typedef struct output_sprite_t
    uint8_t attribute;
 } output_sprite_t;
 
+typedef struct Ppu_Context_t Ppu_Context_t; // ppu registers, memory and frame of one emulator instance, see nes.h
+
+/**
+ * Allocates ppu state for a new emulator instance, in the same state as at program start.
+ * @returns NULL on fail
+*/
+Ppu_Context_t* ppu_context_create(void);
+
+/**
+ * Frees ppu state made by ppu_context_create.
+*/
+void ppu_context_destroy(Ppu_Context_t* context);
+
+/**
+ * Makes the ppu functions called from this thread act on context, NULL binds the default instance.
+*/
+void ppu_bind(Ppu_Context_t* context);
+
 /**
  * Resets ppu internal state.
 */
@@ -41,6 +61,28 @@ bool ppu_load_palettes_from_file(const char* path);
 
 void ppu_load_default_palettes();
 
+// dimensions of the frame the ppu outputs, all 240 scanlines are kept even though the display crops the top and bottom 8
+
+#define PPU_FRAME_W 256
+#define PPU_FRAME_H 240
+
+/**
+ * Returns the 64 rgb colors that palette indices in the frame resolve to.
+*/
+const vec3* ppu_get_system_palette(void);
+
+/**
+ * Returns the pixels of the last rendered frame, PPU_FRAME_W * PPU_FRAME_H bytes in row order.
+ * Each byte is a 6 bit index into the system palette.
+*/
+const uint8_t* ppu_get_frame(void);
+
+/**
+ * Returns the color emphasis bits (ppu_mask bits 5-7 shifted down to bits 0-2) for each of the
+ * PPU_FRAME_H scanlines of the frame.
+*/
+const uint8_t* ppu_get_frame_emphasis(void);
+
 /**
  * Lets cpu write data throught the ppu ports
  * @param position address of ppu register to write to
@@ -60,6 +102,36 @@ uint8_t ppu_port_read(uint16_t position);
 */
 void ppu_cycle(bool * nmi_flip_flop);
 
+/**
+ * The ppu runs lazily behind the cpu. Runs the ppu for every cpu cycle it is behind, 3 ppu cycles each,
+ * so that its state is up to date with the cpu's cycle count. Has to be called before anything observes or
+ * changes ppu state from outside the ppu.
+*/
+void ppu_catch_up(void);
+
+/**
+ * Moves the cpu cycle the ppu is synced to when the cpu rebases its cycle counter.
+ * The ppu must be caught up before the counter changes.
+ * @param cycle_count new cpu cycle count
+*/
+void ppu_rebase_cpu_cycle(long cycle_count);
+
+/**
+ * Writes the ppu registers, internal latches, oam, palette ram and the current frame into the PPU chunk of a save state, see savestate.h.
+*/
+void ppu_save_state(State_Buffer_t* buffer);
+
+/**
+ * Restores the ppu registers, internal latches, oam, palette ram and the current frame from the PPU chunk of a save state.
+*/
+void ppu_load_state(State_Buffer_t* buffer);
+
+/**
+ * Cpu cycle that the ppu is currently running in. While catching up this lags the cpu's cycle count,
+ * mappers that time ppu events against the cpu clock use this instead.
+*/
+long ppu_get_cpu_cycle(void);
+
 // render pipeline events
 
 void rest_cycle(void);
@@ -87,12 +159,40 @@ bool ppu_scheduled_oam_dma(void);
 /// </summary>
 void ppu_handle_oam_dma(void);
 
+// ppu address space $0000 - $2FFF (pattern tables and nametables) is split into 1kb pages for fetches
+
+#define PPU_PAGE_SHIFT 10
+#define PPU_PAGE_SIZE  (1 << PPU_PAGE_SHIFT)
+#define PPU_PAGE_COUNT (0x3000 >> PPU_PAGE_SHIFT)
+
+/**
+ * Points a 1kb page of the ppu address space at host memory, pages 0-7 are the chr banks of the pattern tables
+ * and pages 8-11 are the four nametable slots. Background and sprite fetches index these pages directly.
+ * @param page index of the page, ppu address >> PPU_PAGE_SHIFT
+ * @param memory start of the 1kb block backing the page, NULL unmaps the page
+*/
+void ppu_map_page(uint8_t page, const uint8_t* memory);
+
+/**
+ * Sets a function that is told the address of every background and sprite fetch. Only mappers that
+ * watch the ppu address bus need this (MMC2 latches, MMC3 scanline counter).
+ * @param hook function to call after each fetch, NULL to disable
+*/
+void ppu_set_fetch_hook(void (*hook)(uint16_t position));
+
+/**
+ * Turns handing finished frames to the display on or off. Used to only show the frames that matter
+ * when frames are run that will be thrown away again.
+ * @param flag true to publish frames (the default), false to keep them to the ppu
+*/
+void ppu_set_frame_output(bool flag);
+
 /**
- * Used by debug gui widget to view pattern tables. Updates pixel colors to draw current pixels inside
- * the pattern tables.
- * @param p0 color buffer of pixels that will be rendered for pattern table 0
- * @param p1 color buffer of pixels that will be rendered for pattern table 1
+ * Used by debug gui widget to view pattern tables. Updates the 128x128 system palette indices of the pixels
+ * inside the pattern tables, drawn with background palette 0.
+ * @param p0 index buffer of pixels that will be rendered for pattern table 0
+ * @param p1 index buffer of pixels that will be rendered for pattern table 1
 */
-void DEBUG_ppu_update_pattern_tables(vec4* p0, vec4* p1);
+void DEBUG_ppu_update_pattern_tables(uint8_t* p0, uint8_t* p1);
 
 #endif
@@ -0,0 +1,57 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * rewind.h keeps the last few seconds of gameplay as one save state per emulated frame inside a fixed
+ * memory budget, so the machine can be stepped backwards frame by frame.
+ *
+ * States are stored in a preallocated ring. Every REWIND_KEYFRAME_INTERVAL frames a keyframe holds a
+ * whole state, every frame in between only holds its xor against the previous frame's state. Both are
+ * run length encoded over the zero bytes of the xor, which is most of it since ram, vram, oam and
+ * prg ram change little from frame to frame. The oldest keyframe and its deltas are dropped together
+ * when the ring runs out of room.
+*/
+
+#define REWIND_DEFAULT_BUDGET     (32 * 1024 * 1024) // bytes of encoded states kept
+#define REWIND_MAX_FRAMES         (60 * 60)          // at most a minute of frames regardless of the budget
+#define REWIND_KEYFRAME_INTERVAL  60                 // frames between keyframes
+
+/**
+ * Allocates the rewind ring.
+ * @param budget bytes to reserve for encoded states
+ * @returns false on fail, otherwise return true.
+*/
+bool rewind_init(size_t budget);
+
+/**
+ * Frees the rewind ring.
+*/
+void rewind_shutdown(void);
+
+/**
+ * Drops every recorded frame, called when a different rom is loaded.
+*/
+void rewind_clear(void);
+
+/**
+ * Records the current machine state as the newest frame. Called once after every emulated frame.
+ * @returns false if the state could not be saved or does not fit in the budget at all
+*/
+bool rewind_record(void);
+
+/**
+ * Restores the frame recorded before the newest one and forgets the newest one.
+ * @returns false when there is no older frame left to go back to
+*/
+bool rewind_step_back(void);
+
+/**
+ * @returns number of recorded frames that can be stepped back through
+*/
+uint32_t rewind_get_frame_count(void);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef ROM_IMAGE_H
+#define ROM_IMAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "cartridge.h"
+
+/**
+ * rom_image.h loads the read only part of a .nes file (header, prg-rom and chr-rom) once and shares
+ * it between every emulator instance that loads the same file, see nes.h. Images are reference
+ * counted and freed when the last cartridge using them is unloaded. Everything an instance writes
+ * to (prg-ram, chr-ram, vram, mapper registers) stays in its own cartridge.
+ *
+ * Files are memory mapped read only and prg-rom and chr-rom point straight into the mapping, so
+ * loading a rom costs no copy and only the banks a game touches are ever read from disk. A .nes
+ * file must not be truncated while a cartridge holds it.
+*/
+
+typedef struct Rom_Image_t
+{
+   nes_header_t header;
+   const uint8_t* prg_rom;
+   const uint8_t* chr_rom; // NULL when the cartridge uses chr-ram
+   size_t prg_rom_size;    // in bytes
+   size_t chr_rom_size;    // in bytes, 0 when the cartridge uses chr-ram
+   char name[256];         // file name without directory or extension, names the .sav file
+} Rom_Image_t;
+
+/**
+ * Returns the image of a .nes file, reading it from disk only if no one holds it already.
+ * Safe to call from any thread.
+ * @param path path to the .nes file, images are shared between loads of the same path
+ * @returns NULL on fail
+*/
+const Rom_Image_t* rom_image_acquire(const char* path);
+
+/**
+ * Validates the header of a .nes file in memory and points an image's prg-rom and chr-rom into it.
+ * Checks that the file is long enough for the rom sizes its header gives. The name is left as is.
+ * @param data contents of the .nes file, has to outlive the image
+ * @param size length of data in bytes
+ * @param image image to fill in
+ * @returns false on fail and true on success
+*/
+bool rom_image_parse(const uint8_t* data, size_t size, Rom_Image_t* image);
+
+/**
+ * Decodes the 16 byte header of a .nes file in iNES 1.0 or NES 2.0 format, without checking it
+ * against the size of the file.
+ * @param iNES_header first 16 bytes of a .nes file
+ * @param header struct to contain header information
+ * @returns false on fail and true on success
+*/
+bool rom_image_parse_header(const uint8_t* iNES_header, nes_header_t* header);
+
+/**
+ * @param iNES_header first 16 bytes of a .nes file
+ * @returns true if the header is in NES 2.0 format
+*/
+bool rom_image_is_nes20(const uint8_t* iNES_header);
+
+/**
+ * Maps a whole file read only into memory, its pages are only read from disk when touched.
+ * @param size set to the size of the file in bytes
+ * @returns NULL on fail or when the file is shorter than an iNES header
+*/
+const uint8_t* rom_image_map_file(const char* path, size_t* size);
+
+/**
+ * Unmaps a file mapped by rom_image_map_file.
+*/
+void rom_image_unmap_file(const uint8_t* file, size_t size);
+
+/**
+ * Drops a reference taken by rom_image_acquire, the image is freed with the last one.
+ * @param image image to release, NULL does nothing
+*/
+void rom_image_release(const Rom_Image_t* image);
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef ROM_LIBRARY_H
+#define ROM_LIBRARY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cartridge.h"
+#include "checksum.h"
+
+/**
+ * rom_library.h indexes a directory tree of .nes files. A scan walks the tree, then reads, validates
+ * and hashes the roms on a pool of threads: the header is decoded with the same code cartridges are
+ * loaded with (see rom_image.h), and the CRC32 and SHA-1 of prg-rom followed by chr-rom are taken,
+ * which is what rom databases list dumps by.
+ *
+ * The results are kept in a text index file keyed by path, modification time and size. A scan that
+ * starts from a loaded index only reads the files that are new or changed since, so scanning a large
+ * library again takes no longer than walking its directories.
+ *
+ * Known bad dumps are fixed up by the CRC32 of their roms. A fix-up file holds one rom per line:
+ *
+ *    # crc32   mapper  submapper  mirroring  battery
+ *    1A2B3C4D  4       -          V          1
+ *
+ * mirroring is H or V, battery is 0 or 1 and - keeps the value from the header. Only fields that do
+ * not change the layout of the file can be fixed, submappers and mappers above 255 only in NES 2.0
+ * headers. When a rom is loaded whose path, modification time
+ * and size match an entry of the index, the fix-up of that entry is applied to its header.
+ *
+ * rom_library_load_index, rom_library_load_fixups and rom_library_scan are called from one thread,
+ * rom_library_fix_header is safe to call from any thread.
+*/
+
+#define ROM_LIBRARY_INDEX_FILE  "rom_library.idx"
+#define ROM_LIBRARY_FIXUP_FILE  "rom_fixups.txt"
+#define ROM_LIBRARY_MAX_THREADS 64
+
+typedef struct Rom_Library_Entry_t
+{
+   char* path;                     // absolute path of the .nes file
+   int64_t modified_time;          // seconds since 1970
+   uint64_t file_size;             // in bytes
+   uint8_t iNES_header[16];        // header as it is in the file
+   nes_header_t header;            // decoded header with any fix-up applied
+   uint32_t crc32;                 // of prg-rom followed by chr-rom
+   uint8_t sha1[SHA1_DIGEST_SIZE]; // of prg-rom followed by chr-rom
+   bool is_valid;                  // header decodes and the file holds the roms it gives, the rest is 0 otherwise
+   bool is_header_fixed;           // a fix-up matched the crc32 and changed the header
+   bool is_mapper_supported;
+} Rom_Library_Entry_t;
+
+/**
+ * Replaces the entries of the library with the ones in an index file.
+ * @param index_path path of the index file
+ * @returns false if the file does not exist or is not an index, otherwise return true.
+*/
+bool rom_library_load_index(const char* index_path);
+
+/**
+ * Writes the entries of the library to an index file.
+ * @param index_path path of the index file
+ * @returns false on fail, otherwise return true.
+*/
+bool rom_library_save_index(const char* index_path);
+
+/**
+ * Replaces the fix-ups with the ones in a fix-up file and applies them to the entries.
+ * @param fixup_path path of the fix-up file
+ * @returns false if the file does not exist, otherwise return true. Malformed lines are skipped.
+*/
+bool rom_library_load_fixups(const char* fixup_path);
+
+/**
+ * Scans a directory and everything below it for .nes files. The entries afterwards are exactly the
+ * files found, entries whose file did not change are kept without reading the file again.
+ * @param directory root of the directory tree to scan
+ * @param thread_count threads to read roms on including the caller's, 0 for one per host core
+ * @returns false on fail, otherwise return true.
+*/
+bool rom_library_scan(const char* directory, uint32_t thread_count);
+
+/**
+ * @returns files read by the last rom_library_scan, the others came from the index
+*/
+uint32_t rom_library_get_read_count(void);
+
+/**
+ * @returns entries in the library, ordered by path
+*/
+uint32_t rom_library_get_count(void);
+
+/**
+ * @param index entry to get, below rom_library_get_count
+ * @returns the entry, valid until the next load or scan, or NULL if index is out of range
+*/
+const Rom_Library_Entry_t* rom_library_get_entry(uint32_t index);
+
+/**
+ * Applies the fix-up of a rom to its header if the library holds the file at path unchanged.
+ * @param path path the rom is being loaded from
+ * @param iNES_header first 16 bytes of the rom's file, the fix-up is applied to a copy of them
+ * @param header header of the rom being loaded, decoded again from the fixed copy
+ * @returns true if the header was changed
+*/
+bool rom_library_fix_header(const char* path, const uint8_t* iNES_header, nes_header_t* header);
+
+/**
+ * Frees every entry and fix-up.
+*/
+void rom_library_free(void);
+
+#endif
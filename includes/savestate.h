@@ -0,0 +1,75 @@
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * savestate.h snapshots the whole machine (cpu, ram, ppu, apu, cartridge memory and mapper registers,
+ * controller shift registers) into a versioned binary blob and restores it again.
+ *
+ * Layout, all integers in host byte order since states are meant for the build that made them:
+ *    "BNST"   4 byte magic
+ *    uint32   STATE_VERSION
+ *    chunks   4 byte tag, uint32 payload length, payload
+ *
+ * Each module serializes the bound instance's state (see nes.h) into its chunk with state_write and
+ * reads it back with state_read in the same order. Loaders skip chunks they do not know and refuse a state whose
+ * chunks do not have the lengths the running build and cartridge expect, so nothing is half loaded.
+*/
+
+#define STATE_VERSION 2
+
+typedef struct State_Buffer_t
+{
+   uint8_t* data;
+   size_t   size;        // bytes of state held in data
+   size_t   capacity;    // bytes allocated for data, grown by state_write as needed
+   size_t   position;    // read cursor used while loading
+   size_t   chunk_start; // offset of the chunk currently being written
+   bool     measure;     // only count bytes, nothing is written or read
+   bool     error;       // set when an allocation fails or a read runs past the end of a chunk
+} State_Buffer_t;
+
+/**
+ * Serializes the current machine state into buffer, replacing whatever it held.
+ * The buffer's memory is reused between calls so repeated saves do not allocate.
+ * Must not be called while the emulation thread is running the core.
+ * @param buffer buffer to write into, zero initialize before first use
+ * @returns false on fail, otherwise return true.
+*/
+bool state_save(State_Buffer_t* buffer);
+
+/**
+ * Restores the machine state from a blob made by state_save for the currently loaded cartridge.
+ * Nothing is changed if the blob is invalid or was made for a different cartridge.
+ * @param buffer buffer holding the state
+ * @returns false on fail, otherwise return true.
+*/
+bool state_load(const State_Buffer_t* buffer);
+
+/**
+ * Frees the memory held by a state buffer.
+*/
+void state_buffer_free(State_Buffer_t* buffer);
+
+/**
+ * Appends raw bytes to the chunk being written.
+*/
+void state_write(State_Buffer_t* buffer, const void* data, size_t size);
+
+/**
+ * Reads raw bytes from the chunk being loaded.
+ * @returns false if the chunk does not hold that many more bytes
+*/
+bool state_read(State_Buffer_t* buffer, void* data, size_t size);
+
+/**
+ * Writes a variable or array while saving and reads it back while loading, so a module can list
+ * its state once for both directions.
+*/
+#define state_sync(buffer, saving, variable) \
+   ( (saving) ? state_write( (buffer), &(variable), sizeof(variable) ) : (void) state_read( (buffer), &(variable), sizeof(variable) ) )
+
+#endif
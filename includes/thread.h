@@ -0,0 +1,83 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <stdatomic.h>
+#endif
+
+/**
+ * thread.h wraps the few threading primitives the core uses so batch.c, rom_image.c, battery_save.c
+ * and rom_library.c share one implementation: Win32 threads, slim reader/writer locks and condition
+ * variables on Windows, pthreads and C11 atomics everywhere else.
+*/
+
+#if _WIN32
+typedef HANDLE             Thread_t;
+typedef SRWLOCK            Thread_Lock_t;
+typedef CONDITION_VARIABLE Thread_Condition_t;
+typedef volatile LONG      Thread_Counter_t;
+#define THREAD_LOCK_INIT   SRWLOCK_INIT
+#else
+typedef pthread_t          Thread_t;
+typedef pthread_mutex_t    Thread_Lock_t;
+typedef pthread_cond_t     Thread_Condition_t;
+typedef atomic_uint        Thread_Counter_t;
+#define THREAD_LOCK_INIT   PTHREAD_MUTEX_INITIALIZER
+#endif
+
+/**
+ * @returns number of cores the host has online, at least 1
+*/
+uint32_t thread_host_cores(void);
+
+/**
+ * Starts a thread running function(data).
+ * @returns false on fail, otherwise return true.
+*/
+bool thread_start(Thread_t* thread, void (*function)(void* data), void* data);
+
+/**
+ * Waits for a thread started by thread_start to return and frees it.
+*/
+void thread_join(Thread_t thread);
+
+/**
+ * Initializes a lock that was not statically initialized with THREAD_LOCK_INIT.
+*/
+void thread_lock_init(Thread_Lock_t* lock);
+void thread_lock_destroy(Thread_Lock_t* lock);
+void thread_lock(Thread_Lock_t* lock);
+void thread_unlock(Thread_Lock_t* lock);
+
+void thread_condition_init(Thread_Condition_t* condition);
+void thread_condition_destroy(Thread_Condition_t* condition);
+
+/**
+ * Releases lock while waiting on condition and takes it again before returning, lock must be held.
+ * Can wake up without being signalled, so callers wait in a loop on their own state.
+*/
+void thread_wait(Thread_Condition_t* condition, Thread_Lock_t* lock);
+
+/**
+ * Wakes every thread waiting on condition.
+*/
+void thread_wake_all(Thread_Condition_t* condition);
+
+/**
+ * Sets a counter, only while no other thread uses it.
+*/
+void thread_counter_set(Thread_Counter_t* counter, uint32_t value);
+
+/**
+ * Atomically increments a counter.
+ * @returns value of the counter before the increment
+*/
+uint32_t thread_counter_claim(Thread_Counter_t* counter);
+
+#endif
@@ -1,6 +1,19 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <stdint.h>
+#include <stddef.h>
+
+#define FNV1A_64_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define FNV1A_64_PRIME        0x00000100000001B3ULL
+
+// each thread can have a different emulator instance bound, see nes.h
+#if defined(_MSC_VER)
+#define NES_THREAD_LOCAL __declspec(thread)
+#else
+#define NES_THREAD_LOCAL _Thread_local
+#endif
+
 /**
  * Clears the bit at the specified position of target.
  * @param target target value to set bit on
@@ -23,4 +36,22 @@
 */
 #define store_bit(target, bit, position) target = ( target & ~( 1 << position ) ) | ( bit << position )
 
+/**
+ * Continues a 64 bit FNV-1a hash over a block of memory.
+ * @param hash hash so far, FNV1A_64_OFFSET_BASIS to start a new one
+ * @param data memory to hash
+ * @param size bytes to hash
+ * @returns updated hash
+*/
+static inline uint64_t fnv1a_64(uint64_t hash, const void* data, size_t size)
+{
+   const uint8_t* bytes = (const uint8_t*) data;
+   for (size_t i = 0; i < size; ++i)
+   {
+      hash = (hash ^ bytes[i]) * FNV1A_64_PRIME;
+   }
+
+   return hash;
+}
+
 #endif
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "includes/rom_library.h"
+
+/**
+ * Rom library scanner. Scans a directory tree for .nes files on a pool of threads, updating the
+ * index in the working directory, and lists every rom with its mapper, whether the emulator
+ * supports it, its CRC32 and SHA-1. Fix-ups in the fix-up file of the working directory are
+ * applied to the listed headers, see rom_library.h.
+ *
+ * usage: BudgetNES_library <rom directory> [threads]
+*/
+
+static double library_scan_now_seconds(void);
+
+int main(int argc, char *argv[])
+{
+   if (argc < 2)
+   {
+      printf("usage: %s <rom directory> [threads]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   long threads = (argc > 2) ? strtol(argv[2], NULL, 10) : 0;
+   if (threads < 0)
+   {
+      printf("Invalid arguments!\n");
+      return EXIT_FAILURE;
+   }
+
+   rom_library_load_index(ROM_LIBRARY_INDEX_FILE);
+   rom_library_load_fixups(ROM_LIBRARY_FIXUP_FILE);
+
+   double start = library_scan_now_seconds();
+   if (!rom_library_scan(argv[1], (uint32_t) threads))
+   {
+      rom_library_free();
+      return EXIT_FAILURE;
+   }
+   double elapsed = library_scan_now_seconds() - start;
+
+   uint32_t count = rom_library_get_count();
+   uint32_t supported = 0;
+
+   printf("%-6s %-9s %-5s %-8s %-40s %s\n", "Mapper", "Supported", "Fixed", "CRC32", "SHA-1", "Path");
+   for (uint32_t i = 0; i < count; ++i)
+   {
+      const Rom_Library_Entry_t* entry = rom_library_get_entry(i);
+      if (!entry->is_valid)
+      {
+         printf("%-6s %-9s %-5s %-8s %-40s %s\n", "-", "invalid", "-", "-", "-", entry->path);
+         continue;
+      }
+
+      char sha1[SHA1_DIGEST_SIZE * 2 + 1];
+      for (int k = 0; k < SHA1_DIGEST_SIZE; ++k)
+      {
+         snprintf(sha1 + k * 2, 3, "%02x", entry->sha1[k]);
+      }
+
+      printf("%-6u %-9s %-5s %08X %s %s\n", entry->header.mapper_id,
+         entry->is_mapper_supported ? "yes" : "no", entry->is_header_fixed ? "yes" : "no",
+         (unsigned) entry->crc32, sha1, entry->path);
+
+      supported += entry->is_mapper_supported ? 1 : 0;
+   }
+
+   printf("\n");
+   printf("Roms:       %u\n", count);
+   printf("Supported:  %u\n", supported);
+   printf("Read:       %u (the rest were unchanged in the index)\n", rom_library_get_read_count());
+   printf("Host time:  %.3f s\n", elapsed);
+
+   bool is_saved = rom_library_save_index(ROM_LIBRARY_INDEX_FILE);
+   rom_library_free();
+
+   return is_saved ? 0 : EXIT_FAILURE;
+}
+
+static double library_scan_now_seconds(void)
+{
+   struct timespec ts;
+   timespec_get(&ts, TIME_UTC);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
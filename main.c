@@ -11,6 +11,10 @@
 #include "includes/cartridge.h"
 #include "includes/log.h"
 #include "includes/display.h"
+#include "includes/emu_thread.h"
+#include "includes/rewind.h"
+#include "includes/battery_save.h"
+#include "includes/rom_library.h"
 
 static bool budgetNES_init(int argc, char *rom_path[]);
 static void budgetNES_run(void);
@@ -32,13 +36,17 @@ int main(int argc, char *argv[])
 
 static bool budgetNES_init(int argc, char *rom_path[])
 {
-	if (!display_init() || !apu_init())
+	if (!display_init() || !apu_init() || !rewind_init(REWIND_DEFAULT_BUDGET) || !battery_save_init(BATTERY_SAVE_DEFAULT_INTERVAL))
 	{
 		return false;
 	}
 
 	ppu_load_default_palettes();
 
+	// header fix-ups for roms in a scanned library, both files are optional
+	rom_library_load_index(ROM_LIBRARY_INDEX_FILE);
+	rom_library_load_fixups(ROM_LIBRARY_FIXUP_FILE);
+
    // try loading rom from command line argument if possible
    if (argc > 1)
    {
@@ -51,56 +59,35 @@ static bool budgetNES_init(int argc, char *rom_path[])
 		cpu_init();
 		apu_pause(false);
    }
+
+	// the core runs on its own thread from here on, the main thread only handles the gui
+	if (!emu_thread_start())
+	{
+		return false;
+	}
+
    return true;
 }
 
 static void budgetNES_run(void)
 {
-	Emulator_State_t* emulator_state = get_emulator_state();
-	float delta_time = 0;
-	float previous_time = 0;
-	float current_time = 0;
-
 	bool done = false;
 	while (!done)
 	{
-		current_time = SDL_GetTicks64() / 1000.0f;
-		delta_time += current_time - previous_time;
-
 		display_process_event(&done);
-
-		switch (emulator_state->run_state)
-		{
-			case EMULATOR_RUNNING:
-			{
-				cpu_run_with_audio(&delta_time);
-				break;
-			}
-			case EMULATOR_PAUSED:
-			{
-				if (emulator_state->is_instruction_step)
-				{
-					cpu_emulate_instruction();
-					emulator_state->is_instruction_step = false;
-				}
-
-				emulator_state->reset_delta_timers = true;
-				break;
-			}
-			default:
-				break;
-		}
-
 		display_render();
 		display_update();
-		previous_time = current_time;
 	}
 }
 
 static void budgetNES_shutdown(void)
 {
+   emu_thread_stop();
    apu_shutdown();
+   rewind_shutdown();
    log_free();
    cartridge_free_memory();
+   battery_save_shutdown(); // after the cartridge queued its last save
+   rom_library_free();
    display_shutdown();
 }
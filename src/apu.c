@@ -1,9 +1,14 @@
-#include "SDL_audio.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 
 #include "apu.h"
+#include "audio_device.h"
 #include "cpu.h"
 #include "bus.h"
 #include "cartridge.h"
+#include "util.h"
 #include "CBlip_buffer.h"
 
 #define DUTY_CYCLE_0 0x40 // duty cycle of 12.5%
@@ -11,21 +16,33 @@
 #define DUTY_CYCLE_2 0x78 // duty cycle of 50%
 #define DUTY_CYCLE_3 0x9F // duty cycle of 75%
 
-static SDL_AudioDeviceID audio_device_ID;
-
-static Pulse_t        pulse_1;
-static Pulse_t			 pulse_2;
-static Triangle_t     triangle_1;
-static Noise_t        noise_1;
-static Dmc_t          dmc_1;
-static Framecounter_t frame_counter;
-static size_t sequencer_timer_cpu_tick = 0; // elapsed apu cycles used to track when to clock the next sequence
-
-static bool frame_interrupt_flag;
-static bool dmc_interrupt_flag;
+struct Apu_Context_t
+{
+	Pulse_t        pulse_1;
+	Pulse_t        pulse_2;
+	Triangle_t     triangle_1;
+	Noise_t        noise_1;
+	Dmc_t          dmc_1;
+	Framecounter_t frame_counter;
+	size_t sequencer_timer_cpu_tick; // elapsed apu cycles used to track when to clock the next sequence
+
+	bool frame_interrupt_flag;
+	bool dmc_interrupt_flag;
+
+	// the apu runs lazily behind the cpu and is caught up in batches, see apu_catch_up
+
+	long apu_cycle;        // cpu cycle of the next apu tick that has not run yet
+	bool pulse_clock_even; // pulse timers are clocked on every 2nd apu tick
+	bool output_dirty;     // a register write may have changed an output, run the next tick in full
+
+	CBlip_Buffer* blip_buffer;
+	CBlipSynth synth_1;
+	int  mixer_output; // last amplitude handed to blip, mirrors the synth's own last amplitude
+	bool is_muted;
+};
 
-static CBlip_Buffer* buffer;
-static CBlipSynth synth_1;
+static Apu_Context_t default_context = { .pulse_clock_even = true, .output_dirty = true };
+static NES_THREAD_LOCAL Apu_Context_t* apu = &default_context; // context of the instance bound to this thread
 
 // lookup table of values used in the lengh counter -> https://www.nesdev.org/wiki/APU_Length_Counter
 static uint8_t length_lut[] = 
@@ -51,6 +68,10 @@ static uint16_t dmc_period_lut[] =
 	428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106,  84,  72,  54
 };
 
+// nonlinear mixer lookup tables, filled in by init_mixer_tables -> https://www.nesdev.org/wiki/APU_Mixer
+static float pulse_table[31];  // indexed by pulse 1 + pulse 2
+static float tnd_table[203];   // indexed by 3 * triangle + 2 * noise + dmc
+
 static void clock_quarter_frame(void);
 static void clock_half_frame(void);
 
@@ -72,43 +93,32 @@ static void clock_noise_envelope(Noise_t* noise);
 static void clock_dmc_sequencer(Dmc_t* dmc);
 static void dmc_memory_reader(Dmc_t* dmc);
 
-static void mix_audio(long time, float p1, float p2, float t1, float n1, float d1);
+static void apu_tick(void);
+static void apu_skip_ticks(long ticks);
+static long apu_quiet_ticks(void);
+static long pulse_quiet_ticks(Pulse_t* pulse);
+static void update_irq_deadline(void);
+static void set_frame_interrupt(bool flag);
+static void set_dmc_interrupt(bool flag);
+
+static void init_mixer_tables(void);
+static bool open_blip_buffer(Apu_Context_t* context);
+static void close_blip_buffer(Apu_Context_t* context);
+static void mix_audio(long time, uint8_t p1, uint8_t p2, uint8_t t1, uint8_t n1, uint8_t d1);
 
 bool apu_init(void)
 {
-   SDL_AudioSpec want, have;
-
-   SDL_zero(want);
-   want.freq = 44100;
-   want.format = AUDIO_S16SYS;
-   want.samples = 1024;
-   want.channels = 1;
-
-   audio_device_ID = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
-   if (audio_device_ID == 0)
+   if (!audio_device_open(APU_SAMPLE_RATE))
    {
-      printf("Failed to initialize audio device: %s\n", SDL_GetError());
       return false;
    }
 
-	buffer = create_cblip_buffer();
-	synth_1 = create_cblip_synth();
+	apu_set_audio_latency(APU_DEFAULT_LATENCY_FRAMES);
+	init_mixer_tables();
 
-	if (!buffer)
-		return false;
-	if (!synth_1)
+	if (!open_blip_buffer(&default_context))
 		return false;
 
-	cblip_buffer_clock_rate(buffer, 1800000);
-	if (cblip_buffer_set_sample_rate(buffer, 44100, 1000/60))
-		return false;
-
-	cblip_synth_volume(synth_1, 0.005);
-	cblip_synth_output(synth_1, buffer);
-	cblip_buffer_bass_freq(buffer, 1);
-	cblip_synth_treble_eq(synth_1, 5.0);
-
-
 	apu_reset_internals();
 
    return true;
@@ -116,33 +126,82 @@ bool apu_init(void)
 
 void apu_reset_internals(void)
 {
-	frame_interrupt_flag = false;
-	dmc_interrupt_flag = false;
+	set_frame_interrupt(false);
+	set_dmc_interrupt(false);
+
+	memset(&apu->pulse_1, 0, sizeof(Pulse_t));
+	memset(&apu->pulse_2, 0, sizeof(Pulse_t));
+	memset(&apu->triangle_1, 0, sizeof(Triangle_t));
+	memset(&apu->noise_1, 0, sizeof(Noise_t));
+	memset(&apu->dmc_1, 0, sizeof(Dmc_t));
+	memset(&apu->frame_counter, 0, sizeof(Framecounter_t));
+	apu->sequencer_timer_cpu_tick = 0;
+	apu->pulse_clock_even = true;
+
+	apu->noise_1.shift_register = 1;
+	apu->dmc_1.silence_flag = true;
+
+	// ticks still owed to the old cartridge are dropped rather than run against the new one
+	apu->apu_cycle = get_cpu()->cycle_count;
+	apu->output_dirty = true;
+	update_irq_deadline();
+}
 
-	memset(&pulse_1, 0, sizeof(Pulse_t));
-	memset(&pulse_2, 0, sizeof(Pulse_t));
-	memset(&triangle_1, 0, sizeof(Triangle_t));
-	memset(&noise_1, 0, sizeof(Noise_t));
-	memset(&dmc_1, 0, sizeof(Dmc_t));
+void apu_shutdown(void)
+{
+	close_blip_buffer(&default_context);
+   audio_device_close();
+}
 
-	noise_1.shift_register = 1;
-	dmc_1.silence_flag = true;
+Apu_Context_t* apu_context_create(void)
+{
+	Apu_Context_t* context = calloc(1, sizeof(Apu_Context_t));
+	if (context == NULL)
+		return NULL;
+
+	context->pulse_clock_even = true;
+	context->output_dirty = true;
+	context->noise_1.shift_register = 1;
+	context->dmc_1.silence_flag = true;
+
+	if (!open_blip_buffer(context))
+	{
+		apu_context_destroy(context);
+		return NULL;
+	}
+
+	return context;
 }
 
-void apu_shutdown(void)
+void apu_context_destroy(Apu_Context_t* context)
+{
+	if (context == NULL)
+		return;
+
+	close_blip_buffer(context);
+	free(context);
+}
+
+void apu_bind(Apu_Context_t* context)
 {
-	free_cblip_buffer(buffer);
-	free_cblip_synth(synth_1);
-   SDL_CloseAudioDevice(audio_device_ID);
+	apu = (context != NULL) ? context : &default_context;
 }
 
 void apu_pause(bool flag)
 {
-	SDL_PauseAudioDevice(audio_device_ID, flag ? 1 : 0);
+	audio_device_pause(flag);
+}
+
+void apu_mute(bool flag)
+{
+	apu->is_muted = flag;
 }
 
 void apu_write(uint16_t position, uint8_t data)
 {
+	apu_catch_up();
+	apu->output_dirty = true;
+
    switch (position)
    {
       // pulse 1 channel
@@ -153,50 +212,50 @@ void apu_write(uint16_t position, uint8_t data)
          switch ( (data & 0xC0) >> 6 )
          {
             case 0:
-               pulse_1.sequence_reload = DUTY_CYCLE_0; // duty cycle of 12.5%
+               apu->pulse_1.sequence_reload = DUTY_CYCLE_0; // duty cycle of 12.5%
                break;
             case 1:
-               pulse_1.sequence_reload = DUTY_CYCLE_1; // duty cycle of 25%
+               apu->pulse_1.sequence_reload = DUTY_CYCLE_1; // duty cycle of 25%
                break;
             case 2:
-               pulse_1.sequence_reload = DUTY_CYCLE_2; // duty cycle of 50%
+               apu->pulse_1.sequence_reload = DUTY_CYCLE_2; // duty cycle of 50%
                break;
             case 3:
-               pulse_1.sequence_reload = DUTY_CYCLE_3; // duty cycle of 75%
+               apu->pulse_1.sequence_reload = DUTY_CYCLE_3; // duty cycle of 75%
                break;
             default:
                break;
          }
 
-         pulse_1.volume = data & 0x0F;
-         pulse_1.length_counter_halt = (data & 0x20) >> 5;
-         pulse_1.constant_volume_enable = (data & 0x10) >> 4;
+         apu->pulse_1.volume = data & 0x0F;
+         apu->pulse_1.length_counter_halt = (data & 0x20) >> 5;
+         apu->pulse_1.constant_volume_enable = (data & 0x10) >> 4;
 
          break;
       }
       case 0x4001: // eppp nsss        enable, period, negate, shift
       {
-         pulse_1.sweep_reload = (data & 0x70) >> 4; // period
-         pulse_1.sweep_negate = (data & 0x08) >> 3;
-         pulse_1.sweep_shift =  (data & 0x07);
-         pulse_1.sweep_enable = pulse_1.sweep_shift != 0 ? (data & 0x80) >> 7 : 0;
-			pulse_1.sweep_reset = true;
+         apu->pulse_1.sweep_reload = (data & 0x70) >> 4; // period
+         apu->pulse_1.sweep_negate = (data & 0x08) >> 3;
+         apu->pulse_1.sweep_shift =  (data & 0x07);
+         apu->pulse_1.sweep_enable = apu->pulse_1.sweep_shift != 0 ? (data & 0x80) >> 7 : 0;
+			apu->pulse_1.sweep_reset = true;
 
          break;
       }
       case 0x4002:
       {
-			pulse_1.timer_reload = (pulse_1.timer_reload & 0x700) | data; // set low 8 bits of reload timer
+			apu->pulse_1.timer_reload = (apu->pulse_1.timer_reload & 0x700) | data; // set low 8 bits of reload timer
          break;
       }
       case 0x4003:
       {
-         pulse_1.timer_reload = (pulse_1.timer_reload & 0x00FF) | ((data & 0x7) << 8); // set high 3 bits of reload timer
-         pulse_1.sequence = pulse_1.sequence_reload;
-         pulse_1.envelope_reset = true;
+         apu->pulse_1.timer_reload = (apu->pulse_1.timer_reload & 0x00FF) | ((data & 0x7) << 8); // set high 3 bits of reload timer
+         apu->pulse_1.sequence = apu->pulse_1.sequence_reload;
+         apu->pulse_1.envelope_reset = true;
 
-         if (pulse_1.channel_enable == true) 
-				pulse_1.length_counter = length_lut[ (data >> 3) & 0x1F ];
+         if (apu->pulse_1.channel_enable == true) 
+				apu->pulse_1.length_counter = length_lut[ (data >> 3) & 0x1F ];
          break;
       }
 
@@ -207,50 +266,50 @@ void apu_write(uint16_t position, uint8_t data)
 			switch ((data & 0xC0) >> 6)
 			{
 				case 0:
-					pulse_2.sequence_reload = DUTY_CYCLE_0; // duty cycle of 12.5%
+					apu->pulse_2.sequence_reload = DUTY_CYCLE_0; // duty cycle of 12.5%
 					break;
 				case 1:
-					pulse_2.sequence_reload = DUTY_CYCLE_1; // duty cycle of 25%
+					apu->pulse_2.sequence_reload = DUTY_CYCLE_1; // duty cycle of 25%
 					break;
 				case 2:
-					pulse_2.sequence_reload = DUTY_CYCLE_2; // duty cycle of 50%
+					apu->pulse_2.sequence_reload = DUTY_CYCLE_2; // duty cycle of 50%
 					break;
 				case 3:
-					pulse_2.sequence_reload = DUTY_CYCLE_3; // duty cycle of 75%
+					apu->pulse_2.sequence_reload = DUTY_CYCLE_3; // duty cycle of 75%
 					break;
 				default:
 					break;
 			}
 
-			pulse_2.volume = data & 0x0F;
-			pulse_2.length_counter_halt = (data & 0x20) >> 5;
-			pulse_2.constant_volume_enable = (data & 0x10) >> 4;
+			apu->pulse_2.volume = data & 0x0F;
+			apu->pulse_2.length_counter_halt = (data & 0x20) >> 5;
+			apu->pulse_2.constant_volume_enable = (data & 0x10) >> 4;
 
 			break;
 		}
 		case 0x4005:
 		{
-			pulse_2.sweep_reload = (data & 0x70) >> 4; // period
-			pulse_2.sweep_negate = (data & 0x08) >> 3;
-			pulse_2.sweep_shift = (data & 0x07);
-			pulse_2.sweep_enable = pulse_2.sweep_shift != 0 ? (data & 0x80) >> 7 : 0;
-			pulse_2.sweep_reset = true;
+			apu->pulse_2.sweep_reload = (data & 0x70) >> 4; // period
+			apu->pulse_2.sweep_negate = (data & 0x08) >> 3;
+			apu->pulse_2.sweep_shift = (data & 0x07);
+			apu->pulse_2.sweep_enable = apu->pulse_2.sweep_shift != 0 ? (data & 0x80) >> 7 : 0;
+			apu->pulse_2.sweep_reset = true;
 
 			break;
 		}
 		case 0x4006:
 		{
-			pulse_2.timer_reload = (pulse_2.timer_reload & 0x0700) | data;
+			apu->pulse_2.timer_reload = (apu->pulse_2.timer_reload & 0x0700) | data;
 			break;
 		}
 		case 0x4007:
 		{
-			pulse_2.timer_reload = (pulse_2.timer_reload & 0x00FF) | ((data & 0x7) << 8); // set high 3 bits of reload timer
-			pulse_2.sequence = pulse_2.sequence_reload;
-			pulse_2.envelope_reset = true;
+			apu->pulse_2.timer_reload = (apu->pulse_2.timer_reload & 0x00FF) | ((data & 0x7) << 8); // set high 3 bits of reload timer
+			apu->pulse_2.sequence = apu->pulse_2.sequence_reload;
+			apu->pulse_2.envelope_reset = true;
 
-			if (pulse_2.channel_enable == true) 
-				pulse_2.length_counter = length_lut[(data >> 3) & 0x1F];
+			if (apu->pulse_2.channel_enable == true) 
+				apu->pulse_2.length_counter = length_lut[(data >> 3) & 0x1F];
 
 			break;
 		}
@@ -259,22 +318,22 @@ void apu_write(uint16_t position, uint8_t data)
 
 		case 0x4008:
 		{
-			triangle_1.control_flag = (data & 0x80) >> 7;
-			triangle_1.linear_counter_reload = data & 0x7F;
+			apu->triangle_1.control_flag = (data & 0x80) >> 7;
+			apu->triangle_1.linear_counter_reload = data & 0x7F;
 
 			break;
 		}
 		// 0x4009 is unused
 		case 0x400A:
 		{
-			triangle_1.timer_reload = (triangle_1.timer_reload & 0x0700) | data; // lo 8 bits of 11 bit timer
+			apu->triangle_1.timer_reload = (apu->triangle_1.timer_reload & 0x0700) | data; // lo 8 bits of 11 bit timer
 			break;
 		}
 		case 0x400B:
 		{
-			triangle_1.timer_reload = (triangle_1.timer_reload & 0x00FF) | ((data & 0x7) << 8); // hi 3 bits of 11 bit timer
-			triangle_1.length_counter = length_lut[(data >> 3) & 0x1F];
-			triangle_1.linear_counter_reset = true;
+			apu->triangle_1.timer_reload = (apu->triangle_1.timer_reload & 0x00FF) | ((data & 0x7) << 8); // hi 3 bits of 11 bit timer
+			apu->triangle_1.length_counter = length_lut[(data >> 3) & 0x1F];
+			apu->triangle_1.linear_counter_reset = true;
 			break;
 		}
 
@@ -282,25 +341,25 @@ void apu_write(uint16_t position, uint8_t data)
 
 		case 0x400C:
 		{
-			noise_1.volume = data & 0xF;
-			noise_1.constant_volume_enable = (data >> 4) & 0x1;
-			noise_1.length_counter_halt = (data >> 5) & 0x1;
+			apu->noise_1.volume = data & 0xF;
+			apu->noise_1.constant_volume_enable = (data >> 4) & 0x1;
+			apu->noise_1.length_counter_halt = (data >> 5) & 0x1;
 
 			break;
 		}
 		case 0x400E:
 		{
-			noise_1.noise_mode = (data >> 7) & 0x1;
-			noise_1.timer_reload = noise_period_lut[data & 0xF];
+			apu->noise_1.noise_mode = (data >> 7) & 0x1;
+			apu->noise_1.timer_reload = noise_period_lut[data & 0xF];
 
 			break;
 		}
 		// 0x400D is unused
 		case 0x400F:
 		{
-			noise_1.envelope_reset = true;
-			if (noise_1.channel_enable)
-				noise_1.length_counter = length_lut[(data >> 3) & 0x1F];
+			apu->noise_1.envelope_reset = true;
+			if (apu->noise_1.channel_enable)
+				apu->noise_1.length_counter = length_lut[(data >> 3) & 0x1F];
 
 			break;
 		}
@@ -309,82 +368,82 @@ void apu_write(uint16_t position, uint8_t data)
 
 		case 0x4010:
 		{
-			dmc_1.irq_enable = (data >> 7) & 0x1;
-			if (dmc_1.irq_enable == false) // clear interupt flag if irq enable is also cleared
-				dmc_interrupt_flag = false;
+			apu->dmc_1.irq_enable = (data >> 7) & 0x1;
+			if (apu->dmc_1.irq_enable == false) // clear interupt flag if irq enable is also cleared
+				set_dmc_interrupt(false);
 
-			dmc_1.loop_flag = (data >> 6) & 0x1;
-			dmc_1.timer_reload = dmc_period_lut[data & 0xF];
+			apu->dmc_1.loop_flag = (data >> 6) & 0x1;
+			apu->dmc_1.timer_reload = dmc_period_lut[data & 0xF];
 
 			break;
 		}
 		case 0x4011:
 		{
-			dmc_1.out = data & 0x7F;
+			apu->dmc_1.out = data & 0x7F;
 			break;
 		}
 		case 0x4012:
 		{
 			// %11AAAAAA.AA000000 = $C000 + (data * 64)
 
-			dmc_1.sample_address = 0xC000 | (data << 6);
+			apu->dmc_1.sample_address = 0xC000 | (data << 6);
 			break;
 		}
 		case 0x4013:
 		{
 			// %LLLL.LLLL0001 = (L * 16) + 1 bytes
 
-			dmc_1.sample_bytes_length = 0x001 | (data << 4);
+			apu->dmc_1.sample_bytes_length = 0x001 | (data << 4);
 			break;
 		}
 
       // status register
       case 0x4015:
       {
-			pulse_1.channel_enable = data & 0x1;
-         if (pulse_1.channel_enable == false) 
-            pulse_1.length_counter = 0;
+			apu->pulse_1.channel_enable = data & 0x1;
+         if (apu->pulse_1.channel_enable == false) 
+            apu->pulse_1.length_counter = 0;
 
-			pulse_2.channel_enable = (data & 0x2) >> 1;
-			if (pulse_2.channel_enable == false)
-				pulse_2.length_counter = 0;
+			apu->pulse_2.channel_enable = (data & 0x2) >> 1;
+			if (apu->pulse_2.channel_enable == false)
+				apu->pulse_2.length_counter = 0;
 
-			triangle_1.channel_enable = (data & 0x4) >> 2;
-			if (triangle_1.channel_enable == false)
-				triangle_1.length_counter = 0;
+			apu->triangle_1.channel_enable = (data & 0x4) >> 2;
+			if (apu->triangle_1.channel_enable == false)
+				apu->triangle_1.length_counter = 0;
 
-			noise_1.channel_enable = (data & 0x8) >> 3;
-			if (noise_1.channel_enable == false)
-				noise_1.length_counter = 0;
+			apu->noise_1.channel_enable = (data & 0x8) >> 3;
+			if (apu->noise_1.channel_enable == false)
+				apu->noise_1.length_counter = 0;
 
-			dmc_1.channel_enable = (data & 0x10) >> 4;
-			if (dmc_1.channel_enable)
+			apu->dmc_1.channel_enable = (data & 0x10) >> 4;
+			if (apu->dmc_1.channel_enable)
 			{
-				if (dmc_1.sample_bytes_remaining == 0) // restart dmc sample when remain samples is zero
+				if (apu->dmc_1.sample_bytes_remaining == 0) // restart dmc sample when remain samples is zero
 				{
-					dmc_1.sample_bytes_remaining = dmc_1.sample_bytes_length;
-					dmc_1.current_sample_address = dmc_1.sample_address;
+					apu->dmc_1.sample_bytes_remaining = apu->dmc_1.sample_bytes_length;
+					apu->dmc_1.current_sample_address = apu->dmc_1.sample_address;
 				}
 			}
 			else // set remaining sample bytes to zero when dmc is disabled
-				dmc_1.sample_bytes_remaining = 0;
+				apu->dmc_1.sample_bytes_remaining = 0;
 
 
-			dmc_interrupt_flag = false; // clear/acknowledge interrupt flag on status write
+			set_dmc_interrupt(false); // clear/acknowledge interrupt flag on status write
 
          break;
       }
       // frame counter
       case 0x4017:
       {
-         frame_counter.sequencer_mode = (data >> 7) & 0x1;
-         frame_counter.IRQ_inhibit    = (data >> 6) & 0x1;
-			sequencer_timer_cpu_tick = 0;
+         apu->frame_counter.sequencer_mode = (data >> 7) & 0x1;
+         apu->frame_counter.IRQ_inhibit    = (data >> 6) & 0x1;
+			apu->sequencer_timer_cpu_tick = 0;
 
-			if (frame_counter.IRQ_inhibit)
-				frame_interrupt_flag = false;
+			if (apu->frame_counter.IRQ_inhibit)
+				set_frame_interrupt(false);
 
-			if (frame_counter.sequencer_mode)
+			if (apu->frame_counter.sequencer_mode)
 			{
 				clock_quarter_frame();
 				clock_half_frame();
@@ -395,63 +454,95 @@ void apu_write(uint16_t position, uint8_t data)
 
       default: break;
    }
+
+	update_irq_deadline();
+}
+
+void apu_catch_up(void)
+{
+	long target_cycle = get_cpu()->cycle_count;
+
+	while (apu->apu_cycle < target_cycle)
+	{
+		// channel outputs only change on ticks where a timer expires, the frame counter steps or a
+		// register was written, everything in between is skipped over in one go
+		long quiet = apu->output_dirty ? 0 : apu_quiet_ticks();
+		if (quiet >= target_cycle - apu->apu_cycle)
+		{
+			apu_skip_ticks(target_cycle - apu->apu_cycle);
+			break;
+		}
+
+		apu_skip_ticks(quiet);
+		apu_tick();
+		apu->output_dirty = false;
+	}
+
+	update_irq_deadline();
+}
+
+void apu_rebase_cpu_cycle(long cycle_count)
+{
+	apu->apu_cycle = cycle_count;
 }
 
 /**
  * Clocks the apu for one cycle
  */
-void apu_tick(long audio_time)
+static void apu_tick(void)
 {
+	long audio_time = apu->apu_cycle++;
+
    bool quarterFrame = false;
    bool halfFrame = false;
 
-   ++sequencer_timer_cpu_tick;
+   ++apu->sequencer_timer_cpu_tick;
 
-   if (frame_counter.sequencer_mode == 0) // 4-step mode
+   if (apu->frame_counter.sequencer_mode == 0) // 4-step mode
    {
-      if (sequencer_timer_cpu_tick == 7457)
+      if (apu->sequencer_timer_cpu_tick == 7457)
       {
          quarterFrame = true;
       }
-      else if (sequencer_timer_cpu_tick == 14913)
+      else if (apu->sequencer_timer_cpu_tick == 14913)
       {
          quarterFrame = true;
          halfFrame = true;
       }
-      else if (sequencer_timer_cpu_tick == 22371)
+      else if (apu->sequencer_timer_cpu_tick == 22371)
       {
          quarterFrame = true;
       }
-      else if (sequencer_timer_cpu_tick == 29829)
+      else if (apu->sequencer_timer_cpu_tick == 29829)
       {
          quarterFrame = true;
          halfFrame = true;
-         sequencer_timer_cpu_tick = 0;
+         apu->sequencer_timer_cpu_tick = 0;
       } 
    }
    else // 5-step mode
    {
-		if (sequencer_timer_cpu_tick == 7457)
+		if (apu->sequencer_timer_cpu_tick == 7457)
 		{
 			quarterFrame = true;
 		}
-		else if (sequencer_timer_cpu_tick == 14913)
+		else if (apu->sequencer_timer_cpu_tick == 14913)
 		{
 			quarterFrame = true;
 			halfFrame = true;
 		}
-		else if (sequencer_timer_cpu_tick == 22371)
+		else if (apu->sequencer_timer_cpu_tick == 22371)
 		{
 			quarterFrame = true;
 		}
-		else if (sequencer_timer_cpu_tick == 37281)
+		else if (apu->sequencer_timer_cpu_tick == 37281)
 		{
-			if (frame_counter.IRQ_inhibit == 0)
-				frame_interrupt_flag = true;
+			if (apu->frame_counter.IRQ_inhibit == 0)
+				set_frame_interrupt(true);
 
 			quarterFrame = true;
 			halfFrame = true;
-			sequencer_timer_cpu_tick = 0;
+			apu->sequencer_timer_cpu_tick = 0;
 		}
    }
 
@@ -465,101 +556,204 @@ void apu_tick(long audio_time)
 	}
 	
 	// pulse is clocked every 2nd cpu cycle
-	static bool even = true;
-	if (even)
+	if (apu->pulse_clock_even)
 	{
-		clock_pulse_sequencer(&pulse_1);
-		clock_pulse_sequencer(&pulse_2);
+		clock_pulse_sequencer(&apu->pulse_1);
+		clock_pulse_sequencer(&apu->pulse_2);
 	}
-	even = !even;
+	apu->pulse_clock_even = !apu->pulse_clock_even;
 
 	// triangle channel clocked every cpu cycle
-	clock_triangle_sequencer(&triangle_1);
-	clock_noise_sequencer(&noise_1);
-	clock_dmc_sequencer(&dmc_1);
-	dmc_memory_reader(&dmc_1);
+	clock_triangle_sequencer(&apu->triangle_1);
+	clock_noise_sequencer(&apu->noise_1);
+	clock_dmc_sequencer(&apu->dmc_1);
+	dmc_memory_reader(&apu->dmc_1);
 
-	if (pulse_1.raw_sample != 0 && pulse_1.length_counter != 0 && !pulse_sweep_forcing_silence(&pulse_1))
+	if (apu->pulse_1.raw_sample != 0 && apu->pulse_1.length_counter != 0 && !pulse_sweep_forcing_silence(&apu->pulse_1))
 	{
-		if (pulse_1.constant_volume_enable)
+		if (apu->pulse_1.constant_volume_enable)
 		{
-			pulse_1.out = pulse_1.volume;
+			apu->pulse_1.out = apu->pulse_1.volume;
 		}
 		else
 		{
-			pulse_1.out = pulse_1.envelope_volume;
+			apu->pulse_1.out = apu->pulse_1.envelope_volume;
 		}
 	}
 	else
 	{
-		pulse_1.out = 0;
+		apu->pulse_1.out = 0;
 	}
 
-	if (pulse_2.raw_sample != 0 && pulse_2.length_counter != 0 && !pulse_sweep_forcing_silence(&pulse_2))
+	if (apu->pulse_2.raw_sample != 0 && apu->pulse_2.length_counter != 0 && !pulse_sweep_forcing_silence(&apu->pulse_2))
 	{
-		if (pulse_2.constant_volume_enable)
+		if (apu->pulse_2.constant_volume_enable)
 		{
-			pulse_2.out = pulse_2.volume;
+			apu->pulse_2.out = apu->pulse_2.volume;
 		}
 		else
 		{
-			pulse_2.out = pulse_2.envelope_volume;
+			apu->pulse_2.out = apu->pulse_2.envelope_volume;
 		}
 	}
 	else
 	{
-		pulse_2.out = 0;
+		apu->pulse_2.out = 0;
 	}
 
-	triangle_1.out = triangle_1.raw_sample;
+	apu->triangle_1.out = apu->triangle_1.raw_sample;
 
-	if (noise_1.length_counter != 0 && ((noise_1.shift_register & 0x1) == 0))
+	if (apu->noise_1.length_counter != 0 && ((apu->noise_1.shift_register & 0x1) == 0))
 	{
-		if (noise_1.constant_volume_enable)
+		if (apu->noise_1.constant_volume_enable)
 		{
-			noise_1.raw_samples[noise_1.raw_sample_index] = noise_1.volume;
-			noise_1.out = noise_1.volume;
+			apu->noise_1.out = apu->noise_1.volume;
 		}
 		else
 		{
-			noise_1.raw_samples[noise_1.raw_sample_index] = noise_1.envelope_volume;
-			noise_1.out = noise_1.envelope_volume;
+			apu->noise_1.out = apu->noise_1.envelope_volume;
 		}
 	}
 	else
 	{
-		noise_1.raw_samples[noise_1.raw_sample_index] = 0;
-		noise_1.out = 0;
+		apu->noise_1.out = 0;
 	}
 
 	mix_audio(
 		audio_time,
-		pulse_1.out,
-		pulse_2.out,
-		triangle_1.out,
-		noise_1.out,
-		(float)(dmc_1.out & 0x7F)
+		apu->pulse_1.out,
+		apu->pulse_2.out,
+		apu->triangle_1.out,
+		apu->noise_1.out,
+		apu->dmc_1.out & 0x7F
 	);
+}
+
+/**
+ * Advances every timer by a number of ticks in which none of them expire and the frame counter does not step.
+ * @param ticks number of ticks to skip, must not exceed apu_quiet_ticks
+*/
+static void apu_skip_ticks(long ticks)
+{
+	// pulse timers only count down on the even ticks in the skipped range
+	long pulse_ticks = apu->pulse_clock_even ? (ticks + 1) / 2 : ticks / 2;
+	apu->pulse_1.timer -= (uint16_t) pulse_ticks;
+	apu->pulse_2.timer -= (uint16_t) pulse_ticks;
+	if (ticks & 1)
+	{
+		apu->pulse_clock_even = !apu->pulse_clock_even;
+	}
+
+	apu->triangle_1.timer -= (uint16_t) ticks;
+	apu->noise_1.timer -= (uint16_t) ticks;
+	apu->dmc_1.timer -= (uint16_t) ticks;
+
+	apu->sequencer_timer_cpu_tick += (size_t) ticks;
+	apu->apu_cycle += ticks;
+}
+
+/**
+ * Counts the ticks that can be skipped before the next one where a channel timer expires, the frame
+ * counter steps or the dmc fetches a sample byte.
+*/
+static long apu_quiet_ticks(void)
+{
+	long quiet = pulse_quiet_ticks(&apu->pulse_1);
+
+	long ticks = pulse_quiet_ticks(&apu->pulse_2);
+	if (ticks < quiet) quiet = ticks;
+
+	// these timers are clocked every tick and expire on the tick that finds them at zero
+	if (apu->triangle_1.timer < quiet) quiet = apu->triangle_1.timer;
+	if (apu->noise_1.timer < quiet) quiet = apu->noise_1.timer;
+	if (apu->dmc_1.timer < quiet) quiet = apu->dmc_1.timer;
+
+	if (apu->dmc_1.sample_buffer_filled == false && apu->dmc_1.sample_bytes_remaining > 0)
+		quiet = 0;
+
+	size_t next_step;
+	if (apu->sequencer_timer_cpu_tick < 7457)
+		next_step = 7457;
+	else if (apu->sequencer_timer_cpu_tick < 14913)
+		next_step = 14913;
+	else if (apu->sequencer_timer_cpu_tick < 22371)
+		next_step = 22371;
+	else
+		next_step = apu->frame_counter.sequencer_mode == 0 ? 29829 : 37281;
+
+	ticks = (long) (next_step - apu->sequencer_timer_cpu_tick) - 1;
+	if (ticks < quiet) quiet = ticks;
+
+	return quiet;
+}
+
+static long pulse_quiet_ticks(Pulse_t* pulse)
+{
+	// the timer expires on the (timer + 1)th even tick from now
+	return apu->pulse_clock_even ? 2 * (long) pulse->timer : 2 * (long) pulse->timer + 1;
+}
 
-	noise_1.raw_sample_index = (noise_1.raw_sample_index + 1) % 41;
+/**
+ * Works out the earliest cpu cycle the frame counter or the dmc could raise an interrupt at, so
+ * interrupt polling only has to catch the apu up once that cycle has passed.
+*/
+static void update_irq_deadline(void)
+{
+	long irq_tick = LONG_MAX; // earliest tick either interrupt flag could be raised on
+
+	// the frame interrupt is raised on the tick the 5-step sequence ends
+	if (apu->frame_counter.sequencer_mode == 1 && apu->frame_counter.IRQ_inhibit == 0)
+	{
+		irq_tick = apu->apu_cycle + (long) (37281 - apu->sequencer_timer_cpu_tick) - 1;
+	}
+
+	// the dmc interrupt is raised when the last byte is fetched, the shift register takes 9 timer
+	// periods to empty so every byte but the next one is at least that far apart
+	if (apu->dmc_1.irq_enable && !apu->dmc_1.loop_flag && apu->dmc_1.sample_bytes_remaining > 0)
+	{
+		long dmc_tick = apu->apu_cycle + (long) (apu->dmc_1.sample_bytes_remaining - 1) * 9 * (apu->dmc_1.timer_reload + 1);
+		if (dmc_tick < irq_tick)
+			irq_tick = dmc_tick;
+	}
+
+	// a flag raised on a tick is seen by the cpu once its cycle count has moved past that tick
+	cpu_schedule_event(CPU_EVENT_APU_IRQ, (irq_tick == LONG_MAX) ? LONG_MAX : irq_tick + 1);
+}
+
+static void set_frame_interrupt(bool flag)
+{
+	apu->frame_interrupt_flag = flag;
+	if (flag)
+		cpu_irq_assert(CPU_IRQ_FRAME_COUNTER);
+	else
+		cpu_irq_release(CPU_IRQ_FRAME_COUNTER);
+}
+
+static void set_dmc_interrupt(bool flag)
+{
+	apu->dmc_interrupt_flag = flag;
+	if (flag)
+		cpu_irq_assert(CPU_IRQ_DMC);
+	else
+		cpu_irq_release(CPU_IRQ_DMC);
 }
 
 static void clock_quarter_frame(void)
 {
-	clock_pulse_envelope(&pulse_1);
-	clock_pulse_envelope(&pulse_2);
-	clock_triangle_linear_counter(&triangle_1);
-	clock_noise_envelope(&noise_1);
+	clock_pulse_envelope(&apu->pulse_1);
+	clock_pulse_envelope(&apu->pulse_2);
+	clock_triangle_linear_counter(&apu->triangle_1);
+	clock_noise_envelope(&apu->noise_1);
 }
 
 static void clock_half_frame(void)
 {
-	clock_pulse_sweep(&pulse_1, 1);
-	clock_pulse_sweep(&pulse_2, 2);
-	clock_pulse_length_counter(&pulse_1);
-	clock_pulse_length_counter(&pulse_2);
-	clock_triangle_length_counter(&triangle_1);
-	clock_noise_length_counter(&noise_1); 
+	clock_pulse_sweep(&apu->pulse_1, 1);
+	clock_pulse_sweep(&apu->pulse_2, 2);
+	clock_pulse_length_counter(&apu->pulse_1);
+	clock_pulse_length_counter(&apu->pulse_2);
+	clock_triangle_length_counter(&apu->triangle_1);
+	clock_noise_length_counter(&apu->noise_1); 
 }
 
 static void clock_pulse_sequencer(Pulse_t *pulse)
@@ -839,21 +1033,72 @@ void dmc_memory_reader(Dmc_t* dmc)
 			}
 			else if (dmc->irq_enable)
 			{
-				dmc_interrupt_flag = true;
+				set_dmc_interrupt(true);
 			}
 		}
 	}
 }
 
-static void mix_audio(long time, float p1, float p2, float t1, float n1, float d1)
+static void init_mixer_tables(void)
+{
+	pulse_table[0] = 0.0f;
+	for (int i = 1; i < 31; ++i)
+	{
+		pulse_table[i] = 95.88f / (8128.0f / i + 100);
+	}
+
+	tnd_table[0] = 0.0f;
+	for (int i = 1; i < 203; ++i)
+	{
+		tnd_table[i] = 163.67f / (24329.0f / i + 100);
+	}
+}
+
+/**
+ * Creates the blip buffer and synth an instance's mixed output is resampled through.
+ * @returns false on fail, whatever was created is left for close_blip_buffer
+*/
+static bool open_blip_buffer(Apu_Context_t* context)
+{
+	context->blip_buffer = create_cblip_buffer();
+	context->synth_1 = create_cblip_synth();
+
+	if (!context->blip_buffer)
+		return false;
+	if (!context->synth_1)
+		return false;
+
+	cblip_buffer_clock_rate(context->blip_buffer, 1800000);
+	if (cblip_buffer_set_sample_rate(context->blip_buffer, APU_SAMPLE_RATE, 1000/60))
+		return false;
+
+	cblip_synth_volume(context->synth_1, 0.005);
+	cblip_synth_output(context->synth_1, context->blip_buffer);
+	cblip_buffer_bass_freq(context->blip_buffer, 1);
+	cblip_synth_treble_eq(context->synth_1, 5.0);
+
+	return true;
+}
+
+static void close_blip_buffer(Apu_Context_t* context)
 {
-	float pulse_out = (p1+p2) ? 95.88f / (8128.0f / (p1 + p2) + 100) : 0.0f;
+	if (context->blip_buffer)
+		free_cblip_buffer(context->blip_buffer);
+	if (context->synth_1)
+		free_cblip_synth(context->synth_1);
 
-	t1 = t1 / 8227;
-	n1 = n1 / 12241;
-	d1 = d1 / 22638;
+	context->blip_buffer = NULL;
+	context->synth_1 = NULL;
+}
 
-	float tnd_out = (t1 + n1 + d1) ? 159.79f / (1 / (t1 + n1 + d1) + 100) : 0.0f;
+/**
+ * Mixes the channel outputs through the lookup tables and hands blip the new amplitude. Most cycles
+ * nothing audible changes, so blip is only updated when the amplitude actually moves.
+*/
+static void mix_audio(long time, uint8_t p1, uint8_t p2, uint8_t t1, uint8_t n1, uint8_t d1)
+{
+	float pulse_out = pulse_table[p1 + p2];
+	float tnd_out = tnd_table[3 * t1 + 2 * n1 + d1];
 
 	int output = (int) (((pulse_out + tnd_out) * 0.01f * 65536) - 32767);
 	if (output > 32767)
@@ -865,52 +1110,113 @@ static void mix_audio(long time, float p1, float p2, float t1, float n1, float d
 		output = -32768;
 	}
 
-	cblip_synth_update(synth_1, time, output);
+	if (output != apu->mixer_output && !apu->is_muted)
+	{
+		apu->mixer_output = output;
+		cblip_synth_update(apu->synth_1, time, output);
+	}
 }
 
 uint32_t apu_get_queued_audio()
 {
-	return SDL_GetQueuedAudioSize(audio_device_ID);
+	return audio_device_get_queued();
+}
+
+void apu_set_audio_latency(uint32_t frames)
+{
+	if (frames < 1) frames = 1;
+	if (frames > APU_MAX_LATENCY_FRAMES) frames = APU_MAX_LATENCY_FRAMES;
+
+	audio_device_set_latency(frames * APU_SAMPLES_PER_FRAME);
+}
+
+uint32_t apu_get_audio_latency(void)
+{
+	return audio_device_get_latency() / APU_SAMPLES_PER_FRAME;
+}
+
+uint32_t apu_get_audio_latency_samples(void)
+{
+	return audio_device_get_latency();
 }
 
 void apu_queue_audio_frame(long audio_frame_length)
 {
-	cblip_buffer_end_frame(buffer, audio_frame_length);
-	short samples[735];
-	long count = cblip_buffer_read_samples(buffer, samples, 735);
+	apu_catch_up();
+	if (apu->is_muted)
+	{
+		return;
+	}
 
-	SDL_QueueAudio(audio_device_ID, samples, sizeof(short) * count);
+	cblip_buffer_end_frame(apu->blip_buffer, audio_frame_length);
+	short samples[APU_SAMPLES_PER_FRAME];
+	long count = cblip_buffer_read_samples(apu->blip_buffer, samples, APU_SAMPLES_PER_FRAME);
+
+	audio_device_queue(samples, count);
+}
+
+void apu_queue_silent_frame(void)
+{
+	short samples[APU_SAMPLES_PER_FRAME] = {0};
+	audio_device_queue(samples, APU_SAMPLES_PER_FRAME);
 }
 
 void apu_clear_queued_audio(void)
 {
-	cblip_buffer_clear(buffer);
-	SDL_ClearQueuedAudio(audio_device_ID);
+	cblip_buffer_clear(apu->blip_buffer);
+	audio_device_clear();
 }
 
-bool apu_is_triggering_irq(void)
+/**
+ * Lists every piece of apu state that goes into a save state, in chunk order. The blip buffer
+ * and the audio queue are output rather than machine state and are left alone.
+*/
+static void apu_sync_state(State_Buffer_t* buffer, bool saving)
+{
+	state_sync(buffer, saving, apu->pulse_1);
+	state_sync(buffer, saving, apu->pulse_2);
+	state_sync(buffer, saving, apu->triangle_1);
+	state_sync(buffer, saving, apu->noise_1);
+	state_sync(buffer, saving, apu->dmc_1);
+	state_sync(buffer, saving, apu->frame_counter);
+	state_sync(buffer, saving, apu->sequencer_timer_cpu_tick);
+	state_sync(buffer, saving, apu->frame_interrupt_flag);
+	state_sync(buffer, saving, apu->dmc_interrupt_flag);
+	state_sync(buffer, saving, apu->apu_cycle);
+	state_sync(buffer, saving, apu->pulse_clock_even);
+}
+
+void apu_save_state(State_Buffer_t* buffer)
 {
-	return frame_interrupt_flag || dmc_interrupt_flag;
+	apu_sync_state(buffer, true);
+}
+
+void apu_load_state(State_Buffer_t* buffer)
+{
+	apu_sync_state(buffer, false);
+	apu->output_dirty = true; // channel outputs are recomputed and mixed on the next tick
 }
 
 uint8_t apu_read_status(void)
 {
+	apu_catch_up();
+
 	uint8_t status = 0;
-	if (pulse_1.length_counter > 0)
+	if (apu->pulse_1.length_counter > 0)
 		status |= 0x1;
-	if (pulse_2.length_counter > 0)
+	if (apu->pulse_2.length_counter > 0)
 		status |= 0x1 << 1;
-	if (triangle_1.length_counter > 0)
+	if (apu->triangle_1.length_counter > 0)
 		status |= 0x1 << 2;
-	if (noise_1.length_counter > 0)
+	if (apu->noise_1.length_counter > 0)
 		status |= 0x1 << 3;
-	if (dmc_1.sample_bytes_remaining > 0)
+	if (apu->dmc_1.sample_bytes_remaining > 0)
 		status |= 0x1 << 4;
 
-	status |= (frame_interrupt_flag & 0x1) << 6;
-	frame_interrupt_flag = false; // clear/acknowledge frame interrupt when status is read
+	status |= (apu->frame_interrupt_flag & 0x1) << 6;
+	set_frame_interrupt(false); // clear/acknowledge frame interrupt when status is read
 
-	status |= (dmc_interrupt_flag & 0x1) << 7;
+	status |= (apu->dmc_interrupt_flag & 0x1) << 7;
 
    return status;
 }
@@ -0,0 +1,149 @@
+#include <stdio.h>
+
+#include "SDL_audio.h"
+#include "SDL_atomic.h"
+
+#include "audio_device.h"
+
+// must be a power of 2 so the free running read and write positions can be masked into an index,
+// 16384 samples is ~370ms at 44100hz, twice the largest latency the apu asks for
+#define AUDIO_RING_SIZE 16384
+
+static SDL_AudioDeviceID audio_device_ID;
+
+// single producer (apu on the emulation thread) single consumer (sdl audio callback) ring of samples
+
+static short audio_ring[AUDIO_RING_SIZE];
+static SDL_atomic_t ring_read;  // only written by the audio callback
+static SDL_atomic_t ring_write; // only written by audio_device_queue
+static short last_sample = 0;   // repeated by the callback when the ring runs dry so underruns do not pop
+
+static SDL_atomic_t latency_samples;
+static SDL_atomic_t underrun_count;
+
+static void SDLCALL audio_device_callback(void* userdata, Uint8* stream, int len);
+
+bool audio_device_open(int sample_rate)
+{
+   SDL_AudioSpec want, have;
+
+   SDL_zero(want);
+   want.freq = sample_rate;
+   want.format = AUDIO_S16SYS;
+   want.samples = 512;
+   want.channels = 1;
+   want.callback = audio_device_callback;
+
+   SDL_AtomicSet(&ring_read, 0);
+   SDL_AtomicSet(&ring_write, 0);
+   SDL_AtomicSet(&underrun_count, 0);
+
+   audio_device_ID = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+   if (audio_device_ID == 0)
+   {
+      printf("Failed to initialize audio device: %s\n", SDL_GetError());
+      return false;
+   }
+
+   return true;
+}
+
+void audio_device_close(void)
+{
+   SDL_CloseAudioDevice(audio_device_ID);
+}
+
+void audio_device_pause(bool flag)
+{
+   SDL_PauseAudioDevice(audio_device_ID, flag ? 1 : 0);
+}
+
+uint32_t audio_device_get_queued(void)
+{
+   return (uint32_t) (SDL_AtomicGet(&ring_write) - SDL_AtomicGet(&ring_read));
+}
+
+void audio_device_queue(const short* samples, uint32_t count)
+{
+   int write = SDL_AtomicGet(&ring_write);
+   uint32_t free_samples = AUDIO_RING_SIZE - (uint32_t) (write - SDL_AtomicGet(&ring_read));
+
+   // samples that do not fit are dropped, the emulator stops producing before that happens
+   if (count > free_samples)
+   {
+      count = free_samples;
+   }
+
+   for (uint32_t i = 0; i < count; ++i)
+   {
+      audio_ring[(write + i) & (AUDIO_RING_SIZE - 1)] = samples[i];
+   }
+
+   SDL_AtomicSet(&ring_write, write + (int) count); // publishes the samples to the callback
+}
+
+void audio_device_clear(void)
+{
+   // the callback is the only reader, hold it off while the read position is moved
+   SDL_LockAudioDevice(audio_device_ID);
+   SDL_AtomicSet(&ring_read, SDL_AtomicGet(&ring_write));
+   SDL_UnlockAudioDevice(audio_device_ID);
+}
+
+void audio_device_set_latency(uint32_t samples)
+{
+   if (samples > AUDIO_RING_SIZE / 2)
+   {
+      samples = AUDIO_RING_SIZE / 2;
+   }
+
+   SDL_AtomicSet(&latency_samples, (int) samples);
+}
+
+uint32_t audio_device_get_latency(void)
+{
+   return (uint32_t) SDL_AtomicGet(&latency_samples);
+}
+
+uint32_t audio_device_get_underruns(void)
+{
+   return (uint32_t) SDL_AtomicGet(&underrun_count);
+}
+
+/**
+ * Runs on sdl's audio thread whenever the device needs more samples. Drains as much of the ring as
+ * it can and pads the rest of the stream with the last played sample.
+*/
+static void SDLCALL audio_device_callback(void* userdata, Uint8* stream, int len)
+{
+   (void) userdata;
+
+   short* out = (short*) stream;
+   uint32_t wanted = (uint32_t) len / sizeof(short);
+
+   int read = SDL_AtomicGet(&ring_read);
+   uint32_t available = (uint32_t) (SDL_AtomicGet(&ring_write) - read);
+   uint32_t count = (available < wanted) ? available : wanted;
+
+   for (uint32_t i = 0; i < count; ++i)
+   {
+      out[i] = audio_ring[(read + i) & (AUDIO_RING_SIZE - 1)];
+   }
+
+   if (count > 0)
+   {
+      last_sample = out[count - 1];
+   }
+
+   SDL_AtomicSet(&ring_read, read + (int) count); // hands the slots back to the producer
+
+   if (count < wanted)
+   {
+      SDL_AtomicIncRef(&underrun_count);
+
+      for (uint32_t i = count; i < wanted; ++i)
+      {
+         out[i] = last_sample;
+      }
+   }
+}
@@ -0,0 +1,51 @@
+#include "audio_device.h"
+
+/**
+ * Audio sink for headless builds, samples handed to it are dropped.
+ * Nothing is ever queued so the apu never waits on playback.
+*/
+
+bool audio_device_open(int sample_rate)
+{
+   (void) sample_rate;
+   return true;
+}
+
+void audio_device_close(void)
+{
+}
+
+void audio_device_pause(bool flag)
+{
+   (void) flag;
+}
+
+uint32_t audio_device_get_queued(void)
+{
+   return 0;
+}
+
+void audio_device_queue(const short* samples, uint32_t count)
+{
+   (void) samples;
+   (void) count;
+}
+
+void audio_device_clear(void)
+{
+}
+
+void audio_device_set_latency(uint32_t samples)
+{
+   (void) samples;
+}
+
+uint32_t audio_device_get_latency(void)
+{
+   return 0;
+}
+
+uint32_t audio_device_get_underruns(void)
+{
+   return 0;
+}
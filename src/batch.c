@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "cpu.h"
+#include "bus.h"
+#include "ppu.h"
+#include "controllers.h"
+#include "thread.h"
+
+#define BATCH_CACHE_LINE 64
+
+/**
+ * Instances [begin, end) of a batch, owned by one thread and stolen from by the others once their
+ * own range is done. Every claim takes the next instance so owner and thieves never need a lock.
+*/
+typedef struct Batch_Range_t
+{
+   Thread_Counter_t next;
+   uint32_t end;
+   uint8_t padding[BATCH_CACHE_LINE - sizeof(Thread_Counter_t) - sizeof(uint32_t)]; // claims on one range do not slow down the others
+} Batch_Range_t;
+
+static struct
+{
+   Thread_Lock_t lock;
+   Thread_Condition_t start; // signalled when a new batch is posted or the pool shuts down
+   Thread_Condition_t done;  // signalled when the last worker finishes its part of a batch
+   Thread_t threads[BATCH_MAX_THREADS];
+   uint32_t thread_count;  // workers including the thread calling batch_step
+   uint32_t generation;    // incremented for every batch posted
+   uint32_t busy;          // worker threads still running the current batch
+   bool quit;
+} pool;
+
+// the batch being run, written before it is posted and only read while it runs
+static nes_t* const* job_instances = NULL;
+static const Batch_Input_t* job_inputs = NULL;
+static uint32_t job_frames = 0;
+static Batch_Range_t ranges[BATCH_MAX_THREADS];
+
+static uint8_t* output_frames = NULL;
+static uint8_t* output_ram = NULL;
+static uint32_t output_capacity = 0; // instances the output arrays have room for
+static Batch_Output_t output;
+
+static void batch_work(uint32_t worker);
+static void batch_step_instance(uint32_t index);
+static void batch_worker_loop(void* data);
+
+bool batch_init(uint32_t thread_count)
+{
+   if (pool.thread_count != 0)
+   {
+      printf("Batch threads are already running!\n");
+      return false;
+   }
+
+   if (thread_count == 0)
+   {
+      thread_count = thread_host_cores();
+   }
+   if (thread_count > BATCH_MAX_THREADS)
+   {
+      thread_count = BATCH_MAX_THREADS;
+   }
+
+   thread_lock_init(&pool.lock);
+   thread_condition_init(&pool.start);
+   thread_condition_init(&pool.done);
+
+   pool.generation = 0;
+   pool.busy = 0;
+   pool.quit = false;
+   pool.thread_count = 1; // the caller of batch_step is worker 0
+
+   for (uint32_t worker = 1; worker < thread_count; ++worker)
+   {
+      if (!thread_start(&pool.threads[worker], batch_worker_loop, (void*) (uintptr_t) worker))
+      {
+         printf("Failed to start batch thread!\n");
+         batch_shutdown();
+         return false;
+      }
+      pool.thread_count += 1;
+   }
+
+   return true;
+}
+
+void batch_shutdown(void)
+{
+   if (pool.thread_count == 0)
+   {
+      return;
+   }
+
+   thread_lock(&pool.lock);
+   pool.quit = true;
+   thread_wake_all(&pool.start);
+   thread_unlock(&pool.lock);
+
+   for (uint32_t worker = 1; worker < pool.thread_count; ++worker)
+   {
+      thread_join(pool.threads[worker]);
+   }
+
+   thread_lock_destroy(&pool.lock);
+   thread_condition_destroy(&pool.start);
+   thread_condition_destroy(&pool.done);
+
+   pool.thread_count = 0;
+
+   free(output_frames);
+   free(output_ram);
+   output_frames = NULL;
+   output_ram = NULL;
+   output_capacity = 0;
+   memset(&output, 0, sizeof(output));
+}
+
+uint32_t batch_get_thread_count(void)
+{
+   return pool.thread_count;
+}
+
+const Batch_Output_t* batch_step(nes_t* const instances[], const Batch_Input_t inputs[], uint32_t count, uint32_t n_frames)
+{
+   if (pool.thread_count == 0)
+   {
+      printf("batch_init has to be called before batch_step!\n");
+      return NULL;
+   }
+
+   for (uint32_t i = 0; i < count; ++i)
+   {
+      if (instances[i] == NULL)
+      {
+         printf("Batch instance %u is NULL!\n", i);
+         return NULL;
+      }
+   }
+
+   if (count > output_capacity)
+   {
+      uint8_t* frames = realloc(output_frames, (size_t) count * BATCH_FRAME_SIZE);
+      if (frames != NULL)
+      {
+         output_frames = frames;
+      }
+
+      uint8_t* ram = realloc(output_ram, (size_t) count * BATCH_RAM_SIZE);
+      if (ram != NULL)
+      {
+         output_ram = ram;
+      }
+
+      if (frames == NULL || ram == NULL)
+      {
+         printf("Failed to allocate memory for batch output!\n");
+         return NULL;
+      }
+      output_capacity = count;
+   }
+
+   job_instances = instances;
+   job_inputs = inputs;
+   job_frames = n_frames;
+
+   // contiguous ranges keep each thread on neighbouring instances and output slots
+   uint32_t threads = pool.thread_count;
+   for (uint32_t worker = 0; worker < threads; ++worker)
+   {
+      uint32_t begin = (uint32_t) ((uint64_t) count * worker / threads);
+      thread_counter_set(&ranges[worker].next, begin);
+      ranges[worker].end = (uint32_t) ((uint64_t) count * (worker + 1) / threads);
+   }
+
+   nes_t* bound = nes_get_bound();
+
+   thread_lock(&pool.lock);
+   pool.busy = threads - 1;
+   pool.generation += 1;
+   thread_wake_all(&pool.start);
+   thread_unlock(&pool.lock);
+
+   batch_work(0);
+
+   thread_lock(&pool.lock);
+   while (pool.busy != 0)
+   {
+      thread_wait(&pool.done, &pool.lock);
+   }
+   thread_unlock(&pool.lock);
+
+   nes_bind(bound);
+
+   output.count = count;
+   output.frames = output_frames;
+   output.ram = output_ram;
+
+   return &output;
+}
+
+/**
+ * Steps instances until every range of the batch is used up, starting with the worker's own.
+*/
+static void batch_work(uint32_t worker)
+{
+   uint32_t threads = pool.thread_count;
+
+   for (uint32_t k = 0; k < threads; ++k)
+   {
+      Batch_Range_t* range = &ranges[(worker + k) % threads];
+
+      uint32_t index;
+      while ( (index = thread_counter_claim(&range->next)) < range->end )
+      {
+         batch_step_instance(index);
+      }
+   }
+}
+
+/**
+ * Runs one instance of the batch and copies its frame and ram into its output slots.
+*/
+static void batch_step_instance(uint32_t index)
+{
+   nes_bind(job_instances[index]);
+
+   if (job_inputs != NULL)
+   {
+      controllers_set_buttons(job_inputs[index].joypad1, job_inputs[index].joypad2);
+   }
+
+   for (uint32_t frame = 0; frame < job_frames; ++frame)
+   {
+      cpu_run_frame();
+   }
+
+   memcpy(output_frames + (size_t) index * BATCH_FRAME_SIZE, ppu_get_frame(), BATCH_FRAME_SIZE);
+   memcpy(output_ram + (size_t) index * BATCH_RAM_SIZE, cpu_get_ram(), BATCH_RAM_SIZE);
+}
+
+/**
+ * Runs on every worker thread, data is the worker's index.
+*/
+static void batch_worker_loop(void* data)
+{
+   uint32_t worker = (uint32_t) (uintptr_t) data;
+   uint32_t generation = 0;
+
+   thread_lock(&pool.lock);
+   while (true)
+   {
+      while (pool.generation == generation && !pool.quit)
+      {
+         thread_wait(&pool.start, &pool.lock);
+      }
+
+      if (pool.quit)
+      {
+         break;
+      }
+      generation = pool.generation;
+      thread_unlock(&pool.lock);
+
+      batch_work(worker);
+      nes_bind(NULL); // the instances may be bound by another thread before the next batch
+
+      thread_lock(&pool.lock);
+      pool.busy -= 1;
+      if (pool.busy == 0)
+      {
+         thread_wake_all(&pool.done);
+      }
+   }
+   thread_unlock(&pool.lock);
+}
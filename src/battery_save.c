@@ -0,0 +1,346 @@
+#define _POSIX_C_SOURCE 200809L // fileno and fsync under strict c11
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#include "battery_save.h"
+#include "thread.h"
+
+#define BATTERY_SAVE_PATH_SIZE 512
+
+/**
+ * A copy of battery ram waiting to be written, at most one per rom.
+*/
+typedef struct Battery_Save_Write_t
+{
+   char rom_name[256];
+   uint8_t* data;
+   size_t size;
+   struct Battery_Save_Write_t* next;
+} Battery_Save_Write_t;
+
+static struct
+{
+   Thread_Lock_t lock;
+   Thread_Condition_t wake; // signalled when a write is queued or the thread should stop
+   Thread_t thread;
+   Battery_Save_Write_t* queue;   // oldest first
+   Battery_Save_Write_t* writing; // taken off the queue and being written right now
+   bool is_running;
+   bool quit;
+} writer;
+
+static uint32_t save_interval = 0;
+
+static bool battery_save_write(const char* rom_name, const uint8_t* data, size_t size);
+static void battery_save_path(char* path, const char* rom_name);
+#if !_WIN32
+static bool battery_save_sync_directory(void);
+#endif
+static void battery_save_writer_loop(void* data);
+
+bool battery_save_init(uint32_t interval)
+{
+   if (writer.is_running)
+   {
+      printf("Battery save thread is already running!\n");
+      return false;
+   }
+
+   writer.queue = NULL;
+   writer.writing = NULL;
+   writer.quit = false;
+
+   thread_lock_init(&writer.lock);
+   thread_condition_init(&writer.wake);
+
+   battery_save_set_interval(interval);
+   writer.is_running = true;
+
+   if (!thread_start(&writer.thread, battery_save_writer_loop, NULL))
+   {
+      printf("Failed to start battery save thread!\n");
+      writer.is_running = false;
+      save_interval = 0;
+      thread_lock_destroy(&writer.lock);
+      thread_condition_destroy(&writer.wake);
+      return false;
+   }
+
+   return true;
+}
+
+void battery_save_shutdown(void)
+{
+   if (!writer.is_running)
+   {
+      return;
+   }
+
+   thread_lock(&writer.lock);
+   writer.quit = true;
+   thread_wake_all(&writer.wake);
+   thread_unlock(&writer.lock);
+
+   // the thread writes out whatever is still queued before it exits
+   thread_join(writer.thread);
+   thread_lock_destroy(&writer.lock);
+   thread_condition_destroy(&writer.wake);
+
+   writer.is_running = false;
+   save_interval = 0;
+}
+
+void battery_save_set_interval(uint32_t interval)
+{
+   save_interval = (interval > BATTERY_SAVE_MAX_INTERVAL) ? BATTERY_SAVE_MAX_INTERVAL : interval;
+}
+
+uint32_t battery_save_get_interval(void)
+{
+   return save_interval;
+}
+
+double battery_save_get_time(void)
+{
+   struct timespec ts;
+   timespec_get(&ts, TIME_UTC);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+bool battery_save_queue(const char* rom_name, const uint8_t* data, size_t size)
+{
+   if (!writer.is_running)
+   {
+      return battery_save_write(rom_name, data, size);
+   }
+
+   // the copy is made before taking the lock so the writer is never held up by it
+   uint8_t* copy = malloc(size);
+   if (copy == NULL)
+   {
+      printf("Failed to allocate memory for battery save!\n");
+      return false;
+   }
+   memcpy(copy, data, size);
+
+   Battery_Save_Write_t* write = calloc(1, sizeof(Battery_Save_Write_t));
+   if (write == NULL)
+   {
+      free(copy);
+      printf("Failed to allocate memory for battery save!\n");
+      return false;
+   }
+   strncpy(write->rom_name, rom_name, sizeof(write->rom_name) - 1);
+   write->data = copy;
+   write->size = size;
+
+   thread_lock(&writer.lock);
+
+   Battery_Save_Write_t** link = &writer.queue;
+   while (*link != NULL && strcmp((*link)->rom_name, write->rom_name) != 0)
+   {
+      link = &(*link)->next;
+   }
+
+   if (*link != NULL) // replace the older copy that was not written yet
+   {
+      Battery_Save_Write_t* older = *link;
+      free(older->data);
+      older->data = write->data;
+      older->size = write->size;
+      free(write);
+   }
+   else
+   {
+      *link = write;
+   }
+
+   thread_wake_all(&writer.wake);
+   thread_unlock(&writer.lock);
+
+   return true;
+}
+
+bool battery_save_read(const char* rom_name, uint8_t* data, size_t size)
+{
+   bool is_read = false;
+
+   if (writer.is_running)
+   {
+      thread_lock(&writer.lock);
+
+      // a queued copy is newer than the one being written, which is newer than the file
+      Battery_Save_Write_t* write = writer.queue;
+      while (write != NULL && strcmp(write->rom_name, rom_name) != 0)
+      {
+         write = write->next;
+      }
+      if (write == NULL && writer.writing != NULL && strcmp(writer.writing->rom_name, rom_name) == 0)
+      {
+         write = writer.writing;
+      }
+
+      if (write != NULL)
+      {
+         memcpy(data, write->data, (write->size < size) ? write->size : size);
+         is_read = true;
+      }
+
+      thread_unlock(&writer.lock);
+   }
+
+   if (!is_read)
+   {
+      char path[BATTERY_SAVE_PATH_SIZE];
+      battery_save_path(path, rom_name);
+
+      FILE* file = fopen(path, "rb");
+      if (file)
+      {
+         fread(data, sizeof(uint8_t), size, file);
+         fclose(file);
+         is_read = true;
+      }
+   }
+
+   return is_read;
+}
+
+/**
+ * Writes a save to a temporary file next to the .sav, flushes it to disk and renames it over the .sav.
+ * @returns false on fail, otherwise return true.
+*/
+static bool battery_save_write(const char* rom_name, const uint8_t* data, size_t size)
+{
+#if _WIN32
+   if (CreateDirectory(BATTERY_SAVE_DIRECTORY, NULL) == 0)
+   {
+      // ERROR_ALREADY_EXISTS means directory already exists which is perfectly fine.
+      // Any other error is not fine.
+      if (GetLastError() != ERROR_ALREADY_EXISTS)
+         printf("Failed to create sav directory! Error Code: %lu\n", GetLastError());
+   }
+#else
+   if (mkdir(BATTERY_SAVE_DIRECTORY, 0777) == -1)
+   {
+      // EEXIST error means directory already exists which is perfectly fine.
+      // if errno does not equal EEXIST then a serious error has occured.
+      if (errno != EEXIST)
+         printf("Failed to create sav directory! errno code: %d\n", errno);
+   }
+#endif
+
+   char path[BATTERY_SAVE_PATH_SIZE];
+   char temp_path[BATTERY_SAVE_PATH_SIZE + 4];
+   battery_save_path(path, rom_name);
+   snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+   FILE* file = fopen(temp_path, "wb");
+   if (!file)
+   {
+      printf("Failed to write battery save: %s\n", temp_path);
+      return false;
+   }
+
+   bool is_written = fwrite(data, sizeof(uint8_t), size, file) == size && fflush(file) == 0;
+#if _WIN32
+   is_written = is_written && _commit(_fileno(file)) == 0;
+#else
+   is_written = is_written && fsync(fileno(file)) == 0;
+#endif
+   is_written = (fclose(file) == 0) && is_written;
+
+   if (is_written)
+   {
+#if _WIN32
+      is_written = MoveFileExA(temp_path, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+      // the rename is only on disk once the directory holding it is
+      is_written = rename(temp_path, path) == 0 && battery_save_sync_directory();
+#endif
+   }
+
+   if (!is_written)
+   {
+      printf("Failed to write battery save: %s\n", path);
+      remove(temp_path);
+   }
+
+   return is_written;
+}
+
+/**
+ * Builds the path of a rom's .sav file.
+ * @param path buffer of BATTERY_SAVE_PATH_SIZE bytes
+*/
+static void battery_save_path(char* path, const char* rom_name)
+{
+   snprintf(path, BATTERY_SAVE_PATH_SIZE, "%s/%s.sav", BATTERY_SAVE_DIRECTORY, rom_name);
+}
+
+#if !_WIN32
+/**
+ * Flushes the sav directory's entries to disk, so a rename into it survives a crash.
+ * @returns false on fail, otherwise return true.
+*/
+static bool battery_save_sync_directory(void)
+{
+   int directory = open(BATTERY_SAVE_DIRECTORY, O_RDONLY);
+   if (directory == -1)
+   {
+      return false;
+   }
+
+   bool is_synced = fsync(directory) == 0;
+   close(directory);
+   return is_synced;
+}
+#endif
+
+/**
+ * Writes queued saves one at a time until battery_save_shutdown, the lock is only held to take one
+ * off the queue so queueing never waits for the disk.
+*/
+static void battery_save_writer_loop(void* data)
+{
+   (void) data;
+
+   thread_lock(&writer.lock);
+   while (true)
+   {
+      while (writer.queue == NULL && !writer.quit)
+      {
+         thread_wait(&writer.wake, &writer.lock);
+      }
+
+      Battery_Save_Write_t* write = writer.queue;
+      if (write == NULL) // asked to quit and nothing is left to write
+      {
+         break;
+      }
+      writer.queue = write->next;
+      writer.writing = write;
+      thread_unlock(&writer.lock);
+
+      battery_save_write(write->rom_name, write->data, write->size);
+
+      thread_lock(&writer.lock);
+      writer.writing = NULL;
+      free(write->data);
+      free(write);
+   }
+   thread_unlock(&writer.lock);
+}
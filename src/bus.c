@@ -1,5 +1,6 @@
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "../includes/bus.h"
@@ -8,6 +9,7 @@
 #include "../includes/cpu.h"
 #include "../includes/controllers.h"
 #include "../includes/apu.h"
+#include "../includes/util.h"
 
 // address ranges used by cpu to access cartridge space
 
@@ -21,28 +23,76 @@
 #define CPU_RAM_SIZE 1024 * 2
 #define CPU_RAM_END  0x1FFF
 
-static uint8_t cpu_ram[CPU_RAM_SIZE];
+struct Bus_Context_t
+{
+   uint8_t cpu_ram[CPU_RAM_SIZE];
+   uint8_t open_bus; // value left on the data bus by the last read
+
+   // Host pointers for every 1kb page of the cpu address space that can be read directly.
+   // The 2kb of cpu ram is mirrored across 0x0000 - 0x1FFF, cartridge pages are filled in by the
+   // cartridge as the mapper switches banks. NULL pages (io registers, unmapped cartridge space)
+   // go through the read handlers below.
+   const uint8_t* cpu_read_pages[CPU_PAGE_COUNT];
+};
+
+#define BUS_RAM_PAGES(context) \
+   { \
+      (context).cpu_ram, (context).cpu_ram + CPU_PAGE_SIZE, (context).cpu_ram, (context).cpu_ram + CPU_PAGE_SIZE, \
+      (context).cpu_ram, (context).cpu_ram + CPU_PAGE_SIZE, (context).cpu_ram, (context).cpu_ram + CPU_PAGE_SIZE, \
+   }
+
+static Bus_Context_t default_context = { .cpu_read_pages = BUS_RAM_PAGES(default_context) };
+static NES_THREAD_LOCAL Bus_Context_t* bus = &default_context; // context of the instance bound to this thread
+
+Bus_Context_t* bus_context_create(void)
+{
+   Bus_Context_t* context = calloc(1, sizeof(Bus_Context_t));
+   if (context != NULL)
+   {
+      const uint8_t* ram_pages[] = BUS_RAM_PAGES(*context);
+      memcpy(context->cpu_read_pages, ram_pages, sizeof(ram_pages));
+   }
+
+   return context;
+}
+
+void bus_context_destroy(Bus_Context_t* context)
+{
+   free(context);
+}
+
+void bus_bind(Bus_Context_t* context)
+{
+   bus = (context != NULL) ? context : &default_context;
+}
 
 // read single byte from bus and clocks cpu by 1 tick
 uint8_t cpu_bus_read(uint16_t position)
 {
-   static uint8_t data = 0;
    cpu_read_tick();
 
+   // fast path for ram and mapped prg rom/ram pages
+   const uint8_t* page = bus->cpu_read_pages[position >> CPU_PAGE_SHIFT];
+   if (page != NULL)
+   {
+      bus->open_bus = page[position & (CPU_PAGE_SIZE - 1)];
+      return bus->open_bus;
+   }
+
    // addressing cartridge space
    if ( position >= CPU_CARTRIDGE_START )
    {
-      data = cartridge_cpu_read(position);
+      bus->open_bus = cartridge_cpu_read(position);
    }  
    // accessing 2 kb cpu ram address space
    else if ( position <= CPU_RAM_END )
    {
-      data = cpu_ram[position & 0x7FF];
+      bus->open_bus = bus->cpu_ram[position & 0x7FF];
    }
    // accessing ppu registers
    else if ( position >= CPU_PPU_REG_START && position <= CPU_PPU_REG_END )
    {
-      data = ppu_port_read( 0x2000 | (position & 0x7) );
+      bus->open_bus = ppu_port_read( 0x2000 | (position & 0x7) );
    }
    // reading status register from apu
    else if (position == 0x4015)
@@ -52,15 +102,15 @@ uint8_t cpu_bus_read(uint16_t position)
    // reading controller 1 input state
    else if ( position == 0x4016 )
    {
-      data = 0x40 | controller1_read();
+      bus->open_bus = 0x40 | controller1_read();
    }
    // reading controller 2 input state, CONTROLLER 2 NOT SUPPORTED!
    else if ( position == 0x4017 )
    {
-      data = 0x40 | controller2_read();
+      bus->open_bus = 0x40 | controller2_read();
    }
 
-   return data;
+   return bus->open_bus;
 }
 
 // write single byte to bus and clocks cpu by 1 tick
@@ -71,7 +121,7 @@ void cpu_bus_write(uint16_t position, uint8_t data)
    // accessing 2 kb cpu ram address space
    if ( position <= CPU_RAM_END )
    {
-      cpu_ram[position & 0x7FF] = data;
+      bus->cpu_ram[position & 0x7FF] = data;
    }
    // accessing ppu registers
    else if ( position >= CPU_PPU_REG_START && position <= CPU_PPU_REG_END )
@@ -91,6 +141,7 @@ void cpu_bus_write(uint16_t position, uint8_t data)
    // writing to cartridge rom which is done to configure mapper registers
    else if (position >= 0x8000)
    {
+      apu_catch_up(); // pending dmc fetches must read through the bank mapping from before the write
       cartridge_cpu_write(position, data);
    }
    // writing to program ram
@@ -105,9 +156,27 @@ void cpu_bus_write(uint16_t position, uint8_t data)
    }
 }
 
+void cpu_bus_map_read_page(uint8_t page, const uint8_t* memory)
+{
+   // pages below the cartridge space are fixed to cpu ram and io registers
+   if (page >= (CPU_CARTRIDGE_START >> CPU_PAGE_SHIFT) + 1 && page < CPU_PAGE_COUNT)
+   {
+      bus->cpu_read_pages[page] = memory;
+   }
+}
+
 void cpu_clear_ram(void)
 {
-   memset(cpu_ram, 0, sizeof(cpu_ram));
+   memset(bus->cpu_ram, 0, sizeof(bus->cpu_ram));
+   bus->open_bus = 0;
+}
+
+/**
+ * Gives direct read access to the 2kb of cpu ram, for hashing and debugging.
+*/
+const uint8_t* cpu_get_ram(void)
+{
+   return bus->cpu_ram;
 }
 
 /**
@@ -117,7 +186,7 @@ void cpu_clear_ram(void)
 */
 uint8_t DEBUG_cpu_bus_read(uint16_t position)
 {
-   static uint8_t data = 0;
+   uint8_t data = 0;
 
    // addressing cartridge space
    if ( position >= CPU_CARTRIDGE_START )
@@ -127,8 +196,20 @@ uint8_t DEBUG_cpu_bus_read(uint16_t position)
    // accessing 2 kb cpu ram address space
    else if ( position <= CPU_RAM_END )
    {
-      data = cpu_ram[position & 0x7FF];
+      data = bus->cpu_ram[position & 0x7FF];
    }
    
    return data;
 }
+
+void bus_save_state(State_Buffer_t* buffer)
+{
+   state_write(buffer, bus->cpu_ram, sizeof(bus->cpu_ram));
+   state_write(buffer, &bus->open_bus, sizeof(bus->open_bus));
+}
+
+void bus_load_state(State_Buffer_t* buffer)
+{
+   state_read(buffer, bus->cpu_ram, sizeof(bus->cpu_ram));
+   state_read(buffer, &bus->open_bus, sizeof(bus->open_bus));
+}
@@ -3,69 +3,169 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-
-#if _WIN32
-#include <windows.h>
-#elif __APPLE__
-#include <sys/stat.h>
-#include <errno.h>
-#endif
+#include <limits.h>
 
 #include "cartridge.h"
+#include "rom_image.h"
+#include "battery_save.h"
 #include "mapper.h"
+#include "bus.h"
+#include "ppu.h"
+#include "cpu.h"
+#include "util.h"
+
+#define CPU_CARTRIDGE_PRG_RAM_START 0x6000 // first address that the read page table maps for the cartridge
+
+struct Cartridge_Context_t
+{
+   const mapper_t* mapper;              // descriptor from the mapper registry, NULL when no cartridge is loaded
+   mapper_registers_t mapper_registers; // registers of the mapper, part of the instance rather than the heap
+   nes_header_t rom_header;
+   const Rom_Image_t* image; // header, prg-rom and chr-rom shared with every instance that loaded the same file
 
-#define iNES_HEADER_SIZE 16 // iNES headers are all 16 bytes long
-#define TRAINER_SIZE 512
+   uint8_t ppu_vram[1024 * 2];
+   const uint8_t *prg_rom;
+   uint8_t *prg_ram;          // battery backed prg-ram first, then volatile prg-ram
+   const uint8_t *chr_memory; // memory for either chr-ram or chr-rom
+   uint8_t *chr_ram;          // the instance's own chr-ram, NULL when the cartridge has chr-rom
+   size_t prg_ram_size;       // bytes of prg_ram
+   size_t chr_memory_size;    // bytes of chr_memory
 
-static mapper_t mapper;
-static void* mapper_registers = NULL; // void pointer to struct containing a mapper's registers
-static nes_header_t rom_header;
+   bool is_battery_ram_dirty; // battery backed prg-ram changed since it was last handed to battery_save_queue
+   bool is_battery_save_read_only; // the .sav is read on load but never written, for headless instances
+   double battery_save_time;  // battery_save_get_time of the last hand over
 
-static uint8_t ppu_vram[1024 * 2];
-static uint8_t *prg_rom = NULL;
-static uint8_t *prg_ram = NULL;
-static uint8_t *chr_memory = NULL; // memory for either chr-ram or chr-rom
+   uint8_t cpu_open_bus; // value from the previous read, returned when nothing on the cartridge is addressed
+};
 
-static bool load_iNES10(uint8_t *iNES_header, nes_header_t *header);
-static bool load_iNES20(uint8_t *iNES_header, nes_header_t *header);
+static Cartridge_Context_t default_context;
+static NES_THREAD_LOCAL Cartridge_Context_t* cartridge = &default_context; // context of the instance bound to this thread
+
+static void cartridge_ppu_fetch(uint16_t position);
+static void cartridge_queue_battery_save(void);
+
+/**
+ * Header fields a save state has to agree with for its memory and registers to make sense.
+*/
+typedef struct Cartridge_State_Identity_t
+{
+   uint32_t mapper_id;
+   uint32_t submapper_id;
+   uint32_t prg_rom_size; // in bytes
+   uint32_t prg_ram_size;
+   uint32_t chr_rom_size;
+   uint32_t chr_ram_size;
+} Cartridge_State_Identity_t;
+
+static Cartridge_State_Identity_t cartridge_state_identity(void);
+
+Cartridge_Context_t* cartridge_context_create(void)
+{
+   return calloc(1, sizeof(Cartridge_Context_t));
+}
+
+void cartridge_context_destroy(Cartridge_Context_t* context)
+{
+   free(context);
+}
+
+void cartridge_bind(Cartridge_Context_t* context)
+{
+   cartridge = (context != NULL) ? context : &default_context;
+}
 
-static char rom_name[256];
 
 uint8_t cartridge_cpu_read(uint16_t position)
 {
    size_t mapped_addr = 0;
-   cartridge_access_mode_t mode = mapper.cpu_read(&rom_header, position, &mapped_addr, mapper_registers);
+   cartridge_access_mode_t mode = cartridge->mapper->cpu_read(&cartridge->rom_header, position, &mapped_addr, &cartridge->mapper_registers);
 
-   static uint8_t data = 0;
    switch ( mode )
    {
+      // banks past the end of a memory wrap around like they do on boards with fewer address lines
       case ACCESS_PRG_ROM:
-         data = prg_rom[mapped_addr];
+         cartridge->cpu_open_bus = cartridge->prg_rom[mapped_addr % cartridge->rom_header.prg_rom_bytes];
          break;
       case ACCESS_PRG_RAM:
-         data = prg_ram[mapped_addr];
+         if (cartridge->prg_ram != NULL)
+         {
+            cartridge->cpu_open_bus = cartridge->prg_ram[mapped_addr % cartridge->prg_ram_size];
+         }
          break;
-      case NO_CARTRIDGE_DEVICE: // when addressed location has no attached device, return value from previous read in static data
+      case NO_CARTRIDGE_DEVICE: // when addressed location has no attached device, return value from previous read
       default:
          break;
    }
 
-   return data;
+   return cartridge->cpu_open_bus;
 }
 
 void cartridge_cpu_write(uint16_t position, uint8_t data)
 {
+   bool is_register_write = position < 0x6000 || position > 0x7FFF;
+   uint32_t capabilities = cartridge->mapper->capabilities;
+
+   // writes outside of prg ram can hit mapper registers that change chr banks, mirroring or irq
+   // state the ppu depends on, so the ppu has to be caught up to this point first
+   if (is_register_write && (capabilities & (MAPPER_SWITCHES_PPU | MAPPER_GENERATES_IRQ)))
+   {
+      ppu_catch_up();
+   }
+
    size_t mapped_addr = 0;
-   cartridge_access_mode_t mode = mapper.cpu_write(&rom_header, position, data, &mapped_addr, mapper_registers);
+   cartridge_access_mode_t mode = cartridge->mapper->cpu_write(&cartridge->rom_header, position, data, &mapped_addr, &cartridge->mapper_registers);
 
    switch ( mode )
    {
       case ACCESS_PRG_RAM:
-         prg_ram[mapped_addr] = data;
+         if (cartridge->prg_ram != NULL)
+         {
+            mapped_addr %= cartridge->prg_ram_size;
+            cartridge->prg_ram[mapped_addr] = data;
+            cartridge->is_battery_ram_dirty |= mapped_addr < cartridge->rom_header.prg_nvram_bytes;
+         }
          break;
       default:
          break;
    }
+
+   if (is_register_write && (capabilities & MAPPER_GENERATES_IRQ))
+   {
+      cartridge_update_irq_deadline();
+   }
+}
+
+void cartridge_update_cpu_pages(uint16_t start, uint16_t end)
+{
+   if (start < CPU_CARTRIDGE_PRG_RAM_START)
+   {
+      start = CPU_CARTRIDGE_PRG_RAM_START;
+   }
+
+   size_t prg_rom_size = cartridge->rom_header.prg_rom_bytes;
+   size_t prg_ram_size = cartridge->prg_ram_size;
+
+   for (uint32_t page = start >> CPU_PAGE_SHIFT; page <= (uint32_t) (end >> CPU_PAGE_SHIFT); ++page)
+   {
+      // mappers bank in units of at least 1kb, so the mapping of the first byte in a page
+      // gives the mapping of the whole page
+      size_t mapped_addr = 0;
+      cartridge_access_mode_t mode = cartridge->mapper->cpu_read(&cartridge->rom_header, (uint16_t) (page << CPU_PAGE_SHIFT), &mapped_addr, &cartridge->mapper_registers);
+
+      // wrapped the same way as in cartridge_cpu_read
+      const uint8_t* memory = NULL;
+      if (mode == ACCESS_PRG_ROM && cartridge->prg_rom != NULL && (mapped_addr % prg_rom_size) + CPU_PAGE_SIZE <= prg_rom_size)
+      {
+         memory = cartridge->prg_rom + (mapped_addr % prg_rom_size);
+      }
+      else if (mode == ACCESS_PRG_RAM && cartridge->prg_ram != NULL && (mapped_addr % prg_ram_size) + CPU_PAGE_SIZE <= prg_ram_size)
+      {
+         memory = cartridge->prg_ram + (mapped_addr % prg_ram_size);
+      }
+
+      // pages left NULL (disabled or missing prg ram, memories smaller than a page) are read through cartridge_cpu_read
+      cpu_bus_map_read_page((uint8_t) page, memory);
+   }
 }
 
 uint8_t cartridge_ppu_read(uint16_t position)
@@ -74,16 +174,16 @@ uint8_t cartridge_ppu_read(uint16_t position)
 
    // ppu address space is only 14 bits, hence the 0x3FFF bitmask
 
-   cartridge_access_mode_t mode = mapper.ppu_read(&rom_header, position & 0x3FFF, &mapped_addr, mapper_registers);
+   cartridge_access_mode_t mode = cartridge->mapper->ppu_read(&cartridge->rom_header, position & 0x3FFF, &mapped_addr, &cartridge->mapper_registers);
 
    uint8_t data = 0;
    switch ( mode )
    {
       case ACCESS_CHR_MEM:
-         data = chr_memory[mapped_addr];
+         data = cartridge->chr_memory[mapped_addr % cartridge->chr_memory_size];
          break;
       case ACCESS_VRAM:
-         data = ppu_vram[mapped_addr]; // returned mapped address for vram 
+         data = cartridge->ppu_vram[mapped_addr]; // returned mapped address for vram 
          break;
       default: // default case will never happen due to bit masking but who knows
          printf("PPU read error!\n");
@@ -91,6 +191,11 @@ uint8_t cartridge_ppu_read(uint16_t position)
          break;
    }
 
+   if (cartridge->mapper->capabilities & MAPPER_OBSERVES_PPU_FETCH)
+   {
+      cartridge->mapper->ppu_fetch(&cartridge->rom_header, position & 0x3FFF, &cartridge->mapper_registers);
+   }
+
    return data;
 }
 
@@ -100,15 +205,18 @@ void cartridge_ppu_write(uint16_t position, uint8_t data)
 
    // ppu address space is only 14 bits, hence the 0x3FFF bitmask
 
-   cartridge_access_mode_t mode = mapper.ppu_write(&rom_header, position & 0x3FFF, &mapped_addr, mapper_registers);
+   cartridge_access_mode_t mode = cartridge->mapper->ppu_write(&cartridge->rom_header, position & 0x3FFF, &mapped_addr, &cartridge->mapper_registers);
    
    switch ( mode )
    {
       case ACCESS_CHR_MEM:
-         chr_memory[mapped_addr] = data;
+         if (cartridge->chr_ram != NULL) // chr-rom is shared between instances and never written
+         {
+            cartridge->chr_ram[mapped_addr % cartridge->chr_memory_size] = data;
+         }
          break;
       case ACCESS_VRAM:
-         ppu_vram[mapped_addr] = data;
+         cartridge->ppu_vram[mapped_addr] = data;
          break;
       default: // default should case will never happen unless chr-rom is written to, in which case no write will occur 
          //printf("Writing to chr-rom %X\n", (int)position);
@@ -116,288 +224,329 @@ void cartridge_ppu_write(uint16_t position, uint8_t data)
    }
 }
 
-bool cartridge_load(const char* const filepath)
+void cartridge_update_ppu_pages(uint16_t start, uint16_t end)
 {
-   FILE *file = fopen(filepath, "rb");
-   if (!file)
+   if (end > 0x2FFF)
    {
-      fclose(file);
-      printf("Cannot open file: %s\n", filepath);
-      return false;
+      end = 0x2FFF;
    }
 
-   uint8_t iNES_header[iNES_HEADER_SIZE];
-   size_t bytes_read = fread(iNES_header, sizeof(uint8_t), iNES_HEADER_SIZE, file);
+   size_t chr_mem_size = cartridge->chr_memory_size;
 
-   if (bytes_read != iNES_HEADER_SIZE)
+   for (uint32_t page = start >> PPU_PAGE_SHIFT; page <= (uint32_t) (end >> PPU_PAGE_SHIFT); ++page)
    {
-      fclose(file);
-      printf("Failed to read iNES header!\n");
-      return false;
-   }
+      // chr banks and nametables are switched in units of at least 1kb so like the cpu pages,
+      // mapping the first address of a page maps the whole page
+      size_t mapped_addr = 0;
+      cartridge_access_mode_t mode = cartridge->mapper->ppu_read(&cartridge->rom_header, (uint16_t) (page << PPU_PAGE_SHIFT), &mapped_addr, &cartridge->mapper_registers);
 
-   // check if .nes file is a valid rom file
-   if ( (iNES_header[0]=='N' && iNES_header[1]=='E' && iNES_header[2]=='S' && iNES_header[3]==0x1A) )
-   {
-      // iNES 2.0
-      if ( (iNES_header[7] & 0x0C) == 0x08 )
+      const uint8_t* memory = NULL;
+      if (mode == ACCESS_CHR_MEM && cartridge->chr_memory != NULL && (mapped_addr % chr_mem_size) + PPU_PAGE_SIZE <= chr_mem_size)
       {
-         printf("iNES 2.0\n");
-         if ( !load_iNES20(iNES_header, &rom_header) )
-         {
-            fclose(file);
-            return false;
-         }
+         memory = cartridge->chr_memory + (mapped_addr % chr_mem_size); // banks past the end of chr memory wrap around
       }
-      // iNES 1.0
-      else
+      else if (mode == ACCESS_VRAM)
       {
-         printf("iNES 1.0\n");
-         if ( !load_iNES10(iNES_header, &rom_header) )
-         {
-            fclose(file);
-            return false;
-         }
+         memory = cartridge->ppu_vram + (mapped_addr & 0x400);
       }
+
+      ppu_map_page((uint8_t) page, memory);
    }
-   else
+}
+
+bool cartridge_load(const char* const filepath)
+{
+   const Rom_Image_t* image = rom_image_acquire(filepath);
+   if (image == NULL)
    {
-      printf("Invalid nes file!\n");
-      fclose(file);
       return false;
    }
 
-   if ( !load_mapper(rom_header.mapper_id, &mapper, (void**) &mapper_registers) )
+   cartridge->image = image;
+   cartridge->rom_header = image->header;
+
+   cartridge->mapper = mapper_find(cartridge->rom_header.mapper_id, cartridge->rom_header.submapper_id);
+   if (cartridge->mapper == NULL)
    {
-      fclose(file);
-      printf("Mapper %d does not exist or is not supported!\n", rom_header.mapper_id);
+      printf("Mapper %d does not exist or is not supported!\n", cartridge->rom_header.mapper_id);
+      cartridge_free_memory();
       return false;
    }
    else
    {
-      mapper.init(&rom_header, mapper_registers);
+      cartridge->mapper->init(&cartridge->rom_header, &cartridge->mapper_registers);
    }
-   
 
-   // determine sizes of prg rom/ram and chr rom/ram in bytes
+   // only the memory an instance writes to is allocated per cartridge, at the sizes the header gives,
+   // rom is read from the image
 
-   size_t prg_rom_size = rom_header.prg_rom_size * 1024 * 16;
-   size_t chr_mem_size = 0;
-   size_t prg_ram_size = 0;
+	size_t prg_ram_size = cartridge->rom_header.prg_nvram_bytes + cartridge->rom_header.prg_ram_bytes;
+   if (prg_ram_size != 0)
+   {
+      cartridge->prg_ram = calloc( prg_ram_size, sizeof(uint8_t) );
+      if (cartridge->prg_ram == NULL)
+      {
+         printf("Failed to allocate memory for PRG-ram!\n");
+         cartridge_free_memory();
+         return false;
+      }
+      cartridge->prg_ram_size = prg_ram_size;
+   }
 
-   if (rom_header.chr_rom_size == 0) // if rom size is zero we use chr_ram which will just be fixed to 8kb of memory
+   if (cartridge->rom_header.chr_rom_size == 0) // if rom size is zero we use chr-ram instead
    {
-      chr_mem_size = 1024 * 8;
+      size_t chr_ram_size = cartridge->rom_header.chr_nvram_bytes + cartridge->rom_header.chr_ram_bytes;
+      cartridge->chr_ram = calloc( chr_ram_size, sizeof(uint8_t) );
+      if (cartridge->chr_ram == NULL)
+      {
+         printf("Failed to allocate memory for CHR-ram!\n");
+         cartridge_free_memory();
+         return false;
+      }
+      cartridge->chr_memory = cartridge->chr_ram;
+      cartridge->chr_memory_size = chr_ram_size;
    }
    else
    {
-      chr_mem_size = rom_header.chr_rom_size * 1024 * 8;
+      cartridge->chr_memory = image->chr_rom;
+      cartridge->chr_memory_size = image->chr_rom_size;
    }
 
-	prg_ram_size = rom_header.prg_ram_size * 1024 * 8;
+   cartridge->prg_rom = image->prg_rom;
+
+	// load prg ram from disk if exists for roms using battery backed ram
+	if (cartridge->rom_header.prg_nvram_bytes != 0)
+	{
+		battery_save_read(image->name, cartridge->prg_ram, cartridge->rom_header.prg_nvram_bytes);
+	}
+   cartridge->is_battery_ram_dirty = false;
+   cartridge->battery_save_time = battery_save_get_time();
 
-   // memory allocation for cartridge prg rom/ram and chr rom/ram
+   cartridge_update_cpu_pages(CPU_CARTRIDGE_PRG_RAM_START, 0xFFFF);
+   cartridge_update_ppu_pages(0x0000, 0x2FFF);
+   ppu_set_fetch_hook( (cartridge->mapper->capabilities & MAPPER_OBSERVES_PPU_FETCH) ? &cartridge_ppu_fetch : NULL );
 
-   prg_rom = calloc( prg_rom_size, sizeof(uint8_t) );
-   if (prg_rom == NULL)
-   {
-      fclose(file);
-      printf("Failed to allocate memory for PRG-rom!\n");
-      return false;
-   }
+   cpu_irq_release(CPU_IRQ_MAPPER);
+   cartridge_update_irq_deadline();
 
-   prg_ram = calloc( prg_ram_size, sizeof(uint8_t) );
-   if (prg_ram == NULL)
+   return true;
+}
+
+void cartridge_free_memory(void)
+{
+	// save prg ram to disk if the game changed its battery backed ram
+	if (cartridge->is_battery_ram_dirty && !cartridge->is_battery_save_read_only)
+	{
+      cartridge_queue_battery_save();
+	}
+
+   // unmap prg pages from the bus before the memory backing them is freed
+   for (uint32_t page = CPU_CARTRIDGE_PRG_RAM_START >> CPU_PAGE_SHIFT; page < CPU_PAGE_COUNT; ++page)
    {
-      fclose(file);
-      printf("Failed to allocate memory for PRG-ram!\n");
-      return false;
+      cpu_bus_map_read_page((uint8_t) page, NULL);
    }
 
-   chr_memory = calloc( chr_mem_size, sizeof(uint8_t) );
-   if (chr_memory == NULL)
+   for (uint8_t page = 0; page < PPU_PAGE_COUNT; ++page)
    {
-      fclose(file);
-      printf("Failed to allocated memory for CHR-rom!\n");
-      return false;
+      ppu_map_page(page, NULL);
    }
+   ppu_set_fetch_hook(NULL);
+   cpu_irq_release(CPU_IRQ_MAPPER);
+   cpu_schedule_event(CPU_EVENT_MAPPER_IRQ, LONG_MAX);
+
+   free(cartridge->prg_ram);
+   free(cartridge->chr_ram);
+   rom_image_release(cartridge->image);
+
+   cartridge->prg_rom = NULL;
+   cartridge->prg_ram = NULL;
+   cartridge->chr_memory = NULL;
+   cartridge->chr_ram = NULL;
+   cartridge->prg_ram_size = 0;
+   cartridge->chr_memory_size = 0;
+   cartridge->is_battery_ram_dirty = false;
+   cartridge->mapper = NULL;
+   memset(&cartridge->mapper_registers, 0, sizeof(cartridge->mapper_registers));
+   cartridge->image = NULL;
+   memset(&cartridge->rom_header, 0, sizeof(cartridge->rom_header));
+}
 
-   // read nes file contents into corresponding allocated memory blocks
+void cartridge_update_irq_deadline(void)
+{
+	long cycles = LONG_MAX;
+	if (cartridge->mapper != NULL && (cartridge->mapper->capabilities & MAPPER_GENERATES_IRQ))
+	{
+		cycles = cartridge->mapper->irq_deadline(&cartridge->mapper_registers);
+	}
+
+	// the mapper counts from where the ppu is, which may be behind the cpu
+	cpu_schedule_event(CPU_EVENT_MAPPER_IRQ, (cycles == LONG_MAX) ? LONG_MAX : ppu_get_cpu_cycle() + cycles);
+}
 
-   if ( rom_header.trainer != 0 )
-   {     
-      // ignore trainer data in nes file
-      printf("Trainer data present.\n");
-      fseek(file, TRAINER_SIZE, SEEK_CUR);
+void cartridge_update_battery_save(void)
+{
+   uint32_t interval = battery_save_get_interval();
+   if (!cartridge->is_battery_ram_dirty || cartridge->is_battery_save_read_only || interval == 0)
+   {
+      return;
    }
 
-   bytes_read = fread(prg_rom, sizeof(uint8_t), prg_rom_size, file);
-   if (bytes_read != prg_rom_size)
+   if (battery_save_get_time() - cartridge->battery_save_time >= interval)
    {
-      fclose(file);
-      printf("Program rom reading error!\n");
-      return false;
+      cartridge_queue_battery_save();
    }
+}
 
-   // when rom size is 0 we are using chr-ram so of course chr-rom data does not exist in the nes file
-   if ( rom_header.chr_rom_size != 0 ) 
+void cartridge_set_battery_save_writes(bool flag)
+{
+   cartridge->is_battery_save_read_only = !flag;
+}
+
+void cartridge_power_on(void)
+{
+   if (cartridge->prg_rom == NULL) // no cartridge loaded
    {
-      bytes_read = fread(chr_memory, sizeof(uint8_t), chr_mem_size, file);
-      if (bytes_read != chr_mem_size)
-      {
-         fclose(file);
-         printf("CHR-ram/rom reading error!\n");
-         return false;
-      }
+      return;
    }
 
-   printf("%-13s %d\n%-13s %zu\n%-13s %zu\n%-13s %zu\n%-13s %s\n", 
-      "Mapper:", rom_header.mapper_id, 
-      "Prg-ROM size:", prg_rom_size, 
-      "CHR-ROM/RAM", chr_mem_size, 
-      "PRG_RAM size:", prg_ram_size, 
-      "Mirroring:", (rom_header.nametable_arrangement) ? "Vertical" : "Horizontal"
-   );
+   cartridge->mapper->init(&cartridge->rom_header, &cartridge->mapper_registers);
 
-   fclose(file);
+   memset(cartridge->ppu_vram, 0, sizeof(cartridge->ppu_vram));
+   if (cartridge->chr_ram != NULL)
+   {
+      memset(cartridge->chr_ram, 0, cartridge->chr_memory_size);
+   }
+   if (cartridge->prg_ram != NULL)
+   {
+      // battery backed prg-ram comes first and holds the player's save
+      memset(cartridge->prg_ram + cartridge->rom_header.prg_nvram_bytes, 0, cartridge->rom_header.prg_ram_bytes);
+   }
+   cartridge->cpu_open_bus = 0;
 
-	const char* start = NULL;
-	const char* end = NULL;
+   cartridge_update_cpu_pages(CPU_CARTRIDGE_PRG_RAM_START, 0xFFFF);
+   cartridge_update_ppu_pages(0x0000, 0x2FFF);
+   cpu_irq_release(CPU_IRQ_MAPPER);
+   cartridge_update_irq_deadline();
+}
 
-	if ( (start = strrchr(filepath, '\\')) || (start = strrchr(filepath, '/')) )
-	{
-		start += 1;
-	}
-	else
-	{
-		start = filepath;
-	}
+uint64_t cartridge_get_rom_hash(void)
+{
+   uint64_t hash = FNV1A_64_OFFSET_BASIS;
+   if (cartridge->prg_rom != NULL)
+   {
+      hash = fnv1a_64(hash, cartridge->prg_rom, cartridge->rom_header.prg_rom_bytes);
+   }
+   if (cartridge->chr_memory != NULL && cartridge->rom_header.chr_rom_size != 0)
+   {
+      hash = fnv1a_64(hash, cartridge->chr_memory, cartridge->rom_header.chr_rom_bytes);
+   }
 
-	if ( !(end = strrchr(filepath, '.')) )
-	{
-		end = filepath + strlen(filepath) + 1;
-	}
+   return hash;
+}
 
-	uint16_t start_pos = (uint16_t) (start - filepath);
-	uint16_t end_pos = (uint16_t) (end - filepath);
-	uint16_t length = (uint16_t) (end_pos - start_pos);
+uint64_t cartridge_get_battery_ram_hash(void)
+{
+   if (cartridge->rom_header.prg_nvram_bytes == 0 || cartridge->prg_ram == NULL)
+   {
+      return 0;
+   }
 
-	strncpy(rom_name, start, length);
-	rom_name[length] = '\0';
-	printf("%s\n\n", rom_name);
+   return fnv1a_64(FNV1A_64_OFFSET_BASIS, cartridge->prg_ram, cartridge->rom_header.prg_nvram_bytes);
+}
 
-	// load prg ram from disk if exists for roms using battery backed ram
-	if (rom_header.battery_backed_ram)
-	{
-		char buffer[256] = "sav/";
-		strcat(buffer, rom_name);
-		strcat(buffer, ".sav");
-
-		FILE* save_file = fopen(buffer, "rb");
-		if (save_file)
-		{
-			fread(prg_ram, sizeof(uint8_t), prg_ram_size, save_file);
-			fclose(save_file);
-		}
-	}
+void cartridge_save_state(State_Buffer_t* buffer)
+{
+   Cartridge_State_Identity_t identity = cartridge_state_identity();
+   state_write(buffer, &identity, sizeof(identity));
 
-   return true;
+   state_write(buffer, cartridge->ppu_vram, sizeof(cartridge->ppu_vram));
+   if (cartridge->prg_ram != NULL)
+   {
+      state_write(buffer, cartridge->prg_ram, cartridge->prg_ram_size);
+   }
+   if (cartridge->chr_ram != NULL) // chr-rom never changes so only chr-ram is saved
+   {
+      state_write(buffer, cartridge->chr_ram, cartridge->chr_memory_size);
+   }
+   state_write(buffer, &cartridge->mapper_registers, (cartridge->mapper != NULL) ? cartridge->mapper->registers_size : 0);
+   state_write(buffer, &cartridge->cpu_open_bus, sizeof(cartridge->cpu_open_bus));
 }
 
-void cartridge_free_memory(void)
+void cartridge_load_state(State_Buffer_t* buffer)
 {
-	// save prg ram to disk if rom uses battery backed ram
-	if (rom_header.battery_backed_ram)
-	{
-		char buffer[256] = "sav/";
-		strcat(buffer, rom_name);
-		strcat(buffer, ".sav");
-		
-#if _WIN32
-      if (CreateDirectory("sav", NULL) == 0)
-      {
-         // ERROR_ALREADY_EXISTS means directory already exists which is perfectly fine.
-         // Any other error is not fine.
-         if (GetLastError() != ERROR_ALREADY_EXISTS)
-            printf("Failed to create sav directory! Error Code: %lu", GetLastError());
-      }
-#elif __APPLE__
-      if (mkdir("sav", 0777) == -1)
-      {
-         // EEXIST error means directory already exists which is perfectly fine.
-         // if errno does not equal EEXIST then a serious error has occured.
-         if (errno != EEXIST)
-            printf("Failed to create sav directory! errno code: %d\n", errno);
-      }
-#endif
+   Cartridge_State_Identity_t identity;
+   state_read(buffer, &identity, sizeof(identity));
 
-// todo support linux?
+   state_read(buffer, cartridge->ppu_vram, sizeof(cartridge->ppu_vram));
+   if (cartridge->prg_ram != NULL)
+   {
+      // run ahead and rewind load states all the time, battery ram only needs saving if the state changes it
+      size_t nvram_size = cartridge->rom_header.prg_nvram_bytes;
+      bool is_nvram_changed = nvram_size != 0 && buffer->position + nvram_size <= buffer->size &&
+                              memcmp(buffer->data + buffer->position, cartridge->prg_ram, nvram_size) != 0;
 
-      // if sav/ directory exists then save prg ram into that directory
-      FILE* file = fopen(buffer, "wb");
-      if (file)
-      {
-         fwrite(prg_ram, sizeof(uint8_t), rom_header.prg_ram_size * 1024 * 8, file);
-         fclose(file);
-      }
-	}
+      state_read(buffer, cartridge->prg_ram, cartridge->prg_ram_size);
+      cartridge->is_battery_ram_dirty |= is_nvram_changed;
+   }
+   if (cartridge->chr_ram != NULL)
+   {
+      state_read(buffer, cartridge->chr_ram, cartridge->chr_memory_size);
+   }
+   state_read(buffer, &cartridge->mapper_registers, (cartridge->mapper != NULL) ? cartridge->mapper->registers_size : 0);
+   state_read(buffer, &cartridge->cpu_open_bus, sizeof(cartridge->cpu_open_bus));
 
-   free(prg_rom);
-   free(prg_ram);
-   free(chr_memory);
-   free(mapper_registers);
-   
-   prg_rom = NULL;
-   prg_ram = NULL;
-   chr_memory = NULL;
-   mapper_registers = NULL;
+   // the page tables and irq deadline are derived from the mapper registers that were just replaced
+   cartridge_update_cpu_pages(CPU_CARTRIDGE_PRG_RAM_START, 0xFFFF);
+   cartridge_update_ppu_pages(0x0000, 0x2FFF);
+   cartridge_update_irq_deadline();
 }
 
-bool cartridge_is_triggering_irq(void)
+bool cartridge_validate_state(State_Buffer_t* buffer)
 {
-	return mapper.irq_signaled(mapper_registers);
+   Cartridge_State_Identity_t identity;
+   Cartridge_State_Identity_t expected = cartridge_state_identity();
+
+   return state_read(buffer, &identity, sizeof(identity)) && memcmp(&identity, &expected, sizeof(identity)) == 0;
 }
 
 /**
- * Loads data in iNES in 1.0 format into a struct.
- * @param iNES_header array container 16 header
- * @param header struct to contain header information
- * @return false on fail and true on success
+ * Collects the header fields that go at the start of the cartridge's save state chunk.
 */
-static bool load_iNES10(uint8_t *iNES_header, nes_header_t *header)
+static Cartridge_State_Identity_t cartridge_state_identity(void)
 {
-	header->battery_backed_ram = (iNES_header[6] >> 1) & 0x1;
-   header->trainer = iNES_header[6] & 0x04;
-   header->nametable_arrangement = iNES_header[6] & 0x1;
-   header->prg_rom_size = iNES_header[4];
-   header->prg_ram_size = 4; // fixed prg ram size
-   header->chr_rom_size = iNES_header[5];
+   Cartridge_State_Identity_t identity =
+   {
+      .mapper_id    = cartridge->rom_header.mapper_id,
+      .submapper_id = cartridge->rom_header.submapper_id,
+      .prg_rom_size = (uint32_t) cartridge->rom_header.prg_rom_bytes,
+      .prg_ram_size = (uint32_t) cartridge->prg_ram_size,
+      .chr_rom_size = (uint32_t) cartridge->rom_header.chr_rom_bytes,
+      .chr_ram_size = (uint32_t) ((cartridge->chr_ram != NULL) ? cartridge->chr_memory_size : 0),
+   };
+
+   return identity;
+}
 
-   if (header->prg_rom_size == 0)
+/**
+ * Hands a copy of battery backed prg-ram to the battery save thread and marks it clean.
+*/
+static void cartridge_queue_battery_save(void)
+{
+   if (cartridge->prg_ram != NULL && cartridge->image != NULL)
    {
-      printf("ERROR! No program rom size specified?\n");
-      return false;
+      battery_save_queue(cartridge->image->name, cartridge->prg_ram, cartridge->rom_header.prg_nvram_bytes);
    }
 
-   uint8_t mapper_id_lo = (iNES_header[6] & 0xF0) >> 4;
-   //uint8_t mapper_id_hi = (iNES_header[7] & 0xF0);
-   header->mapper_id =  mapper_id_lo;
-
-   return true;
+   cartridge->is_battery_ram_dirty = false;
+   cartridge->battery_save_time = battery_save_get_time();
 }
 
 /**
- * Loads data in iNES in 2.0 format into a struct.
- * @param iNES_header array container 16 header
- * @param header struct to contain header information
- * @return false on fail and true on success
+ * Forwards the address of a ppu fetch made through the ppu page table to the mapper.
+ * Only installed for mappers that are MAPPER_OBSERVES_PPU_FETCH.
+ * @param position ppu address that was fetched
 */
-static bool load_iNES20(uint8_t *iNES_header, nes_header_t *header)
+static void cartridge_ppu_fetch(uint16_t position)
 {
-   (void) iNES_header;
-   (void) header;
-   // todo: iNES 2.0
-   printf("iNES 2.0 not implemented yet.\n");
-
-   return false;
+   cartridge->mapper->ppu_fetch(&cartridge->rom_header, position, &cartridge->mapper_registers);
 }
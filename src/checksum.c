@@ -0,0 +1,199 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "checksum.h"
+
+#define CRC32_POLYNOMIAL 0xEDB88320u // reflected IEEE 802.3 polynomial
+
+static uint32_t crc32_tables[8][256]; // crc32_tables[k][b] is the crc of byte b followed by k zero bytes
+static bool is_crc32_tables_built = false;
+
+static void sha1_transform(Sha1_Context_t* context, const uint8_t block[64]);
+static uint32_t sha1_rotate(uint32_t value, uint32_t bits);
+
+void checksum_init(void)
+{
+   if (is_crc32_tables_built)
+   {
+      return;
+   }
+
+   for (uint32_t b = 0; b < 256; ++b)
+   {
+      uint32_t crc = b;
+      for (int bit = 0; bit < 8; ++bit)
+      {
+         crc = (crc & 1) ? (crc >> 1) ^ CRC32_POLYNOMIAL : crc >> 1;
+      }
+      crc32_tables[0][b] = crc;
+   }
+
+   for (uint32_t b = 0; b < 256; ++b)
+   {
+      for (int k = 1; k < 8; ++k)
+      {
+         uint32_t previous = crc32_tables[k - 1][b];
+         crc32_tables[k][b] = (previous >> 8) ^ crc32_tables[0][previous & 0xFF];
+      }
+   }
+
+   is_crc32_tables_built = true;
+}
+
+uint32_t crc32_update(uint32_t crc, const void* data, size_t size)
+{
+   checksum_init();
+
+   const uint8_t* bytes = (const uint8_t*) data;
+   crc = ~crc;
+
+   // eight bytes per step, every byte looked up in the table for its distance from the end of the step
+   while (size >= 8)
+   {
+      uint32_t lo = crc ^ ( (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24 );
+      uint32_t hi = (uint32_t) bytes[4] | (uint32_t) bytes[5] << 8 | (uint32_t) bytes[6] << 16 | (uint32_t) bytes[7] << 24;
+
+      crc = crc32_tables[7][lo & 0xFF] ^ crc32_tables[6][(lo >> 8) & 0xFF] ^
+            crc32_tables[5][(lo >> 16) & 0xFF] ^ crc32_tables[4][lo >> 24] ^
+            crc32_tables[3][hi & 0xFF] ^ crc32_tables[2][(hi >> 8) & 0xFF] ^
+            crc32_tables[1][(hi >> 16) & 0xFF] ^ crc32_tables[0][hi >> 24];
+
+      bytes += 8;
+      size -= 8;
+   }
+
+   while (size-- > 0)
+   {
+      crc = (crc >> 8) ^ crc32_tables[0][(crc ^ *bytes++) & 0xFF];
+   }
+
+   return ~crc;
+}
+
+void sha1_init(Sha1_Context_t* context)
+{
+   context->state[0] = 0x67452301;
+   context->state[1] = 0xEFCDAB89;
+   context->state[2] = 0x98BADCFE;
+   context->state[3] = 0x10325476;
+   context->state[4] = 0xC3D2E1F0;
+   context->length = 0;
+}
+
+void sha1_update(Sha1_Context_t* context, const void* data, size_t size)
+{
+   const uint8_t* bytes = (const uint8_t*) data;
+   size_t used = (size_t) (context->length % 64);
+   context->length += size;
+
+   if (used != 0)
+   {
+      size_t fill = 64 - used;
+      if (size < fill)
+      {
+         memcpy(context->block + used, bytes, size);
+         return;
+      }
+
+      memcpy(context->block + used, bytes, fill);
+      sha1_transform(context, context->block);
+      bytes += fill;
+      size -= fill;
+   }
+
+   // whole blocks are hashed straight from data
+   while (size >= 64)
+   {
+      sha1_transform(context, bytes);
+      bytes += 64;
+      size -= 64;
+   }
+
+   memcpy(context->block, bytes, size);
+}
+
+void sha1_final(Sha1_Context_t* context, uint8_t digest[SHA1_DIGEST_SIZE])
+{
+   uint64_t bit_length = context->length * 8;
+
+   // a 1 bit, zeros up to 8 bytes short of a block, then the message length in bits big endian
+   uint8_t padding[64 + 8] = { 0x80 };
+   size_t used = (size_t) (context->length % 64);
+   size_t padding_size = (used < 56) ? 56 - used : 120 - used;
+
+   for (int i = 0; i < 8; ++i)
+   {
+      padding[padding_size + i] = (uint8_t) (bit_length >> (56 - i * 8));
+   }
+   sha1_update(context, padding, padding_size + 8);
+
+   for (int i = 0; i < SHA1_DIGEST_SIZE; ++i)
+   {
+      digest[i] = (uint8_t) (context->state[i / 4] >> (24 - (i % 4) * 8));
+   }
+}
+
+static uint32_t sha1_rotate(uint32_t value, uint32_t bits)
+{
+   return (value << bits) | (value >> (32 - bits));
+}
+
+/**
+ * Mixes one 64 byte block into the hash state.
+*/
+static void sha1_transform(Sha1_Context_t* context, const uint8_t block[64])
+{
+   uint32_t w[80];
+   for (int i = 0; i < 16; ++i)
+   {
+      w[i] = (uint32_t) block[i * 4] << 24 | (uint32_t) block[i * 4 + 1] << 16 | (uint32_t) block[i * 4 + 2] << 8 | block[i * 4 + 3];
+   }
+   for (int i = 16; i < 80; ++i)
+   {
+      w[i] = sha1_rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+   }
+
+   uint32_t a = context->state[0];
+   uint32_t b = context->state[1];
+   uint32_t c = context->state[2];
+   uint32_t d = context->state[3];
+   uint32_t e = context->state[4];
+
+   for (int i = 0; i < 80; ++i)
+   {
+      uint32_t f, k;
+      if (i < 20)
+      {
+         f = (b & c) | (~b & d);
+         k = 0x5A827999;
+      }
+      else if (i < 40)
+      {
+         f = b ^ c ^ d;
+         k = 0x6ED9EBA1;
+      }
+      else if (i < 60)
+      {
+         f = (b & c) | (b & d) | (c & d);
+         k = 0x8F1BBCDC;
+      }
+      else
+      {
+         f = b ^ c ^ d;
+         k = 0xCA62C1D6;
+      }
+
+      uint32_t temp = sha1_rotate(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = sha1_rotate(b, 30);
+      b = a;
+      a = temp;
+   }
+
+   context->state[0] += a;
+   context->state[1] += b;
+   context->state[2] += c;
+   context->state[3] += d;
+   context->state[4] += e;
+}
@@ -1,46 +1,67 @@
+#include <stdlib.h>
+
 #include "../includes/controllers.h"
+#include "../includes/util.h"
 
-// emulator joypad variables track button states and are updated when sdl polls for inputs every frame
+struct Controllers_Context_t
+{
+   // emulator joypad variables track button states and are updated when sdl polls for inputs every frame
+   uint8_t emulator_joypad1;
+   uint8_t emulator_joypad2;
 
-static uint8_t emulator_joypad1 = 0;
+   // shift registers hold each of the 8 button states and is shifted 1 bit right when it is read
+   uint8_t joypad1_shift;
+   uint8_t joypad2_shift;
+   uint8_t strobe; // 1: controller will continuously reload the shift registers, 0: controller will stop reloading shift registers
+};
 
-static uint8_t emulator_joypad2 = 0;
+static Controllers_Context_t default_context;
+static NES_THREAD_LOCAL Controllers_Context_t* controllers = &default_context; // context of the instance bound to this thread
 
-// shift registers hold each of the 8 button states and is shifted 1 bit right when it is read
+Controllers_Context_t* controllers_context_create(void)
+{
+   return calloc(1, sizeof(Controllers_Context_t));
+}
 
-static uint8_t joypad1_shift = 0;
-static uint8_t joypad2_shift = 0;
-static uint8_t strobe; // 1: controller will continuously reload the shift registers, 0: controller will stop reloading shift registers
+void controllers_context_destroy(Controllers_Context_t* context)
+{
+   free(context);
+}
+
+void controllers_bind(Controllers_Context_t* context)
+{
+   controllers = (context != NULL) ? context : &default_context;
+}
 
 void controller_write_strobe(uint8_t data)
 {
-   strobe = data;
+   controllers->strobe = data;
 }
 
 uint8_t controller1_read(void)
 {
-   uint8_t button_state = joypad1_shift & 0x1;
-   joypad1_shift = joypad1_shift >> 1;
-   joypad1_shift |= 0x80;
+   uint8_t button_state = controllers->joypad1_shift & 0x1;
+   controllers->joypad1_shift = controllers->joypad1_shift >> 1;
+   controllers->joypad1_shift |= 0x80;
    
    return button_state;
 }
 
 uint8_t controller2_read(void) // only 1 controller supported for now!
 {
-   uint8_t button_state = joypad2_shift & 0x1;
-   joypad2_shift = joypad2_shift >> 1;
-   joypad2_shift |= 0x80;
+   uint8_t button_state = controllers->joypad2_shift & 0x1;
+   controllers->joypad2_shift = controllers->joypad2_shift >> 1;
+   controllers->joypad2_shift |= 0x80;
 
    return button_state;
 }
 
 void controller_reload_shift_registers(void)
 {
-   if (strobe & 0x1)
+   if (controllers->strobe & 0x1)
    {
-      joypad1_shift = emulator_joypad1;
-      joypad2_shift = emulator_joypad2;
+      controllers->joypad1_shift = controllers->emulator_joypad1;
+      controllers->joypad2_shift = controllers->emulator_joypad2;
    }
 }
 
@@ -50,42 +71,42 @@ void controller1_set_button_down(JOYPAD_BUTTONS button) // only 1 controller sup
    {
       case BUTTON_UP:
       {
-         emulator_joypad1 |= BUTTON_UP;
+         controllers->emulator_joypad1 |= BUTTON_UP;
          break;
       }
       case BUTTON_DOWN:
       {
-         emulator_joypad1 |= BUTTON_DOWN;
+         controllers->emulator_joypad1 |= BUTTON_DOWN;
          break;
       }
       case BUTTON_LEFT:
       {
-         emulator_joypad1 |= BUTTON_LEFT;
+         controllers->emulator_joypad1 |= BUTTON_LEFT;
          break;
       }
       case BUTTON_RIGHT:
       {
-         emulator_joypad1 |= BUTTON_RIGHT;
+         controllers->emulator_joypad1 |= BUTTON_RIGHT;
          break;
       }
       case BUTTON_A:
       {
-         emulator_joypad1 |= BUTTON_A;
+         controllers->emulator_joypad1 |= BUTTON_A;
          break;
       }
       case BUTTON_B:
       {
-         emulator_joypad1 |= BUTTON_B;
+         controllers->emulator_joypad1 |= BUTTON_B;
          break;
       }
       case BUTTON_START:
       {
-         emulator_joypad1 |= BUTTON_START;
+         controllers->emulator_joypad1 |= BUTTON_START;
          break;
       }
       case BUTTON_SELECT:
       {
-         emulator_joypad1 |= BUTTON_SELECT;
+         controllers->emulator_joypad1 |= BUTTON_SELECT;
          break;
       }  
    }
@@ -97,43 +118,80 @@ void controller1_set_button_up(JOYPAD_BUTTONS button) // only 1 controller suppo
    {
       case BUTTON_UP:
       {
-         emulator_joypad1 &= ~BUTTON_UP;
+         controllers->emulator_joypad1 &= ~BUTTON_UP;
          break;
       }
       case BUTTON_DOWN:
       {
-         emulator_joypad1 &= ~BUTTON_DOWN;
+         controllers->emulator_joypad1 &= ~BUTTON_DOWN;
          break;
       }
       case BUTTON_LEFT:
       {
-         emulator_joypad1 &= ~ BUTTON_LEFT;
+         controllers->emulator_joypad1 &= ~ BUTTON_LEFT;
          break;
       }
       case BUTTON_RIGHT:
       {
-         emulator_joypad1 &= ~ BUTTON_RIGHT;
+         controllers->emulator_joypad1 &= ~ BUTTON_RIGHT;
          break;
       }
       case BUTTON_A:
       {
-         emulator_joypad1 &= ~ BUTTON_A;
+         controllers->emulator_joypad1 &= ~ BUTTON_A;
          break;
       }
       case BUTTON_B:
       {
-         emulator_joypad1 &= ~ BUTTON_B;
+         controllers->emulator_joypad1 &= ~ BUTTON_B;
          break;
       }
       case BUTTON_START:
       {
-         emulator_joypad1 &= ~ BUTTON_START;
+         controllers->emulator_joypad1 &= ~ BUTTON_START;
          break;
       }
       case BUTTON_SELECT:
       {
-         emulator_joypad1 &= ~ BUTTON_SELECT;
+         controllers->emulator_joypad1 &= ~ BUTTON_SELECT;
          break;
       }  
    }
 }
+
+void controllers_get_buttons(uint8_t* joypad1, uint8_t* joypad2)
+{
+   *joypad1 = controllers->emulator_joypad1;
+   *joypad2 = controllers->emulator_joypad2;
+}
+
+void controllers_set_buttons(uint8_t joypad1, uint8_t joypad2)
+{
+   controllers->emulator_joypad1 = joypad1;
+   controllers->emulator_joypad2 = joypad2;
+}
+
+void controllers_reset(void)
+{
+   controllers->emulator_joypad1 = 0;
+   controllers->emulator_joypad2 = 0;
+   controllers->joypad1_shift = 0;
+   controllers->joypad2_shift = 0;
+   controllers->strobe = 0;
+}
+
+// the held buttons are live input from the gui rather than machine state, so they are not saved
+
+void controllers_save_state(State_Buffer_t* buffer)
+{
+   state_write(buffer, &controllers->joypad1_shift, sizeof(controllers->joypad1_shift));
+   state_write(buffer, &controllers->joypad2_shift, sizeof(controllers->joypad2_shift));
+   state_write(buffer, &controllers->strobe, sizeof(controllers->strobe));
+}
+
+void controllers_load_state(State_Buffer_t* buffer)
+{
+   state_read(buffer, &controllers->joypad1_shift, sizeof(controllers->joypad1_shift));
+   state_read(buffer, &controllers->joypad2_shift, sizeof(controllers->joypad2_shift));
+   state_read(buffer, &controllers->strobe, sizeof(controllers->strobe));
+}
@@ -2,8 +2,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
-
-#include "SDL_timer.h"
+#include <limits.h>
+#include <time.h>
 
 #include "cpu.h"
 #include "apu.h"
@@ -15,6 +15,8 @@
 #include "controllers.h"
 #include "display.h"
 #include "cartridge.h"
+#include "rewind.h"
+#include "movie.h"
 
 #define NMI_VECTOR       0xFFFA // address of non-maskable interrupt vector
 #define RESET_VECTOR     0xFFFC // address of reset vector
@@ -28,166 +30,154 @@
 */
 #define CPU_STACK_ADDRESS 0x0100
 
-static cpu_6502_t cpu;
+#define CPU_FRAME_MICROSECONDS (1000000.0 / 60.0988)
+
+static cpu_6502_t default_context = { .event_cycles = { LONG_MAX, LONG_MAX, LONG_MAX } };
+static NES_THREAD_LOCAL cpu_6502_t* cpu = &default_context; // registers of the instance bound to this thread
 static Emulator_State_t* emu_state = NULL;
 
+static uint32_t run_ahead_frames = 0;
+static State_Buffer_t run_ahead_state; // real timeline, saved while frames are run ahead of it
+static double frame_cost_us = 0.0;     // moving averages of the host time an emulated frame and a state save + load take
+static double state_cost_us = 0.0;
+
 static uint8_t cpu_fetch(void);
 static uint8_t cpu_fetch_no_increment(void);
-static inline void cpu_execute(void);
-static inline void cpu_decode(uint8_t opcode);
-static uint8_t branch(void);
-static void set_instruction_operand(address_modes_t address_mode, uint8_t *extra_cycle);
+static inline void cpu_execute(uint8_t opcode);
+static void branch(bool condition);
+static void cpu_set_cycle_count(long cycle_count);
+static void cpu_attach_emulator_state(void);
+static void cpu_run_events(void);
+static void cpu_run_ahead(void);
+static double cpu_clock_us(void);
+static void cpu_update_average(double* average, double sample);
 static void stack_push(uint8_t value);
 static uint8_t stack_pop(void);
-static bool check_opcode_access_mode(uint8_t opcode);
-
-// current opcode of the current instruction
-static uint8_t current_opcode;
-
-// current instruction to be executed
-static const instruction_t* current_instruction = NULL;
-
-/**
- * Stores the operand of the instrucion depending on it's adressing mode.
- * Is unused by certain addressing modes such as implied and accumulator modes
- * because the operations are well... implied.
-*/
-static uint16_t instruction_operand;
 
 // ------------------------------- instruction functions ----------------------------------------------------
 
 /**
- * most instruction functions will return 0 but branch instructions 
- * for example return 1 to represent 1 extra cycle when a branch is taken
- * or 2 if a branch is taken and page boudary is crossed.
+ * Instruction functions only perform the operation, the addressing mode is fixed by
+ * each opcode's case in cpu_execute(). Read instructions are passed the operand value,
+ * write and jump instructions are passed the effective address, and read-modify-write
+ * instructions are passed the value in memory or the accumulator and return the result.
  * Function signature commented with * are undocumented opcodes, most games
  * do not make use of these instructions.
 */
 
 // load instructions
 
-static uint8_t LAS(void); // *
-static uint8_t LAX(void); // * implemented
-static uint8_t LDA(void);
-static uint8_t LDX(void);
-static uint8_t LDY(void);
-static uint8_t SAX(void); // * implemented
-static uint8_t SHA(void); // *
-static uint8_t SHX(void); // *
-static uint8_t SHY(void); // *
-static uint8_t STA(void);
-static uint8_t STX(void);
-static uint8_t STY(void);
+static void LAS(uint16_t address); // *
+static void LAX(uint8_t value); // * implemented
+static void LDA(uint8_t value);
+static void LDX(uint8_t value);
+static void LDY(uint8_t value);
+static void SAX(uint16_t address); // * implemented
+static void SHA(uint16_t address); // *
+static void SHX(uint16_t address); // *
+static void SHY(uint16_t address); // *
+static void STA(uint16_t address);
+static void STX(uint16_t address);
+static void STY(uint16_t address);
 
 // transfer instructions
 
-static uint8_t SHS(void); // *
-static uint8_t TAX(void);
-static uint8_t TAY(void);
-static uint8_t TSX(void);
-static uint8_t TXA(void);
-static uint8_t TXS(void);
-static uint8_t TYA(void);
+static void SHS(uint16_t address); // *
+static void TAX(void);
+static void TAY(void);
+static void TSX(void);
+static void TXA(void);
+static void TXS(void);
+static void TYA(void);
 
 // stack instructions
 
-static uint8_t PHA(void);
-static uint8_t PHP(void);  
-static uint8_t PLA(void);
-static uint8_t PLP(void);
+static void PHA(void);
+static void PHP(void);  
+static void PLA(void);
+static void PLP(void);
 
 // shift instructions
 
-static uint8_t ASL(void);
-static uint8_t LSR(void);
-static uint8_t ROL(void);
-static uint8_t ROR(void);
+static uint8_t ASL(uint8_t value);
+static uint8_t LSR(uint8_t value);
+static uint8_t ROL(uint8_t value);
+static uint8_t ROR(uint8_t value);
 
 // logic instructions
 
-static uint8_t AND(void);
-static uint8_t BIT(void);
-static uint8_t EOR(void);
-static uint8_t ORA(void);
+static void AND(uint8_t value);
+static void BIT(uint8_t value);
+static void EOR(uint8_t value);
+static void ORA(uint8_t value);
 
 // arithmetic instructions
 
-static uint8_t ADC(void);
-static uint8_t ANC(void); // *
-static uint8_t ARR(void); // * 
-static uint8_t ASR(void); // *
-static uint8_t CMP(void);
-static uint8_t CPX(void);
-static uint8_t CPY(void);
-static uint8_t DCP(void); // * implemented
-static uint8_t ISB(void); // * implemented
-static uint8_t RLA(void); // * implemented
-static uint8_t RRA(void); // * implemented
-static uint8_t SBC(void);
-static uint8_t SBX(void); // *
-static uint8_t SLO(void); // * implemented
-static uint8_t SRE(void); // * implemented
-static uint8_t XAA(void); // *
+static void ADC(uint8_t value);
+static void ANC(uint8_t value); // *
+static void ARR(uint8_t value); // * 
+static void ASR(uint8_t value); // *
+static void CMP(uint8_t value);
+static void CPX(uint8_t value);
+static void CPY(uint8_t value);
+static uint8_t DCP(uint8_t value); // * implemented
+static uint8_t ISB(uint8_t value); // * implemented
+static uint8_t RLA(uint8_t value); // * implemented
+static uint8_t RRA(uint8_t value); // * implemented
+static void SBC(uint8_t value);
+static void SBX(uint8_t value); // *
+static uint8_t SLO(uint8_t value); // * implemented
+static uint8_t SRE(uint8_t value); // * implemented
+static void XAA(uint8_t value); // *
 
 // increment instructions
 
-static uint8_t DEC(void);
-static uint8_t DEX(void);
-static uint8_t DEY(void);
-static uint8_t INC(void);
-static uint8_t INX(void);
-static uint8_t INY(void);
+static uint8_t DEC(uint8_t value);
+static void DEX(void);
+static void DEY(void);
+static uint8_t INC(uint8_t value);
+static void INX(void);
+static void INY(void);
 
 // control
 
-static uint8_t BRK(void);
-static uint8_t JMP(void);
-static uint8_t JSR(void);
-static uint8_t RTI(void);
-static uint8_t RTS(void);
+static void BRK(void);
+static void JMP(uint16_t address);
+static void JSR(uint16_t address);
+static void RTI(void);
+static void RTS(void);
 
 // branch instructions
 
-static uint8_t BCC(void);
-static uint8_t BCS(void);
-static uint8_t BEQ(void);
-static uint8_t BMI(void);
-static uint8_t BNE(void);
-static uint8_t BPL(void);
-static uint8_t BVC(void);
-static uint8_t BVS(void);
+static void BCC(void);
+static void BCS(void);
+static void BEQ(void);
+static void BMI(void);
+static void BNE(void);
+static void BPL(void);
+static void BVC(void);
+static void BVS(void);
 
 // flags instructions
 
-static uint8_t CLC(void);
-static uint8_t CLD(void);
-static uint8_t CLI(void);
-static uint8_t CLV(void);
-static uint8_t SEC(void);
-static uint8_t SED(void);
-static uint8_t SEI(void);
+static void CLC(void);
+static void CLD(void);
+static void CLI(void);
+static void CLV(void);
+static void SEC(void);
+static void SED(void);
+static void SEI(void);
 
 // kil
 
-static uint8_t JAM(void){return 0;}
+static void JAM(void){}
 
 // nop instruction
 
-static uint8_t NOP(void){
-   switch (current_instruction->mode)
-   {
-      case ZPG:
-      case XZP:
-      case XAB:
-      case ABS:
-         cpu_bus_read(instruction_operand);
-         break;
-      default:
-         break;
-   }
-
-   return 0;
-} 
+/**
+ * Does nothing with the operand, the bus accesses of its addressing mode are still performed.
+*/
+static void NOP(uint8_t value){(void) value;}
 
 // addressing modes
 // https://www.pagetable.com/c64ref/6502/
@@ -203,372 +193,237 @@ static uint8_t NOP(void){
 // (a16)    absolute indirect             ABI
 // r8       relative                      REL
 
+// mnemonic, addressing mode and base cycle count of each opcode, used by the disassembler
 static const instruction_t instruction_lookup_table[] = 
 {
-   /* 0x00 - 0x 0F */
-   {"BRK", &BRK, IMP, 7},  {"ORA", &ORA, XZI, 6},  {"*JAM", &JAM, IMP, 0},
-   {"*SLO", &SLO, XZI, 8}, {"*NOP", &NOP, ZPG, 3}, {"ORA", &ORA, ZPG, 3},
-   {"ASL", &ASL, ZPG, 5},  {"*SLO", &SLO, ZPG, 5}, {"PHP", &PHP, IMP, 3},
-   {"ORA", &ORA, IMM, 2},  {"ASL", &ASL, ACC, 2},  {"*ANC", &ANC, IMM, 2},
-   {"*NOP", &NOP, ABS, 4}, {"ORA", &ORA, ABS, 4},  {"ASL", &ASL, ABS, 6},
-   {"*SLO", &SLO, ABS, 6},
+   /* 0x00 - 0x0F */
+   {"BRK", IMP, 7},     {"ORA", XZI, 6},     {"*JAM", IMP, 0},    {"*SLO", XZI, 8},
+   {"*NOP", ZPG, 3},    {"ORA", ZPG, 3},     {"ASL", ZPG, 5},     {"*SLO", ZPG, 5},
+   {"PHP", IMP, 3},     {"ORA", IMM, 2},     {"ASL", ACC, 2},     {"*ANC", IMM, 2},
+   {"*NOP", ABS, 4},    {"ORA", ABS, 4},     {"ASL", ABS, 6},     {"*SLO", ABS, 6},
 
    /* 0x10 - 0x1F */
-   {"BPL", &BPL, REL, 2},  {"ORA", &ORA, YZI, 5},  {"*JAM", &JAM, IMP, 0},
-   {"*SLO", &SLO, YZI, 8}, {"*NOP", &NOP, XZP, 4}, {"ORA", &ORA, XZP, 4},
-   {"ASL", &ASL, XZP, 6},  {"*SLO", &SLO, XZP, 6}, {"CLC", &CLC, IMP, 2},
-   {"ORA", &ORA, YAB, 4},  {"*NOP", &NOP, IMP, 2}, {"*SLO", &SLO, YAB, 7},
-   {"*NOP", &NOP, XAB, 4}, {"ORA", &ORA, XAB, 4},  {"ASL", &ASL, XAB, 7},
-   {"*SLO", &SLO, XAB, 7},
+   {"BPL", REL, 2},     {"ORA", YZI, 5},     {"*JAM", IMP, 0},    {"*SLO", YZI, 8},
+   {"*NOP", XZP, 4},    {"ORA", XZP, 4},     {"ASL", XZP, 6},     {"*SLO", XZP, 6},
+   {"CLC", IMP, 2},     {"ORA", YAB, 4},     {"*NOP", IMP, 2},    {"*SLO", YAB, 7},
+   {"*NOP", XAB, 4},    {"ORA", XAB, 4},     {"ASL", XAB, 7},     {"*SLO", XAB, 7},
 
    /* 0x20 - 0x2F */
-   {"JSR", &JSR, ABS, 6},  {"AND", &AND, XZI, 6},  {"*JAM", &JAM, IMP, 0},
-   {"*RLA", &RLA, XZI, 8}, {"BIT", &BIT, ZPG, 3},  {"AND", &AND, ZPG, 3},
-   {"ROL", &ROL, ZPG, 5},  {"*RLA", &RLA, ZPG, 5}, {"PLP", &PLP, IMP, 4},
-   {"AND", &AND, IMM, 2},  {"ROL", &ROL, ACC, 2},  {"*ANC", &ANC, IMM, 2},
-   {"BIT", &BIT, ABS, 4},  {"AND", &AND, ABS, 4},  {"ROL", &ROL, ABS, 6},
-   {"*RLA", &RLA, ABS, 6},
+   {"JSR", ABS, 6},     {"AND", XZI, 6},     {"*JAM", IMP, 0},    {"*RLA", XZI, 8},
+   {"BIT", ZPG, 3},     {"AND", ZPG, 3},     {"ROL", ZPG, 5},     {"*RLA", ZPG, 5},
+   {"PLP", IMP, 4},     {"AND", IMM, 2},     {"ROL", ACC, 2},     {"*ANC", IMM, 2},
+   {"BIT", ABS, 4},     {"AND", ABS, 4},     {"ROL", ABS, 6},     {"*RLA", ABS, 6},
 
    /* 0x30 - 0x3F */
-   {"BMI", &BMI, REL, 2},  {"AND", &AND, YZI, 5},  {"*JAM", &JAM, IMP, 0},
-   {"*RLA", &RLA, YZI, 8}, {"*NOP", &NOP, XZP, 4}, {"AND", &AND, XZP, 4},
-   {"ROL", &ROL, XZP, 6},  {"*RLA", &RLA, XZP, 6}, {"SEC", &SEC, IMP, 2},
-   {"AND", &AND, YAB, 4},  {"*NOP", &NOP, IMP, 2}, {"*RLA", &RLA, YAB, 7},
-   {"*NOP", &NOP, XAB, 4}, {"AND", &AND, XAB, 4},  {"ROL", &ROL, XAB, 7},
-   {"*RLA", &RLA, XAB, 7},
+   {"BMI", REL, 2},     {"AND", YZI, 5},     {"*JAM", IMP, 0},    {"*RLA", YZI, 8},
+   {"*NOP", XZP, 4},    {"AND", XZP, 4},     {"ROL", XZP, 6},     {"*RLA", XZP, 6},
+   {"SEC", IMP, 2},     {"AND", YAB, 4},     {"*NOP", IMP, 2},    {"*RLA", YAB, 7},
+   {"*NOP", XAB, 4},    {"AND", XAB, 4},     {"ROL", XAB, 7},     {"*RLA", XAB, 7},
 
    /* 0x40 - 0x4F */
-   {"RTI", &RTI, IMP, 6},  {"EOR", &EOR, XZI, 6},  {"*JAM", &JAM, IMP, 0},
-   {"*SRE", &SRE, XZI, 8}, {"*NOP", &NOP, ZPG, 3}, {"EOR", &EOR, ZPG, 3},
-   {"LSR", &LSR, ZPG, 5},  {"*SRE", &SRE, ZPG, 5}, {"PHA", &PHA, IMP, 3}, 
-   {"EOR", &EOR, IMM, 2},  {"LSR", &LSR, ACC, 2},  {"*ASR", &ASR, IMM, 2}, 
-   {"JMP", &JMP, ABS, 3},  {"EOR", &EOR, ABS, 4},  {"LSR", &LSR, ABS, 6},
-   {"*SRE", &SRE, ABS, 6},
+   {"RTI", IMP, 6},     {"EOR", XZI, 6},     {"*JAM", IMP, 0},    {"*SRE", XZI, 8},
+   {"*NOP", ZPG, 3},    {"EOR", ZPG, 3},     {"LSR", ZPG, 5},     {"*SRE", ZPG, 5},
+   {"PHA", IMP, 3},     {"EOR", IMM, 2},     {"LSR", ACC, 2},     {"*ASR", IMM, 2},
+   {"JMP", ABS, 3},     {"EOR", ABS, 4},     {"LSR", ABS, 6},     {"*SRE", ABS, 6},
 
    /* 0x50 - 0x5F */
-   {"BVC", &BVC, REL, 2},  {"EOR", &EOR, YZI, 5},  {"*JAM", &JAM, IMP, 0},
-   {"*SRE", &SRE, YZI, 8}, {"*NOP", &NOP, XZP, 4}, {"EOR", &EOR, XZP, 4},
-   {"LSR", &LSR, XZP, 6},  {"*SRE", &SRE, XZP, 6}, {"CLI", &CLI, IMP, 2},
-   {"EOR", &EOR, YAB, 4},  {"*NOP", &NOP, IMP, 2}, {"*SRE", &SRE, YAB, 7},
-   {"*NOP", &NOP, XAB, 4}, {"EOR", &EOR, XAB, 4},  {"LSR", &LSR, XAB, 7},
-   {"*SRE", &SRE, XAB,7},
+   {"BVC", REL, 2},     {"EOR", YZI, 5},     {"*JAM", IMP, 0},    {"*SRE", YZI, 8},
+   {"*NOP", XZP, 4},    {"EOR", XZP, 4},     {"LSR", XZP, 6},     {"*SRE", XZP, 6},
+   {"CLI", IMP, 2},     {"EOR", YAB, 4},     {"*NOP", IMP, 2},    {"*SRE", YAB, 7},
+   {"*NOP", XAB, 4},    {"EOR", XAB, 4},     {"LSR", XAB, 7},     {"*SRE", XAB, 7},
 
    /* 0x60 - 0x6F */
-   {"RTS", &RTS, IMP, 6},  {"ADC", &ADC, XZI, 6},  {"*JAM", &JAM, IMP, 0},
-   {"*RRA", &RRA, XZI, 8}, {"*NOP", &NOP, ZPG, 3}, {"ADC", &ADC, ZPG, 3},
-   {"ROR", &ROR, ZPG, 5},  {"*RRA", &RRA, ZPG, 5}, {"PLA", &PLA, IMP, 4},
-   {"ADC", &ADC, IMM, 2},  {"ROR", &ROR, ACC, 2},  {"*ARR", &ARR, IMM, 2},
-   {"JMP", &JMP, ABI, 5},  {"ADC", &ADC, ABS, 4},  {"ROR", &ROR, ABS, 6},
-   {"*RRA", &RRA, ABS, 6},
-
-   /* 0x70 - 7F */
-   {"BVS", &BVS, REL, 2},  {"ADC", &ADC, YZI, 5},  {"*JAM", &JAM, IMP, 0},
-   {"*RRA", &RRA, YZI, 8}, {"*NOP", &NOP, XZP, 4}, {"ADC", &ADC, XZP, 4},
-   {"ROR", &ROR, XZP, 6},  {"*RRA", &RRA, XZP, 6}, {"SEI", &SEI, IMP, 2},
-   {"ADC", &ADC, YAB, 4},  {"*NOP", &NOP, IMP, 2}, {"*RRA", &RRA, YAB, 7},
-   {"*NOP", &NOP, XAB, 4}, {"ADC", &ADC, XAB, 4},  {"ROR", &ROR, XAB, 7},
-   {"*RRA", &RRA, XAB, 7},
+   {"RTS", IMP, 6},     {"ADC", XZI, 6},     {"*JAM", IMP, 0},    {"*RRA", XZI, 8},
+   {"*NOP", ZPG, 3},    {"ADC", ZPG, 3},     {"ROR", ZPG, 5},     {"*RRA", ZPG, 5},
+   {"PLA", IMP, 4},     {"ADC", IMM, 2},     {"ROR", ACC, 2},     {"*ARR", IMM, 2},
+   {"JMP", ABI, 5},     {"ADC", ABS, 4},     {"ROR", ABS, 6},     {"*RRA", ABS, 6},
+
+   /* 0x70 - 0x7F */
+   {"BVS", REL, 2},     {"ADC", YZI, 5},     {"*JAM", IMP, 0},    {"*RRA", YZI, 8},
+   {"*NOP", XZP, 4},    {"ADC", XZP, 4},     {"ROR", XZP, 6},     {"*RRA", XZP, 6},
+   {"SEI", IMP, 2},     {"ADC", YAB, 4},     {"*NOP", IMP, 2},    {"*RRA", YAB, 7},
+   {"*NOP", XAB, 4},    {"ADC", XAB, 4},     {"ROR", XAB, 7},     {"*RRA", XAB, 7},
 
    /* 0x80 - 0x8F */
-   {"*NOP", &NOP, IMM, 2}, {"STA", &STA, XZI, 6},  {"*NOP", &NOP, IMM, 2},
-   {"*SAX", &SAX, XZI, 6}, {"STY", &STY, ZPG, 3},  {"STA", &STA, ZPG, 3},
-   {"STX", &STX, ZPG, 3},  {"*SAX", &SAX, ZPG, 3}, {"DEY", &DEY, IMP, 2},
-   {"*NOP", &NOP, IMM, 2}, {"TXA", &TXA, IMP, 2},  {"*XAA", &XAA, IMM, 2},
-   {"STY", &STY, ABS, 4},  {"STA", &STA, ABS, 4},  {"STX", &STX, ABS, 4},
-   {"*SAX", &SAX, ABS, 4},
+   {"*NOP", IMM, 2},    {"STA", XZI, 6},     {"*NOP", IMM, 2},    {"*SAX", XZI, 6},
+   {"STY", ZPG, 3},     {"STA", ZPG, 3},     {"STX", ZPG, 3},     {"*SAX", ZPG, 3},
+   {"DEY", IMP, 2},     {"*NOP", IMM, 2},    {"TXA", IMP, 2},     {"*XAA", IMM, 2},
+   {"STY", ABS, 4},     {"STA", ABS, 4},     {"STX", ABS, 4},     {"*SAX", ABS, 4},
 
    /* 0x90 - 0x9F */
-   {"BCC", &BCC, REL, 2},  {"STA", &STA, YZI, 6},  {"*JAM", &JAM, IMP, 0},
-   {"*SHA", &SHA, YZI, 6}, {"STY", &STY, XZP, 4},  {"STA", &STA, XZP, 4},
-   {"STX", &STX, YZP, 4},  {"*SAX", &SAX, YZP, 4}, {"TYA", &TYA, IMP, 2},
-   {"STA", &STA, YAB, 5},  {"TXS", &TXS, IMP, 2},  {"*SHS", &SHS, YAB, 5},
-   {"*SHY", &SHY, XAB, 5}, {"STA", &STA, XAB, 5},  {"*SHX", &SHX, YAB, 5},
-   {"*SHA", &SHA, YAB, 5},
+   {"BCC", REL, 2},     {"STA", YZI, 6},     {"*JAM", IMP, 0},    {"*SHA", YZI, 6},
+   {"STY", XZP, 4},     {"STA", XZP, 4},     {"STX", YZP, 4},     {"*SAX", YZP, 4},
+   {"TYA", IMP, 2},     {"STA", YAB, 5},     {"TXS", IMP, 2},     {"*SHS", YAB, 5},
+   {"*SHY", XAB, 5},    {"STA", XAB, 5},     {"*SHX", YAB, 5},    {"*SHA", YAB, 5},
 
    /* 0xA0 - 0xAF */
-   {"LDY", &LDY, IMM, 2},  {"LDA", &LDA, XZI, 6},  {"LDX", &LDX, IMM, 2},
-   {"*LAX", &LAX, XZI, 6}, {"LDY", &LDY, ZPG, 3},  {"LDA", &LDA, ZPG, 3},
-   {"LDX", &LDX, ZPG, 3},  {"*LAX", &LAX, ZPG, 3}, {"TAY", &TAY, IMP, 2},
-   {"LDA", &LDA, IMM, 2},  {"TAX", &TAX, IMP, 2},  {"*LAX", &LAX, IMM, 2},
-   {"LDY", &LDY, ABS, 4},  {"LDA", &LDA, ABS, 4},  {"LDX", &LDX, ABS, 4},
-   {"*LAX", &LAX, ABS, 4},
+   {"LDY", IMM, 2},     {"LDA", XZI, 6},     {"LDX", IMM, 2},     {"*LAX", XZI, 6},
+   {"LDY", ZPG, 3},     {"LDA", ZPG, 3},     {"LDX", ZPG, 3},     {"*LAX", ZPG, 3},
+   {"TAY", IMP, 2},     {"LDA", IMM, 2},     {"TAX", IMP, 2},     {"*LAX", IMM, 2},
+   {"LDY", ABS, 4},     {"LDA", ABS, 4},     {"LDX", ABS, 4},     {"*LAX", ABS, 4},
 
    /* 0xB0 - 0xBF */
-   {"BCS", &BCS, REL, 2},  {"LDA", &LDA, YZI, 5},  {"*JAM", &JAM, IMP, 0},
-   {"*LAX", &LAX, YZI, 5}, {"LDY", &LDY, XZP, 4},  {"LDA", &LDA, XZP, 4},
-   {"LDX", &LDX, YZP, 4},  {"*LAX", &LAX, YZP, 4}, {"CLV", &CLV, IMP, 2},
-   {"LDA", &LDA, YAB, 4},  {"TSX", &TSX, IMP, 2},  {"*LAS", &LAS, YAB, 4},
-   {"LDY", &LDY, XAB, 4},  {"LDA", &LDA, XAB, 4},  {"LDX", &LDX, YAB, 4},
-   {"*LAX", &LAX, YAB, 4},
+   {"BCS", REL, 2},     {"LDA", YZI, 5},     {"*JAM", IMP, 0},    {"*LAX", YZI, 5},
+   {"LDY", XZP, 4},     {"LDA", XZP, 4},     {"LDX", YZP, 4},     {"*LAX", YZP, 4},
+   {"CLV", IMP, 2},     {"LDA", YAB, 4},     {"TSX", IMP, 2},     {"*LAS", YAB, 4},
+   {"LDY", XAB, 4},     {"LDA", XAB, 4},     {"LDX", YAB, 4},     {"*LAX", YAB, 4},
 
    /* 0xC0 - 0xCF */
-   {"CPY", &CPY, IMM, 2},  {"CMP", &CMP, XZI, 6},  {"*NOP", &NOP, IMM, 2},
-   {"*DCP", &DCP, XZI, 8}, {"CPY", &CPY, ZPG, 3},  {"CMP", &CMP, ZPG, 3},
-   {"DEC", &DEC, ZPG, 5},  {"*DCP", &DCP, ZPG, 5}, {"INY", &INY, IMP, 2},
-   {"CMP", &CMP, IMM, 2},  {"DEX", &DEX, IMP, 2},  {"*SBX", &SBX, IMM, 2},
-   {"CPY", &CPY, ABS, 4},  {"CMP", &CMP, ABS, 4},  {"DEC", &DEC, ABS, 6},
-   {"*DCP", &DCP, ABS, 6},
+   {"CPY", IMM, 2},     {"CMP", XZI, 6},     {"*NOP", IMM, 2},    {"*DCP", XZI, 8},
+   {"CPY", ZPG, 3},     {"CMP", ZPG, 3},     {"DEC", ZPG, 5},     {"*DCP", ZPG, 5},
+   {"INY", IMP, 2},     {"CMP", IMM, 2},     {"DEX", IMP, 2},     {"*SBX", IMM, 2},
+   {"CPY", ABS, 4},     {"CMP", ABS, 4},     {"DEC", ABS, 6},     {"*DCP", ABS, 6},
 
    /* 0xD0 - 0xDF */
-   {"BNE", &BNE, REL, 2},  {"CMP", &CMP, YZI, 5},  {"*JAM", &JAM, IMP, 0},
-   {"*DCP", &DCP, YZI, 8}, {"*NOP", &NOP, XZP, 4}, {"CMP", &CMP, XZP, 4},
-   {"DEC", &DEC, XZP, 6},  {"*DCP", &DCP, XZP, 6}, {"CLD", &CLD, IMP, 2},
-   {"CMP", &CMP, YAB, 4},  {"*NOP", &NOP, IMP, 2}, {"*DCP", &DCP, YAB, 7},
-   {"*NOP", &NOP, XAB, 4}, {"CMP", &CMP, XAB, 4},  {"DEC", &DEC, XAB, 7},
-   {"*DCP", &DCP, XAB, 7},
+   {"BNE", REL, 2},     {"CMP", YZI, 5},     {"*JAM", IMP, 0},    {"*DCP", YZI, 8},
+   {"*NOP", XZP, 4},    {"CMP", XZP, 4},     {"DEC", XZP, 6},     {"*DCP", XZP, 6},
+   {"CLD", IMP, 2},     {"CMP", YAB, 4},     {"*NOP", IMP, 2},    {"*DCP", YAB, 7},
+   {"*NOP", XAB, 4},    {"CMP", XAB, 4},     {"DEC", XAB, 7},     {"*DCP", XAB, 7},
 
    /* 0xE0 - 0xEF */
-   {"CPX", &CPX, IMM, 2},  {"SBC", &SBC, XZI, 6},  {"*NOP", &NOP, IMM, 2},
-   {"*ISB", &ISB, XZI, 8}, {"CPX", &CPX, ZPG, 3},  {"SBC", &SBC, ZPG, 3},
-   {"INC", &INC, ZPG, 5},  {"*ISB", &ISB, ZPG, 5}, {"INX", &INX, IMP, 2},
-   {"SBC", &SBC, IMM, 2},  {"NOP", &NOP, IMP, 2},  {"*SBC", &SBC, IMM, 2},
-   {"CPX", &CPX, ABS, 4},  {"SBC", &SBC, ABS, 4},  {"INC", &INC, ABS, 6},
-   {"*ISB", &ISB, ABS, 6},
+   {"CPX", IMM, 2},     {"SBC", XZI, 6},     {"*NOP", IMM, 2},    {"*ISB", XZI, 8},
+   {"CPX", ZPG, 3},     {"SBC", ZPG, 3},     {"INC", ZPG, 5},     {"*ISB", ZPG, 5},
+   {"INX", IMP, 2},     {"SBC", IMM, 2},     {"NOP", IMP, 2},     {"*SBC", IMM, 2},
+   {"CPX", ABS, 4},     {"SBC", ABS, 4},     {"INC", ABS, 6},     {"*ISB", ABS, 6},
 
    /* 0xF0 - 0xFF */
-   {"BEQ", &BEQ, REL, 2},  {"SBC", &SBC, YZI, 5},  {"*JAM", &JAM, IMP, 0},
-   {"*ISB", &ISB, YZI, 8}, {"*NOP", &NOP, XZP, 4}, {"SBC", &SBC, XZP, 4},
-   {"INC", &INC, XZP, 6},  {"*ISB", &ISB, XZP, 6}, {"SED", &SED, IMP, 2},
-   {"SBC", &SBC, YAB, 4},  {"*NOP", &NOP, IMP, 2}, {"*ISB", &ISB, YAB, 7},
-   {"*NOP", &NOP, XAB, 4}, {"SBC", &SBC, XAB, 4},  {"INC", &INC, XAB, 7},
-   {"*ISB", &ISB, XAB, 7}
+   {"BEQ", REL, 2},     {"SBC", YZI, 5},     {"*JAM", IMP, 0},    {"*ISB", YZI, 8},
+   {"*NOP", XZP, 4},    {"SBC", XZP, 4},     {"INC", XZP, 6},     {"*ISB", XZP, 6},
+   {"SED", IMP, 2},     {"SBC", YAB, 4},     {"*NOP", IMP, 2},    {"*ISB", YAB, 7},
+   {"*NOP", XAB, 4},    {"SBC", XAB, 4},     {"INC", XAB, 7},     {"*ISB", XAB, 7}
 };
 
 /**
  * Read more on different addressing modes here -> https://www.pagetable.com/c64ref/6502/?tab=3
- * Forms the instruction operand depending on the provided address mode.
- * @param address_mode the address mode of the current opcode
- * @param extra_cycle set to 1 if page is crossed to represent 1 extra cycle,
- * else is set to zero
+ * Each address function performs the operand fetches and dummy reads of its addressing mode
+ * and returns the effective address that the instruction will access.
+*/
+
+static inline uint16_t address_ZPG(void)
+{
+   return cpu_fetch();
+}
+
+static inline uint16_t address_XZP(void)
+{
+   uint8_t zpg_address = cpu_fetch();
+
+   cpu_bus_read(zpg_address); // dummy read while adding index
+   return (uint8_t) ( zpg_address + cpu->X );
+}
+
+static inline uint16_t address_YZP(void)
+{
+   uint8_t zpg_address = cpu_fetch();
+
+   cpu_bus_read(zpg_address); // dummy read while adding index
+   return (uint8_t) ( zpg_address + cpu->Y );
+}
+
+static inline uint16_t address_ABS(void)
+{
+   uint8_t lo = cpu_fetch();
+   uint8_t hi = cpu_fetch();
+
+   return ( hi << 8 ) | lo;
+}
+
+/**
+ * Adds a index register to a base address.
+ * Only read instructions are able to take advantage of optimizing away a extra cycle
+ * when a page is not crossed. Write instructions always incur this penalty which is
+ * why the dummy read is always performed for them.
+ * @param base_address address before indexing
+ * @param index value of the X or Y register
+ * @param is_write true for write and read-modify-write instructions
+ * @returns the indexed address
 */
-static void set_instruction_operand(address_modes_t address_mode, uint8_t *extra_cycle)
+static inline uint16_t address_indexed(uint16_t base_address, uint8_t index, bool is_write)
 {
-   *extra_cycle = 0;
+   uint16_t address = base_address + index;
 
-   switch (address_mode)
+   /**
+    * +1 extra cycle when the hi bytes are not equal, meaning page is crossed.
+    * This happens because the offset is added to the low byte first which can result in a carry out.
+    * The carry out bit then needs to be added back into the high byte which results in a
+    * extra cycle being taken, emulated as a dummy read to the incorrect address.
+   */
+   if ( is_write || (address & 0xFF00) != (base_address & 0xFF00) )
    {
-      case IMP:
-      {
-         cpu_bus_read(cpu.pc); // dummy read next byte
-         break;
-      }
-      case ACC:
-      { 
-         cpu_bus_read(cpu.pc); // dummy read next byte
-         break;
-      }
-      case IMM:
-      {
-         instruction_operand = cpu_fetch();
-         break;
-      }
-      case ABS:
-      {
-         uint8_t lo = cpu_fetch();
-         uint8_t hi = cpu_fetch();
+      cpu_bus_read( (base_address & 0xFF00) | (uint8_t) (base_address + index) );
+   }
 
-         instruction_operand = ( hi << 8 ) | lo;
-         
-         break;
-      }
-      case XAB:
-      {
-         uint8_t lo = cpu_fetch();
-         uint8_t hi = cpu_fetch();
-
-         uint16_t abs_address = ( hi << 8 ) | lo;
-
-         instruction_operand = abs_address + cpu.X;
-
-         /**
-          * Only read instructions are able to take advantage of optimizing away a extra cycle
-          * when a page is not crossed. Write instructions always incur this penalty which is
-          * by default included in the base clock cycle count. This is why the extra cycle is ignored
-          * for write instructions as it is already accounted for.
-         */
-         if ( !check_opcode_access_mode(current_opcode) )
-         {
-            /**
-             * +1 extra cycle when the hi bytes are not equal, meaning page is crossed.
-             * This happens because the offset is added to the low byte first which can result in a carry out.
-             * The carry out bit then needs to be added back into the high byte which results in a
-             * extra cycle being taken. 
-            */
-            *extra_cycle = ( (instruction_operand & 0xFF00) != (hi << 8) ) ? 1 : 0;
-
-            if (*extra_cycle)
-            {
-               // when page is crossed, emulate the dummy read to the incorrect address
-               cpu_bus_read( (hi << 8) | (uint8_t) (lo + cpu.X) );
-            }
-         }
-         else
-         {
-            cpu_bus_read( (hi << 8) | (uint8_t) (lo + cpu.X) );
-         }
-
-         break;
-      }
-      case YAB:
-      {
-         uint8_t lo = cpu_fetch();
-         uint8_t hi = cpu_fetch();
-
-         uint16_t abs_address = ( hi << 8 ) | lo;
-
-         instruction_operand = abs_address + cpu.Y;
-
-         /**
-          * Only read instructions are able to take advantage of optimizing away a extra cycle
-          * when a page is not crossed. Write instructions always incur this penalty which is
-          * by default included in the base clock cycle count. This is why the extra cycle is ignored
-          * for write instructions as it is already accounted for.
-         */
-         if ( !(check_opcode_access_mode(current_opcode)) )
-         {
-            /**
-             * +1 extra cycle when the hi bytes are not equal, meaning page is crossed.
-             * This happens because the offset is added to the low byte first which can result in a carry out.
-             * The carry out bit then needs to be added back into the high byte which results in a
-             * extra cycle being taken. 
-            */
-            *extra_cycle = ( (instruction_operand & 0xFF00) != hi << 8 ) ? 1 : 0;
-
-            if (*extra_cycle)
-            {
-               // when page is crossed, emulate the dummy read to the incorrect address
-               cpu_bus_read( (hi << 8) | (uint8_t) (lo + cpu.Y) );
-            }
-         }
-         else
-         {
-            cpu_bus_read( (hi << 8) | (uint8_t) (lo + cpu.Y) );
-         }
-
-         break;
-      }
-      case ABI:
-      {
-         uint8_t lo = cpu_fetch();
-         uint8_t hi = cpu_fetch();
+   return address;
+}
 
-         uint16_t abs_address = ( hi << 8 ) | lo;
+static inline uint16_t address_XAB(bool is_write)
+{
+   return address_indexed(address_ABS(), cpu->X, is_write);
+}
 
-         // does not handle page crossing, i.e fetching at 0x02FF will read from 0x02FF and 0x0200
+static inline uint16_t address_YAB(bool is_write)
+{
+   return address_indexed(address_ABS(), cpu->Y, is_write);
+}
 
-         uint8_t indirect_address_lo = cpu_bus_read(abs_address);
-         uint8_t indirect_address_hi = cpu_bus_read( ( hi << 8 ) | (uint8_t) (lo + 1) );
+static inline uint16_t address_ABI(void)
+{
+   uint8_t lo = cpu_fetch();
+   uint8_t hi = cpu_fetch();
 
-         instruction_operand = ( indirect_address_hi << 8 ) | indirect_address_lo;
+   uint16_t abs_address = ( hi << 8 ) | lo;
 
-         break;
-      }
-      case ZPG:
-      {
-         instruction_operand = cpu_fetch();
+   // does not handle page crossing, i.e fetching at 0x02FF will read from 0x02FF and 0x0200
 
-         break;
-      }
-      case XZP:
-      {
-         uint8_t zpg_address = cpu_fetch();
+   uint8_t indirect_address_lo = cpu_bus_read(abs_address);
+   uint8_t indirect_address_hi = cpu_bus_read( ( hi << 8 ) | (uint8_t) (lo + 1) );
 
-         cpu_bus_read(zpg_address); // dummy read while adding index
-         instruction_operand = (uint8_t) ( zpg_address + cpu.X );
+   return ( indirect_address_hi << 8 ) | indirect_address_lo;
+}
 
-         break;
-      }
-      case YZP:
-      {
-         uint8_t zpg_address = cpu_fetch();
+static inline uint16_t address_XZI(void)
+{
+   uint8_t zpg_base_address  = cpu_fetch();
+   cpu_bus_read(zpg_base_address); // 1 cycle for dummy fetched at address and to add X offset
+   uint8_t zpg_address = ( zpg_base_address + cpu->X ); // add X index offsest to base address to form zpg address 
 
-         cpu_bus_read(zpg_address); // dummy read while adding index
-         instruction_operand = (uint8_t) ( zpg_address + cpu.Y );
+   uint8_t lo = cpu_bus_read(zpg_address);
+   uint8_t hi = cpu_bus_read( (uint8_t) ( zpg_address + 1 ) ); // use 8-bit cast to stay within the zero page
 
-         break;
-      }
-      case XZI:
-      {
-         uint8_t zpg_base_address  = cpu_fetch();
-         cpu_bus_read(zpg_base_address); // 1 cycle for dummy fetched at address and to add X offset
-         uint8_t zpg_address = ( zpg_base_address + cpu.X ); // add X index offsest to base address to form zpg address 
+   return ( hi << 8 ) | lo;
+}
 
-         uint8_t lo = cpu_bus_read(zpg_address);
-         uint8_t hi = cpu_bus_read( (uint8_t) ( zpg_address + 1 ) ); // use 8-bit cast to stay within the zero page
+static inline uint16_t address_YZI(bool is_write)
+{
+   uint8_t zpg_address = cpu_fetch();
 
-         instruction_operand = ( hi << 8 ) | lo;
+   uint8_t lo = cpu_bus_read(zpg_address);
+   uint8_t hi = cpu_bus_read( (uint8_t) (zpg_address + 1) ); // 8-bit cast to stay within the zero page
 
-         break;
-      }
-      case YZI:
-      {
-         uint8_t zpg_address = cpu_fetch();
-
-         uint8_t lo = cpu_bus_read(zpg_address);
-         uint8_t hi = cpu_bus_read( (uint8_t) (zpg_address + 1) ); // 8-bit cast to stay within the zero page
-
-         uint16_t base_address = ( hi << 8 ) | lo;
-
-         instruction_operand = base_address + cpu.Y;
-
-         /**
-          * Only read instructions are able to take advantage of optimizing away a extra cycle
-          * when a page is not crossed. Write instructions always incur this penalty which is
-          * by default included in the base clock cycle count. This is why the extra cycle is ignored
-          * for write instructions as it is already accounted for.
-         */
-         if ( !(check_opcode_access_mode(current_opcode)) )
-         {
-            /**
-             * +1 extra cycle when the hi bytes are not equal, meaning page is crossed.
-             * This happens because the offset is added to the low byte first which can result in a carry out.
-             * The carry out bit then needs to be added back into the high byte which results in a
-             * extra cycle being taken. 
-            */
-            *extra_cycle = ( (instruction_operand & 0xFF00) != (base_address & 0xFF00) ) ? 1 : 0;
-
-            if (*extra_cycle)
-            {
-               // when page is crossed, emulate the dummy read to the incorrect address
-               cpu_bus_read( (hi << 8) | (uint8_t) (lo + cpu.Y) );
-            }
-         }
-         else
-         {
-            cpu_bus_read( (hi << 8) | (uint8_t) (lo + cpu.Y) );
-         }
-
-         break;
-      }
-      case REL:
-      {
-         uint8_t offset_byte = cpu_fetch();
-         
-         /**
-          * Offset_byte is in 2's complement so we check bit 7 to see if it is negative.
-         */
-         if (offset_byte & 0x80)
-         {
-            /**
-             * Since the signed offset_byte is 8 bits and we are adding into a 16 bit value,
-             * we need to treat the offset as a 16 bit value. The offset byte is negative value
-             * in 2's complement, so the added extra 8 bits are all set to 1, hence the 0xFF00 bitmask.
-            */
-            instruction_operand = cpu.pc + ( offset_byte | 0xFF00 );
-         }
-         else
-         {
-            instruction_operand = cpu.pc + offset_byte;
-         }
-
-         break;
-      }
+   return address_indexed( ( hi << 8 ) | lo, cpu->Y, is_write );
+}
+
+static inline uint16_t address_REL(void)
+{
+   uint8_t offset_byte = cpu_fetch();
+   
+   /**
+    * Offset_byte is in 2's complement so we check bit 7 to see if it is negative.
+    * Since the signed offset_byte is 8 bits and we are adding into a 16 bit value,
+    * we need to treat the offset as a 16 bit value. The offset byte is negative value
+    * in 2's complement, so the added extra 8 bits are all set to 1, hence the 0xFF00 bitmask.
+   */
+   if (offset_byte & 0x80)
+   {
+      return cpu->pc + ( offset_byte | 0xFF00 );
    }
+
+   return cpu->pc + offset_byte;
 }
 
 // load instructions
 
-static uint8_t LAS(void){return 0;}
+static void LAS(uint16_t address){(void) address;}
 
 /**
  * Undocumented.
@@ -576,43 +431,30 @@ static uint8_t LAS(void){return 0;}
  * Set zero flag if loaded value is zero, else reset.
  * Set negative flag if loaded value has bit 7 set, else resest.
 */
-static uint8_t LAX(void)
+static void LAX(uint8_t value)
 {
-   uint8_t value;
-
-   if (current_instruction->mode == IMM)
-   {
-      value = (uint8_t) instruction_operand;
-   }
-   else
-   {
-      value = cpu_bus_read(instruction_operand);
-   }
-
    // set/reset negative flag
    if (value & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
    if (value == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
-   cpu.ac = value;
-   cpu.X = value;
-
-   return 0;
+   cpu->ac = value;
+   cpu->X = value;
 }
 
 /**
@@ -620,42 +462,29 @@ static uint8_t LAX(void)
  * sets zero flag if accumulator is set to zero, otherwise zero flag is reset
  * sets negative flag if bit 7  of accumulator is 1, otherwises negative flag is reset
 */
-static uint8_t LDA(void)
+static void LDA(uint8_t value)
 {
-   /**
-    * Load operand directly into accumulator when in immediate mode.
-    * Else treat operand as a effective memory address.
-   */ 
-   if (current_instruction->mode == IMM)
-   {
-      cpu.ac = (uint8_t) instruction_operand;
-   }
-   else
-   {
-      cpu.ac = cpu_bus_read(instruction_operand);
-   }
+   cpu->ac = value;
 
    // set zero flag
-   if (cpu.ac == 0)
+   if (cpu->ac == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
    // set negative flag
-   if (cpu.ac & 0x80)
+   if (cpu->ac & 0x80)
    {
-      set_bit(cpu.status_flags,7);
+      set_bit(cpu->status_flags,7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
-
-   return 0;
 }
 
 /**
@@ -663,42 +492,29 @@ static uint8_t LDA(void)
  * Set zero bit if loaded value is zero.
  * Set negative bit if loaded value has bit 7 set to 1.
 */
-static uint8_t LDX(void)
+static void LDX(uint8_t value)
 {
-   /**
-    * Load operand directly into X register when in immediate mode.
-    * Else treat operand as a effective memory address.
-   */ 
-   if (current_instruction->mode == IMM)
-   {
-      cpu.X = (uint8_t) instruction_operand;
-   }
-   else 
-   {
-      cpu.X = cpu_bus_read(instruction_operand);
-   }
+   cpu->X = value;
    
    // set zero flag
-   if (cpu.X == 0)
+   if (cpu->X == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
    // set negative flag
-   if (cpu.X & 0x80)
+   if (cpu->X & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
-
-   return 0;
 }
 
 /**
@@ -706,39 +522,29 @@ static uint8_t LDX(void)
  * Set negative flag if bit 7 of loaded value is 1, else reset.
  * Set zero flag if loaded value is 0, else reset.
 */
-static uint8_t LDY(void)
+static void LDY(uint8_t value)
 {
-   // use operand directly when in immediate mode
-   if ( current_instruction->mode == IMM )
-   {
-      cpu.Y = (uint8_t) instruction_operand;
-   }
-   else // else use operand as effective memory address
-   {
-      cpu.Y = cpu_bus_read(instruction_operand);
-   }
+   cpu->Y = value;
 
    // set/reset negative flag
-   if ( cpu.Y & 0x80 )
+   if ( cpu->Y & 0x80 )
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if ( cpu.Y == 0 )
+   if ( cpu->Y == 0 )
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 /**
@@ -746,78 +552,71 @@ static uint8_t LDY(void)
  * Perform bitwise AND between accumulator and X register,
  * store result into memory
 */
-static uint8_t SAX(void)
+static void SAX(uint16_t address)
 {
-   cpu_bus_write(instruction_operand, cpu.ac & cpu.X);
-
-   return 0;
+   cpu_bus_write(address, cpu->ac & cpu->X);
 }
 
-static uint8_t SHA(void){return 0;}
-static uint8_t SHX(void){return 0;}
-static uint8_t SHY(void){return 0;}
+static void SHA(uint16_t address){(void) address;}
+static void SHX(uint16_t address){(void) address;}
+static void SHY(uint16_t address){(void) address;}
 
 /**
  * transfer accumulator value into memory
 */
-static uint8_t STA(void)
+static void STA(uint16_t address)
 {
-   cpu_bus_write(instruction_operand, cpu.ac);
-   return 0;
+   cpu_bus_write(address, cpu->ac);
 }
 
 /**
  * transfers X register value into memory location
 */
-static uint8_t STX(void)
+static void STX(uint16_t address)
 {
-   cpu_bus_write(instruction_operand, cpu.X);
-   return 0;
+   cpu_bus_write(address, cpu->X);
 }
 
 /**
  * transfers Y register value into memory location
 */
-static uint8_t STY(void)
+static void STY(uint16_t address)
 {
-   cpu_bus_write(instruction_operand, cpu.Y);
-   return 0;
+   cpu_bus_write(address, cpu->Y);
 }
 
 // transfer instructions
 
-static uint8_t SHS(void){return 0;}
+static void SHS(uint16_t address){(void) address;}
 
 /**
  * Transfer accumulator to X register.
  * Negative flag is set if bit 7 in loaded value in X register is 1, else reset.
  * Zero flag is set if loaded value in X register is zero, else reset.
 */
-static uint8_t TAX(void)
+static void TAX(void)
 {
-   cpu.X = cpu.ac;
+   cpu->X = cpu->ac;
 
    // set/reset negative flag
-   if (cpu.X & 0x80)
+   if (cpu->X & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.X == 0)
+   if (cpu->X == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 /**
@@ -825,31 +624,29 @@ static uint8_t TAX(void)
  * Negative flag is set if bit 7 in loaded value in Y register is 1, else reset.
  * Zero flag is set if loaded value in Y register is zero, else reset.
 */
-static uint8_t TAY(void)
+static void TAY(void)
 {
-   cpu.Y = cpu.ac;
+   cpu->Y = cpu->ac;
 
    // set/reset negative flag
-   if (cpu.Y & 0x80)
+   if (cpu->Y & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.Y == 0)
+   if (cpu->Y == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 /**
@@ -857,30 +654,29 @@ static uint8_t TAY(void)
  * Negative flag is set if bit 7 in loaded value in X register is 1, else reset.
  * Zero flag is set if loaded value in X register is zero, else reset.
 */
-static uint8_t TSX(void)
+static void TSX(void)
 {
-   cpu.X = cpu.sp;
+   cpu->X = cpu->sp;
 
    // set/reset negative flag
-   if (cpu.X & 0x80)
+   if (cpu->X & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.X == 0)
+   if (cpu->X == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-   return 0;
 }
 
 /**
@@ -888,40 +684,37 @@ static uint8_t TSX(void)
  * Negative flag is set if bit 7 in loaded value in accumulator is 1, else reset.
  * Zero flag is set if loaded value in accumulator is zero, else reset.
 */
-static uint8_t TXA(void)
+static void TXA(void)
 {
-   cpu.ac = cpu.X;
+   cpu->ac = cpu->X;
 
    // set/reset negative flag
-   if (cpu.ac & 0x80)
+   if (cpu->ac & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.ac == 0)
+   if (cpu->ac == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 /**
  * Transfer X register to stack pointer.
 */
-static uint8_t TXS(void)
+static void TXS(void)
 {
-   cpu.sp = cpu.X;
-   return 0;
+   cpu->sp = cpu->X;
 }
 
 /**
@@ -929,31 +722,29 @@ static uint8_t TXS(void)
  * Negative flag is set if bit 7 in loaded value in accumulator is 1, else reset.
  * Zero flag is set if loaded value in accumulator is zero, else reset.
 */
-static uint8_t TYA(void)
+static void TYA(void)
 {
-   cpu.ac = cpu.Y;
+   cpu->ac = cpu->Y;
 
    // set/reset negative flag
-   if (cpu.ac & 0x80)
+   if (cpu->ac & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.ac == 0)
+   if (cpu->ac == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 // stack instructions
@@ -961,10 +752,9 @@ static uint8_t TYA(void)
 /**
  * Push accumulator onto the stack.
 */
-static uint8_t PHA(void)
+static void PHA(void)
 {
-   stack_push(cpu.ac);
-   return 0;
+   stack_push(cpu->ac);
 }
 
 /**
@@ -973,10 +763,9 @@ static uint8_t PHA(void)
  * bit 4 (break flag) set as 1.
  * Hardware interupts push the break flag set as 0.
 */
-static uint8_t PHP(void)
+static void PHP(void)
 {
-   stack_push(cpu.status_flags | 0x30);
-   return 0;
+   stack_push(cpu->status_flags | 0x30);
 }
 
 /**
@@ -984,32 +773,30 @@ static uint8_t PHP(void)
  * Sets negative flag if bit 7 of accumulator is 1, else reset flag
  * Sets zero flag if if accumulator is 0, else reset
 */
-static uint8_t PLA(void)
+static void PLA(void)
 {
    cpu_tick(); // 1 cycle to increment stack pointer
-   cpu.ac = stack_pop();
+   cpu->ac = stack_pop();
 
    // set or clear negative flag
-   if ( cpu.ac & 0x80 )
+   if ( cpu->ac & 0x80 )
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set or clear zero flag
-   if ( cpu.ac == 0 )
+   if ( cpu->ac == 0 )
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 /**
@@ -1019,13 +806,11 @@ static uint8_t PLA(void)
  * Whet the status register is poped, the break flag is
  * "discarded" by being reset to 0.
 */
-static uint8_t PLP(void)
+static void PLP(void)
 {
    cpu_tick(); // 1 cycle to increment stack pointer
-   cpu.status_flags = stack_pop();
-   clear_bit(cpu.status_flags, 4); // make sure break flag is cleared when retrieving cpu flags from stack
-
-   return 0;
+   cpu->status_flags = stack_pop();
+   clear_bit(cpu->status_flags, 4); // make sure break flag is cleared when retrieving cpu flags from stack
 }
 
 // shift instructions
@@ -1037,51 +822,36 @@ static uint8_t PLP(void)
  * Set negative flag if bit 7 after the shift is set, else reset.
  * Set zero flag if the result after shifting is 0, else reset.
 */
-static uint8_t ASL(void)
+static uint8_t ASL(uint8_t value)
 {
-   uint8_t shifted_value = 0, carry_bit = 0;
+   uint8_t shifted_value, carry_bit;
 
-   if (current_instruction->mode == ACC)
-   {
-      carry_bit = (cpu.ac & 0x80) >> 7; 
-      shifted_value = cpu.ac << 1;
+   carry_bit = (value & 0x80) >> 7;
+   shifted_value = value << 1;
 
-      cpu.ac = shifted_value;
-   }
-   else
-   {
-      uint8_t value_to_shift = cpu_bus_read(instruction_operand);
-      cpu_bus_write(instruction_operand, value_to_shift); // dummy write
-
-      carry_bit = (value_to_shift & 0x80) >> 7;
-      shifted_value = value_to_shift << 1;
-
-      cpu_bus_write(instruction_operand, shifted_value);
-   }
-
-   store_bit(cpu.status_flags, carry_bit, 0); // carry bit into carry flag
+   store_bit(cpu->status_flags, carry_bit, 0); // carry bit into carry flag
 
    // set/reset negative flag
    if (shifted_value & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
    if (shifted_value == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
-   return 0;
+   return shifted_value;
 }
 
 /**
@@ -1091,44 +861,29 @@ static uint8_t ASL(void)
  * Negative flag is alway reset to 0.
  * Set zero flag if result of the shit is 0, else reset.
 */
-static uint8_t LSR(void)
+static uint8_t LSR(uint8_t value)
 {
-   uint8_t shifted_value = 0, carry_bit = 0;
-
-   if (current_instruction->mode == ACC)
-   {
-      carry_bit = ( cpu.ac & 0x01 ); 
-      shifted_value = cpu.ac >> 1;
-
-      cpu.ac = shifted_value;
-   }
-   else
-   {
-      uint8_t value_to_shift = cpu_bus_read(instruction_operand);
-      cpu_bus_write(instruction_operand, value_to_shift); // dummy write
+   uint8_t shifted_value, carry_bit;
 
-      carry_bit = value_to_shift & 0x01;
-      shifted_value = value_to_shift >> 1;
+   carry_bit = value & 0x01;
+   shifted_value = value >> 1;
 
-      cpu_bus_write(instruction_operand, shifted_value);
-   }
-
-   store_bit(cpu.status_flags, carry_bit, 0); // move bit 0 into carry flag
+   store_bit(cpu->status_flags, carry_bit, 0); // move bit 0 into carry flag
 
    // reset negative flag
-   clear_bit(cpu.status_flags, 7);
+   clear_bit(cpu->status_flags, 7);
 
    // set/reset zero flag
    if (shifted_value == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
-   return 0;
+   return shifted_value;
 }
 
 /**
@@ -1138,55 +893,39 @@ static uint8_t LSR(void)
  * Set negative flag to bit 7 of the shifted result.
  * Set zero flag is shifted value is zero, else reset.
 */
-static uint8_t ROL(void)
+static uint8_t ROL(uint8_t value)
 {
-   uint8_t shifted_value = 0, carry_bit = 0;
-   uint8_t carry_flag = cpu.status_flags & 0x01;
+   uint8_t shifted_value, carry_bit;
+   uint8_t carry_flag = cpu->status_flags & 0x01;
 
-   if (current_instruction->mode == ACC)
-   {
-      carry_bit = cpu.ac & 0x80;                // store left most bit prior to shift
-      shifted_value = cpu.ac << 1;              // left shift 1 bit
-      store_bit(shifted_value, carry_flag, 0);  // store the carry flag into the right most bit
-
-      cpu.ac = shifted_value;
-   }
-   else
-   {
-      uint8_t value_to_shift = cpu_bus_read(instruction_operand);
-      cpu_bus_write(instruction_operand, value_to_shift); // dummy write
-
-      carry_bit = value_to_shift & 0x80;         // store left most bit prior to shift
-      shifted_value = value_to_shift << 1;       // left shift 1 bit
-      store_bit(shifted_value, carry_flag, 0);   // store the carry flag into the right most bit
-
-      cpu_bus_write(instruction_operand, shifted_value);
-   }
+   carry_bit = value & 0x80;                // store left most bit prior to shift
+   shifted_value = value << 1;              // left shift 1 bit
+   store_bit(shifted_value, carry_flag, 0); // store the carry flag into the right most bit
 
    carry_bit = carry_bit >> 7;
-   store_bit(cpu.status_flags, carry_bit, 0); // store carry bit into carry flag
+   store_bit(cpu->status_flags, carry_bit, 0); // store carry bit into carry flag
 
    // set/reset negative flag
    if (shifted_value & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
    if (shifted_value == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
-   return 0;
+   return shifted_value;
 }
 
 /**
@@ -1196,54 +935,38 @@ static uint8_t ROL(void)
  * Set negative flag to bit 7 of the shifted result.
  * Set zero flag is shifted value is zero, else reset.
 */
-static uint8_t ROR(void)
+static uint8_t ROR(uint8_t value)
 {
-   uint8_t shifted_value = 0, carry_bit = 0;
-   uint8_t carry_flag = cpu.status_flags & 0x01;
-
-   if (current_instruction->mode == ACC)
-   {
-      carry_bit = cpu.ac & 0x01;                // store right most bit prior to shift
-      shifted_value = cpu.ac >> 1;              // right shift 1 bit
-      store_bit(shifted_value, carry_flag, 7);  // store the carry flag into the leftmost bit
-
-      cpu.ac = shifted_value;
-   }
-   else
-   {
-      uint8_t value_to_shift = cpu_bus_read(instruction_operand);
-      cpu_bus_write(instruction_operand, value_to_shift); // dummy write
-
-      carry_bit = value_to_shift & 0x01;         // store right most bit prior to shift
-      shifted_value = value_to_shift >> 1;       // right shift 1 bit
-      store_bit(shifted_value, carry_flag, 7);   // store the carry flag into the leftmost bit
+   uint8_t shifted_value, carry_bit;
+   uint8_t carry_flag = cpu->status_flags & 0x01;
 
-      cpu_bus_write(instruction_operand, shifted_value);
-   }
+   carry_bit = value & 0x01;                // store right most bit prior to shift
+   shifted_value = value >> 1;              // right shift 1 bit
+   store_bit(shifted_value, carry_flag, 7); // store the carry flag into the leftmost bit
 
-   store_bit(cpu.status_flags, carry_bit, 0); // store carry bit into carry flag
+   store_bit(cpu->status_flags, carry_bit, 0); // store carry bit into carry flag
 
    // set/reset negative flag
    if (shifted_value & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
    if (shifted_value == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
-   return 0;
+   return shifted_value;
 }
 
 // logic instructions
@@ -1254,40 +977,29 @@ static uint8_t ROR(void)
  * Sets the zero flag if result of accumulator is zero, else reset.
  * Sets the negative flag if bit 7 of result of accumulator is set, else reset.
 */
-static uint8_t AND(void)
+static void AND(uint8_t value)
 {
-   // use operand directly in immediate mode
-   if (current_instruction->mode == IMM)
-   {
-      cpu.ac = cpu.ac & (uint8_t) instruction_operand;
-   }
-   // else treat operand as a effective memory address
-   else
-   {
-      cpu.ac = cpu.ac & cpu_bus_read(instruction_operand);
-   }
+   cpu->ac = cpu->ac & value;
 
    // set or clear negative flag
-   if ( cpu.ac & 0x80 )
+   if ( cpu->ac & 0x80 )
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set or clear zero flag
-   if ( cpu.ac == 0 )
+   if ( cpu->ac == 0 )
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 /**
@@ -1297,27 +1009,23 @@ static uint8_t AND(void)
  * Bit 6 of the addressed memory is transfered into the overflow flag.
  * zero flag is set if result of bitwise AND between accumulator and memory is zero
 */
-static uint8_t BIT(void)
+static void BIT(uint8_t value)
 {
-   uint8_t value = cpu_bus_read(instruction_operand);
-
    // clear bits before transfer
-   clear_bit(cpu.status_flags, 7);
-   clear_bit(cpu.status_flags, 6);
+   clear_bit(cpu->status_flags, 7);
+   clear_bit(cpu->status_flags, 6);
 
-   cpu.status_flags |= value & ( 1 << 7 ); // transfer 7th bit into negative flag
-   cpu.status_flags |= value & ( 1 << 6 ); // transfer 6th bit into overflow flag
+   cpu->status_flags |= value & ( 1 << 7 ); // transfer 7th bit into negative flag
+   cpu->status_flags |= value & ( 1 << 6 ); // transfer 6th bit into overflow flag
 
-   if ( (cpu.ac & value) == 0 )
+   if ( (cpu->ac & value) == 0 )
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 /**
@@ -1326,42 +1034,29 @@ static uint8_t BIT(void)
  * Set negative flag if bit 7 is set in result, else reset.
  * Set zero flag if result value is zero, else reset.
 */
-static uint8_t EOR(void)
+static void EOR(uint8_t value)
 {
-   uint8_t operand;
-
-   if (current_instruction->mode == IMM)
-   {
-      operand = (uint8_t) instruction_operand;
-   }
-   else
-   {
-      operand = cpu_bus_read(instruction_operand);
-   }
-
-   cpu.ac = cpu.ac ^ operand;
+   cpu->ac = cpu->ac ^ value;
 
    // set/reset negative flag
-   if (cpu.ac & 0x80)
+   if (cpu->ac & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.ac == 0)
+   if (cpu->ac == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 /**
@@ -1370,42 +1065,29 @@ static uint8_t EOR(void)
  * Set negative flag if bit 7 in result is set, else reset.
  * Set zero flag if result is zero, else reset.
 */
-static uint8_t ORA(void)
+static void ORA(uint8_t value)
 {
-   uint8_t value;
-
-   if (current_instruction->mode == IMM)
-   {
-      value = (uint8_t) instruction_operand;
-   }
-   else
-   {
-      value =  cpu_bus_read(instruction_operand);
-   }
-
-   cpu.ac = cpu.ac | value;
+   cpu->ac = cpu->ac | value;
 
    // set/reset negative flag
-   if (cpu.ac & 0x80)
+   if (cpu->ac & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.ac == 0)
+   if (cpu->ac == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 // arithmetic instructions
@@ -1418,82 +1100,70 @@ static uint8_t ORA(void)
  * Set negative flag if bit 7 of sum is set, else reset.
  * Set zero flag if result is 0, else reset.
 */
-static uint8_t ADC(void)
+static void ADC(uint8_t value)
 {
    uint32_t sum;
-   uint8_t value;
-   uint8_t carry_bit = cpu.status_flags & 1;
-
-   if (current_instruction->mode == IMM)
-   {
-      value = (uint8_t) instruction_operand;
-   }
-   else
-   {
-      value = cpu_bus_read(instruction_operand);
-   }
+   uint8_t carry_bit = cpu->status_flags & 1;
 
-   sum = cpu.ac + value + carry_bit; // do addition
+   sum = cpu->ac + value + carry_bit; // do addition
 
    // set/reset carry flag
    if ( sum > 255 )
    {
-      set_bit(cpu.status_flags, 0);
+      set_bit(cpu->status_flags, 0);
    }
    else
    {
-      clear_bit(cpu.status_flags, 0);
+      clear_bit(cpu->status_flags, 0);
    }   
 
    // set/reset overflow flag
 
-   // ~( cpu.ac ^ value)  ---- has bit 7 on if the sign bit (bit 7) is the same on both operands, else it is off
-   //  ( cpu.ac ^ sum )   ---- has bit 7 on if the sign bit (bit 7) is different on both values, else it is off
+   // ~( cpu->ac ^ value)  ---- has bit 7 on if the sign bit (bit 7) is the same on both operands, else it is off
+   //  ( cpu->ac ^ sum )   ---- has bit 7 on if the sign bit (bit 7) is different on both values, else it is off
    /**
     * Overflowing 127 or -128 will only ever happen if both operands are of a different sign.
     * If the sign bit of both values are different, the expression will always evaluate as false
     * as overflow will never occur.
     * Otherwise if both sign bits are the same, we check if the sign bit of the value prior to
-    * the addition in cpu.ac is different to the sign bit in sum after the addition. If the sign bits
+    * the addition in cpu->ac is different to the sign bit in sum after the addition. If the sign bits
     * are different AND the sign bits of both operands the same, then we know a overflow has happened.
    */
-   if ( ( ~( cpu.ac ^ value ) & ( cpu.ac ^ sum ) ) & 0x80 )
+   if ( ( ~( cpu->ac ^ value ) & ( cpu->ac ^ sum ) ) & 0x80 )
    {
-      set_bit(cpu.status_flags, 6);
+      set_bit(cpu->status_flags, 6);
    }
    else
    {
-      clear_bit(cpu.status_flags, 6);
+      clear_bit(cpu->status_flags, 6);
    }
 
-   cpu.ac = sum & 0xFF;
+   cpu->ac = sum & 0xFF;
 
    // set/reset negative flag
-   if ( cpu.ac & 0x80 )
+   if ( cpu->ac & 0x80 )
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if ( cpu.ac == 0 )
+   if ( cpu->ac == 0 )
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
-static uint8_t ANC(void){return 0;}
-static uint8_t ARR(void){return 0;}
-static uint8_t ASR(void){return 0;}
+static void ANC(uint8_t value){(void) value;}
+static void ARR(uint8_t value){(void) value;}
+static void ASR(uint8_t value){(void) value;}
 
 /**
  * Subtracts value in memory from value in accumulator, the result is not stored.
@@ -1501,53 +1171,41 @@ static uint8_t ASR(void){return 0;}
  * Negative flag is set if bit 7 in the final result of the subtraction is a 1, else reset.
  * Carry flag set if value in memory is less than or equal to value in accumulator, else reset when greater.
 */
-static uint8_t CMP(void)
+static void CMP(uint8_t value)
 {
-   uint8_t result, value;
+   uint8_t result;
 
-   // use operand directly when in immediate mode
-   if ( current_instruction->mode == IMM )
-   {
-      value = (uint8_t) instruction_operand;
-   }
-   else // use operand as effective memory address
-   {
-      value = cpu_bus_read(instruction_operand);
-   }
-
-   result = cpu.ac - value;
+   result = cpu->ac - value;
 
    // set/reset zero flag
-   if ( value == cpu.ac )
+   if ( value == cpu->ac )
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
    // set/reset negative flag
    if ( result & 0x80 )
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset carry flag
-   if ( value <= cpu.ac )
+   if ( value <= cpu->ac )
    {
-      set_bit(cpu.status_flags, 0);
+      set_bit(cpu->status_flags, 0);
    }
    else
    {
-      clear_bit(cpu.status_flags, 0);
+      clear_bit(cpu->status_flags, 0);
    }
-
-   return 0;
 }
 
 /**
@@ -1557,52 +1215,41 @@ static uint8_t CMP(void)
  * Set negative flag if result has bit 7 set, else reset.
  * Set zero flag if value in memory is equal to X, else reset.
 */
-static uint8_t CPX(void)
+static void CPX(uint8_t value)
 {
-   uint8_t value, result;
-
-   if (current_instruction->mode == IMM)
-   {
-      value = (uint8_t) instruction_operand;
-   }
-   else
-   {
-      value = cpu_bus_read(instruction_operand);
-   }
+   uint8_t result;
 
-   result = cpu.X - value;
+   result = cpu->X - value;
 
    // set/reset carry flag
-   if ( cpu.X >= value )
+   if ( cpu->X >= value )
    {
-      set_bit(cpu.status_flags, 0);
+      set_bit(cpu->status_flags, 0);
    }
    else
    {
-      clear_bit(cpu.status_flags, 0);
+      clear_bit(cpu->status_flags, 0);
    }
 
    // set/reset negative flag
    if ( result & 0x80 )
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if ( cpu.X == value )
+   if ( cpu->X == value )
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 /**
@@ -1612,52 +1259,41 @@ static uint8_t CPX(void)
  * Set negative flag if result has bit 7 set, else reset.
  * Set zero flag if value in memory is equal to Y, else reset.
 */
-static uint8_t CPY(void)
+static void CPY(uint8_t value)
 {
-   uint8_t value, result;
-
-   if (current_instruction->mode == IMM)
-   {
-      value = (uint8_t) instruction_operand;
-   }
-   else
-   {
-      value = cpu_bus_read(instruction_operand);
-   }
+   uint8_t result;
 
-   result = cpu.Y - value;
+   result = cpu->Y - value;
 
    // set/reset carry flag
-   if ( cpu.Y >= value )
+   if ( cpu->Y >= value )
    {
-      set_bit(cpu.status_flags, 0);
+      set_bit(cpu->status_flags, 0);
    }
    else
    {
-      clear_bit(cpu.status_flags, 0);
+      clear_bit(cpu->status_flags, 0);
    }
 
    // set/reset negative flag
    if ( result & 0x80 )
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if ( cpu.Y == value )
+   if ( cpu->Y == value )
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 /**
@@ -1668,45 +1304,41 @@ static uint8_t CPY(void)
  * Set negative flag if bit 7 of result from accumulator - decremented value in memory is set, else reset.
  * Set carry flag if decremented value in memory is <= to the accumulator, else reset.
 */
-static uint8_t DCP(void)
+static uint8_t DCP(uint8_t value)
 {
-   uint8_t result = cpu_bus_read(instruction_operand);
-   cpu_bus_write(instruction_operand, result); // dummy write
-   result = result + ( ~(0x01) + 1 ); // use 2's complement to add negative 1 which is equal to minus 1.
+   uint8_t result = value + ( ~(0x01) + 1 ); // use 2's complement to add negative 1 which is equal to minus 1.
 
    // set/reset zero flag
-   if (result == cpu.ac )
+   if (result == cpu->ac )
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
    // set/reset negative flag
-   if ( (cpu.ac - result) & 0x80 )
+   if ( (cpu->ac - result) & 0x80 )
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset carry flag
-   if ( result <= cpu.ac )
+   if ( result <= cpu->ac )
    {
-      set_bit(cpu.status_flags, 0);
+      set_bit(cpu->status_flags, 0);
    }
    else
    {
-      clear_bit(cpu.status_flags, 0);
+      clear_bit(cpu->status_flags, 0);
    }
 
-   cpu_bus_write(instruction_operand, result);
-
-   return 0;
+   return result;
 }
 
 /**
@@ -1719,61 +1351,58 @@ static uint8_t DCP(void)
  * Set negative flag if result has bit 7 set, else reset.
  * Set zero flag if result is 0, else reset.
 */
-static uint8_t ISB(void)
+static uint8_t ISB(uint8_t value)
 {
-   uint8_t value = cpu_bus_read(instruction_operand);
-   cpu_bus_write(instruction_operand, value); // dummy write
    value += 1;
-   cpu_bus_write(instruction_operand, value);
 
-   value = ~value; // negate value since subtraction is done using 2's complement addition
+   uint8_t negated_value = ~value; // negate value since subtraction is done using 2's complement addition
 
-   uint8_t carry_bit = cpu.status_flags & 1;
-   uint32_t sum = cpu.ac + value + carry_bit;
+   uint8_t carry_bit = cpu->status_flags & 1;
+   uint32_t sum = cpu->ac + negated_value + carry_bit;
 
    // set/reset carry flag
    if (sum > 255)
    {
-      set_bit(cpu.status_flags, 0);
+      set_bit(cpu->status_flags, 0);
    }
    else
    {
-      clear_bit(cpu.status_flags, 0);
+      clear_bit(cpu->status_flags, 0);
    }
 
    // set/reset overflow flag
-   if ( (cpu.ac ^ sum) & (value ^ sum) & 0x80 )
+   if ( (cpu->ac ^ sum) & (negated_value ^ sum) & 0x80 )
    {
-      set_bit(cpu.status_flags, 6);
+      set_bit(cpu->status_flags, 6);
    }
    else
    {
-      clear_bit(cpu.status_flags, 6);
+      clear_bit(cpu->status_flags, 6);
    }
 
-   cpu.ac =  (uint8_t) sum;
+   cpu->ac =  (uint8_t) sum;
 
    // set/reset negative flag
-   if (cpu.ac & 0x80)
+   if (cpu->ac & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.ac == 0)
+   if (cpu->ac == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
-   return 0;
+   return value;
 }
 
 /**
@@ -1786,44 +1415,39 @@ static uint8_t ISB(void)
  * Set negative flag if result in accumulator has bit 7 set, else reset.
  * Set zero flag if result in accumulator is 0, else reset
 */
-static uint8_t RLA(void)
+static uint8_t RLA(uint8_t value)
 {
-   uint8_t value = cpu_bus_read(instruction_operand);
-   cpu_bus_write(instruction_operand, value); // dummy write
-
-   uint8_t shifted_in_bit = cpu.status_flags & 1;
+   uint8_t shifted_in_bit = cpu->status_flags & 1;
    uint8_t shifted_out_bit = (value & 0x80) != 0;
 
    value = value << 1;
    
    store_bit(value, shifted_in_bit, 0);             // carry flag is rotated into value
-   store_bit(cpu.status_flags, shifted_out_bit, 0); // bit that is rotated out is moved into carry flag
+   store_bit(cpu->status_flags, shifted_out_bit, 0); // bit that is rotated out is moved into carry flag
 
-   cpu_bus_write(instruction_operand, value);           // store result back into memory
-
-   cpu.ac = cpu.ac & value;
+   cpu->ac = cpu->ac & value;
 
    // set/reset negative
-   if (cpu.ac & 0x80)
+   if (cpu->ac & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.ac == 0)
+   if (cpu->ac == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
-   return 0;
+   return value;
 }
 
 /**
@@ -1838,67 +1462,62 @@ static uint8_t RLA(void)
  * Set negative flag if bit 7 of sum is set, else reset.
  * Set zero flag if result is 0, else reset.
 */
-static uint8_t RRA(void)
+static uint8_t RRA(uint8_t value)
 {
-   uint8_t value = cpu_bus_read(instruction_operand);
-   cpu_bus_write(instruction_operand, value);
-
    uint8_t shifted_out_bit = value & 1;
-   uint8_t shifted_in_bit = cpu.status_flags & 1;
+   uint8_t shifted_in_bit = cpu->status_flags & 1;
 
    value = value >> 1;
 
-   store_bit(cpu.status_flags, shifted_out_bit, 0);
+   store_bit(cpu->status_flags, shifted_out_bit, 0);
    store_bit(value, shifted_in_bit, 7);
 
-   cpu_bus_write(instruction_operand, value);
-
-   uint8_t carry_bit = cpu.status_flags & 1;
-   uint32_t sum = cpu.ac + value + carry_bit;
+   uint8_t carry_bit = cpu->status_flags & 1;
+   uint32_t sum = cpu->ac + value + carry_bit;
 
    // set/reset carry
    if (sum > 255)
    {
-      set_bit(cpu.status_flags, 0);
+      set_bit(cpu->status_flags, 0);
    }
    else
    {
-      clear_bit(cpu.status_flags, 0);
+      clear_bit(cpu->status_flags, 0);
    }
 
    // set/reset overflow flag
-   if ( (cpu.ac ^ sum) & (value ^ sum) & 0x80 )
+   if ( (cpu->ac ^ sum) & (value ^ sum) & 0x80 )
    {
-      set_bit(cpu.status_flags, 6);
+      set_bit(cpu->status_flags, 6);
    }
    else
    {
-      clear_bit(cpu.status_flags, 6);
+      clear_bit(cpu->status_flags, 6);
    }
 
-   cpu.ac = (uint8_t) sum;
+   cpu->ac = (uint8_t) sum;
 
    // set/reset negative
-   if (cpu.ac & 0x80)
+   if (cpu->ac & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.ac == 0)
+   if (cpu->ac == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
-   return 0;
+   return value;
 }
 
 /**
@@ -1909,81 +1528,69 @@ static uint8_t RRA(void)
  * Set negative flag if bit 7 of difference is set, else reset.
  * Set zero flag if difference is 0, else reset.
 */
-static uint8_t SBC(void)
+static void SBC(uint8_t value)
 {
    uint32_t sum;
-   uint8_t value;
-   uint8_t carry_bit = cpu.status_flags & 1;
-
-   if (current_instruction->mode == IMM)
-   {
-      value = (uint8_t) instruction_operand;
-   }
-   else
-   {
-      value = cpu_bus_read(instruction_operand);
-   }
+   uint8_t carry_bit = cpu->status_flags & 1;
 
    // 8-bit int cast to prevent negation of value being promoted to 32-bit int
-   sum = cpu.ac + (uint8_t) ~value + carry_bit; // use 2's complement to do subtraction, ( i.e. 5 - 2 == 5 + (-2) )
+   sum = cpu->ac + (uint8_t) ~value + carry_bit; // use 2's complement to do subtraction, ( i.e. 5 - 2 == 5 + (-2) )
 
    // set/reset carry flag
    if ( sum > 255 )
    {
-      set_bit(cpu.status_flags, 0);
+      set_bit(cpu->status_flags, 0);
    }
    else
    {
-      clear_bit(cpu.status_flags, 0);
+      clear_bit(cpu->status_flags, 0);
    }   
 
    // set/reset overflow flag
 
-   // ~( cpu.ac ^ (~value + carry_bit) )  ---- has bit 7 on if the sign bit (bit 7) is the same on both operands, else it is off
-   //  ( cpu.ac ^ sum )                   ---- has bit 7 on if the sign bit (bit 7) is different on both values, else it is off
+   // ~( cpu->ac ^ (~value + carry_bit) )  ---- has bit 7 on if the sign bit (bit 7) is the same on both operands, else it is off
+   //  ( cpu->ac ^ sum )                   ---- has bit 7 on if the sign bit (bit 7) is different on both values, else it is off
    /**
     * Overflowing 127 or -128 will only ever happen if both operands are of a different sign.
     * If the sign bit of both values are different, the expression will always evaluate as false
     * as overflow will never occur.
     * Otherwise if both sign bits are the same, we check if the sign bit of the value prior to
-    * the addition in cpu.ac is different to the sign bit in sum after the addition. If the sign bits
+    * the addition in cpu->ac is different to the sign bit in sum after the addition. If the sign bits
     * are different AND the sign bits of both operands the same, then we know a overflow has happened.
    */
-   if ( ( ~( cpu.ac ^ (~value) ) & ( cpu.ac ^ sum ) ) & 0x80 )
+   if ( ( ~( cpu->ac ^ (~value) ) & ( cpu->ac ^ sum ) ) & 0x80 )
    {
-      set_bit(cpu.status_flags, 6);
+      set_bit(cpu->status_flags, 6);
    }
    else
    {
-      clear_bit(cpu.status_flags, 6);
+      clear_bit(cpu->status_flags, 6);
    }
 
-   cpu.ac = (uint8_t) sum;
+   cpu->ac = (uint8_t) sum;
 
    // set/reset negative flag
-   if ( cpu.ac & 0x80 )
+   if ( cpu->ac & 0x80 )
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if ( cpu.ac == 0 )
+   if ( cpu->ac == 0 )
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
-static uint8_t SBX(void){return 0;}
+static void SBX(uint8_t value){(void) value;}
 
 /**
  * Undocumented.
@@ -1994,40 +1601,36 @@ static uint8_t SBX(void){return 0;}
  * Set negative flag if result in accumulator has bit 7 set, else reset.
  * Set zero flag if result in accumulator is 0, else reset
 */
-static uint8_t SLO(void)
+static uint8_t SLO(uint8_t value)
 {
-   uint8_t value = cpu_bus_read(instruction_operand);
-   cpu_bus_write(instruction_operand, value); // dummy write
-
    uint8_t shifted_out_bit = (value & 0x80) != 0;
-   store_bit(cpu.status_flags, shifted_out_bit, 0);
+   store_bit(cpu->status_flags, shifted_out_bit, 0);
 
    value = value << 1;
-   cpu_bus_write(instruction_operand, value);
 
-   cpu.ac = cpu.ac | value;
+   cpu->ac = cpu->ac | value;
 
    // set/reset negative flag
-   if (cpu.ac & 0x80)
+   if (cpu->ac & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.ac == 0)
+   if (cpu->ac == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
-   return 0;
+   return value;
 }
 
 /**
@@ -2039,43 +1642,39 @@ static uint8_t SLO(void)
  * Set negative flag if bit 7 of accumulator is set, else reset.
  * Set zero flag if result in accumulator is 0, else reset.
 */
-static uint8_t SRE(void)
+static uint8_t SRE(uint8_t value)
 {
-   uint8_t value = cpu_bus_read(instruction_operand);
-   cpu_bus_write(instruction_operand, value); // dummy write
-
    uint8_t shifted_out_bit = value & 1;
-   store_bit(cpu.status_flags, shifted_out_bit, 0);
+   store_bit(cpu->status_flags, shifted_out_bit, 0);
 
    value = value >> 1;
-   cpu_bus_write(instruction_operand, value);
 
-   cpu.ac = cpu.ac ^ value;
+   cpu->ac = cpu->ac ^ value;
 
    // set/reset negative flag
-   if (cpu.ac & 0x80)
+   if (cpu->ac & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.ac == 0)
+   if (cpu->ac == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
-   return 0;
+   return value;
 }
 
-static uint8_t XAA(void){return 0;}
+static void XAA(uint8_t value){(void) value;}
 
 // increment instructions
 
@@ -2085,33 +1684,31 @@ static uint8_t XAA(void){return 0;}
  * Set negative flag if bit 7 of result is on, else reset.
  * Set zero flag if result is zero, else reset.
 */
-static uint8_t DEC(void)
+static uint8_t DEC(uint8_t value)
 {
-   uint8_t value = cpu_bus_read(instruction_operand);
-   cpu_bus_write(instruction_operand, value); // dummy write
-   cpu_bus_write(instruction_operand, --value);
+   --value;
 
    // set/reset negative flag
    if (value & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
    if (value == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
-   return 0;
+   return value;
 }
 
 /**
@@ -2119,31 +1716,29 @@ static uint8_t DEC(void)
  * Set negative flag if bit 7 of result is on, else reset.
  * Set zero flag if result is zero, else reset.
 */
-static uint8_t DEX(void)
+static void DEX(void)
 {
-   --cpu.X;
+   --cpu->X;
 
    // set/reset negative flag
-   if (cpu.X & 0x80)
+   if (cpu->X & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.X == 0)
+   if (cpu->X == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 /**
@@ -2151,31 +1746,29 @@ static uint8_t DEX(void)
  * Set negative flag if bit 7 of result is on, else reset.
  * Set zero flag if result is zero, else reset.
 */
-static uint8_t DEY(void)
+static void DEY(void)
 {
-   --cpu.Y;
+   --cpu->Y;
 
    // set/reset negative flag
-   if (cpu.Y & 0x80)
+   if (cpu->Y & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.Y == 0)
+   if (cpu->Y == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 /**
@@ -2183,33 +1776,31 @@ static uint8_t DEY(void)
  * Set negative flag if bit 7 of result is on, else reset.
  * Set zero flag if result is zero, else reset. 
 */
-static uint8_t INC(void)
+static uint8_t INC(uint8_t value)
 {
-   uint8_t value = cpu_bus_read(instruction_operand);
-   cpu_bus_write(instruction_operand, value); // dummy write
-   cpu_bus_write(instruction_operand, ++value);
+   ++value;
 
    // set/reset negative flag
    if (value & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
    if (value == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
 
-   return 0;
+   return value;
 }
 
 /**
@@ -2217,31 +1808,29 @@ static uint8_t INC(void)
  * Set negative flag if bit 7 of result is on, else reset.
  * Set zero flag if result is zero, else reset.
 */
-static uint8_t INX(void)
+static void INX(void)
 {
-   ++cpu.X;
+   ++cpu->X;
 
    // set/reset negative flag
-   if (cpu.X & 0x80)
+   if (cpu->X & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.X == 0)
+   if (cpu->X == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 /**
@@ -2249,31 +1838,29 @@ static uint8_t INX(void)
  * Set negative flag if bit 7 of result is on, else reset.
  * Set zero flag if result is zero, else reset.
 */
-static uint8_t INY(void)
+static void INY(void)
 {
-   ++cpu.Y;
+   ++cpu->Y;
 
    // set/reset negative flag
-   if (cpu.Y & 0x80)
+   if (cpu->Y & 0x80)
    {
-      set_bit(cpu.status_flags, 7);
+      set_bit(cpu->status_flags, 7);
    }
    else
    {
-      clear_bit(cpu.status_flags, 7);
+      clear_bit(cpu->status_flags, 7);
    }
 
    // set/reset zero flag
-   if (cpu.Y == 0)
+   if (cpu->Y == 0)
    {
-      set_bit(cpu.status_flags, 1);
+      set_bit(cpu->status_flags, 1);
    }
    else
    {
-      clear_bit(cpu.status_flags, 1);
+      clear_bit(cpu->status_flags, 1);
    }
-
-   return 0;
 }
 
 // control
@@ -2283,49 +1870,46 @@ static uint8_t INY(void)
  * onto the stack with the bit 4 (break flag) set as 1.
  * The cpu then transfers control to the address located at the interrupt vector 0xFFFE.
 */
-static uint8_t BRK(void)
+static void BRK(void)
 {
    // read next byte and ingore fetched result while incrementing pc, the dummy read is already handled
 	// as BRK is a immediate mode intruction. So we just increment the pc.
-   cpu.pc += 1;
-   stack_push( (cpu.pc & 0xFF00) >> 8 );
-   stack_push( cpu.pc & 0x00FF );
+   cpu->pc += 1;
+   stack_push( (cpu->pc & 0xFF00) >> 8 );
+   stack_push( cpu->pc & 0x00FF );
 
-   stack_push(cpu.status_flags | 0x30); // break and unused flag pushed as 1
+   stack_push(cpu->status_flags | 0x30); // break and unused flag pushed as 1
 
-   set_bit(cpu.status_flags, 2); // set interrupt disable flag
+   set_bit(cpu->status_flags, 2); // set interrupt disable flag
 
    uint8_t lo = cpu_bus_read(INTERRUPT_VECTOR);
    uint8_t hi = cpu_bus_read(INTERRUPT_VECTOR + 1);
 
-   cpu.pc = (hi << 8) | lo;
+   cpu->pc = (hi << 8) | lo;
 
    if (emu_state->is_cpu_intr_log) update_disassembly(MAX_NEXT);
-
-   return 0;
 }
 
 /**
  * loads program counter with new jump value
 */
-static uint8_t JMP(void)
+static void JMP(uint16_t address)
 {
-   cpu.pc = instruction_operand;
+   cpu->pc = address;
 
    if (emu_state->is_cpu_intr_log) update_disassembly(MAX_NEXT);
-   return 0;
 }
 
 /**
  * Jumps to a subroutine.
  * Save return address onto the stack
 */
-static uint8_t JSR(void)
+static void JSR(uint16_t address)
 {  
    cpu_tick();
 
    // push the pc address that points to the last byte of the JSR instruction
-   uint16_t return_address = cpu.pc - 1; // the pc currently points to next opcode byte so we minus one to point to last byte of JSR
+   uint16_t return_address = cpu->pc - 1; // the pc currently points to next opcode byte so we minus one to point to last byte of JSR
 
    uint8_t hi = ( return_address & 0xFF00 ) >> 8;
    stack_push(hi);
@@ -2333,11 +1917,9 @@ static uint8_t JSR(void)
    uint8_t lo = return_address & 0x00FF;
    stack_push(lo);
 
-   cpu.pc = instruction_operand;
+   cpu->pc = address;
 
    if (emu_state->is_cpu_intr_log) update_disassembly(MAX_NEXT);
-
-   return 0;
 }
 
 /**
@@ -2345,39 +1927,35 @@ static uint8_t JSR(void)
  * Pops the status flag register and the program counter from the stack
  * and loads them back into respective cpu registers.
 */
-static uint8_t RTI(void)
+static void RTI(void)
 {
    cpu_fetch_no_increment();
    cpu_tick(); // 1 cycle to increment stack pointer
-   cpu.status_flags = stack_pop();
+   cpu->status_flags = stack_pop();
    uint8_t lo = stack_pop();
    uint8_t hi = stack_pop();
 
-   clear_bit(cpu.status_flags, 4); // break flag is always reset when popped from stack
+   clear_bit(cpu->status_flags, 4); // break flag is always reset when popped from stack
 
-   cpu.pc = ( hi << 8) | lo;
+   cpu->pc = ( hi << 8) | lo;
 
    if (emu_state->is_cpu_intr_log) update_disassembly(MAX_NEXT);
-
-   return 0;
 }
 
 /**
  * return from subroutine
 */
-static uint8_t RTS(void)
+static void RTS(void)
 {
    cpu_tick(); // inital stack pointer increment takes 1 cycle
    uint8_t lo = stack_pop();
    uint8_t hi = stack_pop();
    
-   cpu.pc = ( hi << 8 ) | lo;
-   ++cpu.pc;
+   cpu->pc = ( hi << 8 ) | lo;
+   ++cpu->pc;
    cpu_tick(); // 1 cycle used for incrementing pc
 
    if (emu_state->is_cpu_intr_log) update_disassembly(MAX_NEXT);
-
-   return 0;
 }
 
 // branch instructions
@@ -2385,105 +1963,65 @@ static uint8_t RTS(void)
 /**
  * branch if carry flag is cleared
 */
-static uint8_t BCC(void)
+static void BCC(void)
 {
-   if ( !(cpu.status_flags & 0x01) )
-   {
-      return 1 + branch();
-   }
-
-   return 0;
+   branch( !(cpu->status_flags & 0x01) );
 }
 
 /**
  * branch if carry flag is set
 */ 
-static uint8_t BCS(void)
+static void BCS(void)
 {
-   if ( cpu.status_flags & 0x01 )
-   {
-      return 1 + branch();
-   }
-
-   return 0;
+   branch( cpu->status_flags & 0x01 );
 }
 
 /**
  * branch if zero flag is set
 */
-static uint8_t BEQ(void)
+static void BEQ(void)
 {
-   if ( cpu.status_flags & 0x02 )
-   {
-      return 1 + branch();
-   }
-
-   return 0;
+   branch( cpu->status_flags & 0x02 );
 }
 
 /**
  * branch if negative flag is set
 */
-static uint8_t BMI(void)
+static void BMI(void)
 {
-   if ( cpu.status_flags & 0x80 )
-   {
-      return 1 + branch();
-   }
-
-   return 0;
+   branch( cpu->status_flags & 0x80 );
 }
 
 /**
  * branch if zero flag is not set
 */
-static uint8_t BNE(void)
+static void BNE(void)
 {
-   if ( !(cpu.status_flags & 0x02) )
-   {
-      return 1 + branch();
-   }
-
-   return 0;
+   branch( !(cpu->status_flags & 0x02) );
 }
 
 /**
  * branch if negative flag is cleared
 */
-static uint8_t BPL(void)
+static void BPL(void)
 {
-   if ( !(cpu.status_flags & 0x80) )
-   {
-      return 1 + branch();
-   }
-
-   return 0;
+   branch( !(cpu->status_flags & 0x80) );
 }
 
 /**
  * branch if overflow flag is cleared
 */
-static uint8_t BVC(void)
+static void BVC(void)
 {
-   if ( !(cpu.status_flags & 0x40) )
-   {
-      return 1 + branch();
-   }
-
-   return 0;
+   branch( !(cpu->status_flags & 0x40) );
 }
 
 /**
  * branch if overflow flag is set
 */
-static uint8_t BVS(void)
+static void BVS(void)
 {
-   if ( cpu.status_flags & 0x40)
-   {
-      return 1 + branch();
-   }
-
-   return 0;
+   branch( cpu->status_flags & 0x40 );
 }
 
 // flags instructions
@@ -2491,46 +2029,41 @@ static uint8_t BVS(void)
 /**
  * clear the carry flag
 */
-static uint8_t CLC(void)
+static void CLC(void)
 {
-   clear_bit(cpu.status_flags, 0);
-   return 0;
+   clear_bit(cpu->status_flags, 0);
 }
 
 /**
  * clears the decimal mode flag
 */
-static uint8_t CLD(void)
+static void CLD(void)
 {
-   clear_bit(cpu.status_flags, 3);
-   return 0;
+   clear_bit(cpu->status_flags, 3);
 }
 
 /**
  * Clears the interupt flag.
 */
-static uint8_t CLI(void)
+static void CLI(void)
 {
-   clear_bit(cpu.status_flags, 2);
-   return 0;
+   clear_bit(cpu->status_flags, 2);
 }
 
 /**
  * Clears the overflow flag.
 */
-static uint8_t CLV(void)
+static void CLV(void)
 {
-   clear_bit(cpu.status_flags, 6);
-   return 0;
+   clear_bit(cpu->status_flags, 6);
 }
 
 /**
  * sets the carry flag to 1
 */
-static uint8_t SEC(void)
+static void SEC(void)
 {
-   set_bit(cpu.status_flags, 0);
-   return 0;
+   set_bit(cpu->status_flags, 0);
 }
 
 /**
@@ -2538,19 +2071,17 @@ static uint8_t SEC(void)
  * Causes subsequent ADC and SBC instructions to operate
  * in decimal arithmetic mode
 */
-static uint8_t SED(void)
+static void SED(void)
 {
-   set_bit(cpu.status_flags, 3);
-   return 0;
+   set_bit(cpu->status_flags, 3);
 }
 
 /**
  * sets the interrupt disable flag to 1
 */
-static uint8_t SEI(void)
+static void SEI(void)
 {
-   set_bit(cpu.status_flags, 2);
-   return 0;
+   set_bit(cpu->status_flags, 2);
 }
 
 /**
@@ -2558,24 +2089,24 @@ static uint8_t SEI(void)
 */
 void cpu_IRQ(void)
 { 
-   if (cpu.status_flags & 4) 
+   if (cpu->status_flags & 4) 
 		return; // ignore IRQ if interrupt disable flag is set
 
 	cpu_fetch_no_increment(); // fetch opcode
 	cpu_fetch_no_increment(); // attempt to fetch next instruction by fail since pc increment is supressed
 
-   stack_push( ( cpu.pc & 0xFF00 ) >> 8 );
-   stack_push( cpu.pc & 0x00FF );
+   stack_push( ( cpu->pc & 0xFF00 ) >> 8 );
+   stack_push( cpu->pc & 0x00FF );
 
-   clear_bit(cpu.status_flags, 4); // make sure the break flag is cleared when pushed
-   stack_push(cpu.status_flags);
+   clear_bit(cpu->status_flags, 4); // make sure the break flag is cleared when pushed
+   stack_push(cpu->status_flags);
 
-   set_bit(cpu.status_flags, 2);  // set interrupt flag to ignore further IRQs
+   set_bit(cpu->status_flags, 2);  // set interrupt flag to ignore further IRQs
 
    uint8_t lo = cpu_bus_read(INTERRUPT_VECTOR);
    uint8_t hi = cpu_bus_read(INTERRUPT_VECTOR + 1);
 
-   cpu.pc = (hi << 8) | lo;
+   cpu->pc = (hi << 8) | lo;
 
    if (emu_state->is_cpu_intr_log) 
 		update_disassembly(MAX_NEXT + 1);
@@ -2586,41 +2117,45 @@ void cpu_NMI(void)
    cpu_fetch_no_increment(); // fetch opcode
    cpu_fetch_no_increment(); // attempt to fetch next instruction by fail since pc increment is supressed
 
-   stack_push( (cpu.pc & 0xFF00) >> 8 );
-   stack_push(cpu.pc & 0x00FF);
+   stack_push( (cpu->pc & 0xFF00) >> 8 );
+   stack_push(cpu->pc & 0x00FF);
 
-   clear_bit(cpu.status_flags, 4); // make sure the break flag is cleared when pushed
-   stack_push(cpu.status_flags);
+   clear_bit(cpu->status_flags, 4); // make sure the break flag is cleared when pushed
+   stack_push(cpu->status_flags);
 
-   set_bit(cpu.status_flags, 2);  // set interrupt flag to ignore further IRQs
+   set_bit(cpu->status_flags, 2);  // set interrupt flag to ignore further IRQs
 
    uint8_t lo = cpu_bus_read(NMI_VECTOR);
    uint8_t hi = cpu_bus_read(NMI_VECTOR + 1);
 
-   cpu.pc = (hi << 8) | lo;
+   cpu->pc = (hi << 8) | lo;
 
    if (emu_state->is_cpu_intr_log) 
 		update_disassembly(MAX_NEXT + 1);
 }
 
 /**
- * Performs a branch by using loading calculated address in instruction_operand
- * into the program counter.
- * @returns 1 when page boundary is crossed to represent +1 extra cycle taken to
- * correct the high byte.
+ * Fetches the relative offset of a branch instruction and performs the branch by loading
+ * the calculated address into the program counter if the branch condition is met.
+ * A taken branch takes 1 extra cycle, plus 1 more when a page boundary is crossed
+ * to correct the high byte.
+ * @param condition true if the branch is taken
 */
-static uint8_t branch(void)
+static void branch(bool condition)
 {
+   uint16_t branch_address = address_REL();
+
+   if (!condition)
+      return;
+
    cpu_fetch_no_increment(); // next instruction byte is fetched in the cpu pipeline
-   uint8_t extra_cycle = (instruction_operand & 0xFF00) != (cpu.pc & 0xFF00);
+   bool extra_cycle = (branch_address & 0xFF00) != (cpu->pc & 0xFF00);
 
    if (extra_cycle) cpu_tick(); // extra cycle to fix pc high byte due to page cross
 
-   cpu.pc = instruction_operand;
+   cpu->pc = branch_address;
 
    if (emu_state->is_cpu_intr_log) update_disassembly(MAX_NEXT);
-
-   return extra_cycle;
 }
 
 /**
@@ -2631,8 +2166,8 @@ static uint8_t branch(void)
 static uint8_t cpu_fetch(void)
 {
    // fetch
-   uint8_t fetched_byte = cpu_bus_read(cpu.pc);
-   ++cpu.pc;
+   uint8_t fetched_byte = cpu_bus_read(cpu->pc);
+   ++cpu->pc;
 
    return fetched_byte;
 }
@@ -2644,33 +2179,340 @@ static uint8_t cpu_fetch(void)
 static uint8_t cpu_fetch_no_increment(void)
 {
    // fetch
-   uint8_t fetched_byte = cpu_bus_read(cpu.pc);
+   uint8_t fetched_byte = cpu_bus_read(cpu->pc);
 
    return fetched_byte;
 }
 
-/**
- * Decodes an opcode by using the opcode to index into the opcode lookup table
- * The decoded opcode will be executed on the next call to instruction_execute.
- * Call this function before calling cpu_execute.
- * @param opcode the opcode to decode
-*/
-static inline void cpu_decode(uint8_t opcode)
-{
-   current_instruction = &instruction_lookup_table[opcode];
-   current_opcode = opcode;
-}
+// opcode dispatch, each macro expands to the bus accesses of one kind of instruction
+
+// 1 byte instructions, the byte after the opcode is dummy read
+#define IMPLIED(instruction)   \
+   do                          \
+   {                           \
+      cpu_bus_read(cpu->pc);    \
+      instruction();           \
+   } while (0)
+
+#define ACCUMULATOR(instruction)       \
+   do                                  \
+   {                                   \
+      cpu_bus_read(cpu->pc);            \
+      cpu->ac = instruction(cpu->ac);    \
+   } while (0)
+
+#define IMMEDIATE(instruction) instruction( cpu_fetch() )
+
+#define READ(instruction, address) instruction( cpu_bus_read(address) )
+
+// read-modify-write instructions write the unmodified value back before writing the result
+#define MODIFY(instruction, address)                          \
+   do                                                         \
+   {                                                          \
+      uint16_t modify_address = address;                      \
+      uint8_t value = cpu_bus_read(modify_address);           \
+      cpu_bus_write(modify_address, value);                   \
+      cpu_bus_write(modify_address, instruction(value));      \
+   } while (0)
 
 /**
- * execute the instruction that was previously decoded from a call to cpu_decode().
- * Only call this function after cpu_decode() has been called.
- * @returns the number of cycles the executed instruction takes
+ * Executes a single instruction. Every opcode has its own case with the addressing mode
+ * and access type fixed at compile time, so operand fetching, dummy reads and the operation
+ * itself are expanded in place instead of being looked up at runtime.
+ * @param opcode the opcode to execute
 */
-static  inline void cpu_execute(void)
+static inline void cpu_execute(uint8_t opcode)
 {
-   uint8_t extra_cycles = 0;
-   set_instruction_operand(current_instruction->mode, &extra_cycles);
-   current_instruction->opcode_function(); // execute the current instruction
+   switch (opcode)
+   {
+      /* 0x00 - 0x0F */
+      case 0x00: IMPLIED(BRK);                        break;
+      case 0x01: READ(ORA, address_XZI());            break;
+      case 0x02: IMPLIED(JAM);                        break; // *JAM
+      case 0x03: MODIFY(SLO, address_XZI());          break; // *SLO
+      case 0x04: READ(NOP, address_ZPG());            break; // *NOP
+      case 0x05: READ(ORA, address_ZPG());            break;
+      case 0x06: MODIFY(ASL, address_ZPG());          break;
+      case 0x07: MODIFY(SLO, address_ZPG());          break; // *SLO
+      case 0x08: IMPLIED(PHP);                        break;
+      case 0x09: IMMEDIATE(ORA);                      break;
+      case 0x0A: ACCUMULATOR(ASL);                    break;
+      case 0x0B: IMMEDIATE(ANC);                      break; // *ANC
+      case 0x0C: READ(NOP, address_ABS());            break; // *NOP
+      case 0x0D: READ(ORA, address_ABS());            break;
+      case 0x0E: MODIFY(ASL, address_ABS());          break;
+      case 0x0F: MODIFY(SLO, address_ABS());          break; // *SLO
+
+      /* 0x10 - 0x1F */
+      case 0x10: BPL();                               break;
+      case 0x11: READ(ORA, address_YZI(false));       break;
+      case 0x12: IMPLIED(JAM);                        break; // *JAM
+      case 0x13: MODIFY(SLO, address_YZI(true));      break; // *SLO
+      case 0x14: READ(NOP, address_XZP());            break; // *NOP
+      case 0x15: READ(ORA, address_XZP());            break;
+      case 0x16: MODIFY(ASL, address_XZP());          break;
+      case 0x17: MODIFY(SLO, address_XZP());          break; // *SLO
+      case 0x18: IMPLIED(CLC);                        break;
+      case 0x19: READ(ORA, address_YAB(false));       break;
+      case 0x1A: READ(NOP, cpu->pc);                   break; // implied nop, only the dummy read
+      case 0x1B: MODIFY(SLO, address_YAB(true));      break; // *SLO
+      case 0x1C: READ(NOP, address_XAB(false));       break; // *NOP
+      case 0x1D: READ(ORA, address_XAB(false));       break;
+      case 0x1E: MODIFY(ASL, address_XAB(true));      break;
+      case 0x1F: MODIFY(SLO, address_XAB(true));      break; // *SLO
+
+      /* 0x20 - 0x2F */
+      case 0x20: JSR(address_ABS());                  break;
+      case 0x21: READ(AND, address_XZI());            break;
+      case 0x22: IMPLIED(JAM);                        break; // *JAM
+      case 0x23: MODIFY(RLA, address_XZI());          break; // *RLA
+      case 0x24: READ(BIT, address_ZPG());            break;
+      case 0x25: READ(AND, address_ZPG());            break;
+      case 0x26: MODIFY(ROL, address_ZPG());          break;
+      case 0x27: MODIFY(RLA, address_ZPG());          break; // *RLA
+      case 0x28: IMPLIED(PLP);                        break;
+      case 0x29: IMMEDIATE(AND);                      break;
+      case 0x2A: ACCUMULATOR(ROL);                    break;
+      case 0x2B: IMMEDIATE(ANC);                      break; // *ANC
+      case 0x2C: READ(BIT, address_ABS());            break;
+      case 0x2D: READ(AND, address_ABS());            break;
+      case 0x2E: MODIFY(ROL, address_ABS());          break;
+      case 0x2F: MODIFY(RLA, address_ABS());          break; // *RLA
+
+      /* 0x30 - 0x3F */
+      case 0x30: BMI();                               break;
+      case 0x31: READ(AND, address_YZI(false));       break;
+      case 0x32: IMPLIED(JAM);                        break; // *JAM
+      case 0x33: MODIFY(RLA, address_YZI(true));      break; // *RLA
+      case 0x34: READ(NOP, address_XZP());            break; // *NOP
+      case 0x35: READ(AND, address_XZP());            break;
+      case 0x36: MODIFY(ROL, address_XZP());          break;
+      case 0x37: MODIFY(RLA, address_XZP());          break; // *RLA
+      case 0x38: IMPLIED(SEC);                        break;
+      case 0x39: READ(AND, address_YAB(false));       break;
+      case 0x3A: READ(NOP, cpu->pc);                   break; // implied nop, only the dummy read
+      case 0x3B: MODIFY(RLA, address_YAB(true));      break; // *RLA
+      case 0x3C: READ(NOP, address_XAB(false));       break; // *NOP
+      case 0x3D: READ(AND, address_XAB(false));       break;
+      case 0x3E: MODIFY(ROL, address_XAB(true));      break;
+      case 0x3F: MODIFY(RLA, address_XAB(true));      break; // *RLA
+
+      /* 0x40 - 0x4F */
+      case 0x40: IMPLIED(RTI);                        break;
+      case 0x41: READ(EOR, address_XZI());            break;
+      case 0x42: IMPLIED(JAM);                        break; // *JAM
+      case 0x43: MODIFY(SRE, address_XZI());          break; // *SRE
+      case 0x44: READ(NOP, address_ZPG());            break; // *NOP
+      case 0x45: READ(EOR, address_ZPG());            break;
+      case 0x46: MODIFY(LSR, address_ZPG());          break;
+      case 0x47: MODIFY(SRE, address_ZPG());          break; // *SRE
+      case 0x48: IMPLIED(PHA);                        break;
+      case 0x49: IMMEDIATE(EOR);                      break;
+      case 0x4A: ACCUMULATOR(LSR);                    break;
+      case 0x4B: IMMEDIATE(ASR);                      break; // *ASR
+      case 0x4C: JMP(address_ABS());                  break;
+      case 0x4D: READ(EOR, address_ABS());            break;
+      case 0x4E: MODIFY(LSR, address_ABS());          break;
+      case 0x4F: MODIFY(SRE, address_ABS());          break; // *SRE
+
+      /* 0x50 - 0x5F */
+      case 0x50: BVC();                               break;
+      case 0x51: READ(EOR, address_YZI(false));       break;
+      case 0x52: IMPLIED(JAM);                        break; // *JAM
+      case 0x53: MODIFY(SRE, address_YZI(true));      break; // *SRE
+      case 0x54: READ(NOP, address_XZP());            break; // *NOP
+      case 0x55: READ(EOR, address_XZP());            break;
+      case 0x56: MODIFY(LSR, address_XZP());          break;
+      case 0x57: MODIFY(SRE, address_XZP());          break; // *SRE
+      case 0x58: IMPLIED(CLI);                        break;
+      case 0x59: READ(EOR, address_YAB(false));       break;
+      case 0x5A: READ(NOP, cpu->pc);                   break; // implied nop, only the dummy read
+      case 0x5B: MODIFY(SRE, address_YAB(true));      break; // *SRE
+      case 0x5C: READ(NOP, address_XAB(false));       break; // *NOP
+      case 0x5D: READ(EOR, address_XAB(false));       break;
+      case 0x5E: MODIFY(LSR, address_XAB(true));      break;
+      case 0x5F: MODIFY(SRE, address_XAB(true));      break; // *SRE
+
+      /* 0x60 - 0x6F */
+      case 0x60: IMPLIED(RTS);                        break;
+      case 0x61: READ(ADC, address_XZI());            break;
+      case 0x62: IMPLIED(JAM);                        break; // *JAM
+      case 0x63: MODIFY(RRA, address_XZI());          break; // *RRA
+      case 0x64: READ(NOP, address_ZPG());            break; // *NOP
+      case 0x65: READ(ADC, address_ZPG());            break;
+      case 0x66: MODIFY(ROR, address_ZPG());          break;
+      case 0x67: MODIFY(RRA, address_ZPG());          break; // *RRA
+      case 0x68: IMPLIED(PLA);                        break;
+      case 0x69: IMMEDIATE(ADC);                      break;
+      case 0x6A: ACCUMULATOR(ROR);                    break;
+      case 0x6B: IMMEDIATE(ARR);                      break; // *ARR
+      case 0x6C: JMP(address_ABI());                  break;
+      case 0x6D: READ(ADC, address_ABS());            break;
+      case 0x6E: MODIFY(ROR, address_ABS());          break;
+      case 0x6F: MODIFY(RRA, address_ABS());          break; // *RRA
+
+      /* 0x70 - 0x7F */
+      case 0x70: BVS();                               break;
+      case 0x71: READ(ADC, address_YZI(false));       break;
+      case 0x72: IMPLIED(JAM);                        break; // *JAM
+      case 0x73: MODIFY(RRA, address_YZI(true));      break; // *RRA
+      case 0x74: READ(NOP, address_XZP());            break; // *NOP
+      case 0x75: READ(ADC, address_XZP());            break;
+      case 0x76: MODIFY(ROR, address_XZP());          break;
+      case 0x77: MODIFY(RRA, address_XZP());          break; // *RRA
+      case 0x78: IMPLIED(SEI);                        break;
+      case 0x79: READ(ADC, address_YAB(false));       break;
+      case 0x7A: READ(NOP, cpu->pc);                   break; // implied nop, only the dummy read
+      case 0x7B: MODIFY(RRA, address_YAB(true));      break; // *RRA
+      case 0x7C: READ(NOP, address_XAB(false));       break; // *NOP
+      case 0x7D: READ(ADC, address_XAB(false));       break;
+      case 0x7E: MODIFY(ROR, address_XAB(true));      break;
+      case 0x7F: MODIFY(RRA, address_XAB(true));      break; // *RRA
+
+      /* 0x80 - 0x8F */
+      case 0x80: IMMEDIATE(NOP);                      break; // *NOP
+      case 0x81: STA(address_XZI());                  break;
+      case 0x82: IMMEDIATE(NOP);                      break; // *NOP
+      case 0x83: SAX(address_XZI());                  break; // *SAX
+      case 0x84: STY(address_ZPG());                  break;
+      case 0x85: STA(address_ZPG());                  break;
+      case 0x86: STX(address_ZPG());                  break;
+      case 0x87: SAX(address_ZPG());                  break; // *SAX
+      case 0x88: IMPLIED(DEY);                        break;
+      case 0x89: IMMEDIATE(NOP);                      break; // *NOP
+      case 0x8A: IMPLIED(TXA);                        break;
+      case 0x8B: IMMEDIATE(XAA);                      break; // *XAA
+      case 0x8C: STY(address_ABS());                  break;
+      case 0x8D: STA(address_ABS());                  break;
+      case 0x8E: STX(address_ABS());                  break;
+      case 0x8F: SAX(address_ABS());                  break; // *SAX
+
+      /* 0x90 - 0x9F */
+      case 0x90: BCC();                               break;
+      case 0x91: STA(address_YZI(true));              break;
+      case 0x92: IMPLIED(JAM);                        break; // *JAM
+      case 0x93: SHA(address_YZI(true));              break; // *SHA
+      case 0x94: STY(address_XZP());                  break;
+      case 0x95: STA(address_XZP());                  break;
+      case 0x96: STX(address_YZP());                  break;
+      case 0x97: SAX(address_YZP());                  break; // *SAX
+      case 0x98: IMPLIED(TYA);                        break;
+      case 0x99: STA(address_YAB(true));              break;
+      case 0x9A: IMPLIED(TXS);                        break;
+      case 0x9B: SHS(address_YAB(true));              break; // *SHS
+      case 0x9C: SHY(address_XAB(true));              break; // *SHY
+      case 0x9D: STA(address_XAB(true));              break;
+      case 0x9E: SHX(address_YAB(true));              break; // *SHX
+      case 0x9F: SHA(address_YAB(true));              break; // *SHA
+
+      /* 0xA0 - 0xAF */
+      case 0xA0: IMMEDIATE(LDY);                      break;
+      case 0xA1: READ(LDA, address_XZI());            break;
+      case 0xA2: IMMEDIATE(LDX);                      break;
+      case 0xA3: READ(LAX, address_XZI());            break; // *LAX
+      case 0xA4: READ(LDY, address_ZPG());            break;
+      case 0xA5: READ(LDA, address_ZPG());            break;
+      case 0xA6: READ(LDX, address_ZPG());            break;
+      case 0xA7: READ(LAX, address_ZPG());            break; // *LAX
+      case 0xA8: IMPLIED(TAY);                        break;
+      case 0xA9: IMMEDIATE(LDA);                      break;
+      case 0xAA: IMPLIED(TAX);                        break;
+      case 0xAB: IMMEDIATE(LAX);                      break; // *LAX
+      case 0xAC: READ(LDY, address_ABS());            break;
+      case 0xAD: READ(LDA, address_ABS());            break;
+      case 0xAE: READ(LDX, address_ABS());            break;
+      case 0xAF: READ(LAX, address_ABS());            break; // *LAX
+
+      /* 0xB0 - 0xBF */
+      case 0xB0: BCS();                               break;
+      case 0xB1: READ(LDA, address_YZI(false));       break;
+      case 0xB2: IMPLIED(JAM);                        break; // *JAM
+      case 0xB3: READ(LAX, address_YZI(false));       break; // *LAX
+      case 0xB4: READ(LDY, address_XZP());            break;
+      case 0xB5: READ(LDA, address_XZP());            break;
+      case 0xB6: READ(LDX, address_YZP());            break;
+      case 0xB7: READ(LAX, address_YZP());            break; // *LAX
+      case 0xB8: IMPLIED(CLV);                        break;
+      case 0xB9: READ(LDA, address_YAB(false));       break;
+      case 0xBA: IMPLIED(TSX);                        break;
+      case 0xBB: LAS(address_YAB(false));             break; // *LAS
+      case 0xBC: READ(LDY, address_XAB(false));       break;
+      case 0xBD: READ(LDA, address_XAB(false));       break;
+      case 0xBE: READ(LDX, address_YAB(false));       break;
+      case 0xBF: READ(LAX, address_YAB(false));       break; // *LAX
+
+      /* 0xC0 - 0xCF */
+      case 0xC0: IMMEDIATE(CPY);                      break;
+      case 0xC1: READ(CMP, address_XZI());            break;
+      case 0xC2: IMMEDIATE(NOP);                      break; // *NOP
+      case 0xC3: MODIFY(DCP, address_XZI());          break; // *DCP
+      case 0xC4: READ(CPY, address_ZPG());            break;
+      case 0xC5: READ(CMP, address_ZPG());            break;
+      case 0xC6: MODIFY(DEC, address_ZPG());          break;
+      case 0xC7: MODIFY(DCP, address_ZPG());          break; // *DCP
+      case 0xC8: IMPLIED(INY);                        break;
+      case 0xC9: IMMEDIATE(CMP);                      break;
+      case 0xCA: IMPLIED(DEX);                        break;
+      case 0xCB: IMMEDIATE(SBX);                      break; // *SBX
+      case 0xCC: READ(CPY, address_ABS());            break;
+      case 0xCD: READ(CMP, address_ABS());            break;
+      case 0xCE: MODIFY(DEC, address_ABS());          break;
+      case 0xCF: MODIFY(DCP, address_ABS());          break; // *DCP
+
+      /* 0xD0 - 0xDF */
+      case 0xD0: BNE();                               break;
+      case 0xD1: READ(CMP, address_YZI(false));       break;
+      case 0xD2: IMPLIED(JAM);                        break; // *JAM
+      case 0xD3: MODIFY(DCP, address_YZI(true));      break; // *DCP
+      case 0xD4: READ(NOP, address_XZP());            break; // *NOP
+      case 0xD5: READ(CMP, address_XZP());            break;
+      case 0xD6: MODIFY(DEC, address_XZP());          break;
+      case 0xD7: MODIFY(DCP, address_XZP());          break; // *DCP
+      case 0xD8: IMPLIED(CLD);                        break;
+      case 0xD9: READ(CMP, address_YAB(false));       break;
+      case 0xDA: READ(NOP, cpu->pc);                   break; // implied nop, only the dummy read
+      case 0xDB: MODIFY(DCP, address_YAB(true));      break; // *DCP
+      case 0xDC: READ(NOP, address_XAB(false));       break; // *NOP
+      case 0xDD: READ(CMP, address_XAB(false));       break;
+      case 0xDE: MODIFY(DEC, address_XAB(true));      break;
+      case 0xDF: MODIFY(DCP, address_XAB(true));      break; // *DCP
+
+      /* 0xE0 - 0xEF */
+      case 0xE0: IMMEDIATE(CPX);                      break;
+      case 0xE1: READ(SBC, address_XZI());            break;
+      case 0xE2: IMMEDIATE(NOP);                      break; // *NOP
+      case 0xE3: MODIFY(ISB, address_XZI());          break; // *ISB
+      case 0xE4: READ(CPX, address_ZPG());            break;
+      case 0xE5: READ(SBC, address_ZPG());            break;
+      case 0xE6: MODIFY(INC, address_ZPG());          break;
+      case 0xE7: MODIFY(ISB, address_ZPG());          break; // *ISB
+      case 0xE8: IMPLIED(INX);                        break;
+      case 0xE9: IMMEDIATE(SBC);                      break;
+      case 0xEA: READ(NOP, cpu->pc);                   break; // implied nop, only the dummy read
+      case 0xEB: IMMEDIATE(SBC);                      break; // *SBC
+      case 0xEC: READ(CPX, address_ABS());            break;
+      case 0xED: READ(SBC, address_ABS());            break;
+      case 0xEE: MODIFY(INC, address_ABS());          break;
+      case 0xEF: MODIFY(ISB, address_ABS());          break; // *ISB
+
+      /* 0xF0 - 0xFF */
+      case 0xF0: BEQ();                               break;
+      case 0xF1: READ(SBC, address_YZI(false));       break;
+      case 0xF2: IMPLIED(JAM);                        break; // *JAM
+      case 0xF3: MODIFY(ISB, address_YZI(true));      break; // *ISB
+      case 0xF4: READ(NOP, address_XZP());            break; // *NOP
+      case 0xF5: READ(SBC, address_XZP());            break;
+      case 0xF6: MODIFY(INC, address_XZP());          break;
+      case 0xF7: MODIFY(ISB, address_XZP());          break; // *ISB
+      case 0xF8: IMPLIED(SED);                        break;
+      case 0xF9: READ(SBC, address_YAB(false));       break;
+      case 0xFA: READ(NOP, cpu->pc);                   break; // implied nop, only the dummy read
+      case 0xFB: MODIFY(ISB, address_YAB(true));      break; // *ISB
+      case 0xFC: READ(NOP, address_XAB(false));       break; // *NOP
+      case 0xFD: READ(SBC, address_XAB(false));       break;
+      case 0xFE: MODIFY(INC, address_XAB(true));      break;
+      case 0xFF: MODIFY(ISB, address_XAB(true));      break; // *ISB
+   }
 }
 
 /**
@@ -2679,8 +2521,8 @@ static  inline void cpu_execute(void)
  */ 
 static void stack_push(uint8_t value)
 {
-   cpu_bus_write(CPU_STACK_ADDRESS + cpu.sp, value);
-   --cpu.sp;
+   cpu_bus_write(CPU_STACK_ADDRESS + cpu->sp, value);
+   --cpu->sp;
 }
 
 /**
@@ -2689,8 +2531,8 @@ static void stack_push(uint8_t value)
 */ 
 static uint8_t stack_pop(void)
 {
-   ++cpu.sp;
-   return cpu_bus_read(CPU_STACK_ADDRESS + cpu.sp);
+   ++cpu->sp;
+   return cpu_bus_read(CPU_STACK_ADDRESS + cpu->sp);
 }
 
 /**
@@ -2700,23 +2542,27 @@ static uint8_t stack_pop(void)
 void cpu_emulate_instruction(void)
 {  
    if (emu_state->is_cpu_intr_log) 
-		log_cpu_state("A:%02X X:%02X Y:%02X SP:%02X P:%02X", cpu.ac, cpu.X, cpu.Y, cpu.sp, cpu.status_flags);
+		log_cpu_state("A:%02X X:%02X Y:%02X SP:%02X P:%02X", cpu->ac, cpu->X, cpu->Y, cpu->sp, cpu->status_flags);
 
    uint8_t opcode = cpu_fetch();
-   cpu_decode(opcode);
-   cpu_execute();
+   cpu_execute(opcode);
 
    controller_reload_shift_registers(); // check if controller shifts registers need to be reloaded
 
    if (emu_state->is_cpu_intr_log) 
 		disassemble();
 
-   if (cpu.nmi_flip_flop)
+   if (cpu->cycle_count >= cpu->next_event_cycle)
    {
-      cpu.nmi_flip_flop = false;
+      cpu_run_events(); // make sure nmi and irq lines are current
+   }
+
+   if (cpu->nmi_flip_flop)
+   {
+      cpu->nmi_flip_flop = false;
       cpu_NMI();
    }
-	else if (apu_is_triggering_irq() || cartridge_is_triggering_irq())
+	else if (cpu->irq_line)
 	{
 		cpu_IRQ();
 	}
@@ -2730,37 +2576,123 @@ void cpu_run_for_one_sample(void)
 	while (time <= (1 / 44100.0f))
 	{
 		cpu_emulate_instruction();
-		time += cpu.cycle_count * (1 / 1789773.0f) - time;
+		time += cpu->cycle_count * (1 / 1789773.0f) - time;
 	}
 	time -= 1 / 44100.0f;
-	cpu.cycle_count = 0;
+	cpu_set_cycle_count(0);
 }
 
-void cpu_run_with_audio(float *delta_time)
+/**
+ * Run the cpu for one frame worth of clock cycles and hand the frame's audio to the apu.
+ * Cycles that overshoot the frame are carried over into the next one.
+*/
+void cpu_run_frame(void)
 {
-	float frame_rate = 60.0988f;// 29829 29780
-	while (*delta_time >= (1.0f / frame_rate))
+	while (cpu->cycle_count <= CPU_CYCLES_PER_FRAME)
 	{
-		if (apu_get_queued_audio() < (735 * 16))
-		{
-			while (cpu.cycle_count <= 29780)
-			{
-				cpu_emulate_instruction();
-			}
-			apu_queue_audio_frame(29780);
-			cpu.cycle_count -= 29780;
-		}
-
-		if (get_emulator_state()->reset_delta_timers)
-		{
-			*delta_time = 0;
-			get_emulator_state()->reset_delta_timers = false;
-		}
-		else
-		{
-			*delta_time -= 1.0f / frame_rate;
-		}
+		cpu_emulate_instruction();
 	}
+	apu_queue_audio_frame(CPU_CYCLES_PER_FRAME);
+	cpu_set_cycle_count(cpu->cycle_count - CPU_CYCLES_PER_FRAME); // also brings the ppu up to the end of the frame
+}
+
+/**
+ * Tops the audio queue up to the target latency, one frame at a time. The audio device drains the
+ * queue at its own rate so its clock is what paces emulation. Every frame goes through the movie
+ * recorder/player and is recorded for rewinding, and with run ahead on the frames shown are run
+ * ahead of these instead.
+*/
+void cpu_run_with_audio(void)
+{
+	bool is_frame_run = false;
+	ppu_set_frame_output(run_ahead_frames == 0);
+
+	while (apu_get_queued_audio() < apu_get_audio_latency_samples())
+	{
+		movie_begin_frame();
+
+		double start = cpu_clock_us();
+		cpu_run_frame();
+		cpu_update_average(&frame_cost_us, cpu_clock_us() - start);
+
+		movie_end_frame();
+		rewind_record();
+		is_frame_run = true;
+	}
+
+	if (is_frame_run && run_ahead_frames != 0)
+	{
+		cpu_run_ahead();
+	}
+	ppu_set_frame_output(true);
+}
+
+void cpu_set_run_ahead(uint32_t frames)
+{
+	run_ahead_frames = (frames > CPU_MAX_RUN_AHEAD_FRAMES) ? CPU_MAX_RUN_AHEAD_FRAMES : frames;
+}
+
+uint32_t cpu_get_run_ahead(void)
+{
+	return run_ahead_frames;
+}
+
+uint32_t cpu_get_run_ahead_capacity(void)
+{
+	if (frame_cost_us == 0.0)
+	{
+		return 0;
+	}
+
+	// every host frame runs the real frame, the frames ahead and a save + load, leave a fifth of
+	// the frame spare for the gui taking the core lock and scheduling jitter
+	double frames = (CPU_FRAME_MICROSECONDS * 0.8 - state_cost_us) / frame_cost_us - 1.0;
+	return (frames < 1.0) ? 0 : (uint32_t) frames;
+}
+
+/**
+ * Saves the real timeline, runs run_ahead_frames frames past it with the buttons currently held and
+ * the apu muted, shows the last of them and then restores the real timeline. Audio only ever comes
+ * from the real timeline.
+*/
+static void cpu_run_ahead(void)
+{
+	double start = cpu_clock_us();
+	if (!state_save(&run_ahead_state))
+	{
+		display_update_color_buffer(); // fall back to showing the real frame
+		return;
+	}
+	double saved = cpu_clock_us();
+
+	apu_mute(true);
+	for (uint32_t frame = 0; frame < run_ahead_frames; ++frame)
+	{
+		ppu_set_frame_output(frame == run_ahead_frames - 1);
+		cpu_run_frame();
+	}
+	apu_mute(false);
+	double ran = cpu_clock_us();
+
+	state_load(&run_ahead_state);
+
+	cpu_update_average(&state_cost_us, (saved - start) + (cpu_clock_us() - ran));
+	cpu_update_average(&frame_cost_us, (ran - saved) / run_ahead_frames);
+}
+
+/**
+ * @returns wall clock time in microseconds, only meaningful as a difference
+*/
+static double cpu_clock_us(void)
+{
+	struct timespec time;
+	timespec_get(&time, TIME_UTC);
+	return (double) time.tv_sec * 1000000.0 + (double) time.tv_nsec / 1000.0;
+}
+
+static void cpu_update_average(double* average, double sample)
+{
+	*average = (*average == 0.0) ? sample : *average * 0.9 + sample * 0.1;
 }
 
 /**
@@ -2781,27 +2713,22 @@ void cpu_run_without_audio(float* delta_time)
          *delta_time -= 1.0f / 60.0988f;
       }
 
-      while ( cpu.cycle_count < 29780 )
+      while ( cpu->cycle_count < 29780 )
       {
          cpu_emulate_instruction();
       }
-      cpu.cycle_count = 0;
+      cpu_set_cycle_count(0);
    }
 }
 
 /**
- * Ticks cpu by 1 clock cycle and runs ppu for 3 cycles
+ * Ticks cpu by 1 clock cycle. The ppu's 3 cycles per cpu cycle and the apu's cycle are run later in bulk
+ * by ppu_catch_up and apu_catch_up whenever something can observe them.
 */
 void cpu_tick(void)
 {
-	apu_tick(cpu.cycle_count);
-
-   ppu_cycle(&cpu.nmi_flip_flop);
-   ppu_cycle(&cpu.nmi_flip_flop);
-   ppu_cycle(&cpu.nmi_flip_flop);
-
-   cpu.cycle_count += 1;
-	cpu.get_put_cycle = !cpu.get_put_cycle;
+   cpu->cycle_count += 1;
+	cpu->get_put_cycle = !cpu->get_put_cycle;
 }
 
 void cpu_read_tick(void)
@@ -2814,7 +2741,7 @@ void cpu_read_tick(void)
 
 		// optional alignment cycle if currently on a put cycle
 		// dma begins with a read which can only happen on get cycles
-		if (cpu.get_put_cycle == false)
+		if (cpu->get_put_cycle == false)
 			cpu_tick();
 
 		// perform dma
@@ -2834,12 +2761,12 @@ void cpu_write_tick(void)
 */
 void cpu_reset(void)
 {
-   cpu.cycle_count = 0;
-   cpu.sp = 0xFD;
-   cpu.status_flags = cpu.status_flags | 0x4;
+   cpu_set_cycle_count(0);
+   cpu->sp = 0xFD;
+   cpu->status_flags = cpu->status_flags | 0x4;
    uint8_t lo = cpu_bus_read(RESET_VECTOR);
    uint8_t hi =  cpu_bus_read(RESET_VECTOR + 1);
-   cpu.pc = (hi << 8) | lo;
+   cpu->pc = (hi << 8) | lo;
 	
    if (emu_state->is_cpu_intr_log) 
 		update_disassembly(MAX_NEXT + 1);
@@ -2852,81 +2779,98 @@ void cpu_reset(void)
 */
 void cpu_init(void)
 {  
-   emu_state = get_emulator_state();
-
-   cpu.cycle_count = 0;
-   cpu.nmi_flip_flop = false;
-   cpu.ac = 0;
-   cpu.X = 0;
-   cpu.Y = 0;
-   cpu.sp = 0xFD;
-   cpu.status_flags = 0x04;
+   cpu_attach_emulator_state();
+
+   cpu_set_cycle_count(0);
+   cpu->nmi_flip_flop = false;
+   cpu->get_put_cycle = false;
+   cpu->ac = 0;
+   cpu->X = 0;
+   cpu->Y = 0;
+   cpu->sp = 0xFD;
+   cpu->status_flags = 0x04;
    uint8_t lo = cpu_bus_read(RESET_VECTOR);
    uint8_t hi =  cpu_bus_read(RESET_VECTOR + 1);
-   cpu.pc = (hi << 8) | lo;
+   cpu->pc = (hi << 8) | lo;
 
    ppu_init();
 }
 
 /**
- * This function checks if a opcode which uses a addressing mode
- * that contains page crossing is a write or read instruction.
- * This is to handle edge cases where write instructions do not take an
- * extra cycle as the extra cycle is already included in the base cycle count.
- * @param opcode the opcode to check
- * @returns true if opcode is a write instruction, else return false.
+ * Changes the cpu cycle counter, the ppu and apu are caught up to the old count first
+ * and then rebased onto the new one.
+ * @param cycle_count new cycle count
 */
-static bool check_opcode_access_mode(uint8_t opcode)
+static void cpu_set_cycle_count(long cycle_count)
 {
-   bool is_a_write_instruction;
+   ppu_catch_up();
+   apu_catch_up();
 
-   switch (opcode)
+   long shift = cpu->cycle_count - cycle_count;
+   for (int i = 0; i < CPU_EVENT_COUNT; ++i)
+   {
+      if (cpu->event_cycles[i] != LONG_MAX)
+         cpu->event_cycles[i] -= shift;
+   }
+   if (cpu->next_event_cycle != LONG_MAX)
+      cpu->next_event_cycle -= shift;
+
+   cpu->cycle_count = cycle_count;
+   ppu_rebase_cpu_cycle(cycle_count);
+   apu_rebase_cpu_cycle(cycle_count);
+}
+
+/**
+ * Catches up the devices whose events are due. Each one schedules its next event as it runs.
+*/
+static void cpu_run_events(void)
+{
+   bool ppu_due = cpu->cycle_count >= cpu->event_cycles[CPU_EVENT_PPU_NMI] || cpu->cycle_count >= cpu->event_cycles[CPU_EVENT_MAPPER_IRQ];
+   bool apu_due = cpu->cycle_count >= cpu->event_cycles[CPU_EVENT_APU_IRQ];
+
+   if (ppu_due)
+   {
+      cpu_schedule_event(CPU_EVENT_MAPPER_IRQ, LONG_MAX);
+      ppu_catch_up();
+   }
+
+   if (apu_due)
+   {
+      cpu_schedule_event(CPU_EVENT_APU_IRQ, LONG_MAX);
+      apu_catch_up();
+   }
+}
+
+void cpu_schedule_event(Cpu_Event_t event, long cycle)
+{
+   cpu->event_cycles[event] = cycle;
+
+   cpu->next_event_cycle = cpu->event_cycles[0];
+   for (int i = 1; i < CPU_EVENT_COUNT; ++i)
    {
-      // X-indexed absolute
-      case 0x1E: // ASL
-      case 0xDF: // DCP
-      case 0xDE: // DEC
-      case 0xFE: // INC
-      case 0xFF: // ISC
-      case 0x5E: // LSR
-      case 0x3F: // RLA
-      case 0x3E: // ROL
-      case 0x7E: // ROR
-      case 0x7F: // RRA
-      case 0x9C: // SHY
-      case 0x1F: // SLO
-      case 0x5F: // SRE
-      case 0x9D: // STA
-
-      // Y-indexed absolute
-      case 0xDB: // DCP
-      case 0xFB: // ISC
-      case 0x3B: // RLA
-      case 0x7B: // RRA
-      case 0x9F: // SHA
-      case 0x9B: // SHS
-      case 0x9E: // SHX
-      case 0x1B: // SLO
-      case 0x5B: // SRE
-      case 0x99: // STA
-
-      // Zero page indirect Y-indexed
-      case 0xD3: // DCP
-      case 0xF3: // ISC
-      case 0x33: // RLA
-      case 0x73: // RRA
-      case 0x93: // SHA
-      case 0x13: // SLO
-      case 0x53: // SRE
-      case 0x91: // STA
-         is_a_write_instruction = true;
-         break;
-
-      default:
-         is_a_write_instruction = false;
-   }
-
-   return is_a_write_instruction;
+      if (cpu->event_cycles[i] < cpu->next_event_cycle)
+         cpu->next_event_cycle = cpu->event_cycles[i];
+   }
+}
+
+void cpu_save_state(State_Buffer_t* buffer)
+{
+   state_write(buffer, cpu, sizeof(*cpu));
+}
+
+void cpu_load_state(State_Buffer_t* buffer)
+{
+   state_read(buffer, cpu, sizeof(*cpu));
+}
+
+void cpu_irq_assert(Cpu_Irq_Source_t source)
+{
+   cpu->irq_line |= (uint8_t) source;
+}
+
+void cpu_irq_release(Cpu_Irq_Source_t source)
+{
+   cpu->irq_line &= (uint8_t) ~source;
 }
 
 /**
@@ -2934,7 +2878,46 @@ static bool check_opcode_access_mode(uint8_t opcode)
 */
 cpu_6502_t* get_cpu(void)
 {
-   return &cpu;
+   return cpu;
+}
+
+cpu_6502_t* cpu_context_create(void)
+{
+   cpu_attach_emulator_state();
+
+   cpu_6502_t* context = calloc(1, sizeof(cpu_6502_t));
+   if (context != NULL)
+   {
+      for (int i = 0; i < CPU_EVENT_COUNT; ++i)
+      {
+         context->event_cycles[i] = LONG_MAX;
+      }
+   }
+
+   return context;
+}
+
+void cpu_context_destroy(cpu_6502_t* context)
+{
+   free(context);
+}
+
+void cpu_bind(cpu_6502_t* context)
+{
+   cpu = (context != NULL) ? context : &default_context;
+}
+
+/**
+ * Points emu_state at the gui's emulator state, which every instance shares. It is only written the
+ * first time so instances powering on from other threads never store to it while it is being read.
+*/
+static void cpu_attach_emulator_state(void)
+{
+   Emulator_State_t* state = get_emulator_state();
+   if (emu_state != state)
+   {
+      emu_state = state;
+   }
 }
 
 /**
@@ -2954,6 +2937,6 @@ const instruction_t* get_instruction_lookup_entry(uint8_t position)
 void update_disassembly(uint8_t next)
 {
    log_rewind(next);
-   disassemble_set_position(cpu.pc);
+   disassemble_set_position(cpu->pc);
    disassemble_next_x(next);
 }
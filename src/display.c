@@ -10,6 +10,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "bus.h"
 #include "display.h"
@@ -19,24 +20,27 @@
 #include "ppu.h"
 #include "cartridge.h"
 #include "apu.h"
+#include "audio_device.h"
+#include "emu_thread.h"
+#include "savestate.h"
+#include "rewind.h"
+#include "movie.h"
+#include "battery_save.h"
 
 #define NES_PIXELS_W 256
 #define NES_PIXELS_H (240 - 16) // the nes displays 240 vertical scanlines but when rendered to a tv the top and bottom 8 scanlines are cut off, hence the minus 16
+#define NES_PIXELS_TOP 8        // first scanline of the ppu frame that is displayed
+
+#define PALETTE_EMPHASIS_ATTENUATION 0.816328f // how much the color channels that are not emphasized get dimmed by
 
 /**
- * row 0: top left
- * row 1: bottom left
- * row 2: bottom right
- * row 3: top right
+ * Quad covering the whole gl viewport, x y position followed by u v texture coordinate.
+ * v runs top to bottom so row 0 of a frame lands at the top of the framebuffer.
 */
-#define PIXEL_VERTICES_INIT(pixel_w, pixel_h) {0.0f,    0.0f,    0.0f,  \
-                                               0.0f,    pixel_h, 0.0f,  \
-                                               pixel_w, pixel_h, 0.0f,  \
-                                               pixel_w, 0.0f,    0.0f}; \
-
-// indices of index buffer object for pixel vertices
-#define PIXEL_INDICES_INIT {0, 1, 2,  \
-                            2, 3, 0}; \
+#define SCREEN_QUAD_VERTICES_INIT {-1.0f,  1.0f,  0.0f, 0.0f,  \
+                                   -1.0f, -1.0f,  0.0f, 1.0f,  \
+                                    1.0f,  1.0f,  1.0f, 0.0f,  \
+                                    1.0f, -1.0f,  1.0f, 1.0f}; \
 
 static SDL_Window* window = NULL;
 static SDL_GLContext gContext = NULL;
@@ -62,33 +66,48 @@ struct Viewport_buffers {
    GLuint FBO;
    GLuint textureID;
    GLuint RBO;
-   GLuint VAO;
-   GLuint color_VBO;
-   GLuint translation_VBO;
-   GLuint vertex_VBO;
+   GLuint index_texture;    // system palette index of every pixel in the ppu frame
+   GLuint emphasis_texture; // emphasis bits of every scanline in the ppu frame
 };
 
 /**
  * Two pattern table that are rendered to their own framebuffers and textures,
- * but they share some of the same VBOs (for vertex data and) and IBOs.
+ * both drawn with the screen quad.
 */
 struct Pattern_tables_buffers {
    GLuint FBO[2];
    GLuint textureID[2];
    GLuint RBO[2];
-   GLuint VAO[2];
-   GLuint color_VBO[2];
-   GLuint vertex_VBO;
-   GLuint vertex_IBO;
-   GLuint translation_VBO;
+   GLuint index_texture[2];
 };
 
 static struct Viewport_buffers viewport;
 static struct Pattern_tables_buffers pattern_tables;
+static GLuint palette_texture = 0; // 64 system colors by 8 emphasis combinations that pixel indices are resolved through
+static GLuint screen_quad_VAO = 0;
+static GLuint screen_quad_VBO = 0;
+
+static uint8_t* pattern_table_0_pixel_indices = NULL;
+static uint8_t* pattern_table_1_pixel_indices = NULL;
+
+/**
+ * Triple buffer that hands finished frames from the emulation thread to the gui thread without locking.
+ * Each side owns one slot, the third is swapped in and out of ready_frame. FRAME_FRESH is set when
+ * the emulation thread publishes a frame the gui thread has not taken yet.
+*/
+typedef struct Display_Frame_t
+{
+   uint8_t pixels[PPU_FRAME_H * PPU_FRAME_W];
+   uint8_t emphasis[PPU_FRAME_H];
+} Display_Frame_t;
 
-static vec4 viewport_pixel_colors[NES_PIXELS_H * NES_PIXELS_W];
-static vec4* pattern_table_0_pixel_colors = NULL;
-static vec4* pattern_table_1_pixel_colors = NULL;
+#define FRAME_INDEX_MASK 0x3
+#define FRAME_FRESH      0x4
+
+static Display_Frame_t frames[3];
+static SDL_atomic_t ready_frame = {2};
+static int write_frame = 0; // owned by the emulation thread
+static int read_frame = 1;  // owned by the gui thread
 
 static void display_add_shader(GLuint program, const GLchar* shader_code, GLenum type);
 static bool display_init_main_viewport_buffers(void);
@@ -97,10 +116,14 @@ static void display_free_pattern_table_buffers(void);
 static void display_update_pattern_table_color_buffers(void);
 static bool display_create_shaders(void);
 static bool display_create_frameBuffers(GLuint *FBO_ID, GLuint *textureID, GLuint *RBO_ID, int width, int height);
+static void display_create_index_texture(GLuint *textureID, int width, int height);
+static void display_draw_indexed_frame(GLuint FBO, GLuint index_texture, int row_offset, int row_count, bool use_emphasis);
 static void display_resize_texture(int width, int height, GLuint textureID, GLuint RBO_ID);
-static void display_set_pixel_position(float pixel_w, float pixel_h, mat4 pixel_pos[], uint32_t width, uint32_t height);
 static void display_resize(DISPLAY_SIZE_CONFIG_t display_size);
 static void display_clear(void);
+static void display_upload_frame(void);
+static void display_set_run_state(Emulator_Run_State_t run_state);
+static void display_start_movie(bool is_recording);
 
 // global state of emulator
 static Emulator_State_t emulator_state = 
@@ -114,6 +137,8 @@ static Emulator_State_t emulator_state =
    .is_instruction_step   = false,
 };
 
+static State_Buffer_t quick_state; // single in memory slot for the quick save/load menu items
+
 static DISPLAY_SIZE_CONFIG_t pattern_tables_viewport_scale = DISPLAY_3X; // have the pattern table viewer be set to whatever the initial display size is
 
 /**
@@ -240,6 +265,7 @@ void display_shutdown(void)
    ImGui_ImplOpenGL3_Shutdown();
    ImGui_ImplSDL2_Shutdown();
    igDestroyContext(NULL);
+   state_buffer_free(&quick_state);
 
    SDL_GL_DeleteContext(gContext);
    SDL_DestroyWindow(window);
@@ -270,7 +296,7 @@ void display_process_event(bool* done)
       {
          if (event.syswm.msg->msg.win.msg == WM_MOVE)
          {
-            emulator_state.reset_delta_timers = true;
+            emu_thread_send(EMU_COMMAND_RESET_TIMERS, 0);
          }
       }
 #endif
@@ -284,7 +310,7 @@ void display_process_event(bool* done)
             {
                if ( emulator_state.run_state == EMULATOR_PAUSED )
                {
-                  emulator_state.is_instruction_step = true;
+                  emu_thread_send(EMU_COMMAND_STEP, 0);
                }
                break;
             }
@@ -293,12 +319,12 @@ void display_process_event(bool* done)
             {
                if ( (emulator_state.run_state & 0x1) == EMULATOR_RUNNING )
                {
-                  emulator_state.run_state &= ~EMULATOR_RUNNING; // pause emulator
+                  display_set_run_state(emulator_state.run_state & ~EMULATOR_RUNNING); // pause emulator
 						apu_pause(true);
                }
                else
                {
-                  emulator_state.run_state |= EMULATOR_RUNNING; // unpause emulator
+                  display_set_run_state(emulator_state.run_state | EMULATOR_RUNNING); // unpause emulator
 						if (!(emulator_state.run_state & EMULATOR_UNLOADED))
 						{
 							apu_pause(false);
@@ -312,44 +338,49 @@ void display_process_event(bool* done)
 
             case SDL_SCANCODE_W: // up
             {
-               controller1_set_button_up(BUTTON_UP);
+               emu_thread_send(EMU_COMMAND_BUTTON_UP, BUTTON_UP);
                break;
             }
             case SDL_SCANCODE_A: // left
             {
-               controller1_set_button_up(BUTTON_LEFT);
+               emu_thread_send(EMU_COMMAND_BUTTON_UP, BUTTON_LEFT);
                break;
             }
             case SDL_SCANCODE_S: // down
             {
-               controller1_set_button_up(BUTTON_DOWN);
+               emu_thread_send(EMU_COMMAND_BUTTON_UP, BUTTON_DOWN);
                break;
             }
             case SDL_SCANCODE_D: // right
             {
-               controller1_set_button_up(BUTTON_RIGHT);
+               emu_thread_send(EMU_COMMAND_BUTTON_UP, BUTTON_RIGHT);
                break;
             }
             case SDL_SCANCODE_Q: // start
             {
-               controller1_set_button_up(BUTTON_START);
+               emu_thread_send(EMU_COMMAND_BUTTON_UP, BUTTON_START);
                break;
             }
             case SDL_SCANCODE_E: // select
             {
-               controller1_set_button_up(BUTTON_SELECT);
+               emu_thread_send(EMU_COMMAND_BUTTON_UP, BUTTON_SELECT);
                break;
             }
             case SDL_SCANCODE_K: // B button
             {
-               controller1_set_button_up(BUTTON_B);
+               emu_thread_send(EMU_COMMAND_BUTTON_UP, BUTTON_B);
                break;
             }
             case SDL_SCANCODE_L: // A button
             {
-               controller1_set_button_up(BUTTON_A);
+               emu_thread_send(EMU_COMMAND_BUTTON_UP, BUTTON_A);
                break;
             } 
+            case SDL_SCANCODE_R: // stop rewinding
+            {
+               emu_thread_send(EMU_COMMAND_REWIND, 0);
+               break;
+            }
 
             default:
                break;
@@ -363,42 +394,50 @@ void display_process_event(bool* done)
 
             case SDL_SCANCODE_W: // up
             {
-               controller1_set_button_down(BUTTON_UP);
+               emu_thread_send(EMU_COMMAND_BUTTON_DOWN, BUTTON_UP);
                break;
             }
             case SDL_SCANCODE_A: // left
             {
-               controller1_set_button_down(BUTTON_LEFT);
+               emu_thread_send(EMU_COMMAND_BUTTON_DOWN, BUTTON_LEFT);
                break;
             }
             case SDL_SCANCODE_S: // down
             {
-               controller1_set_button_down(BUTTON_DOWN);
+               emu_thread_send(EMU_COMMAND_BUTTON_DOWN, BUTTON_DOWN);
                break;
             }
             case SDL_SCANCODE_D: // right
             {
-               controller1_set_button_down(BUTTON_RIGHT);
+               emu_thread_send(EMU_COMMAND_BUTTON_DOWN, BUTTON_RIGHT);
                break;
             }
             case SDL_SCANCODE_Q: // start
             {
-               controller1_set_button_down(BUTTON_START);
+               emu_thread_send(EMU_COMMAND_BUTTON_DOWN, BUTTON_START);
                break;
             }
             case SDL_SCANCODE_E: // select
             {
-               controller1_set_button_down(BUTTON_SELECT);
+               emu_thread_send(EMU_COMMAND_BUTTON_DOWN, BUTTON_SELECT);
                break;
             }
             case SDL_SCANCODE_K: // B button
             {
-               controller1_set_button_down(BUTTON_B);
+               emu_thread_send(EMU_COMMAND_BUTTON_DOWN, BUTTON_B);
                break;
             }
             case SDL_SCANCODE_L: // A button
             {
-               controller1_set_button_down(BUTTON_A);
+               emu_thread_send(EMU_COMMAND_BUTTON_DOWN, BUTTON_A);
+               break;
+            }
+            case SDL_SCANCODE_R: // rewind while held
+            {
+               if (!event.key.repeat)
+               {
+                  emu_thread_send(EMU_COMMAND_REWIND, 1);
+               }
                break;
             }
             default:
@@ -421,31 +460,27 @@ void display_render(void)
    igNewFrame();
 
    if (emulator_state.is_cpu_debug) 
+   {
+      emu_thread_lock();
 		gui_cpu_debug();
+      emu_thread_unlock();
+   }
    //gui_demo();
 
-	//display_update_color_buffer();
+   display_upload_frame();
    gui_main_viewport();
 
-   glBindFramebuffer(GL_FRAMEBUFFER, viewport.FBO);
-   glBindVertexArray(viewport.VAO);
-   glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, 0, NES_PIXELS_W * NES_PIXELS_H);
-   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+   display_draw_indexed_frame(viewport.FBO, viewport.index_texture, NES_PIXELS_TOP, NES_PIXELS_H, true);
 
    if (emulator_state.is_pattern_table_open) 
    {
+      emu_thread_lock();
       display_update_pattern_table_color_buffers();
+      emu_thread_unlock();
       gui_pattern_table_viewer();
 
-      glBindFramebuffer(GL_FRAMEBUFFER, pattern_tables.FBO[0]);
-      glBindVertexArray(pattern_tables.VAO[0]);
-      glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, 0, 128 * 128);
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-      glBindFramebuffer(GL_FRAMEBUFFER, pattern_tables.FBO[1]);
-      glBindVertexArray(pattern_tables.VAO[1]);
-      glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, 0, 128 * 128);
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      display_draw_indexed_frame(pattern_tables.FBO[0], pattern_tables.index_texture[0], 0, 128, false);
+      display_draw_indexed_frame(pattern_tables.FBO[1], pattern_tables.index_texture[1], 0, 128, false);
    }
 }
 
@@ -537,8 +572,9 @@ static void gui_main_viewport(void)
          {
             if ( igMenuItem_Bool("Load Rom...", NULL, false, true) )
             {
+               emu_thread_lock(); // emulation stays stopped while the dialog is open and the new rom is loaded
 					apu_pause(true); // pause emulation when loading new file
-               emulator_state.reset_delta_timers = true; // opening file dialogue will block program execution so we need to reset delta timers to zero when execution resumes
+               emu_thread_send(EMU_COMMAND_RESET_TIMERS, 0); // opening file dialogue will block program execution so we need to reset delta timers to zero when execution resumes
 
                if (emulator_state.display_scale_factor == DISPLAY_BORDERLESS_FULLSCREEN)
                {
@@ -552,7 +588,10 @@ static void gui_main_viewport(void)
                // attempt to load rom file
                if (result == NFD_OKAY)
                {
+                  movie_stop();
                   cartridge_free_memory();
+                  quick_state.size = 0; // a quick save only belongs to the rom it was made with
+                  rewind_clear();
                   if (cartridge_load(rom_path))
                   {
                      emulator_state.is_cpu_intr_log = false;
@@ -560,7 +599,7 @@ static void gui_main_viewport(void)
                      cpu_init();
 							apu_reset_internals();
                      log_free();
-                     emulator_state.run_state &= ~EMULATOR_UNLOADED; // no longer waiting for rom file to be loaded
+                     display_set_run_state(emulator_state.run_state & ~EMULATOR_UNLOADED); // no longer waiting for rom file to be loaded
 							if (emulator_state.run_state == EMULATOR_RUNNING)
 							{
 								apu_pause(false);
@@ -570,7 +609,7 @@ static void gui_main_viewport(void)
                   else
                   {
                      rom_load_failed = true;
-                     emulator_state.run_state |= EMULATOR_UNLOADED; // fail to load rom so we continue waiting for user to load rom
+                     display_set_run_state(emulator_state.run_state | EMULATOR_UNLOADED); // fail to load rom so we continue waiting for user to load rom
                      if (emulator_state.is_pattern_table_open) // close pattern table viewer when loading new rom fails
                      {
                         emulator_state.is_pattern_table_open = false;
@@ -600,9 +639,52 @@ static void gui_main_viewport(void)
                   SDL_RestoreWindow(window);
                }
 
+               emu_thread_unlock();
+
                
             }
 
+            bool is_rom_loaded = !(emulator_state.run_state & EMULATOR_UNLOADED);
+            if ( igMenuItem_Bool("Quick Save", NULL, false, is_rom_loaded) )
+            {
+               emu_thread_lock();
+               state_save(&quick_state);
+               emu_thread_unlock();
+            }
+
+            if ( igMenuItem_Bool("Quick Load", NULL, false, is_rom_loaded && quick_state.size != 0) )
+            {
+               emu_thread_lock();
+               movie_stop(); // a movie cannot follow a jump to another point in time
+               if (state_load(&quick_state))
+               {
+                  apu_clear_queued_audio();
+                  display_update_color_buffer(); // show the restored frame even while paused
+               }
+               emu_thread_unlock();
+            }
+
+            igSeparator();
+
+            if ( igMenuItem_Bool("Record Movie...", NULL, false, is_rom_loaded) )
+            {
+               display_start_movie(true);
+            }
+
+            if ( igMenuItem_Bool("Play Movie...", NULL, false, is_rom_loaded) )
+            {
+               display_start_movie(false);
+            }
+
+            if ( igMenuItem_Bool("Stop Movie", NULL, false, movie_get_mode() != MOVIE_OFF) )
+            {
+               emu_thread_lock();
+               movie_stop();
+               emu_thread_unlock();
+            }
+
+            igSeparator();
+
             if ( igMenuItem_Bool("Exit", "", false, true) )
             {
                SDL_Event event;
@@ -669,6 +751,72 @@ static void gui_main_viewport(void)
             }
             igEndMenu();
          }
+
+         if (igBeginMenu("Audio", true))
+         {
+            // the queue is topped up to this many frames of audio, lower is more responsive but underruns sooner
+            for (uint32_t frames = 1; frames <= APU_MAX_LATENCY_FRAMES; ++frames)
+            {
+               char label[32];
+               snprintf(label, sizeof(label), "%u frame latency", (unsigned) frames);
+               if ( igMenuItem_Bool(label, "", apu_get_audio_latency() == frames, true) )
+               {
+                  apu_set_audio_latency(frames);
+               }
+            }
+
+            igSeparator();
+            igText("Queued %u / %u samples", (unsigned) apu_get_queued_audio(), (unsigned) apu_get_audio_latency_samples());
+            igText("Underruns %u", (unsigned) audio_device_get_underruns());
+            igEndMenu();
+         }
+
+         if (igBeginMenu("Run Ahead", true))
+         {
+            emu_thread_lock();
+            uint32_t run_ahead = cpu_get_run_ahead();
+            uint32_t capacity = cpu_get_run_ahead_capacity();
+            emu_thread_unlock();
+
+            // runs this many frames past the real one each frame and shows the last, hiding the games' own input lag
+            for (uint32_t frames = 0; frames <= CPU_MAX_RUN_AHEAD_FRAMES; ++frames)
+            {
+               char label[32];
+               if (frames == 0) snprintf(label, sizeof(label), "Off");
+               else snprintf(label, sizeof(label), "%u frame%s", (unsigned) frames, (frames == 1) ? "" : "s");
+
+               if ( igMenuItem_Bool(label, "", run_ahead == frames, true) )
+               {
+                  emu_thread_send(EMU_COMMAND_RUN_AHEAD, (uint8_t) frames);
+               }
+            }
+
+            igSeparator();
+            igText("Host can sustain %u frame%s", (unsigned) capacity, (capacity == 1) ? "" : "s");
+            igEndMenu();
+         }
+
+         if (igBeginMenu("Battery Save", true))
+         {
+            emu_thread_lock();
+            uint32_t interval = battery_save_get_interval();
+            emu_thread_unlock();
+
+            // how often battery ram the game changed is written to its .sav, bounding what a crash can lose
+            static const uint8_t intervals[] = { 0, 1, 5, 15, 30, BATTERY_SAVE_MAX_INTERVAL };
+            for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); ++i)
+            {
+               char label[32];
+               if (intervals[i] == 0) snprintf(label, sizeof(label), "Only On Exit");
+               else snprintf(label, sizeof(label), "Every %u second%s", (unsigned) intervals[i], (intervals[i] == 1) ? "" : "s");
+
+               if ( igMenuItem_Bool(label, "", interval == intervals[i], true) )
+               {
+                  emu_thread_send(EMU_COMMAND_SAVE_INTERVAL, intervals[i]);
+               }
+            }
+            igEndMenu();
+         }
       
          igEndMenuBar();
       }
@@ -862,7 +1010,7 @@ static void gui_cpu_debug(void)
             igPushStyleColor_Vec4(ImGuiCol_Button, red);
             if ( igButton("Pause", zero_vec) )
             {
-               emulator_state.run_state |= EMULATOR_RUNNING;
+               display_set_run_state(emulator_state.run_state | EMULATOR_RUNNING);
 					if (!(emulator_state.run_state & EMULATOR_UNLOADED))
 					{
 						apu_pause(false);
@@ -874,7 +1022,7 @@ static void gui_cpu_debug(void)
          {
             if ( igButton("Pause", zero_vec) )
             {
-               emulator_state.run_state &= ~EMULATOR_RUNNING;
+               display_set_run_state(emulator_state.run_state & ~EMULATOR_RUNNING);
 					apu_pause(true);
             }
          }
@@ -883,7 +1031,7 @@ static void gui_cpu_debug(void)
          igBeginDisabled( (emulator_state.run_state & (EMULATOR_RUNNING | EMULATOR_UNLOADED) ));
             if ( igButton("Intruction Step", zero_vec) )
             {
-               emulator_state.is_instruction_step = true;
+               emu_thread_send(EMU_COMMAND_STEP, 0);
             }
          igEndDisabled();
          gui_help_marker("Step through a single instruction while the emulator is paused. Has no effect when emulator is not paused.");
@@ -1012,66 +1160,37 @@ static bool display_init_main_viewport_buffers(void)
    int width, height;
    SDL_GetWindowSize(window, &width, &height);
 
-   mat4* pixel_pos = malloc(NES_PIXELS_W * NES_PIXELS_W * sizeof(mat4));
-   if (pixel_pos == NULL) printf("Failed to allocate memory for main viewport pixel pos\n");
-
-   float pixel_w = (float) width / NES_PIXELS_W;
-   float pixel_h = (float) height / NES_PIXELS_H;
-   display_set_pixel_position(pixel_w, pixel_h, pixel_pos, NES_PIXELS_W, NES_PIXELS_H);
-
-   float pixel_vertices[] = PIXEL_VERTICES_INIT(pixel_w, pixel_h);
+   float quad_vertices[] = SCREEN_QUAD_VERTICES_INIT;
 
-   GLubyte indices[] = PIXEL_INDICES_INIT;
+   // a single quad is shared by the main viewport and the pattern tables, each frame is one draw of 4 vertices
+   glGenVertexArrays(1, &screen_quad_VAO);
+   glGenBuffers(1, &screen_quad_VBO);
 
-   // send vertex data for pixels
-   GLuint vertex_IBO;
-   glGenVertexArrays(1, &viewport.VAO);
-   glGenBuffers(1, &viewport.vertex_VBO);
-   glGenBuffers(1, &vertex_IBO);
+   glBindVertexArray(screen_quad_VAO);
+   glBindBuffer(GL_ARRAY_BUFFER, screen_quad_VBO);
+   glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), quad_vertices, GL_STATIC_DRAW);
 
-   glBindVertexArray(viewport.VAO);
-   glBindBuffer(GL_ARRAY_BUFFER, viewport.vertex_VBO);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(pixel_vertices), pixel_vertices, GL_STATIC_DRAW);
-
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vertex_IBO);
-   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*) 0);
 	glEnableVertexAttribArray(0);
-
-   // send instanced transformation data for pixels
-   glGenBuffers(1, &viewport.translation_VBO);
-
-   glBindBuffer(GL_ARRAY_BUFFER, viewport.translation_VBO);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(mat4) * NES_PIXELS_W * NES_PIXELS_H, pixel_pos, GL_STATIC_DRAW);
-   free(pixel_pos);
-
-   glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*) 0);
-   glEnableVertexAttribArray(1);
-   glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*) ( 1 * sizeof(vec4) ));
-   glEnableVertexAttribArray(2);
-   glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*) ( 2 * sizeof(vec4) ));
-   glEnableVertexAttribArray(3);
-   glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*) ( 3 * sizeof(vec4) ));
-   glEnableVertexAttribArray(4);
-
-   glVertexAttribDivisor(1, 1);
-   glVertexAttribDivisor(2, 1);
-   glVertexAttribDivisor(3, 1);
-   glVertexAttribDivisor(4, 1);
-
-   // send instanced color data for pixels
-   glGenBuffers(1, &viewport.color_VBO);
-   glBindBuffer(GL_ARRAY_BUFFER, viewport.color_VBO);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(viewport_pixel_colors), viewport_pixel_colors, GL_DYNAMIC_DRAW);
-   glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(vec4), (void*) 0);
-   glEnableVertexAttribArray(5);
-   
-   glVertexAttribDivisor(5, 1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*) ( 2 * sizeof(float) ));
+	glEnableVertexAttribArray(1);
 
    glBindVertexArray(0);
    glBindBuffer(GL_ARRAY_BUFFER, 0);
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+   // the whole ppu frame is uploaded as palette indices, the shader skips the rows that are cut off
+   display_create_index_texture(&viewport.index_texture, PPU_FRAME_W, PPU_FRAME_H);
+   display_create_index_texture(&viewport.emphasis_texture, PPU_FRAME_H, 1);
+
+   glGenTextures(1, &palette_texture);
+   glBindTexture(GL_TEXTURE_2D, palette_texture);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, 64, 8, 0, GL_RGB, GL_FLOAT, NULL);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+   glBindTexture(GL_TEXTURE_2D, 0);
+
+   display_update_palette();
+   display_clear();
 
    if ( !display_create_frameBuffers(&viewport.FBO, &viewport.textureID, &viewport.RBO, width, height) ) return false;
 
@@ -1080,7 +1199,7 @@ static bool display_init_main_viewport_buffers(void)
 
 static bool display_init_pattern_table_buffers(void)
 {
-   if (pattern_table_0_pixel_colors != NULL || pattern_table_1_pixel_colors != NULL)
+   if (pattern_table_0_pixel_indices != NULL || pattern_table_1_pixel_indices != NULL)
    {
       printf("Must free pattern tables first before initializing!\n");
       return false;
@@ -1089,126 +1208,18 @@ static bool display_init_pattern_table_buffers(void)
    int width = NES_PIXELS_W * pattern_tables_viewport_scale;
    int height = NES_PIXELS_H * pattern_tables_viewport_scale;
 
-   mat4* pixel_pos = malloc(sizeof(mat4) * 128 * 128);
-
-   if (pixel_pos == NULL)
-   {
-      printf("Failed to allocate memory for pattern table pixel pos\n");
-      return false;
-   }
-
-   pattern_table_0_pixel_colors = malloc(sizeof(vec4) * 128 * 128);
-   pattern_table_1_pixel_colors = malloc(sizeof(vec4) * 128 * 128);
+   pattern_table_0_pixel_indices = malloc(sizeof(uint8_t) * 128 * 128);
+   pattern_table_1_pixel_indices = malloc(sizeof(uint8_t) * 128 * 128);
 
-   if (pattern_table_0_pixel_colors == NULL || pattern_table_1_pixel_colors == NULL)
+   if (pattern_table_0_pixel_indices == NULL || pattern_table_1_pixel_indices == NULL)
    {
-      printf("Failed to allocate memory for patten table pixel colors\n");
+      printf("Failed to allocate memory for patten table pixel indices\n");
       return false;
    }
 
-   DEBUG_ppu_update_pattern_tables(pattern_table_0_pixel_colors, pattern_table_1_pixel_colors);
-
-   float pixel_w = (width) / 128.0f;
-   float pixel_h = (height) / 128.0f;
-   display_set_pixel_position(pixel_w, pixel_h, pixel_pos, 128, 128);
-
-   float pixel_vertices[] = PIXEL_VERTICES_INIT(pixel_w, pixel_h);
-
-   GLubyte indices[] = PIXEL_INDICES_INIT;
-
-   // buffers used by both pattern tables
-
-   glGenBuffers(1, &pattern_tables.vertex_VBO);
-   glGenBuffers(1, &pattern_tables.vertex_IBO);
-   glGenBuffers(1, &pattern_tables.translation_VBO);
-
-   // setup buffers for pattern table 0
-
-   glGenVertexArrays(1, &pattern_tables.VAO[0]);
-   
-   glBindVertexArray(pattern_tables.VAO[0]);
-   glBindBuffer(GL_ARRAY_BUFFER, pattern_tables.vertex_VBO);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(pixel_vertices), pixel_vertices, GL_STATIC_DRAW);
-
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pattern_tables.vertex_IBO);
-   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-   glEnableVertexAttribArray(0);
-   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*) 0);
-
-   glBindBuffer(GL_ARRAY_BUFFER, pattern_tables.translation_VBO);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(mat4) * 128 * 128, pixel_pos, GL_STATIC_DRAW);
-
-   glEnableVertexAttribArray(1);
-   glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*) 0);
-   glVertexAttribDivisor(1, 1);
-   
-   glEnableVertexAttribArray(2);
-   glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*) ( 1 * sizeof(vec4) ));
-   glVertexAttribDivisor(2, 1);
-
-   glEnableVertexAttribArray(3);
-   glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*) ( 2 * sizeof(vec4) ));
-   glVertexAttribDivisor(3, 1);
-
-   glEnableVertexAttribArray(4);
-   glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*) ( 3 * sizeof(vec4) ));
-   glVertexAttribDivisor(4, 1);
-
-   glGenBuffers(1, &pattern_tables.color_VBO[0]);
-   glBindBuffer(GL_ARRAY_BUFFER, pattern_tables.color_VBO[0]);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(vec4) * 128 * 128, pattern_table_0_pixel_colors, GL_DYNAMIC_DRAW);
-   glEnableVertexAttribArray(5);
-   glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(vec4), (void*) 0);
-
-   glVertexAttribDivisor(5, 1);
-
-   glBindVertexArray(0);
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-   // setup buffers for pattern table 1
-
-   glGenVertexArrays(1, &pattern_tables.VAO[1]);
-
-   glBindVertexArray(pattern_tables.VAO[1]);
-   glBindBuffer(GL_ARRAY_BUFFER, pattern_tables.vertex_VBO);
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pattern_tables.vertex_IBO);
-
-   glEnableVertexAttribArray(0);
-   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*) 0);
-
-   glBindBuffer(GL_ARRAY_BUFFER, pattern_tables.translation_VBO);
-
-   glEnableVertexAttribArray(1);
-   glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*) 0);
-   glVertexAttribDivisor(1, 1);
-   
-   glEnableVertexAttribArray(2);
-   glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*) ( 1 * sizeof(vec4) ));
-   glVertexAttribDivisor(2, 1);
-   
-   glEnableVertexAttribArray(3);
-   glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*) ( 2 * sizeof(vec4) ));
-   glVertexAttribDivisor(3, 1);
-
-   glEnableVertexAttribArray(4);
-   glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*) ( 3 * sizeof(vec4) ));
-   glVertexAttribDivisor(4, 1);
-
-   glGenBuffers(1, &pattern_tables.color_VBO[1]);
-   glBindBuffer(GL_ARRAY_BUFFER, pattern_tables.color_VBO[1]);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(vec4) * 128 * 128, pattern_table_1_pixel_colors, GL_DYNAMIC_DRAW);
-   glEnableVertexAttribArray(5);
-   glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(vec4), (void*) 0);
-
-   glVertexAttribDivisor(5, 1);
-
-   glBindVertexArray(0);
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-   
-   free(pixel_pos);
+   display_create_index_texture(&pattern_tables.index_texture[0], 128, 128);
+   display_create_index_texture(&pattern_tables.index_texture[1], 128, 128);
+   display_update_pattern_table_color_buffers();
 
    if ( !display_create_frameBuffers(&pattern_tables.FBO[0], &pattern_tables.textureID[0], &pattern_tables.RBO[0], width, height) ) return false;
    if ( !display_create_frameBuffers(&pattern_tables.FBO[1], &pattern_tables.textureID[1], &pattern_tables.RBO[1], width, height) ) return false;
@@ -1218,34 +1229,26 @@ static bool display_init_pattern_table_buffers(void)
 
 static void display_update_pattern_table_color_buffers(void)
 {
-   DEBUG_ppu_update_pattern_tables(pattern_table_0_pixel_colors, pattern_table_1_pixel_colors);
-   glBindBuffer(GL_ARRAY_BUFFER, pattern_tables.color_VBO[0]);
-   glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vec4) * 128 * 128, pattern_table_0_pixel_colors);
-   glBindBuffer(GL_ARRAY_BUFFER, pattern_tables.color_VBO[1]);
-   glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vec4) * 128 * 128, pattern_table_1_pixel_colors);
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-   
+   DEBUG_ppu_update_pattern_tables(pattern_table_0_pixel_indices, pattern_table_1_pixel_indices);
+   glBindTexture(GL_TEXTURE_2D, pattern_tables.index_texture[0]);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 128, 128, GL_RED_INTEGER, GL_UNSIGNED_BYTE, pattern_table_0_pixel_indices);
+   glBindTexture(GL_TEXTURE_2D, pattern_tables.index_texture[1]);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 128, 128, GL_RED_INTEGER, GL_UNSIGNED_BYTE, pattern_table_1_pixel_indices);
+   glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 static void display_free_pattern_table_buffers(void)
 {
-   glBindVertexArray(0);
-
    glDeleteTextures(2, pattern_tables.textureID);
    glDeleteRenderbuffers(2, pattern_tables.RBO);
    glDeleteFramebuffers(2, pattern_tables.FBO);
+   glDeleteTextures(2, pattern_tables.index_texture);
 
-   glDeleteBuffers(1, &pattern_tables.vertex_VBO);
-   glDeleteBuffers(1, &pattern_tables.vertex_IBO);
-   glDeleteBuffers(1, &pattern_tables.translation_VBO);
-   glDeleteBuffers(2, pattern_tables.color_VBO);
-   glDeleteVertexArrays(2, pattern_tables.VAO);
-
-   free(pattern_table_0_pixel_colors);
-   free(pattern_table_1_pixel_colors);
+   free(pattern_table_0_pixel_indices);
+   free(pattern_table_1_pixel_indices);
 
-   pattern_table_0_pixel_colors = NULL;
-   pattern_table_1_pixel_colors = NULL;
+   pattern_table_0_pixel_indices = NULL;
+   pattern_table_1_pixel_indices = NULL;
 }
 
 static bool display_create_frameBuffers(GLuint *FBO_ID, GLuint *textureID, GLuint *RBO_ID, int width, int height)
@@ -1277,6 +1280,48 @@ static bool display_create_frameBuffers(GLuint *FBO_ID, GLuint *textureID, GLuin
    return true;
 }
 
+/**
+ * Creates a single channel unsigned integer texture that holds one system palette index per texel.
+ * Integer textures can not be filtered so texels are always fetched exactly.
+*/
+static void display_create_index_texture(GLuint *textureID, int width, int height)
+{
+   glGenTextures(1, textureID);
+   glBindTexture(GL_TEXTURE_2D, *textureID);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, NULL);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+   glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/**
+ * Draws a frame of palette indices into a framebuffer as one quad that fills the current gl viewport,
+ * every fragment picks the nearest pixel of index_texture and resolves its color through the palette texture.
+ * @param row_offset first row of index_texture to draw
+ * @param row_count number of rows of index_texture to draw
+ * @param use_emphasis true to apply the emphasis bits of the ppu frame's scanlines
+*/
+static void display_draw_indexed_frame(GLuint FBO, GLuint index_texture, int row_offset, int row_count, bool use_emphasis)
+{
+   glUseProgram(display_shader_id);
+   glUniform1i(glGetUniformLocation(display_shader_id, "row_offset"), row_offset);
+   glUniform1i(glGetUniformLocation(display_shader_id, "row_count"), row_count);
+   glUniform1i(glGetUniformLocation(display_shader_id, "use_emphasis"), use_emphasis);
+
+   glActiveTexture(GL_TEXTURE0);
+   glBindTexture(GL_TEXTURE_2D, index_texture);
+   glActiveTexture(GL_TEXTURE1);
+   glBindTexture(GL_TEXTURE_2D, viewport.emphasis_texture);
+   glActiveTexture(GL_TEXTURE2);
+   glBindTexture(GL_TEXTURE_2D, palette_texture);
+   glActiveTexture(GL_TEXTURE0);
+
+   glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+   glBindVertexArray(screen_quad_VAO);
+   glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
 static void display_resize_texture(int width, int height, GLuint textureID, GLuint RBO_ID)
 {
    glBindTexture(GL_TEXTURE_2D, textureID);
@@ -1293,28 +1338,36 @@ static void display_resize_texture(int width, int height, GLuint textureID, GLui
 static bool display_create_shaders(void)
 {
    GLchar* vertex_shader_code = "#version 330 core\n"
-      "layout (location = 0) in vec3 aPos;\n"
-      "layout (location = 1) in mat4 instanceMatrix;\n"
-      "layout (location = 5) in vec4 instanceColor;\n"
+      "layout (location = 0) in vec2 aPos;\n"
+      "layout (location = 1) in vec2 aTexCoord;\n"
 
-      "out vec4 color;\n"
-
-      "uniform mat4 view;\n"
-      "uniform mat4 projection;\n"
+      "out vec2 tex_coord;\n"
 
       "void main()\n"
       "{\n"
-      "   gl_Position = projection * view * instanceMatrix * vec4(aPos, 1.0);\n"
-      "   color = instanceColor;\n"
+      "   gl_Position = vec4(aPos, 0.0, 1.0);\n"
+      "   tex_coord = aTexCoord;\n"
       "}\0";
 
    GLchar* fragment_shader_code = "#version 330 core\n"
       "out vec4 fragColor;\n"
-      "in vec4 color;\n"
+      "in vec2 tex_coord;\n"
+
+      "uniform usampler2D index_texture;\n"    // system palette index of each pixel
+      "uniform usampler2D emphasis_texture;\n" // emphasis bits of each scanline
+      "uniform sampler2D palette_texture;\n"   // 64 system colors per row, one row per emphasis combination
+      "uniform int row_offset;\n"
+      "uniform int row_count;\n"
+      "uniform bool use_emphasis;\n"
 
       "void main()\n"
       "{\n"
-      "  fragColor = color;\n"
+      "  int width = textureSize(index_texture, 0).x;\n"
+      "  ivec2 pixel = min(ivec2(tex_coord * vec2(width, row_count)), ivec2(width - 1, row_count - 1));\n"
+      "  pixel.y += row_offset;\n"
+      "  uint palette_index = texelFetch(index_texture, pixel, 0).r;\n"
+      "  uint emphasis = use_emphasis ? texelFetch(emphasis_texture, ivec2(pixel.y, 0), 0).r : 0u;\n"
+      "  fragColor = vec4(texelFetch(palette_texture, ivec2(palette_index, emphasis), 0).rgb, 1.0);\n"
       "}\0";
 
    display_shader_id = glCreateProgram();
@@ -1342,19 +1395,9 @@ static bool display_create_shaders(void)
 
    glUseProgram(display_shader_id);
 
-   mat4 view = GLM_MAT4_IDENTITY_INIT;
-   vec3 translate = {0.0f, 0.0f, 0.0f};
-   glm_translate(view, translate);
-   GLuint viewLoc = glGetUniformLocation(display_shader_id, "view");
-   glUniformMatrix4fv(viewLoc, 1, GL_FALSE, (GLfloat*) view);
-
-   int width = NES_PIXELS_W * emulator_state.display_scale_factor;
-   int height = NES_PIXELS_H * emulator_state.display_scale_factor;
-
-   mat4 ortho_projection = GLM_MAT4_IDENTITY_INIT;
-   glm_ortho(0.0f, (float) width, (float) height, 0.0f, -1.0f, 1.0f, ortho_projection);
-   GLuint projectionLoc = glGetUniformLocation(display_shader_id, "projection");
-   glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, (GLfloat*) ortho_projection);
+   glUniform1i(glGetUniformLocation(display_shader_id, "index_texture"), 0);
+   glUniform1i(glGetUniformLocation(display_shader_id, "emphasis_texture"), 1);
+   glUniform1i(glGetUniformLocation(display_shader_id, "palette_texture"), 2);
 
    return true;
 }
@@ -1392,39 +1435,40 @@ static void display_add_shader(GLuint program, const GLchar* shader_code, GLenum
 }
 
 /**
- * Sets the position of each pixel of the nes display
- * @param w width of the pixel
- * @param h height of the pixel
+ * Rebuilds the palette texture from the ppu's system colors, called whenever the ppu loads a new palette.
+ * Row n of the texture holds the 64 colors with emphasis bits n applied, the color channels that are
+ * not emphasized get dimmed.
 */
-static void display_set_pixel_position(float pixel_w, float pixel_h, mat4 pixel_pos[], uint32_t width, uint32_t height)
+void display_update_palette(void)
 {
-   for (size_t row = 0; row < height; ++row)
+   if (palette_texture == 0) return;
+
+   const vec3* system_palette = ppu_get_system_palette();
+   static vec3 palette_colors[8 * 64];
+
+   for (int emphasis = 0; emphasis < 8; ++emphasis)
    {
-      for (size_t col = 0; col < width; ++col)
+      for (int i = 0; i < 64; ++i)
       {
-         mat4 model = GLM_MAT4_IDENTITY_INIT;
-         vec3 translation = {pixel_w * col, pixel_h * row, 0.0f};
-         glm_translate(model, translation);
-         glm_mat4_copy(model, pixel_pos[row * width + col]);
+         float* color = palette_colors[emphasis * 64 + i];
+         glm_vec3_copy((float*) system_palette[i], color);
+
+         // columns $xE and $xF are black and emphasis has no effect on them
+         if (emphasis == 0 || (i & 0x0E) == 0x0E) continue;
+
+         for (int channel = 0; channel < 3; ++channel)
+         {
+            if ( (emphasis & (1 << channel)) == 0 )
+            {
+               color[channel] *= PALETTE_EMPHASIS_ATTENUATION;
+            }
+         }
       }
    }
-}
 
-/**
- * Updates color of a pixel in the buffer on host memory side for the main viewport.
- * @param row of the pixel
- * @param col of the pixel
-*/
-void set_viewport_pixel_color(uint32_t row, uint32_t col, vec3 color)
-{
-   if (row >= 8 && row < 232)
-   {
-      uint32_t index = (row - 8) * NES_PIXELS_W + col;
-      viewport_pixel_colors[index][0] = color[0];
-      viewport_pixel_colors[index][1] = color[1];
-      viewport_pixel_colors[index][2] = color[2];
-      viewport_pixel_colors[index][3] = 1.0f;
-   }
+   glBindTexture(GL_TEXTURE_2D, palette_texture);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 64, 8, GL_RGB, GL_FLOAT, palette_colors);
+   glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 static void gui_help_marker(const char* desc)
@@ -1462,13 +1506,75 @@ static void gui_popup_modal(const char* title, const char* desc, bool p_open)
 }
 
 /**
- * Update pixel colors of main display
+ * Called by the ppu on the emulation thread when it finishes the visible scanlines. Copies the frame into
+ * the emulation thread's slot of the triple buffer and publishes it, the gui thread uploads it on its next render.
  */
 void display_update_color_buffer(void)
 {
-   glBindBuffer(GL_ARRAY_BUFFER, viewport.color_VBO);
-   glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vec4) * NES_PIXELS_W * NES_PIXELS_H, &viewport_pixel_colors);
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   memcpy(frames[write_frame].pixels, ppu_get_frame(), sizeof(frames[write_frame].pixels));
+   memcpy(frames[write_frame].emphasis, ppu_get_frame_emphasis(), sizeof(frames[write_frame].emphasis));
+   write_frame = SDL_AtomicSet(&ready_frame, write_frame | FRAME_FRESH) & FRAME_INDEX_MASK;
+}
+
+/**
+ * Takes the newest frame published by the emulation thread, if there is one, and uploads it to the main display.
+ */
+static void display_upload_frame(void)
+{
+   if ( (SDL_AtomicGet(&ready_frame) & FRAME_FRESH) == 0 ) return;
+
+   read_frame = SDL_AtomicSet(&ready_frame, read_frame) & FRAME_INDEX_MASK;
+
+   glBindTexture(GL_TEXTURE_2D, viewport.index_texture);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, PPU_FRAME_W, PPU_FRAME_H, GL_RED_INTEGER, GL_UNSIGNED_BYTE, frames[read_frame].pixels);
+   glBindTexture(GL_TEXTURE_2D, viewport.emphasis_texture);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, PPU_FRAME_H, 1, GL_RED_INTEGER, GL_UNSIGNED_BYTE, frames[read_frame].emphasis);
+   glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/**
+ * Changes the run state shown by the gui and tells the emulation thread about it.
+ */
+static void display_set_run_state(Emulator_Run_State_t run_state)
+{
+   emulator_state.run_state = run_state;
+   emu_thread_send(EMU_COMMAND_RUN_STATE, (uint8_t) run_state);
+}
+
+/**
+ * Asks for a movie file and power cycles the machine into recording or playing it back.
+ * The emulation thread is held for as long as the file dialog is open.
+ * @param is_recording true to record a new movie, false to play one
+ */
+static void display_start_movie(bool is_recording)
+{
+   emu_thread_lock();
+   apu_pause(true);
+
+   nfdchar_t* movie_path = NULL;
+   nfdfilteritem_t filters[1] = { {"BudgetNES movie", "bnm"} };
+   nfdresult_t result = is_recording ? NFD_SaveDialog(&movie_path, filters, 1, NULL, "movie.bnm") : NFD_OpenDialog(&movie_path, filters, 1, NULL);
+
+   if (result == NFD_OKAY)
+   {
+      bool is_started = is_recording ? movie_record(movie_path) : movie_play(movie_path, NULL);
+      if (is_started)
+      {
+         rewind_clear();
+         apu_clear_queued_audio();
+      }
+      NFD_FreePath(movie_path);
+   }
+   else if (result == NFD_ERROR)
+   {
+      printf("File open error: %s\n", NFD_GetError());
+   }
+
+   if (emulator_state.run_state == EMULATOR_RUNNING)
+   {
+      apu_pause(false);
+   }
+   emu_thread_unlock();
 }
 
 SDL_Window* display_get_window(void)
@@ -1481,13 +1587,19 @@ SDL_Window* display_get_window(void)
  */
 static void display_clear(void)
 {
-   for (int i = 0; i < NES_PIXELS_H * NES_PIXELS_W; ++i)
+   static uint8_t black_frame[PPU_FRAME_H * PPU_FRAME_W];
+   static uint8_t no_emphasis[PPU_FRAME_H];
+   memset(black_frame, 0x0F, sizeof(black_frame)); // $0F is black in every palette
+
+   // drop a frame the emulation thread published before the clear so it does not get drawn over it
+   if (SDL_AtomicGet(&ready_frame) & FRAME_FRESH)
    {
-      viewport_pixel_colors[i][0] = 0.0f;
-      viewport_pixel_colors[i][1] = 0.0f;
-      viewport_pixel_colors[i][2] = 0.0f;
-      viewport_pixel_colors[i][3] = 1.0f;
+      read_frame = SDL_AtomicSet(&ready_frame, read_frame) & FRAME_INDEX_MASK;
    }
 
-   display_update_color_buffer();
+   glBindTexture(GL_TEXTURE_2D, viewport.index_texture);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, PPU_FRAME_W, PPU_FRAME_H, GL_RED_INTEGER, GL_UNSIGNED_BYTE, black_frame);
+   glBindTexture(GL_TEXTURE_2D, viewport.emphasis_texture);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, PPU_FRAME_H, 1, GL_RED_INTEGER, GL_UNSIGNED_BYTE, no_emphasis);
+   glBindTexture(GL_TEXTURE_2D, 0);
 }
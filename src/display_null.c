@@ -0,0 +1,30 @@
+#include "display.h"
+
+/**
+ * Headless stand-in for display.c. Provides the emulator state and the pixel
+ * sinks that the core calls into, without creating a window. Frames stay in the ppu and are never drawn.
+*/
+
+static Emulator_State_t emulator_state = 
+{
+   .display_scale_factor = DISPLAY_2X,
+   .is_cpu_debug = false,
+   .is_cpu_intr_log = false,
+   .is_pattern_table_open = false,
+   .run_state = EMULATOR_RUNNING,
+   .reset_delta_timers = false,
+   .is_instruction_step = false,
+};
+
+void display_update_color_buffer(void)
+{
+}
+
+void display_update_palette(void)
+{
+}
+
+Emulator_State_t* get_emulator_state(void)
+{
+   return &emulator_state;
+}
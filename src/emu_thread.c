@@ -0,0 +1,222 @@
+#include <stdio.h>
+
+#include "SDL.h"
+
+#include "emu_thread.h"
+#include "display.h"
+#include "controllers.h"
+#include "cpu.h"
+#include "apu.h"
+#include "rewind.h"
+#include "movie.h"
+#include "cartridge.h"
+#include "battery_save.h"
+
+// must be a power of 2 so the free running head and tail can be masked into an index
+#define EMU_COMMAND_QUEUE_SIZE 256
+
+static SDL_Thread* emu_thread = NULL;
+static SDL_mutex* core_lock = NULL; // held by the emulation thread while it runs the core
+static SDL_atomic_t quit;
+
+// single producer (gui thread) single consumer (emulation thread) ring of commands
+
+static Emu_Command_t command_queue[EMU_COMMAND_QUEUE_SIZE];
+static SDL_atomic_t command_head; // next command to read, only written by the emulation thread
+static SDL_atomic_t command_tail; // next free slot, only written by the gui thread
+
+static int emu_thread_run(void* data);
+static bool emu_thread_receive(Emu_Command_t* command);
+static void emu_thread_rewind(void);
+
+bool emu_thread_start(void)
+{
+   core_lock = SDL_CreateMutex();
+   if (core_lock == NULL)
+   {
+      printf("Failed to create emulation lock: %s\n", SDL_GetError());
+      return false;
+   }
+
+   SDL_AtomicSet(&quit, 0);
+   SDL_AtomicSet(&command_head, 0);
+   SDL_AtomicSet(&command_tail, 0);
+
+   // the thread only learns about the run state through commands, so give it the one it starts with
+   emu_thread_send(EMU_COMMAND_RUN_STATE, (uint8_t) get_emulator_state()->run_state);
+
+   emu_thread = SDL_CreateThread(emu_thread_run, "BudgetNES emulation", NULL);
+   if (emu_thread == NULL)
+   {
+      printf("Failed to create emulation thread: %s\n", SDL_GetError());
+      SDL_DestroyMutex(core_lock);
+      core_lock = NULL;
+      return false;
+   }
+
+   return true;
+}
+
+void emu_thread_stop(void)
+{
+   if (emu_thread != NULL)
+   {
+      SDL_AtomicSet(&quit, 1);
+      SDL_WaitThread(emu_thread, NULL);
+      emu_thread = NULL;
+   }
+
+   if (core_lock != NULL)
+   {
+      SDL_DestroyMutex(core_lock);
+      core_lock = NULL;
+   }
+}
+
+bool emu_thread_send(Emu_Command_Type_t type, uint8_t value)
+{
+   int tail = SDL_AtomicGet(&command_tail);
+   if (tail - SDL_AtomicGet(&command_head) == EMU_COMMAND_QUEUE_SIZE)
+   {
+      return false;
+   }
+
+   command_queue[tail & (EMU_COMMAND_QUEUE_SIZE - 1)].type = type;
+   command_queue[tail & (EMU_COMMAND_QUEUE_SIZE - 1)].value = value;
+   SDL_AtomicSet(&command_tail, tail + 1); // publishes the command to the emulation thread
+
+   return true;
+}
+
+void emu_thread_lock(void)
+{
+   if (core_lock != NULL) SDL_LockMutex(core_lock);
+}
+
+void emu_thread_unlock(void)
+{
+   if (core_lock != NULL) SDL_UnlockMutex(core_lock);
+}
+
+/**
+ * Pops the oldest command off the queue.
+ * @returns false if the queue is empty
+*/
+static bool emu_thread_receive(Emu_Command_t* command)
+{
+   int head = SDL_AtomicGet(&command_head);
+   if (head == SDL_AtomicGet(&command_tail))
+   {
+      return false;
+   }
+
+   *command = command_queue[head & (EMU_COMMAND_QUEUE_SIZE - 1)];
+   SDL_AtomicSet(&command_head, head + 1); // hands the slot back to the gui thread
+
+   return true;
+}
+
+/**
+ * Steps back one recorded frame for every frame of audio the device plays, so rewinding runs at the same
+ * speed as the game. Silence is queued in place of the audio since nothing is emulated.
+*/
+static void emu_thread_rewind(void)
+{
+   bool is_stepped = false;
+   while (apu_get_queued_audio() < apu_get_audio_latency_samples())
+   {
+      is_stepped |= rewind_step_back();
+      apu_queue_silent_frame();
+   }
+
+   if (is_stepped)
+   {
+      display_update_color_buffer(); // the restored frame is not rendered again, so publish it as is
+   }
+}
+
+/**
+ * Emulation loop, paced by the audio device draining the queued audio. Sleeps for a millisecond
+ * between iterations to give the gui thread a chance at the core lock.
+*/
+static int emu_thread_run(void* data)
+{
+   (void) data;
+
+   Emulator_State_t* emulator_state = get_emulator_state();
+   Emulator_Run_State_t run_state = EMULATOR_UNLOADED;
+   bool is_rewinding = false;
+
+   while (SDL_AtomicGet(&quit) == 0)
+   {
+      SDL_LockMutex(core_lock);
+
+      // reset_delta_timers and is_instruction_step are only touched by this thread once it is running
+      Emu_Command_t command;
+      while (emu_thread_receive(&command))
+      {
+         switch (command.type)
+         {
+            case EMU_COMMAND_BUTTON_DOWN:
+               controller1_set_button_down( (JOYPAD_BUTTONS) command.value );
+               break;
+            case EMU_COMMAND_BUTTON_UP:
+               controller1_set_button_up( (JOYPAD_BUTTONS) command.value );
+               break;
+            case EMU_COMMAND_RUN_STATE:
+               run_state = (Emulator_Run_State_t) command.value;
+               break;
+            case EMU_COMMAND_STEP:
+               emulator_state->is_instruction_step = true;
+               break;
+            case EMU_COMMAND_RESET_TIMERS:
+               emulator_state->reset_delta_timers = true;
+               break;
+            case EMU_COMMAND_REWIND:
+               is_rewinding = command.value != 0;
+               break;
+            case EMU_COMMAND_RUN_AHEAD:
+               cpu_set_run_ahead(command.value);
+               break;
+            case EMU_COMMAND_SAVE_INTERVAL:
+               battery_save_set_interval(command.value);
+               break;
+         }
+      }
+
+      switch (run_state)
+      {
+         case EMULATOR_RUNNING:
+         {
+            if (is_rewinding && movie_get_mode() == MOVIE_OFF) // rewinding would break a movie's timeline
+            {
+               emu_thread_rewind();
+            }
+            else
+            {
+               cpu_run_with_audio();
+            }
+            break;
+         }
+         case EMULATOR_PAUSED:
+         {
+            if (emulator_state->is_instruction_step)
+            {
+               cpu_emulate_instruction();
+               emulator_state->is_instruction_step = false;
+            }
+            break;
+         }
+         default:
+            break;
+      }
+
+      // a copy of battery ram goes to the battery save thread, the disk is never waited on here
+      cartridge_update_battery_save();
+
+      SDL_UnlockMutex(core_lock);
+      SDL_Delay(1);
+   }
+
+   return 0;
+}
@@ -1,132 +1,116 @@
-#include <stdlib.h>
-#include <stdio.h>
+#include <stddef.h>
 
 #include "mapper.h"
 #include "mapper_000.h"
-#include "mapper_001.h"
-#include "mapper_002.h"
-#include "mapper_004.h"
-#include "mapper_007.h"
-#include "mapper_009.h"
 
-// mappers that don't generate irqs use this default function
-static bool irq_signaled_default(void* internal_registers)
+static const mapper_t mappers[] =
 {
-	(void)internal_registers;
-	return false;
-}
-
-bool load_mapper(uint32_t mapper_id, mapper_t *mapper, void** mapper_registers)
+   {
+      .mapper_id      = 0,
+      .submapper_id   = MAPPER_ANY_SUBMAPPER,
+      .capabilities   = 0,
+      .registers_size = 0,
+      .cpu_read       = &mapper000_cpu_read,
+      .cpu_write      = &mapper000_cpu_write,
+      .ppu_read       = &mapper000_ppu_read,
+      .ppu_write      = &mapper000_ppu_write,
+      .init           = &mapper000_init,
+   },
+   {
+      .mapper_id      = 1,
+      .submapper_id   = MAPPER_ANY_SUBMAPPER,
+      .capabilities   = MAPPER_SWITCHES_PPU,
+      .registers_size = sizeof(Registers_001),
+      .cpu_read       = &mapper001_cpu_read,
+      .cpu_write      = &mapper001_cpu_write,
+      .ppu_read       = &mapper001_ppu_read,
+      .ppu_write      = &mapper001_ppu_write,
+      .init           = &mapper001_init,
+   },
+   {
+      .mapper_id      = 2,
+      .submapper_id   = MAPPER_ANY_SUBMAPPER,
+      .capabilities   = 0, // only switches prg banks
+      .registers_size = sizeof(Registers_002),
+      .cpu_read       = &mapper002_cpu_read,
+      .cpu_write      = &mapper002_cpu_write,
+      .ppu_read       = &mapper002_ppu_read,
+      .ppu_write      = &mapper002_ppu_write,
+      .init           = &mapper002_init,
+   },
+   {
+      .mapper_id      = 4,
+      .submapper_id   = MAPPER_ANY_SUBMAPPER,
+      .capabilities   = MAPPER_GENERATES_IRQ | MAPPER_OBSERVES_PPU_FETCH | MAPPER_SWITCHES_PPU,
+      .registers_size = sizeof(Registers_004),
+      .cpu_read       = &mapper004_cpu_read,
+      .cpu_write      = &mapper004_cpu_write,
+      .ppu_read       = &mapper004_ppu_read,
+      .ppu_write      = &mapper004_ppu_write,
+      .init           = &mapper004_init,
+      .irq_deadline   = &mapper004_irq_deadline,
+      .ppu_fetch      = &mapper004_ppu_fetch,
+   },
+   {
+      .mapper_id      = 7,
+      .submapper_id   = MAPPER_ANY_SUBMAPPER,
+      .capabilities   = MAPPER_SWITCHES_PPU,
+      .registers_size = sizeof(Registers_007),
+      .cpu_read       = &mapper007_cpu_read,
+      .cpu_write      = &mapper007_cpu_write,
+      .ppu_read       = &mapper007_ppu_read,
+      .ppu_write      = &mapper007_ppu_write,
+      .init           = &mapper007_init,
+   },
+   {
+      .mapper_id      = 9,
+      .submapper_id   = MAPPER_ANY_SUBMAPPER,
+      .capabilities   = MAPPER_OBSERVES_PPU_FETCH | MAPPER_SWITCHES_PPU,
+      .registers_size = sizeof(Registers_009),
+      .cpu_read       = &mapper009_cpu_read,
+      .cpu_write      = &mapper009_cpu_write,
+      .ppu_read       = &mapper009_ppu_read,
+      .ppu_write      = &mapper009_ppu_write,
+      .init           = &mapper009_init,
+      .ppu_fetch      = &mapper009_ppu_fetch,
+   },
+};
+
+#define MAPPER_COUNT (sizeof(mappers) / sizeof(mappers[0]))
+
+const mapper_t* mapper_find(uint16_t mapper_id, uint8_t submapper_id)
 {
-   bool status = true;
+   const mapper_t* generic = NULL;
 
-   switch (mapper_id)
+   for (size_t i = 0; i < MAPPER_COUNT; ++i)
    {
-      case 0:
+      if (mappers[i].mapper_id != mapper_id)
       {
-         mapper->cpu_read     = &mapper000_cpu_read;
-         mapper->cpu_write    = &mapper000_cpu_write;
-         mapper->ppu_read     = &mapper000_ppu_read;
-         mapper->ppu_write    = &mapper000_ppu_write;
-         mapper->init         = &mapper000_init;
-			mapper->irq_signaled = &irq_signaled_default;
-         *mapper_registers = NULL;
-         break;
+         continue;
       }
-      case 1:
-      {  
-         mapper->cpu_read     = &mapper001_cpu_read;
-         mapper->cpu_write    = &mapper001_cpu_write;
-         mapper->ppu_read     = &mapper001_ppu_read;
-         mapper->ppu_write    = &mapper001_ppu_write;
-         mapper->init         = &mapper001_init;
-			mapper->irq_signaled = &irq_signaled_default;
-         *mapper_registers = malloc(sizeof(Registers_001));
-
-         if (mapper_registers == NULL)
-         {
-            printf("Mapper 001 register malloc failed!\n");
-            status = false;
-         }
 
-         break;
+      if (mappers[i].submapper_id == submapper_id)
+      {
+         return &mappers[i];
       }
-      case 2:
+      if (mappers[i].submapper_id == MAPPER_ANY_SUBMAPPER)
       {
-         mapper->cpu_read     = &mapper002_cpu_read;
-         mapper->cpu_write    = &mapper002_cpu_write;
-         mapper->ppu_read     = &mapper002_ppu_read;
-         mapper->ppu_write    = &mapper002_ppu_write;
-         mapper->init         = &mapper002_init;
-			mapper->irq_signaled = &irq_signaled_default;
-         *mapper_registers    = malloc(sizeof(Registers_002));
-
-         if (mapper_registers == NULL)
-         {
-            printf("Mapper 002 register malloc failed!\n");
-            status = false;
-         }
-
-         break;
+         generic = &mappers[i];
       }
-		case 4:
-		{
-			mapper->cpu_read     = &mapper004_cpu_read;
-			mapper->cpu_write    = &mapper004_cpu_write;
-			mapper->ppu_read     = &mapper004_ppu_read;
-			mapper->ppu_write    = &mapper004_ppu_write;
-			mapper->init         = &mapper004_init;
-			mapper->irq_signaled = &mapper004_irq_signaled;
-			*mapper_registers    = malloc(sizeof(Registers_004));
-
-			if (mapper_registers == NULL)
-			{
-				printf("Mapper 004 register malloc failed!\n");
-				status = false;
-			}
-
-			break;
-		}
-		case 7:
-		{
-			mapper->cpu_read     = &mapper007_cpu_read;
-			mapper->cpu_write    = &mapper007_cpu_write;
-			mapper->ppu_read     = &mapper007_ppu_read;
-			mapper->ppu_write    = &mapper007_ppu_write;
-			mapper->init         = &mapper007_init;
-			mapper->irq_signaled = &irq_signaled_default;
-			*mapper_registers    = malloc(sizeof(Registers_007));
-
-			if (mapper_registers == NULL)
-			{
-				printf("Mapper 007 register malloc failed!\n");
-				status = false;
-			}
-
-			break;
-		}
-		case 9:
-		{
-			mapper->cpu_read     = &mapper009_cpu_read;
-			mapper->cpu_write    = &mapper009_cpu_write;
-			mapper->ppu_read     = &mapper009_ppu_read;
-			mapper->ppu_write    = &mapper009_ppu_write;
-			mapper->init         = &mapper009_init;
-			mapper->irq_signaled = &irq_signaled_default;
-			*mapper_registers    = malloc(sizeof(Registers_009));
-
-			if (mapper_registers == NULL)
-			{
-				printf("Mapper 009 register malloc failed!\n");
-				status = false;
-			}
+   }
 
-			break;
-		}
+   return generic;
+}
 
-      default:
-         status = false;
+bool mapper_is_supported(uint16_t mapper_id)
+{
+   for (size_t i = 0; i < MAPPER_COUNT; ++i)
+   {
+      if (mappers[i].mapper_id == mapper_id)
+      {
+         return true;
+      }
    }
 
-   return status;
+   return false;
 }
@@ -96,6 +96,7 @@ cartridge_access_mode_t mapper001_cpu_write(nes_header_t *header, uint16_t posit
       {
          mapper->shift_register = 0x10;
          mapper->control |= 0xC;
+         cartridge_update_cpu_pages(0x8000, 0xFFFF);
       }
       // bit 0 being set means shift register is full
       else if (mapper->shift_register & 0x1)
@@ -143,6 +144,11 @@ cartridge_access_mode_t mapper001_cpu_write(nes_header_t *header, uint16_t posit
          {
             mapper->control = dest;
          }
+
+         // every register can affect prg banking (control, prg bank, prg ram banks on SOROM/SUROM/SXROM)
+         // and chr banking/mirroring (control, chr banks)
+         cartridge_update_cpu_pages(0x6000, 0xFFFF);
+         cartridge_update_ppu_pages(0x0000, 0x2FFF);
       }
       // else just shift bit 0 of data being written into the msb of shift register
       // and shift the register right 1 bit
@@ -39,6 +39,7 @@ cartridge_access_mode_t mapper002_cpu_write(nes_header_t *header, uint16_t posit
    if (position >= 0x8000)
    {
       mapper->PRG_bank = data;
+      cartridge_update_cpu_pages(0x8000, 0xBFFF);
    }
 
    return mode;
@@ -1,8 +1,10 @@
 #include "mapper_004.h"
 #include "mirror_config.h"
+#include "ppu.h"
 #include "cpu.h"
 
 #include <string.h>
+#include <limits.h>
 
 static void mapper004_clock_irq(Registers_004* mapper);
 
@@ -95,6 +97,16 @@ cartridge_access_mode_t mapper004_cpu_write(nes_header_t* header, uint16_t posit
 			{
 				mapper->bank_registers[index] = data;
 			}
+
+			// R6 and R7 select prg banks, R0-R5 select chr banks
+			if (index == 6 || index == 7)
+			{
+				cartridge_update_cpu_pages(0x8000, 0xDFFF);
+			}
+			else
+			{
+				cartridge_update_ppu_pages(0x0000, 0x1FFF);
+			}
 		}
 		// even addresses select the low register (control register)
 		else
@@ -102,6 +114,8 @@ cartridge_access_mode_t mapper004_cpu_write(nes_header_t* header, uint16_t posit
 			mapper->register_select = data & 0x7;
 			mapper->prg_rom_bank_mode = (data >> 6) & 0x1;
 			mapper->chr_bank_mode = (data >> 7) & 0x1;
+			cartridge_update_cpu_pages(0x8000, 0xDFFF); // prg bank mode swaps $8000 and $C000
+			cartridge_update_ppu_pages(0x0000, 0x1FFF); // chr bank mode swaps $0000 and $1000
 		}
 	}
 	else if (position >= 0xA000 && position <= 0xBFFF)
@@ -111,11 +125,13 @@ cartridge_access_mode_t mapper004_cpu_write(nes_header_t* header, uint16_t posit
 		{
 			mapper->prg_write_disable = (data >> 6) & 0x1;
 			mapper->prg_ram_enable = (data >> 7) & 0x1;
+			cartridge_update_cpu_pages(0x6000, 0x7FFF);
 		}
 		// even address
 		else
 		{
 			mapper->mirroring_mode = data & 0x1;
+			cartridge_update_ppu_pages(0x2000, 0x2FFF);
 		}
 	}
 	else if (position >= 0xC000 && position <= 0xDFFF)
@@ -143,6 +159,7 @@ cartridge_access_mode_t mapper004_cpu_write(nes_header_t* header, uint16_t posit
 		{
 			mapper->irq_enable = false;
 			mapper->irq_pending = false; // acknowledge pending irqs
+			cpu_irq_release(CPU_IRQ_MAPPER);
 		}
 	}
 	
@@ -155,27 +172,6 @@ cartridge_access_mode_t mapper004_ppu_read(nes_header_t* header, uint16_t positi
 	Registers_004* mapper = (Registers_004*)internal_registers;
 	cartridge_access_mode_t mode = NO_CARTRIDGE_DEVICE;
 
-	{
-		size_t cpu_cycle_count = get_cpu()->cycle_count;
-		if ((position & 0x1000) == 0 && cpu_cycle_count != mapper->cpu_timestamp)
-		{
-			mapper->M2 += 1;
-		}
-		else if ((position & 0x1000) && (mapper->A12 == 0) && mapper->M2 >= 3)
-		{
-			// rising edge of a12 decrements irq counter
-			mapper004_clock_irq(internal_registers);
-			mapper->M2 = 0;
-		}
-		else if ((position & 0x1000) && (mapper->A12 == 0) && mapper->M2 < 3)
-		{
-			mapper->M2 = 0;
-		}
-
-		mapper->cpu_timestamp = cpu_cycle_count;
-		mapper->A12 = (position & 0x1000) >> 12;
-	}
-
 	// bank mode 1:
 	// two 2 KB banks at $1000-$1FFF
 	// four 1 KB banks at $0000 - $0FFF
@@ -272,26 +268,7 @@ cartridge_access_mode_t mapper004_ppu_write(nes_header_t* header, uint16_t posit
 	Registers_004* mapper = (Registers_004*)internal_registers;
 	cartridge_access_mode_t mode = NO_CARTRIDGE_DEVICE;
 
-	{
-		size_t cpu_cycle_count = get_cpu()->cycle_count;
-		if ((position & 0x1000) == 0 && cpu_cycle_count != mapper->cpu_timestamp)
-		{
-			mapper->M2 += 1;
-		}
-		else if ((position & 0x1000) && (mapper->A12 == 0) && mapper->M2 >= 3)
-		{
-			// rising edge of a12 decrements irq counter
-			mapper004_clock_irq(internal_registers);
-			mapper->M2 = 0;
-		}
-		else if ((position & 0x1000) && (mapper->A12 == 0) && mapper->M2 < 3)
-		{
-			mapper->M2 = 0;
-		}
-
-		mapper->cpu_timestamp = cpu_cycle_count;
-		mapper->A12 = (position & 0x1000) >> 12;
-	}
+	mapper004_ppu_fetch(header, position, internal_registers); // ppu writes also drive A12
 
 	// writing to chr-memory
 	if (position <= 0x1FFF)
@@ -299,8 +276,9 @@ cartridge_access_mode_t mapper004_ppu_write(nes_header_t* header, uint16_t posit
 		// only allow writes if chr memory is ram and not rom
 		if (header->chr_rom_size == 0)
 		{
-			mode = ACCESS_CHR_MEM;
-			*mapped_addr = position & 0x1FFF; // iNES 1.0 only which means chr-ram is fixed to 8kb
+			// chr-ram is banked the same way as chr-rom, boards with more than 8kb use the upper bank bits
+			mode = mapper004_ppu_read(header, position, mapped_addr, internal_registers);
+			*mapped_addr %= header->chr_ram_bytes + header->chr_nvram_bytes;
 		}
 	}
 	// writting to ppu nametable vram
@@ -324,6 +302,31 @@ cartridge_access_mode_t mapper004_ppu_write(nes_header_t* header, uint16_t posit
 	return mode;
 }
 
+void mapper004_ppu_fetch(nes_header_t* header, uint16_t position, void* internal_registers)
+{
+	(void)header;
+	Registers_004* mapper = (Registers_004*)internal_registers;
+
+	size_t cpu_cycle_count = ppu_get_cpu_cycle(); // cpu cycle of this fetch, the ppu may be catching up
+	if ((position & 0x1000) == 0 && cpu_cycle_count != mapper->cpu_timestamp)
+	{
+		mapper->M2 += 1;
+	}
+	else if ((position & 0x1000) && (mapper->A12 == 0) && mapper->M2 >= 3)
+	{
+		// rising edge of a12 decrements irq counter
+		mapper004_clock_irq(internal_registers);
+		mapper->M2 = 0;
+	}
+	else if ((position & 0x1000) && (mapper->A12 == 0) && mapper->M2 < 3)
+	{
+		mapper->M2 = 0;
+	}
+
+	mapper->cpu_timestamp = cpu_cycle_count;
+	mapper->A12 = (position & 0x1000) >> 12;
+}
+
 void mapper004_init(nes_header_t* header, void* internal_registers)
 {
 	Registers_004* mapper = (Registers_004*)internal_registers;
@@ -345,12 +348,25 @@ void mapper004_clock_irq(Registers_004* mapper)
 	if (mapper->irq_counter == 0 && mapper->irq_enable)
 	{
 		mapper->irq_pending = true;
+		cpu_irq_assert(CPU_IRQ_MAPPER);
 	}
 }
 
-bool mapper004_irq_signaled(void* internal_registers)
+long mapper004_irq_deadline(void* internal_registers)
 {
 	Registers_004* mapper = (Registers_004*)internal_registers;
-	return mapper->irq_pending;
+	if (!mapper->irq_enable || mapper->irq_pending)
+	{
+		return LONG_MAX;
+	}
+
+	// a zero counter is reloaded on the next clock instead of decremented
+	long clocks = mapper->irq_counter;
+	if (clocks == 0)
+	{
+		clocks = mapper->irq_counter_reload + 1;
+	}
+
+	return (clocks - 1) * 3;
 }
 
@@ -34,6 +34,8 @@ cartridge_access_mode_t mapper007_cpu_write(nes_header_t* header, uint16_t posit
 	{
 		mapper->prg_bank = data & 0x7;
 		mapper->vram_bank = (data >> 4) & 0x1;
+		cartridge_update_cpu_pages(0x8000, 0xFFFF);
+		cartridge_update_ppu_pages(0x2000, 0x2FFF);
 	}
 
 	return mode;
@@ -47,26 +47,32 @@ cartridge_access_mode_t mapper009_cpu_write(nes_header_t* header, uint16_t posit
 	else if (position >= 0xA000 && position <= 0xAFFF)
 	{
 		mapper->prg_bank = data & 0xF;
+		cartridge_update_cpu_pages(0x8000, 0x9FFF);
 	}
 	else if (position >= 0xB000 && position <= 0xBFFF)
 	{
 		mapper->chr_bank_FD_0 = data & 0x1F;
+		cartridge_update_ppu_pages(0x0000, 0x0FFF);
 	}
 	else if (position >= 0xC000 && position <= 0xCFFF)
 	{
 		mapper->chr_bank_FE_0 = data & 0x1F;
+		cartridge_update_ppu_pages(0x0000, 0x0FFF);
 	}
 	else if (position >= 0xD000 && position <= 0xDFFF)
 	{
 		mapper->chr_bank_FD_1 = data & 0x1F;
+		cartridge_update_ppu_pages(0x1000, 0x1FFF);
 	}
 	else if (position >= 0xE000 && position <= 0xEFFF)
 	{
 		mapper->chr_bank_FE_1 = data & 0x1F;
+		cartridge_update_ppu_pages(0x1000, 0x1FFF);
 	}
 	else if (position >= 0xF000 && position <= 0xFFFF)
 	{
 		mapper->mirroring_mode = data & 0x1;
+		cartridge_update_ppu_pages(0x2000, 0x2FFF);
 	}
 
 
@@ -92,15 +98,6 @@ cartridge_access_mode_t mapper009_ppu_read(nes_header_t* header, uint16_t positi
 		{
 			*mapped_addr = (position & 0xFFF) + (mapper->chr_bank_FE_0 * 0x1000);
 		}
-
-		if (position == 0x0FD8)
-		{
-			mapper->latch_0 = 0xFD;
-		}
-		else if (position == 0x0FE8)
-		{
-			mapper->latch_0 = 0xFE;
-		}
 	}
 	// switchable 4kb bank at 0x1000 - 0x1FFF
 	else if (position <= 0x1FFF)
@@ -115,15 +112,6 @@ cartridge_access_mode_t mapper009_ppu_read(nes_header_t* header, uint16_t positi
 		{
 			*mapped_addr = (position & 0xFFF) + (mapper->chr_bank_FE_1 * 0x1000);
 		}
-
-		if (position >= 0x1FD8 && position <= 0x1FDF)
-		{
-			mapper->latch_1 = 0xFD;
-		}
-		else if (position >= 0x1FE8 && position <= 0x1FEF)
-		{
-			mapper->latch_1 = 0xFE;
-		}
 	}
 	// reading ppu nametable vram
 	else
@@ -185,6 +173,33 @@ cartridge_access_mode_t mapper009_ppu_write(nes_header_t* header, uint16_t posit
 	return mode;
 }
 
+void mapper009_ppu_fetch(nes_header_t* header, uint16_t position, void* internal_registers)
+{
+	(void)header;
+	Registers_009* mapper = (Registers_009*)internal_registers;
+
+	// latches switch after the tile at $0FD8/$0FE8 ($1FD8-$1FDF/$1FE8-$1FEF) has been read,
+	// the read that trips a latch still comes from the old bank
+	if (position == 0x0FD8 || position == 0x0FE8)
+	{
+		uint8_t latch = (position == 0x0FD8) ? 0xFD : 0xFE;
+		if (mapper->latch_0 != latch)
+		{
+			mapper->latch_0 = latch;
+			cartridge_update_ppu_pages(0x0000, 0x0FFF);
+		}
+	}
+	else if ((position >= 0x1FD8 && position <= 0x1FDF) || (position >= 0x1FE8 && position <= 0x1FEF))
+	{
+		uint8_t latch = (position <= 0x1FDF) ? 0xFD : 0xFE;
+		if (mapper->latch_1 != latch)
+		{
+			mapper->latch_1 = latch;
+			cartridge_update_ppu_pages(0x1000, 0x1FFF);
+		}
+	}
+}
+
 void mapper009_init(nes_header_t* header, void* internal_registers)
 {
 	Registers_009* mapper = (Registers_009*)internal_registers;
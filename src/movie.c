@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "movie.h"
+#include "cartridge.h"
+#include "controllers.h"
+#include "cpu.h"
+#include "apu.h"
+#include "ppu.h"
+#include "bus.h"
+#include "util.h"
+
+#define MOVIE_MAGIC       "BNMV"
+#define MOVIE_HEADER_SIZE 24 // magic + version + rom hash + battery ram hash
+#define MOVIE_FRAME_SIZE  2
+
+static Movie_Mode_t mode = MOVIE_OFF;
+static FILE* movie_file = NULL;  // open while recording
+static FILE* hash_log = NULL;    // open while playing with a hash log
+static uint8_t* movie_frames = NULL; // frames of the movie being played
+static uint32_t movie_length = 0;
+static uint32_t movie_frame = 0;
+
+static void movie_power_on(void);
+static void movie_write_u32(uint8_t* out, uint32_t value);
+static void movie_write_u64(uint8_t* out, uint64_t value);
+static uint32_t movie_read_u32(const uint8_t* in);
+static uint64_t movie_read_u64(const uint8_t* in);
+
+bool movie_record(const char* path)
+{
+   movie_stop();
+
+   movie_file = fopen(path, "wb");
+   if (movie_file == NULL)
+   {
+      printf("Cannot open movie file: %s\n", path);
+      return false;
+   }
+
+   uint8_t header[MOVIE_HEADER_SIZE];
+   memcpy(header, MOVIE_MAGIC, 4);
+   movie_write_u32(header + 4, MOVIE_VERSION);
+   movie_write_u64(header + 8, cartridge_get_rom_hash());
+   movie_write_u64(header + 16, cartridge_get_battery_ram_hash());
+
+   if (fwrite(header, sizeof(uint8_t), MOVIE_HEADER_SIZE, movie_file) != MOVIE_HEADER_SIZE)
+   {
+      printf("Failed to write movie header!\n");
+      movie_stop();
+      return false;
+   }
+
+   movie_power_on();
+   mode = MOVIE_RECORDING;
+
+   return true;
+}
+
+bool movie_play(const char* path, const char* hash_log_path)
+{
+   movie_stop();
+
+   FILE* file = fopen(path, "rb");
+   if (file == NULL)
+   {
+      printf("Cannot open movie file: %s\n", path);
+      return false;
+   }
+
+   uint8_t header[MOVIE_HEADER_SIZE];
+   if (fread(header, sizeof(uint8_t), MOVIE_HEADER_SIZE, file) != MOVIE_HEADER_SIZE || memcmp(header, MOVIE_MAGIC, 4) != 0)
+   {
+      fclose(file);
+      printf("Invalid movie file!\n");
+      return false;
+   }
+
+   if (movie_read_u32(header + 4) != MOVIE_VERSION)
+   {
+      fclose(file);
+      printf("Movie version %u is not supported!\n", movie_read_u32(header + 4));
+      return false;
+   }
+
+   if (movie_read_u64(header + 8) != cartridge_get_rom_hash())
+   {
+      fclose(file);
+      printf("Movie was recorded with a different rom!\n");
+      return false;
+   }
+
+   if (movie_read_u64(header + 16) != cartridge_get_battery_ram_hash())
+   {
+      printf("Battery backed ram differs from when the movie was recorded, playback may desync.\n");
+   }
+
+   // the frames run to the end of the file
+   fseek(file, 0, SEEK_END);
+   long file_size = ftell(file);
+   fseek(file, MOVIE_HEADER_SIZE, SEEK_SET);
+
+   movie_length = (file_size > MOVIE_HEADER_SIZE) ? (uint32_t) ((file_size - MOVIE_HEADER_SIZE) / MOVIE_FRAME_SIZE) : 0;
+   movie_frames = malloc((size_t) movie_length * MOVIE_FRAME_SIZE + 1);
+   if (movie_frames == NULL)
+   {
+      fclose(file);
+      printf("Failed to allocate memory for movie!\n");
+      return false;
+   }
+
+   size_t bytes_read = fread(movie_frames, MOVIE_FRAME_SIZE, movie_length, file);
+   fclose(file);
+   if (bytes_read != movie_length)
+   {
+      printf("Movie reading error!\n");
+      movie_stop();
+      return false;
+   }
+
+   if (hash_log_path != NULL)
+   {
+      hash_log = fopen(hash_log_path, "w");
+      if (hash_log == NULL)
+      {
+         printf("Cannot open hash log: %s\n", hash_log_path);
+         movie_stop();
+         return false;
+      }
+   }
+
+   movie_power_on();
+   mode = MOVIE_PLAYING;
+
+   return true;
+}
+
+void movie_stop(void)
+{
+   if (movie_file != NULL)
+   {
+      fclose(movie_file);
+      movie_file = NULL;
+   }
+
+   if (hash_log != NULL)
+   {
+      fclose(hash_log);
+      hash_log = NULL;
+   }
+
+   free(movie_frames);
+   movie_frames = NULL;
+   movie_length = 0;
+   movie_frame = 0;
+   mode = MOVIE_OFF;
+}
+
+Movie_Mode_t movie_get_mode(void)
+{
+   return mode;
+}
+
+uint32_t movie_get_frame(void)
+{
+   return movie_frame;
+}
+
+uint32_t movie_get_length(void)
+{
+   return (mode == MOVIE_PLAYING) ? movie_length : movie_frame;
+}
+
+bool movie_begin_frame(void)
+{
+   switch (mode)
+   {
+      case MOVIE_RECORDING:
+      {
+         uint8_t buttons[MOVIE_FRAME_SIZE];
+         controllers_get_buttons(&buttons[0], &buttons[1]);
+
+         if (fwrite(buttons, sizeof(uint8_t), MOVIE_FRAME_SIZE, movie_file) != MOVIE_FRAME_SIZE)
+         {
+            printf("Failed to write movie frame, recording stopped!\n");
+            movie_stop();
+            break;
+         }
+         movie_frame += 1;
+         break;
+      }
+      case MOVIE_PLAYING:
+      {
+         if (movie_frame >= movie_length)
+         {
+            movie_stop();
+            controllers_set_buttons(0, 0); // the last frame's buttons would otherwise stay held
+            return false;
+         }
+
+         const uint8_t* buttons = movie_frames + (size_t) movie_frame * MOVIE_FRAME_SIZE;
+         controllers_set_buttons(buttons[0], buttons[1]);
+         movie_frame += 1;
+         break;
+      }
+      default:
+         break;
+   }
+
+   return true;
+}
+
+void movie_end_frame(void)
+{
+   if (hash_log != NULL)
+   {
+      fprintf(hash_log, "%" PRIu32 " %016" PRIx64 "\n", movie_frame - 1, movie_hash_frame());
+   }
+}
+
+uint64_t movie_hash_frame(void)
+{
+   uint64_t hash = fnv1a_64(FNV1A_64_OFFSET_BASIS, ppu_get_frame(), PPU_FRAME_W * PPU_FRAME_H);
+   return fnv1a_64(hash, cpu_get_ram(), 1024 * 2);
+}
+
+/**
+ * Resets everything a movie depends on to the same state a freshly loaded rom starts in.
+*/
+static void movie_power_on(void)
+{
+   cartridge_power_on();
+   cpu_clear_ram();
+   apu_reset_internals();
+   controllers_reset();
+   cpu_init();
+}
+
+static void movie_write_u32(uint8_t* out, uint32_t value)
+{
+   for (int i = 0; i < 4; ++i)
+   {
+      out[i] = (uint8_t) (value >> (i * 8));
+   }
+}
+
+static void movie_write_u64(uint8_t* out, uint64_t value)
+{
+   for (int i = 0; i < 8; ++i)
+   {
+      out[i] = (uint8_t) (value >> (i * 8));
+   }
+}
+
+static uint32_t movie_read_u32(const uint8_t* in)
+{
+   uint32_t value = 0;
+   for (int i = 0; i < 4; ++i)
+   {
+      value |= (uint32_t) in[i] << (i * 8);
+   }
+   return value;
+}
+
+static uint64_t movie_read_u64(const uint8_t* in)
+{
+   uint64_t value = 0;
+   for (int i = 0; i < 8; ++i)
+   {
+      value |= (uint64_t) in[i] << (i * 8);
+   }
+   return value;
+}
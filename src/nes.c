@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "nes.h"
+#include "cpu.h"
+#include "bus.h"
+#include "ppu.h"
+#include "apu.h"
+#include "cartridge.h"
+#include "controllers.h"
+#include "util.h"
+
+struct nes_t
+{
+   cpu_6502_t* cpu;
+   Bus_Context_t* bus;
+   Ppu_Context_t* ppu;
+   Apu_Context_t* apu;
+   Cartridge_Context_t* cartridge;
+   Controllers_Context_t* controllers;
+};
+
+static NES_THREAD_LOCAL nes_t* bound = NULL; // instance bound to this thread, NULL for the default instance
+
+static void nes_free_contexts(nes_t* nes);
+
+nes_t* nes_create(void)
+{
+   nes_t* nes = calloc(1, sizeof(nes_t));
+   if (nes == NULL)
+   {
+      printf("Failed to allocate memory for emulator instance!\n");
+      return NULL;
+   }
+
+   nes->cpu = cpu_context_create();
+   nes->bus = bus_context_create();
+   nes->ppu = ppu_context_create();
+   nes->apu = apu_context_create();
+   nes->cartridge = cartridge_context_create();
+   nes->controllers = controllers_context_create();
+
+   if (nes->cpu == NULL || nes->bus == NULL || nes->ppu == NULL || nes->apu == NULL || nes->cartridge == NULL || nes->controllers == NULL)
+   {
+      printf("Failed to allocate memory for emulator instance!\n");
+      nes_free_contexts(nes);
+      return NULL;
+   }
+
+   // instances made here are headless, the display and audio device belong to the default instance
+   nes_t* previous = bound;
+   nes_bind(nes);
+   ppu_set_frame_output(false);
+   apu_mute(true);
+   cartridge_set_battery_save_writes(false);
+   nes_bind(previous);
+
+   return nes;
+}
+
+void nes_destroy(nes_t* nes)
+{
+   if (nes == NULL)
+   {
+      return;
+   }
+
+   // the rom is freed while bound since unloading it also unmaps the instance's cpu and ppu pages
+   nes_t* previous = bound;
+   nes_bind(nes);
+   cartridge_free_memory();
+   nes_bind( (previous != nes) ? previous : NULL );
+
+   nes_free_contexts(nes);
+}
+
+void nes_bind(nes_t* nes)
+{
+   bound = nes;
+
+   cpu_bind( (nes != NULL) ? nes->cpu : NULL );
+   bus_bind( (nes != NULL) ? nes->bus : NULL );
+   ppu_bind( (nes != NULL) ? nes->ppu : NULL );
+   apu_bind( (nes != NULL) ? nes->apu : NULL );
+   cartridge_bind( (nes != NULL) ? nes->cartridge : NULL );
+   controllers_bind( (nes != NULL) ? nes->controllers : NULL );
+}
+
+nes_t* nes_get_bound(void)
+{
+   return bound;
+}
+
+bool nes_load_rom(const char* path)
+{
+   cartridge_free_memory();
+   if (!cartridge_load(path))
+   {
+      return false;
+   }
+
+   cpu_clear_ram();
+   controllers_reset();
+   cpu_init();
+   apu_reset_internals();
+
+   return true;
+}
+
+/**
+ * Frees whichever of an instance's contexts were created, and the instance itself.
+*/
+static void nes_free_contexts(nes_t* nes)
+{
+   cpu_context_destroy(nes->cpu);
+   bus_context_destroy(nes->bus);
+   ppu_context_destroy(nes->ppu);
+   apu_context_destroy(nes->apu);
+   cartridge_context_destroy(nes->cartridge);
+   controllers_context_destroy(nes->controllers);
+   free(nes);
+}
@@ -4,7 +4,6 @@
 #include <stdio.h>
 #include <string.h>
 #include "vec3.h"
-#include "vec4.h"
 
 #include "../includes/ppu.h"
 #include "../includes/cartridge.h"
@@ -12,6 +11,7 @@
 #include "../includes/bus.h"
 #include "../includes/ppu_renderer_lookup.h"
 #include "../includes/display.h"
+#include "../includes/util.h"
 
 // cpu mapped addresses of PPU ports at 0x2000 - 0x2007 and 0x4041
 
@@ -27,68 +27,138 @@
 
 #define PALETTE_START 0x3F00
 
-// internal registers
+// 64 rgb colors for system_palette, shared by every instance
+static vec3 system_palette[64];
 
-static uint8_t ppu_control = 0;
-static uint8_t ppu_mask = 0;
-static uint8_t ppu_status = 0xA0;
-static uint8_t oam_address = 0;
-static uint8_t oam_data = 0;
+// retrieves palette index that is mirrored if necessary
+// host pointers for the 1kb pattern table and nametable pages, unmapped pages read as zero
+static const uint8_t unmapped_page[PPU_PAGE_SIZE];
 
-static bool write_toggle = false; // false: first write, true: second write for PPUADDR and PPUSCROLL port, set to false when ppu_status is read
-static uint8_t x_register = 0;    // fine x scroll (3 bits)
-static uint16_t t_register = 0;   // 15-bit temporary vram address
-static uint16_t v_register = 0;   // current vram address that when used through port $2007 to access ppu memory only 14 bits are used, but it is otherwise a 15 bit register
+struct Ppu_Context_t
+{
+   // internal registers
 
-static uint8_t  nametable_byte = 0;
-static uint8_t  pattern_tile_lo_bits = 0;
-static uint8_t  pattern_tile_hi_bits = 0;
-static uint8_t  attribute_byte = 0;
-static uint16_t tile_shift_register_lo = 0;
-static uint16_t tile_shift_register_hi = 0;
-static uint8_t  attribute_shift_register_lo = 0;
-static uint8_t  attribute_shift_register_hi = 0;
-static uint8_t  attribute_1_bit_latch_x = 0;     // 1 bit value selected by bit 1 of coarse_x
-static uint8_t  attribute_1_bit_latch_y = 0;     // 1 bit value selected by bit 1 of coarse_y
+   uint8_t ppu_control;
+   uint8_t ppu_mask;
+   uint8_t ppu_status;
+   uint8_t oam_address;
+   uint8_t oam_data;
 
-static bool odd_even_flag = true; // false: on a odd frame, true: on a even frame
+   bool write_toggle;     // false: first write, true: second write for PPUADDR and PPUSCROLL port, set to false when ppu_status is read
+   uint8_t x_register;    // fine x scroll (3 bits)
+   uint16_t t_register;   // 15-bit temporary vram address
+   uint16_t v_register;   // current vram address that when used through port $2007 to access ppu memory only 14 bits are used, but it is otherwise a 15 bit register
 
-// bus
+   uint8_t  nametable_byte;
+   uint8_t  pattern_tile_lo_bits;
+   uint8_t  pattern_tile_hi_bits;
+   uint8_t  attribute_byte;
+   uint16_t tile_shift_register_lo;
+   uint16_t tile_shift_register_hi;
+   uint8_t  attribute_shift_register_lo;
+   uint8_t  attribute_shift_register_hi;
+   uint8_t  attribute_1_bit_latch_x;     // 1 bit value selected by bit 1 of coarse_x
+   uint8_t  attribute_1_bit_latch_y;     // 1 bit value selected by bit 1 of coarse_y
 
-static uint8_t read_buffer = 0;   // internal buffer that holds contents being read from port 2007 that are non-pallete addresses
-static uint8_t open_bus = 0;
+   bool odd_even_flag; // false: on a odd frame, true: on a even frame
 
-// memory
+   // bus
 
-static uint8_t palette_ram[32];
-static uint8_t oam_ram[256];
-static input_sprite_t secondary_oam_ram[8];
-static output_sprite_t output_sprites[8]; // array of fetched sprites that will be rendered on the next scanline
-static uint8_t number_of_sprites = 0;     // number of sprites to draw on the next scanline
+   uint8_t read_buffer;   // internal buffer that holds contents being read from port 2007 that are non-pallete addresses
+   uint8_t open_bus;
 
-// track current scanline and cycles
+   // memory
 
-static uint16_t scanline = 261;
-static uint16_t cycle = 0;
+   uint8_t palette_ram[32];
+   uint8_t oam_ram[256];
+   input_sprite_t secondary_oam_ram[8];
+   output_sprite_t output_sprites[8]; // array of fetched sprites that will be rendered on the next scanline
+   uint8_t number_of_sprites;         // number of sprites to draw on the next scanline
+   uint8_t sprite_fetch_index;        // output sprite the next fetch_sprites call fills in
 
-// 64 rgb colors for system_palette
-static vec3 system_palette[64];
+   // track current scanline and cycles
 
-static bool oam_dma_scheduled = false;
-static uint16_t oam_dma_address;
+   uint16_t scanline;
+   uint16_t cycle;
 
-// retrieves palette index that is mirrored if necessary
+   // finished pixels of the current frame as 6 bit system palette indices, colors are resolved by the display
+   uint8_t frame_pixels[PPU_FRAME_H * PPU_FRAME_W];
+   uint8_t frame_emphasis[PPU_FRAME_H]; // color emphasis bits 5-7 of ppu_mask, sampled per scanline
+
+   bool oam_dma_scheduled;
+   uint16_t oam_dma_address;
+
+   const uint8_t* ppu_pages[PPU_PAGE_COUNT];
+   void (*fetch_hook)(uint16_t position);
+   bool is_frame_output; // finished frames are published to the display
+
+   // the ppu is run in bulk only when something can observe it
+
+   long ppu_dot; // ppu cycles run so far, 3 per cpu cycle so ppu_dot / 3 is the cpu cycle the ppu is in
+};
+
+static Ppu_Context_t default_context =
+{
+   .ppu_status = 0xA0,
+   .odd_even_flag = true,
+   .scanline = 261,
+   .ppu_pages =
+   {
+      unmapped_page, unmapped_page, unmapped_page, unmapped_page,
+      unmapped_page, unmapped_page, unmapped_page, unmapped_page,
+      unmapped_page, unmapped_page, unmapped_page, unmapped_page,
+   },
+   .is_frame_output = true,
+};
+static NES_THREAD_LOCAL Ppu_Context_t* ppu = &default_context; // context of the instance bound to this thread
+
+static void update_nmi_deadline(void);
+static void render_scanline_batched(void);
+static inline int get_sprite_pixel(uint16_t dot, uint8_t* sprite_pixel);
+static inline void draw_pixel(uint16_t dot, uint8_t background_pixel, uint8_t sprite_pixel, int active_sprite);
+
+static inline uint8_t ppu_fetch(uint16_t position);
 static uint8_t get_palette_index(uint8_t index);
 static uint8_t flip_bits_horizontally(uint8_t in);
 static void sprite_evaluation(void);
 
+Ppu_Context_t* ppu_context_create(void)
+{
+   Ppu_Context_t* context = calloc(1, sizeof(Ppu_Context_t));
+   if (context == NULL)
+   {
+      return NULL;
+   }
+
+   context->ppu_status = 0xA0;
+   context->odd_even_flag = true;
+   context->scanline = 261;
+   for (int i = 0; i < PPU_PAGE_COUNT; ++i)
+   {
+      context->ppu_pages[i] = unmapped_page;
+   }
+   context->is_frame_output = true;
+
+   return context;
+}
+
+void ppu_context_destroy(Ppu_Context_t* context)
+{
+   free(context);
+}
+
+void ppu_bind(Ppu_Context_t* context)
+{
+   ppu = (context != NULL) ? context : &default_context;
+}
+
 void ppu_cycle(bool* nmi_flip_flop)
 {
    uint8_t background_pixel = 0;
    uint8_t sprite_pixel = 0;
 
    // background tile rendering
-   if ( (cycle >= 1 && cycle <= 256) || (cycle >= 321 && cycle <= 336) )
+   if ( (ppu->cycle >= 1 && ppu->cycle <= 256) || (ppu->cycle >= 321 && ppu->cycle <= 336) )
    {
       /**
        * Output pixel bit pattern
@@ -102,263 +172,184 @@ void ppu_cycle(bool* nmi_flip_flop)
       // PPU selects bits to output a final color index for a pixel, after which shift registers are shifted 1 bit 
       // and every 8 cycles the shift registers are reloaded with newly fetched data.
 
-      uint8_t position = 15 - x_register; // position of the bit to select
+      uint8_t position = 15 - ppu->x_register; // position of the bit to select
 
-      background_pixel = (tile_shift_register_lo >> position) & 0x1;              // set bit 0
-      background_pixel |= ( (tile_shift_register_hi >> position) & 0x1 ) << 1;    // set bit 1
+      background_pixel = (ppu->tile_shift_register_lo >> position) & 0x1;              // set bit 0
+      background_pixel |= ( (ppu->tile_shift_register_hi >> position) & 0x1 ) << 1;    // set bit 1
 
-      position = 7 - x_register;
+      position = 7 - ppu->x_register;
 
-      background_pixel |= ( (attribute_shift_register_lo >> position) & 0x1 ) << 2; // set bit 2
-      background_pixel |= ( (attribute_shift_register_hi >> position) & 0x1 ) << 3; // set bit 3
+      background_pixel |= ( (ppu->attribute_shift_register_lo >> position) & 0x1 ) << 2; // set bit 2
+      background_pixel |= ( (ppu->attribute_shift_register_hi >> position) & 0x1 ) << 3; // set bit 3
 
       // shift registers left by 1
 
-      tile_shift_register_lo = tile_shift_register_lo << 1;
-      tile_shift_register_hi = tile_shift_register_hi << 1;
+      ppu->tile_shift_register_lo = ppu->tile_shift_register_lo << 1;
+      ppu->tile_shift_register_hi = ppu->tile_shift_register_hi << 1;
 
       // the bit in the 1 bit latches are shifted into the attribute shift registers
 
-      attribute_shift_register_lo = attribute_shift_register_lo << 1;
-      attribute_shift_register_lo |= attribute_1_bit_latch_x;          
-      attribute_shift_register_hi = attribute_shift_register_hi << 1;
-      attribute_shift_register_hi |= attribute_1_bit_latch_y;
+      ppu->attribute_shift_register_lo = ppu->attribute_shift_register_lo << 1;
+      ppu->attribute_shift_register_lo |= ppu->attribute_1_bit_latch_x;          
+      ppu->attribute_shift_register_hi = ppu->attribute_shift_register_hi << 1;
+      ppu->attribute_shift_register_hi |= ppu->attribute_1_bit_latch_y;
    }
 
    int active_sprite = -1;
    //if (scanline == 30) ppu_status |= 0x40;
    // sprite rendering
-   if (cycle >= 1 && cycle <= 256 && scanline <= 239) 
+   if (ppu->cycle >= 1 && ppu->cycle <= 256 && ppu->scanline <= 239) 
    {
-      bool sprite_found = false;
-
-      // search for the first in range opaque sprite pixel on the horizontal axis
-      for (int i = 0; i < 8; ++i)
-      {
-         if ( cycle >= output_sprites[i].x_position + 1 && cycle - (output_sprites[i].x_position + 1) <= 8 /*&& scanline != 0*/ )
-         {
-            if (!sprite_found)
-            {
-               // contruct 4 bit pallete index with pattern table bitplanes and attribute bytes of the sprite
-               sprite_pixel =  (output_sprites[i].lo_bitplane >> 7) & 0x1;
-               sprite_pixel |= ( (output_sprites[i].hi_bitplane >> 7) & 0x1 ) << 1;
-               sprite_pixel |= (output_sprites[i].attribute & 0x3) << 2;
-
-               if ( (sprite_pixel & 0x3) != 0 ) // only set sprite found to true if the sprite pixel found is not transparent
-               {
-                  sprite_found = true;
-                  active_sprite = i;
-               }
-            }
-
-            // shift bitplanes once they have been used to render a pixel
-            output_sprites[i].lo_bitplane = output_sprites[i].lo_bitplane << 1;
-            output_sprites[i].hi_bitplane = output_sprites[i].hi_bitplane << 1;
-         }
-      }
+      active_sprite = get_sprite_pixel(ppu->cycle, &sprite_pixel);
    }
 
    // scanline 0-239 (i.e 240 scanlines) are the visible scanlines to the display
-   if (scanline <= 239)
+   if (ppu->scanline <= 239)
    {
-      uint8_t output_pixel = 0;
-
-      if (ppu_mask & 0x18) // check if rendering is enabled
+      if (ppu->ppu_mask & 0x18) // check if rendering is enabled
       {
-         scanline_lookup[cycle]();
+         scanline_lookup[ppu->cycle]();
 
-         if (cycle == 1)
+         if (ppu->cycle == 1)
          {
             sprite_clear_secondary_oam(); // for simplicity, initialize secondary oam all cycle 1 of ppu visible scanlines
          }
 
-         if (cycle == 65)
+         if (ppu->cycle == 65)
          {
             sprite_evaluation();         // for simplicity, do sprite evaluation all in 1 ppu cycle during cycle 65 of a visible scanline
          }
 
          // check if rendering of background or sprite pixels are disabled, if disabled just set color to transparent background color
-         if ( (ppu_mask & 0x08) == 0 )
+         if ( (ppu->ppu_mask & 0x08) == 0 )
          {
             background_pixel = 0;
          }
-         else if ( (ppu_mask & 0x10) == 0 )
+         else if ( (ppu->ppu_mask & 0x10) == 0 )
          {
             sprite_pixel = 0;
          }
       }
 
-      if (cycle >= 1 && cycle <= 256)
+      if (ppu->cycle >= 1 && ppu->cycle <= 256)
       {
-         if (cycle <= 8)
-         {
-            // hide background pixels on leftmost 8 pixels of screen
-            if ((ppu_mask & 0x2) == 0)
-            {
-               background_pixel &= 0xC;
-            }
-         }
-
-         // no active sprite for this pixel so we just choose from the background
-         if (active_sprite == -1)
-         {
-            if ( (background_pixel & 0x3) == 0 ) // transparent pixels will display colors at 0x3F00
-            {
-               output_pixel = 0;
-            }
-            else
-            {
-               output_pixel = background_pixel;
-            }
-         }
-         // active sprite present so we must determine whether to render the background or sprite
-         else
-         {
-            if (cycle <= 8)
-            {
-               // hide sprite pixels on leftmost 8 pixels of screen
-               if ((ppu_mask & 0x4) == 0)
-               {
-                  sprite_pixel &= 0xC;
-               }
-            }
-
-            // bg and sp are background and sprite color indices within a palette, 0 means that color is the transparent background color
-            uint8_t bg = background_pixel & 0x3;
-            uint8_t sp = sprite_pixel & 0x3;
-
-            // 0: sprite is in front of background, 1: sprite is behind background
-            uint8_t sp_priority = (output_sprites[active_sprite].attribute & 0x20) >> 5;
-
-            if (bg == 0 && sp == 0)      output_pixel = 0;
-            else if (bg == 0 && sp != 0) output_pixel = 0x10 | sprite_pixel;
-            else if (bg != 0 && sp == 0) output_pixel = background_pixel;
-            else                         output_pixel = (sp_priority) ? background_pixel : (0x10 | sprite_pixel);
-
-            // check for sprite 0 hit
-            if ( output_sprites[active_sprite].sprite_id == 0 )
-            {
-               if ( sprite_pixel != 0 &&  background_pixel != 0 )
-               {
-                  ppu_status |= 0x40;
-               }
-            }
-         }
-         //output_pixel = 0x0 | (output_pixel & 0x3);
-
-         uint8_t palette_index = palette_ram[ output_pixel & 0x1F ] ;
-         set_viewport_pixel_color( scanline, cycle - 1, system_palette[palette_index & 0x3F] );
+         draw_pixel(ppu->cycle, background_pixel, sprite_pixel, active_sprite);
       }
    }
-   else if (scanline >= 240 && scanline <= 260) // vertical blank scanlines
+   else if (ppu->scanline >= 240 && ppu->scanline <= 260) // vertical blank scanlines
    {
-      if (scanline == 241 && cycle == 1)
+      if (ppu->scanline == 241 && ppu->cycle == 1)
 		{
-         display_update_color_buffer(); // update color buffer after visible scanlines are finished rendering
+         if (ppu->is_frame_output)
+         {
+            display_update_color_buffer(); // update color buffer after visible scanlines are finished rendering
+         }
 
-         if (ppu_control & 0x80)
+         if (ppu->ppu_control & 0x80)
          {
             *nmi_flip_flop = true;
          }
 
-         ppu_status |= 0x80; // set VBlank flag on cycle 1 of scanline 241  
+         ppu->ppu_status |= 0x80; // set VBlank flag on cycle 1 of scanline 241  
       }
 
       // ppu performs no memory accesses during vertical blank scanlines so we just do nothing here
    }
    else // pre-render scanline 261
    {
-      if (cycle == 1)
+      if (ppu->cycle == 1)
       {
-         odd_even_flag = !odd_even_flag;
-         ppu_status &= ~0xE0; // clear VBlank and sprite 0 flag on cycle 1 of scanline 261
+         ppu->odd_even_flag = !ppu->odd_even_flag;
+         ppu->ppu_status &= ~0xE0; // clear VBlank and sprite 0 flag on cycle 1 of scanline 261
       }
 
-      if (cycle >= 280 && cycle <= 304)
+      if (ppu->cycle >= 280 && ppu->cycle <= 304)
       {
-         if (ppu_mask & 0x18) 
+         if (ppu->ppu_mask & 0x18) 
 				transfer_t_vertical(); // reload vertical scroll bits if rendering enabled
       }
-      else if (cycle == 339)
+      else if (ppu->cycle == 339)
       {
-         if (ppu_mask & 0x18 && odd_even_flag == false) 
-				cycle = 340; // frames are 1 cycle shorted every odd frame 
+         if (ppu->ppu_mask & 0x18 && ppu->odd_even_flag == false) 
+				ppu->cycle = 340; // frames are 1 cycle shorted every odd frame 
       }
 
-      if (ppu_mask & 0x18) 
-			scanline_lookup[cycle](); // execute function from lookup table if rendering enabled
+      if (ppu->ppu_mask & 0x18) 
+			scanline_lookup[ppu->cycle](); // execute function from lookup table if rendering enabled
    }
 
-   cycle++;
-   if (cycle == 341) // finish processing 341 cycles of 1 scanline, move onto the next scanline
+   ppu->cycle++;
+   if (ppu->cycle == 341) // finish processing 341 cycles of 1 scanline, move onto the next scanline
    {
-      cycle = 0;
-      scanline++;
-      scanline = scanline % 262;
+      ppu->cycle = 0;
+      ppu->scanline++;
+      ppu->scanline = ppu->scanline % 262;
    }
 }
 
 void ppu_port_write(uint16_t position, uint8_t data)
 {
+   ppu_catch_up();
+
    switch(position)
    {
       case PPUCTRL:
-         ppu_control = data;
+         ppu->ppu_control = data;
          // transfer bits 0-1 of ppu_control to bits 10-11 of t_register
-         uint16_t NN = (ppu_control & 0x3) << 10;
-         t_register = t_register & ~(0x0C00); // clear bits 10-11 of t_register before transfering bits 0-1
-         t_register = t_register | NN;
+         uint16_t NN = (ppu->ppu_control & 0x3) << 10;
+         ppu->t_register = ppu->t_register & ~(0x0C00); // clear bits 10-11 of t_register before transfering bits 0-1
+         ppu->t_register = ppu->t_register | NN;
          break;
       case PPUMASK:
-         ppu_mask = data;
+         ppu->ppu_mask = data;
          break;
       case OAMADDR:
-         oam_address = data;
+         ppu->oam_address = data;
          break;
       case PPUSCROLL:
-         if (!write_toggle) // first write
+         if (!ppu->write_toggle) // first write
          {
-            x_register = data & 0x7; // bits 0-2 stored into x_register
+            ppu->x_register = data & 0x7; // bits 0-2 stored into x_register
 
-            t_register = t_register & ~(0x001F); // clear bits 0-4 before transfer
-            t_register = t_register | ( (data & 0xF8) >> 3 ); // bits 3-7 stored into bits 0-4 of t_register
+            ppu->t_register = ppu->t_register & ~(0x001F); // clear bits 0-4 before transfer
+            ppu->t_register = ppu->t_register | ( (data & 0xF8) >> 3 ); // bits 3-7 stored into bits 0-4 of t_register
 
-            write_toggle = true;
+            ppu->write_toggle = true;
          }
          else // second write
          {
-            t_register = t_register & ~(0x73E0); // clear bits 5-9 and bits 12-14 before transfer
-            t_register = t_register | ( (data & 0x7) << 12 ); // bits 0-2 stored into bits 12-14 of t_register
-            t_register = t_register | ( (data & 0xF8) << 2 ); // bits 3-7 stored into bits 5-9 of t_register
+            ppu->t_register = ppu->t_register & ~(0x73E0); // clear bits 5-9 and bits 12-14 before transfer
+            ppu->t_register = ppu->t_register | ( (data & 0x7) << 12 ); // bits 0-2 stored into bits 12-14 of t_register
+            ppu->t_register = ppu->t_register | ( (data & 0xF8) << 2 ); // bits 3-7 stored into bits 5-9 of t_register
 
-            write_toggle = false;
+            ppu->write_toggle = false;
          }
 
          break;
       case PPUADDR:
-         if (!write_toggle)
+         if (!ppu->write_toggle)
          {
             // writing high byte (first write)
-            t_register = t_register & ~(0x7F00);
-            t_register = t_register | (data & 0x3F) << 8; 
+            ppu->t_register = ppu->t_register & ~(0x7F00);
+            ppu->t_register = ppu->t_register | (data & 0x3F) << 8; 
             
-            write_toggle = true;
+            ppu->write_toggle = true;
          }
          else
          {
             // writing low byte (second write)
-            t_register = t_register & ~(0x00FF);
-            t_register = t_register | data;
-            v_register = t_register;
+            ppu->t_register = ppu->t_register & ~(0x00FF);
+            ppu->t_register = ppu->t_register | data;
+            ppu->v_register = ppu->t_register;
 
-            write_toggle = false;
+            ppu->write_toggle = false;
          }
 
          break;
       case OAMDMA:
       {
-			oam_dma_scheduled = true;
-			oam_dma_address = data << 8;
+			ppu->oam_dma_scheduled = true;
+			ppu->oam_dma_address = data << 8;
 
          //uint16_t read_address = data << 8;
          //cpu_tick();
@@ -372,71 +363,73 @@ void ppu_port_write(uint16_t position, uint8_t data)
          break;
       }
       case OAMDATA:
-         oam_data = data;         
-         oam_ram[oam_address] = oam_data;
-         oam_address += 1;
+         ppu->oam_data = data;         
+         ppu->oam_ram[ppu->oam_address] = ppu->oam_data;
+         ppu->oam_address += 1;
          break;
       case PPUDATA:
-         if ( (v_register & 0x3FFF) >= PALETTE_START )
+         if ( (ppu->v_register & 0x3FFF) >= PALETTE_START )
          {
             // writing to palette ram
-            palette_ram[get_palette_index( v_register & 0x1F )] = data;
+            ppu->palette_ram[get_palette_index( ppu->v_register & 0x1F )] = data;
          }
          else
          {
-            cartridge_ppu_write(v_register & 0x3FFF, data);
+            cartridge_ppu_write(ppu->v_register & 0x3FFF, data);
          }
 
-         if (ppu_control & 0x4)
+         if (ppu->ppu_control & 0x4)
          {
-            v_register += 32;
+            ppu->v_register += 32;
          }
          else
          {
-            v_register += 1;
+            ppu->v_register += 1;
          }
          break;
    }
 
-   open_bus = data; // writes to any ppu ports loads a value into the I/O bus
+   ppu->open_bus = data; // writes to any ppu ports loads a value into the I/O bus
 }
 
 uint8_t ppu_port_read(uint16_t position)
 {
+   ppu_catch_up();
+
    switch(position)
    {
       case OAMDATA: // read/write
-         oam_data = oam_ram[oam_address];
-         open_bus = oam_data;
+         ppu->oam_data = ppu->oam_ram[ppu->oam_address];
+         ppu->open_bus = ppu->oam_data;
          break;
       case PPUDATA:
-         open_bus = read_buffer;
-         read_buffer = cartridge_ppu_read(v_register);
+         ppu->open_bus = ppu->read_buffer;
+         ppu->read_buffer = cartridge_ppu_read(ppu->v_register);
          
          // when reading palette, data is returned directly from palette ram rather than the internal read buffer
-         if ( (v_register & 0x3FFF) >= PALETTE_START )
+         if ( (ppu->v_register & 0x3FFF) >= PALETTE_START )
          {
-            open_bus = palette_ram[ get_palette_index(v_register & 0x1F) ];
+            ppu->open_bus = ppu->palette_ram[ get_palette_index(ppu->v_register & 0x1F) ];
          }
 
-         if (ppu_control & 0x4)
+         if (ppu->ppu_control & 0x4)
          {
-            v_register += 32;
+            ppu->v_register += 32;
          }
          else
          {
-            v_register += 1;
+            ppu->v_register += 1;
          }
 
          break;
       case PPUSTATUS: // read only
-         open_bus = (ppu_status & 0xE0) | (open_bus & 0x1F); // load ppu status onto bits 7-5 of the open bus
-         write_toggle = false;
-         ppu_status &= ~0x80; // clear vertical blank flag after read
+         ppu->open_bus = (ppu->ppu_status & 0xE0) | (ppu->open_bus & 0x1F); // load ppu status onto bits 7-5 of the open bus
+         ppu->write_toggle = false;
+         ppu->ppu_status &= ~0x80; // clear vertical blank flag after read
          break;
    }
 
-   return open_bus;
+   return ppu->open_bus;
 }
 
 void rest_cycle(void){return;} // function that does nothing to fill gaps inside the render event lookup table
@@ -444,7 +437,7 @@ void rest_cycle(void){return;} // function that does nothing to fill gaps inside
 
 void fetch_nametable(void)
 {
-   nametable_byte = cartridge_ppu_read( 0x2000 | (v_register & 0x0FFF) );
+   ppu->nametable_byte = ppu_fetch( 0x2000 | (ppu->v_register & 0x0FFF) );
 }
 
 /*
@@ -457,10 +450,10 @@ void fetch_nametable(void)
 void fetch_attribute()
 {
    //                                     nametable select         hi 3 bit of coarse y           hi 3 bit of coarse x
-   uint16_t attribute_address = 0x23C0 | (v_register & 0x0C00) | ( (v_register >> 4) & 0x38 ) | ( (v_register >> 2) & 0x07 );
+   uint16_t attribute_address = 0x23C0 | (ppu->v_register & 0x0C00) | ( (ppu->v_register >> 4) & 0x38 ) | ( (ppu->v_register >> 2) & 0x07 );
    //                           0x23C0 means select from address space 0x2000 and up with a 960 byte offset. Attribute table is the last 64 bytes of our 1024 byte nametable
 
-   attribute_byte = cartridge_ppu_read(attribute_address);
+   ppu->attribute_byte = ppu_fetch(attribute_address);
 }
 
 /* 
@@ -473,14 +466,14 @@ void fetch_attribute()
 */
 void fetch_pattern_table_lo()
 {
-   uint16_t pattern_tile_address =  ( (ppu_control & 0x10) << 8 )  | (nametable_byte << 4) | ( (v_register >> 12) & 0x7 );
-   pattern_tile_lo_bits = cartridge_ppu_read(pattern_tile_address);
+   uint16_t pattern_tile_address =  ( (ppu->ppu_control & 0x10) << 8 )  | (ppu->nametable_byte << 4) | ( (ppu->v_register >> 12) & 0x7 );
+   ppu->pattern_tile_lo_bits = ppu_fetch(pattern_tile_address);
 }
 
 void fetch_pattern_table_hi()
 {
-   uint16_t pattern_tile_address =  ( (ppu_control & 0x10) << 8 )  | (nametable_byte << 4) | (1 << 3) | ( (v_register >> 12) & 0x7 );
-   pattern_tile_hi_bits = cartridge_ppu_read(pattern_tile_address);
+   uint16_t pattern_tile_address =  ( (ppu->ppu_control & 0x10) << 8 )  | (ppu->nametable_byte << 4) | (1 << 3) | ( (ppu->v_register >> 12) & 0x7 );
+   ppu->pattern_tile_hi_bits = ppu_fetch(pattern_tile_address);
 }
 
 /**
@@ -490,26 +483,26 @@ void fetch_pattern_table_hi()
 void increment_v_horizontal(void)
 {
    // load shift registers with new data
-   tile_shift_register_lo |= pattern_tile_lo_bits;
-   tile_shift_register_hi |= pattern_tile_hi_bits;
+   ppu->tile_shift_register_lo |= ppu->pattern_tile_lo_bits;
+   ppu->tile_shift_register_hi |= ppu->pattern_tile_hi_bits;
 
    // load 1 bit latches with a bit selected by bit 1 of coarse x and y
-   uint8_t x_bit = (v_register >> 1) & 0x1;
-   uint8_t y_bit = (v_register >> 6) & 0x1;
+   uint8_t x_bit = (ppu->v_register >> 1) & 0x1;
+   uint8_t y_bit = (ppu->v_register >> 6) & 0x1;
    
 
    uint8_t position = x_bit * 2 + y_bit * 4;
-   attribute_1_bit_latch_x = ( attribute_byte & (1 << position) ) >> position;
-   attribute_1_bit_latch_y = ( attribute_byte & ( 1 << (position + 1) ) ) >> (position + 1);
+   ppu->attribute_1_bit_latch_x = ( ppu->attribute_byte & (1 << position) ) >> position;
+   ppu->attribute_1_bit_latch_y = ( ppu->attribute_byte & ( 1 << (position + 1) ) ) >> (position + 1);
 
-   if ( (v_register & 0x1F) == 31 ) // coarse X are bits 0-4 which can represent values 0-31, so overflow will happen if coarse X == 31 when we increment
+   if ( (ppu->v_register & 0x1F) == 31 ) // coarse X are bits 0-4 which can represent values 0-31, so overflow will happen if coarse X == 31 when we increment
    {
-      v_register = v_register & (~0x1F); // wrap back down to zero on overflow
-      v_register = v_register ^ 0x400;   // toggle bit 10 on overflow to switch nametables
+      ppu->v_register = ppu->v_register & (~0x1F); // wrap back down to zero on overflow
+      ppu->v_register = ppu->v_register ^ 0x400;   // toggle bit 10 on overflow to switch nametables
    }
    else
    {
-      v_register += 1;
+      ppu->v_register += 1;
    }
 }
 
@@ -519,18 +512,18 @@ void increment_v_horizontal(void)
 */
 void increment_v_vertical(void)
 {
-   if ( (v_register & 0x7000) == 0x7000 ) // fine y bits == 7 which means overflow will happen
+   if ( (ppu->v_register & 0x7000) == 0x7000 ) // fine y bits == 7 which means overflow will happen
    {
-      v_register &= ~0x7000; // fine y bits wrap down to zero
+      ppu->v_register &= ~0x7000; // fine y bits wrap down to zero
 
-      uint8_t coarse_y = (v_register >> 5) & 0x1F;
+      uint8_t coarse_y = (ppu->v_register >> 5) & 0x1F;
 
       // when fine y wraps down to zero, we increment coarse_y bits
 
       if (coarse_y == 29) // toggle bit 11 on overflow
       {
          coarse_y = 0;
-         v_register ^= 0x800; // switch vertical nametables
+         ppu->v_register ^= 0x800; // switch vertical nametables
       }
       else if (coarse_y == 31) // bit 11 does not get toggled when set out of bounds, nametable rows are only index 0-29 (30 rows)
       {
@@ -541,11 +534,11 @@ void increment_v_vertical(void)
          coarse_y += 1;
       }
 
-      v_register = (v_register & ~0x3E0) | (coarse_y << 5);
+      ppu->v_register = (ppu->v_register & ~0x3E0) | (coarse_y << 5);
    }
    else
    {
-      v_register += 0x1000;
+      ppu->v_register += 0x1000;
    }
 }
 
@@ -560,7 +553,7 @@ void increment_v_both(void)
 */
 void transfer_t_horizontal(void)
 {
-   v_register = (v_register & ~0x41F) | (t_register & 0x41F);
+   ppu->v_register = (ppu->v_register & ~0x41F) | (ppu->t_register & 0x41F);
 }
 
 /**
@@ -568,25 +561,25 @@ void transfer_t_horizontal(void)
 */
 void transfer_t_vertical(void)
 {
-   v_register = (v_register & ~0x7BE0) | (t_register & 0x7BE0);
+   ppu->v_register = (ppu->v_register & ~0x7BE0) | (ppu->t_register & 0x7BE0);
 }
 
 void sprite_clear_secondary_oam(void)
 {
    for (size_t i = 0; i < 8; ++i)
    {
-      secondary_oam_ram[i].sprite_id  = 0xFF;
-      secondary_oam_ram[i].tile_id    = 0xFF;
-      secondary_oam_ram[i].y_coord    = 0xFF;
-      secondary_oam_ram[i].attribute  = 0xFF;
-      secondary_oam_ram[i].x_position = 0xFF;
+      ppu->secondary_oam_ram[i].sprite_id  = 0xFF;
+      ppu->secondary_oam_ram[i].tile_id    = 0xFF;
+      ppu->secondary_oam_ram[i].y_coord    = 0xFF;
+      ppu->secondary_oam_ram[i].attribute  = 0xFF;
+      ppu->secondary_oam_ram[i].x_position = 0xFF;
    }
 }
 
 bool ppu_scheduled_oam_dma(void)
 {
-	bool temp = oam_dma_scheduled;
-	oam_dma_scheduled = false;
+	bool temp = ppu->oam_dma_scheduled;
+	ppu->oam_dma_scheduled = false;
 	return temp;
 }
 
@@ -595,9 +588,10 @@ void ppu_handle_oam_dma(void)
 	for (uint16_t i = 0; i < 256; ++i)
 	{
 		cpu_tick();
-		oam_data = cpu_bus_read(oam_dma_address + i);
-		oam_ram[oam_address] = oam_data;
-		oam_address += 1;
+		ppu->oam_data = cpu_bus_read(ppu->oam_dma_address + i);
+		ppu_catch_up(); // sprite evaluation must not see oam bytes before they are written
+		ppu->oam_ram[ppu->oam_address] = ppu->oam_data;
+		ppu->oam_address += 1;
 	}
 }
 
@@ -605,32 +599,32 @@ static void sprite_evaluation(void)
 {
    uint8_t secondary_oam_index = 0;
    uint8_t sprite_id = 0;
-   number_of_sprites = 0;
+   ppu->number_of_sprites = 0;
    while ( true )
    {
-      uint8_t y_coord = oam_ram[oam_address];
+      uint8_t y_coord = ppu->oam_ram[ppu->oam_address];
       if ( secondary_oam_index < 8 )
       {
-         secondary_oam_ram[secondary_oam_index].sprite_id = sprite_id;
-         secondary_oam_ram[secondary_oam_index].y_coord = y_coord;
+         ppu->secondary_oam_ram[secondary_oam_index].sprite_id = sprite_id;
+         ppu->secondary_oam_ram[secondary_oam_index].y_coord = y_coord;
 
-         if ( (scanline - y_coord) >= 0 && (scanline - y_coord) < ((ppu_control & 0x20) ? 16 : 8) ) // if sprite is in y range, copy rest of sprite data into secondary oam
+         if ( (ppu->scanline - y_coord) >= 0 && (ppu->scanline - y_coord) < ((ppu->ppu_control & 0x20) ? 16 : 8) ) // if sprite is in y range, copy rest of sprite data into secondary oam
          {
-            secondary_oam_ram[secondary_oam_index].tile_id    = oam_ram[oam_address + 1]; // tile index
-            secondary_oam_ram[secondary_oam_index].attribute  = oam_ram[oam_address + 2]; // attributes
-            secondary_oam_ram[secondary_oam_index].x_position = oam_ram[oam_address + 3]; // x position
+            ppu->secondary_oam_ram[secondary_oam_index].tile_id    = ppu->oam_ram[ppu->oam_address + 1]; // tile index
+            ppu->secondary_oam_ram[secondary_oam_index].attribute  = ppu->oam_ram[ppu->oam_address + 2]; // attributes
+            ppu->secondary_oam_ram[secondary_oam_index].x_position = ppu->oam_ram[ppu->oam_address + 3]; // x position
             secondary_oam_index += 1; // increment to next free location in secondary oam
-            number_of_sprites += 1;
+            ppu->number_of_sprites += 1;
          }
       }
 
-      if ( (oam_address + 4) > 255 ) // finish sprite evaluation when all sprites in oam_ram has been scanned
+      if ( (ppu->oam_address + 4) > 255 ) // finish sprite evaluation when all sprites in oam_ram has been scanned
       {
          break;
       }
       else
       {
-         oam_address += 4;          // else increment oam_address by 4 bytes and continue evaluation
+         ppu->oam_address += 4;          // else increment oam_address by 4 bytes and continue evaluation
          sprite_id += 1;
       }
    }
@@ -649,34 +643,34 @@ static void sprite_evaluation(void)
 // we cheat a little here and fetch sprites all on a single ppu cycle for simplicity
 void fetch_sprites(void)
 {
-	static uint8_t i = 0;
-   oam_address = 0;
+	uint8_t i = ppu->sprite_fetch_index;
+   ppu->oam_address = 0;
    
-	uint8_t sprite_fine_y        = (uint8_t) (scanline - secondary_oam_ram[i].y_coord); // row within a sprite
-   uint8_t tile_number          = secondary_oam_ram[i].tile_id;
-   output_sprites[i].sprite_id  = secondary_oam_ram[i].sprite_id;
-   output_sprites[i].attribute  = secondary_oam_ram[i].attribute;
-   output_sprites[i].x_position = secondary_oam_ram[i].x_position;
+	uint8_t sprite_fine_y        = (uint8_t) (ppu->scanline - ppu->secondary_oam_ram[i].y_coord); // row within a sprite
+   uint8_t tile_number          = ppu->secondary_oam_ram[i].tile_id;
+   ppu->output_sprites[i].sprite_id  = ppu->secondary_oam_ram[i].sprite_id;
+   ppu->output_sprites[i].attribute  = ppu->secondary_oam_ram[i].attribute;
+   ppu->output_sprites[i].x_position = ppu->secondary_oam_ram[i].x_position;
 
 	uint16_t pattern_tile_address_lo = 0;
 
    // using 8 by 8 sprites
-   if ((ppu_control & 0x20) == 0)
+   if ((ppu->ppu_control & 0x20) == 0)
    {
       // sprite flipped vertically
-      if (output_sprites[i].attribute & 0x80)
+      if (ppu->output_sprites[i].attribute & 0x80)
       {
          sprite_fine_y = 7 - sprite_fine_y;
       }
 
       // fetching lo bitplane
-      pattern_tile_address_lo = ( (ppu_control & 0x8) << 9 )  | (tile_number << 4) | (sprite_fine_y & 0x7);
+      pattern_tile_address_lo = ( (ppu->ppu_control & 0x8) << 9 )  | (tile_number << 4) | (sprite_fine_y & 0x7);
    }
    // using 8 by 16 sprites
    else                           
    {
       // sprite flipped vertically
-      if (output_sprites[i].attribute & 0x80)
+      if (ppu->output_sprites[i].attribute & 0x80)
       {
          // fetching bottom tile
          if (sprite_fine_y < 8)
@@ -707,24 +701,24 @@ void fetch_sprites(void)
       }	
    }
 
-	output_sprites[i].lo_bitplane = cartridge_ppu_read(pattern_tile_address_lo);
-	output_sprites[i].hi_bitplane = cartridge_ppu_read(pattern_tile_address_lo + 8);
+	ppu->output_sprites[i].lo_bitplane = ppu_fetch(pattern_tile_address_lo);
+	ppu->output_sprites[i].hi_bitplane = ppu_fetch(pattern_tile_address_lo + 8);
 
    // sprite flipped horizontally
-   if (output_sprites[i].attribute & 0x40)
+   if (ppu->output_sprites[i].attribute & 0x40)
    {
-      output_sprites[i].lo_bitplane = flip_bits_horizontally( output_sprites[i].lo_bitplane );
-      output_sprites[i].hi_bitplane = flip_bits_horizontally( output_sprites[i].hi_bitplane );
+      ppu->output_sprites[i].lo_bitplane = flip_bits_horizontally( ppu->output_sprites[i].lo_bitplane );
+      ppu->output_sprites[i].hi_bitplane = flip_bits_horizontally( ppu->output_sprites[i].hi_bitplane );
    }
 
    // when there are less than 8 sprites on the next scanline, the remaining fetches have their color index replaced with the transparent background color
-   if (i >= number_of_sprites)
+   if (i >= ppu->number_of_sprites)
    {
-      output_sprites[i].lo_bitplane = 0;
-      output_sprites[i].hi_bitplane = 0;
+      ppu->output_sprites[i].lo_bitplane = 0;
+      ppu->output_sprites[i].hi_bitplane = 0;
    }
       
-	i = (i + 1) & 0x7;
+	ppu->sprite_fetch_index = (i + 1) & 0x7;
 }
 
 #define PALETTE_SIZE 192
@@ -762,6 +756,7 @@ bool ppu_load_palettes_from_file(const char* path)
    }
 	
    fclose(file);
+   display_update_palette();
    return true;
 }
 
@@ -794,6 +789,58 @@ void ppu_load_default_palettes()
 
 		glm_vec3_copy(rgb_color, system_palette[i]);
 	}
+
+	display_update_palette();
+}
+
+const vec3* ppu_get_system_palette(void)
+{
+   return (const vec3*) system_palette;
+}
+
+const uint8_t* ppu_get_frame(void)
+{
+   return ppu->frame_pixels;
+}
+
+const uint8_t* ppu_get_frame_emphasis(void)
+{
+   return ppu->frame_emphasis;
+}
+
+void ppu_map_page(uint8_t page, const uint8_t* memory)
+{
+   if (page < PPU_PAGE_COUNT)
+   {
+      ppu->ppu_pages[page] = (memory != NULL) ? memory : unmapped_page;
+   }
+}
+
+void ppu_set_fetch_hook(void (*hook)(uint16_t position))
+{
+   ppu->fetch_hook = hook;
+}
+
+void ppu_set_frame_output(bool flag)
+{
+   ppu->is_frame_output = flag;
+}
+
+/**
+ * Fetch used by the rendering pipeline, reads pattern table or nametable memory straight
+ * from the page table and then lets the mapper observe the address if it asked to.
+ * @param position ppu address in $0000 - $2FFF
+*/
+static inline uint8_t ppu_fetch(uint16_t position)
+{
+   uint8_t data = ppu->ppu_pages[position >> PPU_PAGE_SHIFT][position & (PPU_PAGE_SIZE - 1)];
+
+   if (ppu->fetch_hook != NULL)
+   {
+      ppu->fetch_hook(position);
+   }
+
+   return data;
 }
 
 static uint8_t get_palette_index(uint8_t index)
@@ -821,7 +868,7 @@ static uint8_t flip_bits_horizontally(uint8_t in)
    return in;
 }
 
-void DEBUG_ppu_update_pattern_tables(vec4* p0, vec4* p1)
+void DEBUG_ppu_update_pattern_tables(uint8_t* p0, uint8_t* p1)
 {
    //const uint8_t debug_palette[4] = {0x3F, 0x00, 0x10, 0x20};
 
@@ -833,28 +880,22 @@ void DEBUG_ppu_update_pattern_tables(vec4* p0, vec4* p1)
          
          for (uint8_t fine_y = 0; fine_y < 8; ++fine_y)
          {
-            uint8_t p0_lo = cartridge_ppu_read( (tile_number << 4) | fine_y );
-            uint8_t p0_hi = cartridge_ppu_read( (tile_number << 4) | (1 << 3) | fine_y );
+            // read the chr pages directly so the viewer does not disturb mappers watching ppu fetches
+            uint16_t p0_address = (tile_number << 4) | fine_y;
+            uint16_t p1_address = (1 << 12) | (tile_number << 4) | fine_y;
+
+            uint8_t p0_lo = ppu->ppu_pages[p0_address >> PPU_PAGE_SHIFT][p0_address & (PPU_PAGE_SIZE - 1)];
+            uint8_t p0_hi = ppu->ppu_pages[p0_address >> PPU_PAGE_SHIFT][(p0_address | (1 << 3)) & (PPU_PAGE_SIZE - 1)];
 
-            uint8_t p1_lo = cartridge_ppu_read( (1 << 12) | (tile_number << 4) | fine_y );
-            uint8_t p1_hi = cartridge_ppu_read( (1 << 12) | (tile_number << 4) | (1 << 3) | fine_y );
+            uint8_t p1_lo = ppu->ppu_pages[p1_address >> PPU_PAGE_SHIFT][p1_address & (PPU_PAGE_SIZE - 1)];
+            uint8_t p1_hi = ppu->ppu_pages[p1_address >> PPU_PAGE_SHIFT][(p1_address | (1 << 3)) & (PPU_PAGE_SIZE - 1)];
 
             for (int fine_x = 0; fine_x < 8; ++fine_x)
             {
-               vec3* p0_color = &system_palette[ palette_ram[( (p0_hi & 0x80) >> 6 ) | ( (p0_lo & 0x80) >> 7 )] ];
-               vec3* p1_color = &system_palette[ palette_ram[( (p1_hi & 0x80) >> 6 ) | ( (p1_lo & 0x80) >> 7 )] ];
-
                uint32_t index = (tile_row * 128 * 8) + (tile_col * 8) + (fine_y * 128) + fine_x;
 
-               p0[index][0] = p0_color[0][0];
-               p0[index][1] = p0_color[0][1];
-               p0[index][2] = p0_color[0][2];
-               p0[index][3] = 1.0f;
-
-               p1[index][0] = p1_color[0][0];
-               p1[index][1] = p1_color[0][1];
-               p1[index][2] = p1_color[0][2];
-               p1[index][3] = 1.0f;
+               p0[index] = ppu->palette_ram[( (p0_hi & 0x80) >> 6 ) | ( (p0_lo & 0x80) >> 7 )] & 0x3F;
+               p1[index] = ppu->palette_ram[( (p1_hi & 0x80) >> 6 ) | ( (p1_lo & 0x80) >> 7 )] & 0x3F;
 
                p0_lo = p0_lo << 1;
                p0_hi = p0_hi << 1;
@@ -869,42 +910,384 @@ void DEBUG_ppu_update_pattern_tables(vec4* p0, vec4* p1)
 
 void ppu_reset(void)
 {
-   ppu_control = 0;
-   ppu_mask = 0;
-   write_toggle = false;
-   read_buffer = 0;
-   odd_even_flag = true;
-   x_register = 0;
-   t_register = 0;
-	oam_dma_scheduled = false;
+   ppu_catch_up();
+
+   ppu->ppu_control = 0;
+   ppu->ppu_mask = 0;
+   ppu->write_toggle = false;
+   ppu->read_buffer = 0;
+   ppu->odd_even_flag = true;
+   ppu->x_register = 0;
+   ppu->t_register = 0;
+	ppu->oam_dma_scheduled = false;
+   update_nmi_deadline();
 }
 
 void ppu_init(void)
 {
-   ppu_control = 0;
-   ppu_mask = 0;
-   ppu_status = 0;
-   oam_address = 0;
-   oam_data = 0;
-   write_toggle = false;
-   x_register = 0;
-   t_register = 0;
-   v_register = 0;
-   nametable_byte = 0;
-   pattern_tile_lo_bits = 0;
-   pattern_tile_hi_bits = 0;
-   attribute_byte = 0;
-   tile_shift_register_hi = 0;
-   tile_shift_register_lo = 0;
-   attribute_shift_register_hi = 0;
-   attribute_shift_register_lo = 0;
-   attribute_1_bit_latch_x = 0;
-   attribute_1_bit_latch_y = 0;
-   odd_even_flag = true;
-   read_buffer = 0;
-   open_bus = 0;
-   number_of_sprites = 0;
-   scanline = 261;
-   cycle = 0;
-	oam_dma_scheduled = false;
+   ppu_catch_up();
+
+   ppu->ppu_control = 0;
+   ppu->ppu_mask = 0;
+   ppu->ppu_status = 0;
+   ppu->oam_address = 0;
+   ppu->oam_data = 0;
+   ppu->write_toggle = false;
+   ppu->x_register = 0;
+   ppu->t_register = 0;
+   ppu->v_register = 0;
+   ppu->nametable_byte = 0;
+   ppu->pattern_tile_lo_bits = 0;
+   ppu->pattern_tile_hi_bits = 0;
+   ppu->attribute_byte = 0;
+   ppu->tile_shift_register_hi = 0;
+   ppu->tile_shift_register_lo = 0;
+   ppu->attribute_shift_register_hi = 0;
+   ppu->attribute_shift_register_lo = 0;
+   ppu->attribute_1_bit_latch_x = 0;
+   ppu->attribute_1_bit_latch_y = 0;
+   ppu->odd_even_flag = true;
+   ppu->read_buffer = 0;
+   ppu->open_bus = 0;
+   ppu->number_of_sprites = 0;
+   ppu->sprite_fetch_index = 0;
+   ppu->scanline = 261;
+   ppu->cycle = 0;
+	ppu->oam_dma_scheduled = false;
+
+   // undefined on hardware, cleared so a power cycle always starts from the same state
+   memset(ppu->palette_ram, 0, sizeof(ppu->palette_ram));
+   memset(ppu->oam_ram, 0, sizeof(ppu->oam_ram));
+   memset(ppu->secondary_oam_ram, 0, sizeof(ppu->secondary_oam_ram));
+   memset(ppu->output_sprites, 0, sizeof(ppu->output_sprites));
+   memset(ppu->frame_pixels, 0, sizeof(ppu->frame_pixels));
+   memset(ppu->frame_emphasis, 0, sizeof(ppu->frame_emphasis));
+   update_nmi_deadline();
+}
+
+void ppu_catch_up(void)
+{
+   cpu_6502_t* cpu = get_cpu();
+   long target_dot = cpu->cycle_count * 3;
+
+   while (ppu->ppu_dot < target_dot)
+   {
+      // Any cpu access that could change ppu registers catches the ppu up first, so a visible scanline
+      // that fits entirely inside one catch up has no mid line register writes and can be drawn in one pass.
+      if (ppu->cycle == 0 && ppu->scanline <= 239 && (ppu->ppu_mask & 0x18) && target_dot - ppu->ppu_dot >= 257)
+      {
+         render_scanline_batched();
+      }
+      else
+      {
+         ppu_cycle(&cpu->nmi_flip_flop);
+         ppu->ppu_dot += 1;
+      }
+   }
+
+   update_nmi_deadline();
+
+   // mappers watching ppu fetches (mmc3) may have clocked their irq counters
+   if (ppu->fetch_hook != NULL)
+   {
+      cartridge_update_irq_deadline();
+   }
+}
+
+void ppu_rebase_cpu_cycle(long cycle_count)
+{
+   ppu->ppu_dot = cycle_count * 3;
+}
+
+long ppu_get_cpu_cycle(void)
+{
+   return ppu->ppu_dot / 3;
+}
+
+/**
+ * Lists every piece of ppu state that goes into a save state, in chunk order.
+*/
+static void ppu_sync_state(State_Buffer_t* buffer, bool saving)
+{
+   state_sync(buffer, saving, ppu->ppu_control);
+   state_sync(buffer, saving, ppu->ppu_mask);
+   state_sync(buffer, saving, ppu->ppu_status);
+   state_sync(buffer, saving, ppu->oam_address);
+   state_sync(buffer, saving, ppu->oam_data);
+   state_sync(buffer, saving, ppu->write_toggle);
+   state_sync(buffer, saving, ppu->x_register);
+   state_sync(buffer, saving, ppu->t_register);
+   state_sync(buffer, saving, ppu->v_register);
+   state_sync(buffer, saving, ppu->nametable_byte);
+   state_sync(buffer, saving, ppu->pattern_tile_lo_bits);
+   state_sync(buffer, saving, ppu->pattern_tile_hi_bits);
+   state_sync(buffer, saving, ppu->attribute_byte);
+   state_sync(buffer, saving, ppu->tile_shift_register_lo);
+   state_sync(buffer, saving, ppu->tile_shift_register_hi);
+   state_sync(buffer, saving, ppu->attribute_shift_register_lo);
+   state_sync(buffer, saving, ppu->attribute_shift_register_hi);
+   state_sync(buffer, saving, ppu->attribute_1_bit_latch_x);
+   state_sync(buffer, saving, ppu->attribute_1_bit_latch_y);
+   state_sync(buffer, saving, ppu->odd_even_flag);
+   state_sync(buffer, saving, ppu->read_buffer);
+   state_sync(buffer, saving, ppu->open_bus);
+   state_sync(buffer, saving, ppu->palette_ram);
+   state_sync(buffer, saving, ppu->oam_ram);
+   state_sync(buffer, saving, ppu->secondary_oam_ram);
+   state_sync(buffer, saving, ppu->output_sprites);
+   state_sync(buffer, saving, ppu->number_of_sprites);
+   state_sync(buffer, saving, ppu->sprite_fetch_index);
+   state_sync(buffer, saving, ppu->scanline);
+   state_sync(buffer, saving, ppu->cycle);
+   state_sync(buffer, saving, ppu->oam_dma_scheduled);
+   state_sync(buffer, saving, ppu->oam_dma_address);
+   state_sync(buffer, saving, ppu->ppu_dot);
+   state_sync(buffer, saving, ppu->frame_pixels);
+   state_sync(buffer, saving, ppu->frame_emphasis);
+}
+
+void ppu_save_state(State_Buffer_t* buffer)
+{
+   ppu_sync_state(buffer, true);
+}
+
+void ppu_load_state(State_Buffer_t* buffer)
+{
+   ppu_sync_state(buffer, false);
+}
+
+/**
+ * Predicts the cpu cycle count by which the ppu will have reached cycle 1 of scanline 241 where
+ * vblank starts and the nmi is raised. Assumes the odd frame skipped cycle always happens so the
+ * prediction is never late.
+*/
+static void update_nmi_deadline(void)
+{
+   const long frame_dots = 262 * 341;
+   long dots = (241 * 341 + 1) - (ppu->scanline * 341 + ppu->cycle); // dots to run before the vblank dot
+   if (dots < 0)
+   {
+      dots += frame_dots;
+   }
+
+   // dots + 1 including the vblank dot itself, minus 1 for a possible skipped dot
+   if (dots < 1)
+   {
+      dots = 1;
+   }
+
+   // earliest cpu cycle count by which the ppu could have raised the vblank nmi
+   cpu_schedule_event(CPU_EVENT_PPU_NMI, ppu->ppu_dot / 3 + (dots - 1) / 3 + 1);
+}
+
+/**
+ * Draws cycles 0 - 256 of a visible scanline with rendering enabled in one pass. Produces the same
+ * pixels, fetches and register state as running ppu_cycle for each of those cycles, but decodes the
+ * background a tile (8 pixels) at a time instead of shifting the shift registers every cycle.
+ * Sprite pixels are only searched for when a sprite on this line has opaque pixels left.
+*/
+static void render_scanline_batched(void)
+{
+   long line_dot = ppu->ppu_dot; // ppu_dot of cycle 0, fetches set ppu_dot to their own cycle for mappers timing them
+
+   uint8_t fine_x = ppu->x_register;
+   bool sprites_on_line = false;
+   for (int i = 0; i < 8; ++i)
+   {
+      if (ppu->output_sprites[i].lo_bitplane | ppu->output_sprites[i].hi_bitplane)
+      {
+         sprites_on_line = true;
+      }
+   }
+
+   for (uint16_t tile = 0; tile < 32; ++tile)
+   {
+      uint16_t dot = tile * 8 + 1; // first cycle of this tile
+
+      // decode the 8 background pixels for cycles dot - dot + 7 from the shift registers, bits shifted
+      // into the attribute registers past their top 8 - fine x bits come from the 1 bit latches
+      for (uint8_t i = 0; i < 8; ++i)
+      {
+         uint8_t background_pixel = ( ppu->tile_shift_register_lo >> (15 - fine_x - i) ) & 0x1;
+         background_pixel |= ( ( ppu->tile_shift_register_hi >> (15 - fine_x - i) ) & 0x1 ) << 1;
+
+         if (fine_x + i <= 7)
+         {
+            background_pixel |= ( (ppu->attribute_shift_register_lo >> (7 - fine_x - i)) & 0x1 ) << 2;
+            background_pixel |= ( (ppu->attribute_shift_register_hi >> (7 - fine_x - i)) & 0x1 ) << 3;
+         }
+         else
+         {
+            background_pixel |= ppu->attribute_1_bit_latch_x << 2;
+            background_pixel |= ppu->attribute_1_bit_latch_y << 3;
+         }
+
+         uint8_t sprite_pixel = 0;
+         int active_sprite = -1;
+         if (sprites_on_line)
+         {
+            active_sprite = get_sprite_pixel(dot + i, &sprite_pixel);
+         }
+
+         if ( (ppu->ppu_mask & 0x08) == 0 )
+         {
+            background_pixel = 0;
+         }
+         else if ( (ppu->ppu_mask & 0x10) == 0 )
+         {
+            sprite_pixel = 0;
+         }
+
+         draw_pixel(dot + i, background_pixel, sprite_pixel, active_sprite);
+      }
+
+      // 8 cycles worth of shifting
+      ppu->tile_shift_register_lo = ppu->tile_shift_register_lo << 8;
+      ppu->tile_shift_register_hi = ppu->tile_shift_register_hi << 8;
+      ppu->attribute_shift_register_lo = ppu->attribute_1_bit_latch_x ? 0xFF : 0x00;
+      ppu->attribute_shift_register_hi = ppu->attribute_1_bit_latch_y ? 0xFF : 0x00;
+
+      if (tile == 0)
+      {
+         sprite_clear_secondary_oam(); // cycle 1
+      }
+      else if (tile == 8)
+      {
+         sprite_evaluation(); // cycle 65
+      }
+
+      // fetches at cycles +1, +3, +5, +6 and the shift register reload at cycle +7 of this tile
+      ppu->ppu_dot = line_dot + dot + 1;
+      fetch_nametable();
+      ppu->ppu_dot = line_dot + dot + 3;
+      fetch_attribute();
+      ppu->ppu_dot = line_dot + dot + 5;
+      fetch_pattern_table_lo();
+      ppu->ppu_dot = line_dot + dot + 6;
+      fetch_pattern_table_hi();
+
+      if (tile == 31)
+      {
+         increment_v_both(); // cycle 256
+      }
+      else
+      {
+         increment_v_horizontal();
+      }
+   }
+
+   ppu->cycle = 257;
+   ppu->ppu_dot = line_dot + 257;
+}
+
+/**
+ * Finds the first opaque sprite pixel on the current scanline at a cycle and shifts the bitplanes
+ * of every sprite in range.
+ * @param dot ppu cycle 1 - 256 of the pixel
+ * @param sprite_pixel set to the 4 bit sprite pixel (palette and color index)
+ * @returns index of the sprite in output_sprites that owns the pixel, -1 if no opaque sprite pixel
+*/
+static inline int get_sprite_pixel(uint16_t dot, uint8_t* sprite_pixel)
+{
+   int active_sprite = -1;
+   bool sprite_found = false;
+
+   // search for the first in range opaque sprite pixel on the horizontal axis
+   for (int i = 0; i < 8; ++i)
+   {
+      if ( dot >= ppu->output_sprites[i].x_position + 1 && dot - (ppu->output_sprites[i].x_position + 1) <= 8 /*&& scanline != 0*/ )
+      {
+         if (!sprite_found)
+         {
+            // contruct 4 bit pallete index with pattern table bitplanes and attribute bytes of the sprite
+            *sprite_pixel =  (ppu->output_sprites[i].lo_bitplane >> 7) & 0x1;
+            *sprite_pixel |= ( (ppu->output_sprites[i].hi_bitplane >> 7) & 0x1 ) << 1;
+            *sprite_pixel |= (ppu->output_sprites[i].attribute & 0x3) << 2;
+
+            if ( (*sprite_pixel & 0x3) != 0 ) // only set sprite found to true if the sprite pixel found is not transparent
+            {
+               sprite_found = true;
+               active_sprite = i;
+            }
+         }
+
+         // shift bitplanes once they have been used to render a pixel
+         ppu->output_sprites[i].lo_bitplane = ppu->output_sprites[i].lo_bitplane << 1;
+         ppu->output_sprites[i].hi_bitplane = ppu->output_sprites[i].hi_bitplane << 1;
+      }
+   }
+
+   return active_sprite;
+}
+
+/**
+ * Combines the background and sprite pixel of a visible cycle, checks for sprite 0 hit
+ * and outputs the final color.
+ * @param dot ppu cycle 1 - 256 of the pixel
+ * @param background_pixel 4 bit background pixel
+ * @param sprite_pixel 4 bit sprite pixel
+ * @param active_sprite index of the sprite owning sprite_pixel, -1 if none
+*/
+static inline void draw_pixel(uint16_t dot, uint8_t background_pixel, uint8_t sprite_pixel, int active_sprite)
+{
+   uint8_t output_pixel = 0;
+
+   if (dot <= 8)
+   {
+      // hide background pixels on leftmost 8 pixels of screen
+      if ((ppu->ppu_mask & 0x2) == 0)
+      {
+         background_pixel &= 0xC;
+      }
+   }
+
+   // no active sprite for this pixel so we just choose from the background
+   if (active_sprite == -1)
+   {
+      if ( (background_pixel & 0x3) == 0 ) // transparent pixels will display colors at 0x3F00
+      {
+         output_pixel = 0;
+      }
+      else
+      {
+         output_pixel = background_pixel;
+      }
+   }
+   // active sprite present so we must determine whether to render the background or sprite
+   else
+   {
+      if (dot <= 8)
+      {
+         // hide sprite pixels on leftmost 8 pixels of screen
+         if ((ppu->ppu_mask & 0x4) == 0)
+         {
+            sprite_pixel &= 0xC;
+         }
+      }
+
+      // bg and sp are background and sprite color indices within a palette, 0 means that color is the transparent background color
+      uint8_t bg = background_pixel & 0x3;
+      uint8_t sp = sprite_pixel & 0x3;
+
+      // 0: sprite is in front of background, 1: sprite is behind background
+      uint8_t sp_priority = (ppu->output_sprites[active_sprite].attribute & 0x20) >> 5;
+
+      if (bg == 0 && sp == 0)      output_pixel = 0;
+      else if (bg == 0 && sp != 0) output_pixel = 0x10 | sprite_pixel;
+      else if (bg != 0 && sp == 0) output_pixel = background_pixel;
+      else                         output_pixel = (sp_priority) ? background_pixel : (0x10 | sprite_pixel);
+
+      // check for sprite 0 hit
+      if ( ppu->output_sprites[active_sprite].sprite_id == 0 )
+      {
+         if ( sprite_pixel != 0 &&  background_pixel != 0 )
+         {
+            ppu->ppu_status |= 0x40;
+         }
+      }
+   }
+   //output_pixel = 0x0 | (output_pixel & 0x3);
+
+   ppu->frame_pixels[ppu->scanline * PPU_FRAME_W + dot - 1] = ppu->palette_ram[ output_pixel & 0x1F ] & 0x3F;
+   ppu->frame_emphasis[ppu->scanline] = ppu->ppu_mask >> 5;
 }
@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rewind.h"
+#include "savestate.h"
+
+#define REWIND_MAX_RUN 0xFFFF // longest unchanged or literal run a single run header can hold
+
+// encoded frame layout: repeated { uint16 unchanged count, uint16 literal count, literal xor bytes }
+// raw frames are the plain xor, used when run length encoding would not make it smaller
+
+typedef enum Rewind_Frame_Flags_t
+{
+   REWIND_KEYFRAME = 0x1, // xor against an all zero state, so it decodes on its own
+   REWIND_RAW      = 0x2, // not run length encoded
+} Rewind_Frame_Flags_t;
+
+typedef struct Rewind_Frame_t
+{
+   size_t  offset; // where the encoded frame starts in the arena
+   size_t  size;   // encoded bytes
+   uint8_t flags;
+} Rewind_Frame_t;
+
+static uint8_t* arena = NULL; // encoded frames, laid out in recording order and wrapping back to the start
+static size_t arena_capacity = 0;
+static size_t arena_head = 0; // where the next frame is encoded
+
+static Rewind_Frame_t frames[REWIND_MAX_FRAMES];
+static uint32_t frame_oldest = 0;
+static uint32_t frame_count = 0;
+static uint32_t frames_since_keyframe = 0; // frames in the newest keyframe's group, keyframe included
+
+static State_Buffer_t latest;          // decoded state of the newest recorded frame
+static State_Buffer_t present;         // scratch buffer the current state is saved into
+static uint8_t* zero_state = NULL;     // all zero state that keyframes are xored against
+static size_t zero_state_size = 0;
+
+static size_t rewind_reserve(size_t size);
+static void rewind_drop_oldest_group(void);
+static size_t rewind_encode(const uint8_t* state, const uint8_t* previous, size_t size, uint8_t* out, size_t limit);
+static void rewind_apply(const Rewind_Frame_t* frame, uint8_t* state, size_t size);
+
+static inline Rewind_Frame_t* rewind_frame(uint32_t age)
+{
+   return &frames[(frame_oldest + age) % REWIND_MAX_FRAMES];
+}
+
+bool rewind_init(size_t budget)
+{
+   arena = malloc(budget);
+   if (arena == NULL)
+   {
+      printf("Failed to allocate memory for rewind!\n");
+      return false;
+   }
+
+   // touch every page up front so recording never stalls on the os handing out memory
+   memset(arena, 0, budget);
+   arena_capacity = budget;
+   rewind_clear();
+
+   return true;
+}
+
+void rewind_shutdown(void)
+{
+   free(arena);
+   free(zero_state);
+   state_buffer_free(&latest);
+   state_buffer_free(&present);
+
+   arena = NULL;
+   zero_state = NULL;
+   arena_capacity = 0;
+   zero_state_size = 0;
+   rewind_clear();
+}
+
+void rewind_clear(void)
+{
+   arena_head = 0;
+   frame_oldest = 0;
+   frame_count = 0;
+   frames_since_keyframe = 0;
+}
+
+bool rewind_record(void)
+{
+   if (arena == NULL || !state_save(&present))
+   {
+      return false;
+   }
+
+   size_t size = present.size;
+   if (size > arena_capacity)
+   {
+      return false;
+   }
+
+   // xor deltas only make sense between states of the same layout
+   if (frame_count != 0 && size != latest.size)
+   {
+      rewind_clear();
+   }
+
+   if (zero_state_size != size)
+   {
+      free(zero_state);
+      zero_state = calloc(size, sizeof(uint8_t));
+      zero_state_size = (zero_state != NULL) ? size : 0;
+      if (zero_state == NULL)
+      {
+         printf("Failed to allocate memory for rewind!\n");
+         return false;
+      }
+   }
+
+   if (frame_count == REWIND_MAX_FRAMES)
+   {
+      rewind_drop_oldest_group();
+   }
+
+   // encoded frames never take more room than the state itself, see the raw fallback below
+   size_t position = rewind_reserve(size);
+
+   bool is_keyframe = frame_count == 0 || frames_since_keyframe >= REWIND_KEYFRAME_INTERVAL;
+   const uint8_t* previous = is_keyframe ? zero_state : latest.data;
+   uint8_t* out = arena + position;
+
+   Rewind_Frame_t* frame = rewind_frame(frame_count);
+   frame->offset = position;
+   frame->flags = is_keyframe ? REWIND_KEYFRAME : 0;
+   frame->size = rewind_encode(present.data, previous, size, out, size);
+
+   if (frame->size == 0)
+   {
+      for (size_t i = 0; i < size; ++i)
+      {
+         out[i] = present.data[i] ^ previous[i];
+      }
+      frame->size = size;
+      frame->flags |= REWIND_RAW;
+   }
+
+   arena_head = position + frame->size;
+   frame_count += 1;
+   frames_since_keyframe = is_keyframe ? 1 : frames_since_keyframe + 1;
+
+   // the state just recorded becomes the one the next frame is xored against
+   State_Buffer_t swap = latest;
+   latest = present;
+   present = swap;
+
+   return true;
+}
+
+bool rewind_step_back(void)
+{
+   if (frame_count < 2)
+   {
+      return false;
+   }
+
+   Rewind_Frame_t* newest = rewind_frame(frame_count - 1);
+
+   if ( !(newest->flags & REWIND_KEYFRAME) )
+   {
+      // xoring the delta back out of the newest state gives the one before it
+      rewind_apply(newest, latest.data, latest.size);
+   }
+   else
+   {
+      // the frame before a keyframe is rebuilt from the previous keyframe and the deltas after it,
+      // the oldest frame is always a keyframe so there is one
+      uint32_t age = frame_count - 2;
+      while ( !(rewind_frame(age)->flags & REWIND_KEYFRAME) )
+      {
+         --age;
+      }
+
+      memset(latest.data, 0, latest.size);
+      for (; age < frame_count - 1; ++age)
+      {
+         rewind_apply(rewind_frame(age), latest.data, latest.size);
+      }
+   }
+
+   arena_head = newest->offset;
+   frame_count -= 1;
+
+   frames_since_keyframe = 1;
+   while ( !(rewind_frame(frame_count - frames_since_keyframe)->flags & REWIND_KEYFRAME) )
+   {
+      frames_since_keyframe += 1;
+   }
+
+   return state_load(&latest);
+}
+
+uint32_t rewind_get_frame_count(void)
+{
+   return frame_count;
+}
+
+/**
+ * Finds room for a frame of up to size bytes in the arena, dropping the oldest keyframe groups that
+ * are in the way. Frames are laid out in recording order, so whatever follows the head is the oldest.
+ * @returns offset the frame can be encoded at
+*/
+static size_t rewind_reserve(size_t size)
+{
+   size_t position = arena_head;
+
+   if (position + size > arena_capacity)
+   {
+      // the end of the arena is given up on this lap, the frames stored there are the oldest ones
+      while (frame_count != 0 && rewind_frame(0)->offset >= position)
+      {
+         rewind_drop_oldest_group();
+      }
+      position = 0;
+   }
+
+   while (frame_count != 0)
+   {
+      const Rewind_Frame_t* oldest = rewind_frame(0);
+      if (oldest->offset >= position + size || position >= oldest->offset + oldest->size)
+      {
+         break;
+      }
+      rewind_drop_oldest_group();
+   }
+
+   return position;
+}
+
+/**
+ * Drops the oldest keyframe together with the deltas that depend on it.
+*/
+static void rewind_drop_oldest_group(void)
+{
+   do
+   {
+      frame_oldest = (frame_oldest + 1) % REWIND_MAX_FRAMES;
+      frame_count -= 1;
+   }
+   while (frame_count != 0 && !(rewind_frame(0)->flags & REWIND_KEYFRAME));
+
+   if (frame_count == 0)
+   {
+      rewind_clear();
+   }
+}
+
+/**
+ * Run length encodes the xor of two states.
+ * @param state state being recorded
+ * @param previous state it is xored against
+ * @param size bytes in each state
+ * @param out where the encoded frame is written
+ * @param limit bytes available at out
+ * @returns encoded size, or 0 if the encoding would not fit in limit
+*/
+static size_t rewind_encode(const uint8_t* state, const uint8_t* previous, size_t size, uint8_t* out, size_t limit)
+{
+   size_t in = 0;
+   size_t out_size = 0;
+
+   while (in < size)
+   {
+      // skip over unchanged bytes, a word at a time while possible
+      size_t unchanged = 0;
+      while (in + 8 <= size && unchanged + 8 <= REWIND_MAX_RUN && memcmp(state + in, previous + in, 8) == 0)
+      {
+         in += 8;
+         unchanged += 8;
+      }
+      while (in < size && unchanged < REWIND_MAX_RUN && state[in] == previous[in])
+      {
+         in += 1;
+         unchanged += 1;
+      }
+
+      // take changed bytes a word at a time until a whole word is unchanged, shorter unchanged gaps
+      // would cost more in run headers than they save
+      size_t start = in;
+      while (in < size && in - start <= REWIND_MAX_RUN - 8)
+      {
+         if (in + 8 > size)
+         {
+            in = size;
+            break;
+         }
+
+         if (memcmp(state + in, previous + in, 8) == 0)
+         {
+            break;
+         }
+         in += 8;
+      }
+
+      size_t literals = in - start;
+      if (out_size + 4 + literals > limit)
+      {
+         return 0;
+      }
+
+      uint16_t run[2] = { (uint16_t) unchanged, (uint16_t) literals };
+      memcpy(out + out_size, run, sizeof(run));
+      out_size += sizeof(run);
+
+      for (size_t i = 0; i < literals; ++i)
+      {
+         out[out_size + i] = state[start + i] ^ previous[start + i];
+      }
+      out_size += literals;
+   }
+
+   return out_size;
+}
+
+/**
+ * Xors an encoded frame into a state.
+ * @param frame frame to decode
+ * @param state state to apply it to
+ * @param size bytes in the state
+*/
+static void rewind_apply(const Rewind_Frame_t* frame, uint8_t* state, size_t size)
+{
+   const uint8_t* in = arena + frame->offset;
+
+   if (frame->flags & REWIND_RAW)
+   {
+      for (size_t i = 0; i < size; ++i)
+      {
+         state[i] ^= in[i];
+      }
+      return;
+   }
+
+   const uint8_t* end = in + frame->size;
+   size_t position = 0;
+   while (in < end)
+   {
+      uint16_t run[2];
+      memcpy(run, in, sizeof(run));
+      in += sizeof(run);
+      position += run[0];
+
+      for (size_t i = 0; i < run[1]; ++i)
+      {
+         state[position + i] ^= in[i];
+      }
+      in += run[1];
+      position += run[1];
+   }
+}
@@ -0,0 +1,468 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "rom_image.h"
+#include "rom_library.h"
+#include "thread.h"
+
+#define iNES_HEADER_SIZE 16 // iNES headers are all 16 bytes long
+#define TRAINER_SIZE 512
+#define ROM_SIZE_EXPONENT_MAX 30 // largest 2^E of an exponent-multiplier rom size that is accepted
+
+/**
+ * A loaded image and the bookkeeping for sharing it. The image comes first so the pointer handed
+ * out by rom_image_acquire converts back to its entry.
+*/
+typedef struct Rom_Image_Entry_t
+{
+   Rom_Image_t image;
+   const uint8_t* file; // read only mapping of the whole .nes file, the image's pointers point into it
+   size_t file_size;
+   char* path;          // path the image was loaded from
+   uint32_t references;
+   struct Rom_Image_Entry_t* next;
+} Rom_Image_Entry_t;
+
+static Rom_Image_Entry_t* images = NULL; // every image that is held by at least one cartridge
+
+static Thread_Lock_t images_lock = THREAD_LOCK_INIT;
+
+static Rom_Image_Entry_t* rom_image_load(const char* path);
+static bool load_iNES10(const uint8_t *iNES_header, nes_header_t *header);
+static bool load_iNES20(const uint8_t *iNES_header, nes_header_t *header);
+static bool nes20_rom_bytes(uint8_t size_lsb, uint8_t size_msb, size_t unit, size_t* bytes);
+static size_t nes20_ram_bytes(uint8_t shift_count);
+
+const Rom_Image_t* rom_image_acquire(const char* path)
+{
+   thread_lock(&images_lock);
+
+   Rom_Image_Entry_t* entry = images;
+   while (entry != NULL && strcmp(entry->path, path) != 0)
+   {
+      entry = entry->next;
+   }
+
+   if (entry == NULL)
+   {
+      entry = rom_image_load(path);
+      if (entry != NULL)
+      {
+         entry->next = images;
+         images = entry;
+      }
+   }
+
+   if (entry != NULL)
+   {
+      entry->references += 1;
+   }
+
+   thread_unlock(&images_lock);
+
+   return (entry != NULL) ? &entry->image : NULL;
+}
+
+void rom_image_release(const Rom_Image_t* image)
+{
+   if (image == NULL)
+   {
+      return;
+   }
+
+   thread_lock(&images_lock);
+
+   Rom_Image_Entry_t** link = &images;
+   while (*link != NULL && &(*link)->image != image)
+   {
+      link = &(*link)->next;
+   }
+
+   Rom_Image_Entry_t* entry = *link;
+   if (entry != NULL && --entry->references == 0)
+   {
+      *link = entry->next;
+      rom_image_unmap_file(entry->file, entry->file_size);
+      free(entry->path);
+      free(entry);
+   }
+
+   thread_unlock(&images_lock);
+}
+
+bool rom_image_parse(const uint8_t* data, size_t size, Rom_Image_t* image)
+{
+   nes_header_t* header = &image->header;
+
+   if (size < iNES_HEADER_SIZE)
+   {
+      memset(header, 0, sizeof(nes_header_t));
+      printf("Failed to read iNES header!\n");
+      return false;
+   }
+
+   if (!rom_image_parse_header(data, header))
+   {
+      return false;
+   }
+
+   size_t offset = iNES_HEADER_SIZE + ((header->trainer != 0) ? TRAINER_SIZE : 0); // trainer data is ignored
+   size_t prg_rom_size = header->prg_rom_bytes;
+   size_t chr_rom_size = header->chr_rom_bytes;
+
+   if (offset > size || prg_rom_size > size - offset || chr_rom_size > size - offset - prg_rom_size)
+   {
+      printf("File is smaller than the rom sizes in its header!\n");
+      return false;
+   }
+
+   image->prg_rom = data + offset;
+   image->prg_rom_size = prg_rom_size;
+   image->chr_rom = (chr_rom_size != 0) ? data + offset + prg_rom_size : NULL;
+   image->chr_rom_size = chr_rom_size;
+
+   return true;
+}
+
+bool rom_image_parse_header(const uint8_t* iNES_header, nes_header_t* header)
+{
+   memset(header, 0, sizeof(nes_header_t));
+
+   // check if .nes file is a valid rom file
+   if ( !(iNES_header[0]=='N' && iNES_header[1]=='E' && iNES_header[2]=='S' && iNES_header[3]==0x1A) )
+   {
+      printf("Invalid nes file!\n");
+      return false;
+   }
+
+   bool is_parsed = rom_image_is_nes20(iNES_header) ? load_iNES20(iNES_header, header) : load_iNES10(iNES_header, header);
+   if (!is_parsed)
+   {
+      return false;
+   }
+
+   // boards without chr-rom always have chr-ram, even when a NES 2.0 header leaves its size out
+   if (header->chr_rom_bytes == 0 && header->chr_ram_bytes == 0 && header->chr_nvram_bytes == 0)
+   {
+      header->chr_ram_bytes = 1024 * 8;
+   }
+
+   return true;
+}
+
+bool rom_image_is_nes20(const uint8_t* iNES_header)
+{
+   return (iNES_header[7] & 0x0C) == 0x08;
+}
+
+/**
+ * Maps a .nes file and parses it into a new image entry with no references.
+ * @returns NULL on fail
+*/
+static Rom_Image_Entry_t* rom_image_load(const char* path)
+{
+   size_t file_size = 0;
+   const uint8_t* file = rom_image_map_file(path, &file_size);
+   if (file == NULL)
+   {
+      return NULL;
+   }
+
+   Rom_Image_Entry_t* entry = calloc(1, sizeof(Rom_Image_Entry_t));
+   char* entry_path = malloc(strlen(path) + 1);
+   if (entry == NULL || entry_path == NULL)
+   {
+      printf("Failed to allocate memory for rom image!\n");
+      free(entry);
+      free(entry_path);
+      rom_image_unmap_file(file, file_size);
+      return NULL;
+   }
+
+   if (!rom_image_parse(file, file_size, &entry->image))
+   {
+      free(entry);
+      free(entry_path);
+      rom_image_unmap_file(file, file_size);
+      return NULL;
+   }
+
+   strcpy(entry_path, path);
+   entry->path = entry_path;
+   entry->file = file;
+   entry->file_size = file_size;
+
+   nes_header_t* header = &entry->image.header;
+   if (rom_library_fix_header(path, file, header))
+   {
+      printf("Header fixed from the rom library.\n");
+   }
+
+   printf(header->is_nes20 ? "iNES 2.0\n" : "iNES 1.0\n");
+
+   if ( header->trainer != 0 )
+   {
+      printf("Trainer data present.\n");
+   }
+
+   printf("%-13s %d\n%-13s %zu\n%-13s %zu\n%-13s %zu\n%-13s %s\n",
+      "Mapper:", header->mapper_id,
+      "Prg-ROM size:", header->prg_rom_bytes,
+      "CHR-ROM/RAM", (header->chr_rom_bytes != 0) ? header->chr_rom_bytes : header->chr_ram_bytes + header->chr_nvram_bytes,
+      "PRG_RAM size:", header->prg_ram_bytes + header->prg_nvram_bytes,
+      "Mirroring:", (header->nametable_arrangement) ? "Vertical" : "Horizontal"
+   );
+   if (header->is_nes20)
+   {
+      printf("%-13s %d\n", "Submapper:", header->submapper_id);
+   }
+
+	const char* start = NULL;
+	const char* end = NULL;
+
+	if ( (start = strrchr(path, '\\')) || (start = strrchr(path, '/')) )
+	{
+		start += 1;
+	}
+	else
+	{
+		start = path;
+	}
+
+	if ( !(end = strrchr(path, '.')) || end < start )
+	{
+		end = path + strlen(path);
+	}
+
+	size_t length = (size_t) (end - start);
+	if (length >= sizeof(entry->image.name))
+	{
+		length = sizeof(entry->image.name) - 1;
+	}
+
+	memcpy(entry->image.name, start, length);
+	entry->image.name[length] = '\0';
+	printf("%s\n\n", entry->image.name);
+
+   return entry;
+}
+
+const uint8_t* rom_image_map_file(const char* path, size_t* size)
+{
+#if _WIN32
+   HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (file == INVALID_HANDLE_VALUE)
+   {
+      printf("Cannot open file: %s\n", path);
+      return NULL;
+   }
+
+   LARGE_INTEGER file_size;
+   if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart < iNES_HEADER_SIZE)
+   {
+      CloseHandle(file);
+      printf("Failed to read iNES header!\n");
+      return NULL;
+   }
+
+   // the view keeps the file mapped after both handles are closed
+   HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+   const uint8_t* data = (mapping != NULL) ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+   if (mapping != NULL)
+   {
+      CloseHandle(mapping);
+   }
+   CloseHandle(file);
+
+   if (data == NULL)
+   {
+      printf("Failed to map file: %s Error Code: %lu\n", path, GetLastError());
+      return NULL;
+   }
+
+   *size = (size_t) file_size.QuadPart;
+   return data;
+#else
+   int file = open(path, O_RDONLY);
+   if (file == -1)
+   {
+      printf("Cannot open file: %s\n", path);
+      return NULL;
+   }
+
+   struct stat info;
+   if (fstat(file, &info) == -1 || !S_ISREG(info.st_mode) || info.st_size < iNES_HEADER_SIZE)
+   {
+      close(file);
+      printf("Failed to read iNES header!\n");
+      return NULL;
+   }
+
+   // the mapping stays valid after the descriptor is closed
+   void* data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+   close(file);
+
+   if (data == MAP_FAILED)
+   {
+      printf("Failed to map file: %s\n", path);
+      return NULL;
+   }
+
+   *size = (size_t) info.st_size;
+   return data;
+#endif
+}
+
+void rom_image_unmap_file(const uint8_t* file, size_t size)
+{
+#if _WIN32
+   (void) size;
+   UnmapViewOfFile(file);
+#else
+   munmap( (void*) file, size );
+#endif
+}
+
+/**
+ * Loads data in iNES in 1.0 format into a struct.
+ * iNES 1.0 does not say how much ram a board has, so prg-ram comes from byte 8 (8kb when 0) except
+ * for mapper 1 whose boards can bank up to 32kb of it, and chr-ram is 8kb.
+ * @param iNES_header array container 16 header
+ * @param header struct to contain header information
+ * @return false on fail and true on success
+*/
+static bool load_iNES10(const uint8_t *iNES_header, nes_header_t *header)
+{
+	header->battery_backed_ram = (iNES_header[6] >> 1) & 0x1;
+   header->trainer = iNES_header[6] & 0x04;
+   header->nametable_arrangement = iNES_header[6] & 0x1;
+   header->prg_rom_size = iNES_header[4];
+   header->chr_rom_size = iNES_header[5];
+   header->prg_rom_bytes = (size_t) header->prg_rom_size * 1024 * 16;
+   header->chr_rom_bytes = (size_t) header->chr_rom_size * 1024 * 8;
+
+   if (header->prg_rom_size == 0)
+   {
+      printf("ERROR! No program rom size specified?\n");
+      return false;
+   }
+
+   uint8_t mapper_id_lo = (iNES_header[6] & 0xF0) >> 4;
+   uint8_t mapper_id_hi = (iNES_header[7] & 0xF0);
+
+   // old dumps have text like "DiskDude!" in bytes 7 - 15, byte 7 is only trusted when the padding is zero
+   if (iNES_header[12] != 0 || iNES_header[13] != 0 || iNES_header[14] != 0 || iNES_header[15] != 0)
+   {
+      mapper_id_hi = 0;
+   }
+   header->mapper_id = mapper_id_hi | mapper_id_lo;
+
+   size_t prg_ram_bytes = (iNES_header[8] != 0) ? (size_t) iNES_header[8] * 1024 * 8 : 1024 * 8;
+   if (header->mapper_id == 1 && prg_ram_bytes < 1024 * 32)
+   {
+      prg_ram_bytes = 1024 * 32;
+   }
+
+   if (header->battery_backed_ram)
+   {
+      header->prg_nvram_bytes = prg_ram_bytes;
+   }
+   else
+   {
+      header->prg_ram_bytes = prg_ram_bytes;
+   }
+   header->chr_ram_bytes = (header->chr_rom_size == 0) ? 1024 * 8 : 0;
+
+   return true;
+}
+
+/**
+ * Loads data in NES 2.0 format into a struct.
+ * @param iNES_header array container 16 header
+ * @param header struct to contain header information
+ * @return false on fail and true on success
+*/
+static bool load_iNES20(const uint8_t *iNES_header, nes_header_t *header)
+{
+   header->is_nes20 = true;
+	header->battery_backed_ram = (iNES_header[6] >> 1) & 0x1;
+   header->trainer = iNES_header[6] & 0x04;
+   header->nametable_arrangement = iNES_header[6] & 0x1;
+
+   header->mapper_id = (uint16_t) ( ((iNES_header[8] & 0x0F) << 8) | (iNES_header[7] & 0xF0) | (iNES_header[6] >> 4) );
+   header->submapper_id = iNES_header[8] >> 4;
+
+   if ( !nes20_rom_bytes(iNES_header[4], iNES_header[9] & 0x0F, 1024 * 16, &header->prg_rom_bytes) ||
+        !nes20_rom_bytes(iNES_header[5], iNES_header[9] >> 4, 1024 * 8, &header->chr_rom_bytes) )
+   {
+      printf("ERROR! Rom size in header is too large!\n");
+      return false;
+   }
+
+   if (header->prg_rom_bytes == 0)
+   {
+      printf("ERROR! No program rom size specified?\n");
+      return false;
+   }
+
+   // bank math in the mappers works in whole units
+   header->prg_rom_size = (uint32_t) ((header->prg_rom_bytes + 1024 * 16 - 1) / (1024 * 16));
+   header->chr_rom_size = (uint32_t) ((header->chr_rom_bytes + 1024 * 8 - 1) / (1024 * 8));
+
+   header->prg_ram_bytes = nes20_ram_bytes(iNES_header[10] & 0x0F);
+   header->prg_nvram_bytes = nes20_ram_bytes(iNES_header[10] >> 4);
+   header->chr_ram_bytes = nes20_ram_bytes(iNES_header[11] & 0x0F);
+   header->chr_nvram_bytes = nes20_ram_bytes(iNES_header[11] >> 4);
+
+   return true;
+}
+
+/**
+ * Decodes a NES 2.0 rom size. An msb nibble of 0xF means the lsb holds an exponent and multiplier,
+ * 2^E * (M * 2 + 1) bytes, otherwise msb and lsb are a 12 bit count of units.
+ * @param size_lsb header byte 4 or 5
+ * @param size_msb matching nibble of header byte 9
+ * @param unit bytes in one unit, 16kb for prg-rom and 8kb for chr-rom
+ * @param bytes set to the size in bytes
+ * @return false if the size is too large to load
+*/
+static bool nes20_rom_bytes(uint8_t size_lsb, uint8_t size_msb, size_t unit, size_t* bytes)
+{
+   if (size_msb == 0x0F)
+   {
+      uint8_t exponent = size_lsb >> 2;
+      uint8_t multiplier = size_lsb & 0x3;
+      if (exponent > ROM_SIZE_EXPONENT_MAX)
+      {
+         return false;
+      }
+
+      *bytes = ((size_t) 1 << exponent) * (multiplier * 2 + 1);
+   }
+   else
+   {
+      *bytes = ( ((size_t) size_msb << 8) | size_lsb ) * unit;
+   }
+
+   return true;
+}
+
+/**
+ * Decodes a NES 2.0 ram shift count.
+ * @returns 64 << shift_count bytes, 0 when the shift count is 0
+*/
+static size_t nes20_ram_bytes(uint8_t shift_count)
+{
+   return (shift_count != 0) ? (size_t) 64 << shift_count : 0;
+}
@@ -0,0 +1,957 @@
+#define _XOPEN_SOURCE 700 // lstat and realpath under strict c11
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#include "rom_library.h"
+#include "rom_image.h"
+#include "mapper.h"
+#include "thread.h"
+
+#define ROM_LIBRARY_INDEX_MAGIC "BNLI 1"       // first line of an index file, the number is the format version
+#define ROM_LIBRARY_LINE_SIZE   (4096 + 256)   // longest index line read, a path plus the fields before it
+#define ROM_LIBRARY_MAX_DEPTH   32             // directories below the scanned one that are walked
+#define ROM_LIBRARY_HASH_CHUNK  (1024 * 64)    // bytes fed to crc32 and sha1 in turn, so both hash them while cached
+#define ROM_LIBRARY_KEEP        -1             // fix-up field that keeps the value from the header
+
+#if _WIN32
+#define ROM_LIBRARY_SEPARATOR '\\'
+#else
+#define ROM_LIBRARY_SEPARATOR '/'
+#endif
+
+/**
+ * Header fields to overwrite for the rom with a crc32, ROM_LIBRARY_KEEP leaves a field as is.
+*/
+typedef struct Rom_Library_Fixup_t
+{
+   uint32_t crc32;
+   int32_t mapper_id;
+   int32_t submapper_id;
+   int32_t nametable_arrangement;
+   int32_t battery_backed_ram;
+} Rom_Library_Fixup_t;
+
+typedef struct Rom_Library_List_t
+{
+   Rom_Library_Entry_t* entries;
+   uint32_t count;
+   uint32_t capacity;
+} Rom_Library_List_t;
+
+static Rom_Library_List_t library;   // ordered by path
+static Rom_Library_Fixup_t* fixups = NULL; // ordered by crc32
+static uint32_t fixup_count = 0;
+static uint32_t read_count = 0;
+
+static Thread_Lock_t library_lock = THREAD_LOCK_INIT;
+
+// the scan being run, written before its threads start and only read while they run
+static Rom_Library_Entry_t* scan_entries = NULL;
+static const uint32_t* scan_pending = NULL; // indices of scan_entries whose file has to be read
+static uint32_t scan_pending_count = 0;
+static Thread_Counter_t scan_next;
+
+static bool rom_library_walk(const char* directory, uint32_t depth, Rom_Library_List_t* list);
+static bool rom_library_add(Rom_Library_List_t* list, char* path, int64_t modified_time, uint64_t file_size);
+static void rom_library_free_list(Rom_Library_List_t* list);
+static bool rom_library_is_rom_file(const char* name);
+static bool rom_library_is_directory(const char* path);
+static bool rom_library_stat(const char* path, int64_t* modified_time, uint64_t* file_size);
+static char* rom_library_full_path(const char* path);
+static char* rom_library_join_path(const char* directory, const char* name);
+static Rom_Library_Entry_t* rom_library_find_entry(const Rom_Library_List_t* list, const char* path);
+static const Rom_Library_Fixup_t* rom_library_find_fixup(uint32_t crc32);
+static bool rom_library_apply_fixup(const Rom_Library_Fixup_t* fixup, const uint8_t* iNES_header, nes_header_t* header);
+static void rom_library_update_entry(Rom_Library_Entry_t* entry);
+static void rom_library_read_rom(Rom_Library_Entry_t* entry);
+static bool rom_library_read_hex(const char* hex, uint8_t* bytes, size_t count);
+static bool rom_library_read_fixup_field(const char* text, int32_t max, int32_t* value);
+static int rom_library_compare_entries(const void* a, const void* b);
+static int rom_library_compare_fixups(const void* a, const void* b);
+static void rom_library_scan_work(void* data);
+
+bool rom_library_load_index(const char* index_path)
+{
+   FILE* file = fopen(index_path, "r");
+   if (!file)
+   {
+      return false;
+   }
+
+   char line[ROM_LIBRARY_LINE_SIZE];
+   if (fgets(line, sizeof(line), file) == NULL || strncmp(line, ROM_LIBRARY_INDEX_MAGIC, strlen(ROM_LIBRARY_INDEX_MAGIC)) != 0)
+   {
+      printf("Not a rom library index: %s\n", index_path);
+      fclose(file);
+      return false;
+   }
+
+   Rom_Library_List_t loaded = {0};
+   bool is_loaded = true;
+
+   while (is_loaded && fgets(line, sizeof(line), file) != NULL)
+   {
+      size_t length = strlen(line);
+      if (length > 0 && line[length - 1] != '\n' && !feof(file)) // skip the rest of a line too long to be an entry
+      {
+         int c;
+         while ( (c = fgetc(file)) != EOF && c != '\n' );
+         continue;
+      }
+      while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+      {
+         line[--length] = '\0';
+      }
+
+      int64_t modified_time;
+      uint64_t file_size;
+      int is_valid;
+      uint32_t crc32;
+      char sha1_hex[SHA1_DIGEST_SIZE * 2 + 1];
+      char header_hex[16 * 2 + 1];
+      int path_start = 0;
+
+      Rom_Library_Entry_t entry = {0};
+      if ( sscanf(line, "%" SCNd64 " %" SCNu64 " %d %8" SCNx32 " %40s %32s %n", &modified_time, &file_size, &is_valid, &crc32, sha1_hex, header_hex, &path_start) != 6 ||
+           path_start == 0 || line[path_start] == '\0' ||
+           !rom_library_read_hex(sha1_hex, entry.sha1, SHA1_DIGEST_SIZE) ||
+           !rom_library_read_hex(header_hex, entry.iNES_header, sizeof(entry.iNES_header)) )
+      {
+         continue; // a damaged entry is read again by the next scan
+      }
+
+      char* path = malloc(strlen(line + path_start) + 1);
+      if (path == NULL)
+      {
+         is_loaded = false;
+         break;
+      }
+      strcpy(path, line + path_start);
+
+      if (!rom_library_add(&loaded, path, modified_time, file_size))
+      {
+         is_loaded = false;
+         break;
+      }
+
+      Rom_Library_Entry_t* added = &loaded.entries[loaded.count - 1];
+      memcpy(added->sha1, entry.sha1, SHA1_DIGEST_SIZE);
+      memcpy(added->iNES_header, entry.iNES_header, sizeof(entry.iNES_header));
+      added->crc32 = crc32;
+      added->is_valid = is_valid != 0;
+   }
+   fclose(file);
+
+   if (!is_loaded)
+   {
+      printf("Failed to allocate memory for rom library!\n");
+      rom_library_free_list(&loaded);
+      return false;
+   }
+
+   qsort(loaded.entries, loaded.count, sizeof(Rom_Library_Entry_t), rom_library_compare_entries);
+   for (uint32_t i = 0; i < loaded.count; ++i)
+   {
+      rom_library_update_entry(&loaded.entries[i]);
+   }
+
+   thread_lock(&library_lock);
+   Rom_Library_List_t old = library;
+   library = loaded;
+   thread_unlock(&library_lock);
+
+   rom_library_free_list(&old);
+   return true;
+}
+
+bool rom_library_save_index(const char* index_path)
+{
+   char temp_path[ROM_LIBRARY_LINE_SIZE];
+   snprintf(temp_path, sizeof(temp_path), "%s.tmp", index_path);
+
+   FILE* file = fopen(temp_path, "w");
+   if (!file)
+   {
+      printf("Failed to write rom library index: %s\n", temp_path);
+      return false;
+   }
+
+   fprintf(file, "%s\n", ROM_LIBRARY_INDEX_MAGIC);
+   for (uint32_t i = 0; i < library.count; ++i)
+   {
+      const Rom_Library_Entry_t* entry = &library.entries[i];
+      if (strchr(entry->path, '\n') != NULL || strchr(entry->path, '\r') != NULL) // cannot be stored one per line
+      {
+         continue;
+      }
+
+      fprintf(file, "%" PRId64 " %" PRIu64 " %d %08" PRIX32 " ", entry->modified_time, entry->file_size, entry->is_valid ? 1 : 0, entry->crc32);
+      for (int k = 0; k < SHA1_DIGEST_SIZE; ++k)
+      {
+         fprintf(file, "%02x", entry->sha1[k]);
+      }
+      fputc(' ', file);
+      for (size_t k = 0; k < sizeof(entry->iNES_header); ++k)
+      {
+         fprintf(file, "%02x", entry->iNES_header[k]);
+      }
+      fprintf(file, " %s\n", entry->path);
+   }
+
+   bool is_written = (ferror(file) == 0);
+   is_written = (fclose(file) == 0) && is_written;
+
+   // the old index stays in place until the new one is complete
+   if (is_written)
+   {
+#if _WIN32
+      is_written = MoveFileExA(temp_path, index_path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+      is_written = rename(temp_path, index_path) == 0;
+#endif
+   }
+
+   if (!is_written)
+   {
+      printf("Failed to write rom library index: %s\n", index_path);
+      remove(temp_path);
+   }
+
+   return is_written;
+}
+
+bool rom_library_load_fixups(const char* fixup_path)
+{
+   FILE* file = fopen(fixup_path, "r");
+   if (!file)
+   {
+      return false;
+   }
+
+   Rom_Library_Fixup_t* loaded = NULL;
+   uint32_t loaded_count = 0;
+   uint32_t capacity = 0;
+   uint32_t line_number = 0;
+   char line[256];
+
+   while (fgets(line, sizeof(line), file) != NULL)
+   {
+      line_number += 1;
+
+      const char* text = line;
+      while (isspace( (unsigned char) *text ))
+      {
+         ++text;
+      }
+      if (*text == '\0' || *text == '#')
+      {
+         continue;
+      }
+
+      Rom_Library_Fixup_t fixup;
+      char mapper[16], submapper[16], mirroring[16], battery[16];
+      if ( sscanf(text, "%8" SCNx32 " %15s %15s %15s %15s", &fixup.crc32, mapper, submapper, mirroring, battery) != 5 ||
+           !rom_library_read_fixup_field(mapper, 0x0FFF, &fixup.mapper_id) ||
+           !rom_library_read_fixup_field(submapper, 0x0F, &fixup.submapper_id) ||
+           !rom_library_read_fixup_field(battery, 1, &fixup.battery_backed_ram) )
+      {
+         printf("Skipping malformed fix-up on line %u of %s\n", line_number, fixup_path);
+         continue;
+      }
+
+      switch (toupper( (unsigned char) mirroring[0] ))
+      {
+         case '-': fixup.nametable_arrangement = ROM_LIBRARY_KEEP; break;
+         case 'H': fixup.nametable_arrangement = 0; break;
+         case 'V': fixup.nametable_arrangement = 1; break;
+         default:
+            printf("Skipping malformed fix-up on line %u of %s\n", line_number, fixup_path);
+            continue;
+      }
+
+      if (loaded_count == capacity)
+      {
+         uint32_t new_capacity = (capacity != 0) ? capacity * 2 : 64;
+         Rom_Library_Fixup_t* grown = realloc(loaded, new_capacity * sizeof(Rom_Library_Fixup_t));
+         if (grown == NULL)
+         {
+            printf("Failed to allocate memory for rom fix-ups!\n");
+            free(loaded);
+            fclose(file);
+            return false;
+         }
+         loaded = grown;
+         capacity = new_capacity;
+      }
+      loaded[loaded_count++] = fixup;
+   }
+   fclose(file);
+
+   if (loaded_count != 0)
+   {
+      qsort(loaded, loaded_count, sizeof(Rom_Library_Fixup_t), rom_library_compare_fixups);
+   }
+
+   thread_lock(&library_lock);
+   free(fixups);
+   fixups = loaded;
+   fixup_count = loaded_count;
+   for (uint32_t i = 0; i < library.count; ++i)
+   {
+      rom_library_update_entry(&library.entries[i]);
+   }
+   thread_unlock(&library_lock);
+
+   return true;
+}
+
+bool rom_library_scan(const char* directory, uint32_t thread_count)
+{
+   char* root = rom_library_full_path(directory);
+   if (root == NULL || !rom_library_is_directory(root))
+   {
+      printf("Cannot open directory: %s\n", directory);
+      free(root);
+      return false;
+   }
+
+   Rom_Library_List_t found = {0};
+   bool is_walked = rom_library_walk(root, 0, &found);
+   free(root);
+
+   uint32_t* pending = is_walked ? malloc( (found.count + 1) * sizeof(uint32_t) ) : NULL;
+   if (pending == NULL)
+   {
+      printf("Failed to allocate memory for rom library!\n");
+      rom_library_free_list(&found);
+      return false;
+   }
+
+   if (found.count != 0)
+   {
+      qsort(found.entries, found.count, sizeof(Rom_Library_Entry_t), rom_library_compare_entries);
+   }
+
+   // entries of files that did not change are kept, only the rest is read. Only this thread changes
+   // the library so it is read here without the lock.
+   uint32_t pending_count = 0;
+   for (uint32_t i = 0; i < found.count; ++i)
+   {
+      Rom_Library_Entry_t* entry = &found.entries[i];
+      const Rom_Library_Entry_t* known = rom_library_find_entry(&library, entry->path);
+
+      if (known != NULL && known->modified_time == entry->modified_time && known->file_size == entry->file_size)
+      {
+         char* path = entry->path;
+         *entry = *known;
+         entry->path = path;
+      }
+      else
+      {
+         pending[pending_count++] = i;
+      }
+   }
+
+   if (thread_count == 0)
+   {
+      thread_count = thread_host_cores();
+   }
+   if (thread_count > ROM_LIBRARY_MAX_THREADS)
+   {
+      thread_count = ROM_LIBRARY_MAX_THREADS;
+   }
+   if (thread_count > pending_count)
+   {
+      thread_count = (pending_count != 0) ? pending_count : 1;
+   }
+
+   checksum_init(); // before the tables are used from several threads
+   scan_entries = found.entries;
+   scan_pending = pending;
+   scan_pending_count = pending_count;
+   thread_counter_set(&scan_next, 0);
+
+   // threads that fail to start only leave more files for the others
+   Thread_t threads[ROM_LIBRARY_MAX_THREADS];
+   uint32_t started = 0;
+   while (started + 1 < thread_count && thread_start(&threads[started], rom_library_scan_work, NULL))
+   {
+      started += 1;
+   }
+
+   rom_library_scan_work(NULL);
+
+   for (uint32_t i = 0; i < started; ++i)
+   {
+      thread_join(threads[i]);
+   }
+
+   scan_entries = NULL;
+   scan_pending = NULL;
+   free(pending);
+
+   thread_lock(&library_lock);
+   for (uint32_t i = 0; i < found.count; ++i)
+   {
+      rom_library_update_entry(&found.entries[i]);
+   }
+   Rom_Library_List_t old = library;
+   library = found;
+   read_count = pending_count;
+   thread_unlock(&library_lock);
+
+   rom_library_free_list(&old);
+   return true;
+}
+
+uint32_t rom_library_get_read_count(void)
+{
+   return read_count;
+}
+
+uint32_t rom_library_get_count(void)
+{
+   return library.count;
+}
+
+const Rom_Library_Entry_t* rom_library_get_entry(uint32_t index)
+{
+   return (index < library.count) ? &library.entries[index] : NULL;
+}
+
+bool rom_library_fix_header(const char* path, const uint8_t* iNES_header, nes_header_t* header)
+{
+   // most loads happen without any fix-ups, they do not need to look at the file
+   thread_lock(&library_lock);
+   bool has_fixups = fixup_count != 0 && library.count != 0;
+   thread_unlock(&library_lock);
+
+   if (!has_fixups)
+   {
+      return false;
+   }
+
+   char* full_path = rom_library_full_path(path);
+   int64_t modified_time = 0;
+   uint64_t file_size = 0;
+   if (full_path == NULL || !rom_library_stat(full_path, &modified_time, &file_size))
+   {
+      free(full_path);
+      return false;
+   }
+
+   bool is_fixed = false;
+
+   thread_lock(&library_lock);
+   const Rom_Library_Entry_t* entry = rom_library_find_entry(&library, full_path);
+   if (entry != NULL && entry->is_valid && entry->modified_time == modified_time && entry->file_size == file_size)
+   {
+      const Rom_Library_Fixup_t* fixup = rom_library_find_fixup(entry->crc32);
+      if (fixup != NULL)
+      {
+         is_fixed = rom_library_apply_fixup(fixup, iNES_header, header);
+      }
+   }
+   thread_unlock(&library_lock);
+
+   free(full_path);
+   return is_fixed;
+}
+
+void rom_library_free(void)
+{
+   thread_lock(&library_lock);
+   Rom_Library_List_t old = library;
+   memset(&library, 0, sizeof(library));
+   free(fixups);
+   fixups = NULL;
+   fixup_count = 0;
+   read_count = 0;
+   thread_unlock(&library_lock);
+
+   rom_library_free_list(&old);
+}
+
+/**
+ * Adds every .nes file in a directory and the directories below it to a list.
+ * @returns false if memory ran out, directories that cannot be opened are skipped
+*/
+static bool rom_library_walk(const char* directory, uint32_t depth, Rom_Library_List_t* list)
+{
+   bool is_walked = true;
+
+#if _WIN32
+   char* pattern = rom_library_join_path(directory, "*");
+   if (pattern == NULL)
+   {
+      return false;
+   }
+
+   WIN32_FIND_DATAA item;
+   HANDLE find = FindFirstFileA(pattern, &item);
+   free(pattern);
+   if (find == INVALID_HANDLE_VALUE)
+   {
+      return true;
+   }
+
+   do
+   {
+      if (strcmp(item.cFileName, ".") == 0 || strcmp(item.cFileName, "..") == 0)
+      {
+         continue;
+      }
+
+      char* path = rom_library_join_path(directory, item.cFileName);
+      if (path == NULL)
+      {
+         is_walked = false;
+      }
+      else if (item.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      {
+         // junctions are not followed, they could lead back up the tree
+         if ( !(item.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) && depth < ROM_LIBRARY_MAX_DEPTH )
+         {
+            is_walked = rom_library_walk(path, depth + 1, list);
+         }
+         free(path);
+      }
+      else if (rom_library_is_rom_file(item.cFileName))
+      {
+         ULARGE_INTEGER time;
+         time.LowPart = item.ftLastWriteTime.dwLowDateTime;
+         time.HighPart = item.ftLastWriteTime.dwHighDateTime;
+         int64_t modified_time = (int64_t) (time.QuadPart / 10000000) - 11644473600; // 100ns ticks since 1601 to seconds since 1970
+         uint64_t file_size = ((uint64_t) item.nFileSizeHigh << 32) | item.nFileSizeLow;
+         is_walked = rom_library_add(list, path, modified_time, file_size);
+      }
+      else
+      {
+         free(path);
+      }
+   } while (is_walked && FindNextFileA(find, &item));
+
+   FindClose(find);
+#else
+   DIR* dir = opendir(directory);
+   if (dir == NULL)
+   {
+      printf("Cannot open directory: %s\n", directory);
+      return true;
+   }
+
+   struct dirent* item;
+   while (is_walked && (item = readdir(dir)) != NULL)
+   {
+      if (strcmp(item->d_name, ".") == 0 || strcmp(item->d_name, "..") == 0)
+      {
+         continue;
+      }
+
+      char* path = rom_library_join_path(directory, item->d_name);
+      struct stat info;
+      if (path == NULL)
+      {
+         is_walked = false;
+      }
+      else if (lstat(path, &info) == 0 && S_ISDIR(info.st_mode))
+      {
+         // symbolic links to directories are not followed, they could lead back up the tree
+         if (depth < ROM_LIBRARY_MAX_DEPTH)
+         {
+            is_walked = rom_library_walk(path, depth + 1, list);
+         }
+         free(path);
+      }
+      else if (rom_library_is_rom_file(item->d_name) && stat(path, &info) == 0 && S_ISREG(info.st_mode))
+      {
+         is_walked = rom_library_add(list, path, (int64_t) info.st_mtime, (uint64_t) info.st_size);
+      }
+      else
+      {
+         free(path);
+      }
+   }
+
+   closedir(dir);
+#endif
+
+   return is_walked;
+}
+
+/**
+ * Appends an entry that has not been read yet to a list, the list takes ownership of path.
+ * @returns false if memory ran out, path is freed then
+*/
+static bool rom_library_add(Rom_Library_List_t* list, char* path, int64_t modified_time, uint64_t file_size)
+{
+   if (list->count == list->capacity)
+   {
+      uint32_t capacity = (list->capacity != 0) ? list->capacity * 2 : 256;
+      Rom_Library_Entry_t* grown = realloc(list->entries, capacity * sizeof(Rom_Library_Entry_t));
+      if (grown == NULL)
+      {
+         free(path);
+         return false;
+      }
+      list->entries = grown;
+      list->capacity = capacity;
+   }
+
+   Rom_Library_Entry_t* entry = &list->entries[list->count++];
+   memset(entry, 0, sizeof(Rom_Library_Entry_t));
+   entry->path = path;
+   entry->modified_time = modified_time;
+   entry->file_size = file_size;
+
+   return true;
+}
+
+static void rom_library_free_list(Rom_Library_List_t* list)
+{
+   for (uint32_t i = 0; i < list->count; ++i)
+   {
+      free(list->entries[i].path);
+   }
+   free(list->entries);
+   memset(list, 0, sizeof(Rom_Library_List_t));
+}
+
+/**
+ * @returns true if a file name ends in .nes in any case
+*/
+static bool rom_library_is_rom_file(const char* name)
+{
+   const char* extension = strrchr(name, '.');
+   return extension != NULL && strlen(extension) == 4 &&
+          tolower( (unsigned char) extension[1] ) == 'n' &&
+          tolower( (unsigned char) extension[2] ) == 'e' &&
+          tolower( (unsigned char) extension[3] ) == 's';
+}
+
+static bool rom_library_is_directory(const char* path)
+{
+#if _WIN32
+   DWORD attributes = GetFileAttributesA(path);
+   return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+   struct stat info;
+   return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+/**
+ * Reads the modification time and size of a file the same way a scan does.
+ * @returns false if the file does not exist
+*/
+static bool rom_library_stat(const char* path, int64_t* modified_time, uint64_t* file_size)
+{
+#if _WIN32
+   WIN32_FILE_ATTRIBUTE_DATA info;
+   if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info))
+   {
+      return false;
+   }
+
+   ULARGE_INTEGER time;
+   time.LowPart = info.ftLastWriteTime.dwLowDateTime;
+   time.HighPart = info.ftLastWriteTime.dwHighDateTime;
+   *modified_time = (int64_t) (time.QuadPart / 10000000) - 11644473600;
+   *file_size = ((uint64_t) info.nFileSizeHigh << 32) | info.nFileSizeLow;
+#else
+   struct stat info;
+   if (stat(path, &info) != 0)
+   {
+      return false;
+   }
+
+   *modified_time = (int64_t) info.st_mtime;
+   *file_size = (uint64_t) info.st_size;
+#endif
+
+   return true;
+}
+
+/**
+ * @returns newly allocated absolute path, NULL on fail
+*/
+static char* rom_library_full_path(const char* path)
+{
+#if _WIN32
+   return _fullpath(NULL, path, 0);
+#else
+   return realpath(path, NULL);
+#endif
+}
+
+/**
+ * @returns newly allocated directory/name, NULL on fail
+*/
+static char* rom_library_join_path(const char* directory, const char* name)
+{
+   size_t length = strlen(directory);
+   bool has_separator = length > 0 && (directory[length - 1] == '/' || directory[length - 1] == '\\');
+
+   char* path = malloc(length + 1 + strlen(name) + 1);
+   if (path != NULL)
+   {
+      strcpy(path, directory);
+      if (!has_separator)
+      {
+         path[length++] = ROM_LIBRARY_SEPARATOR;
+      }
+      strcpy(path + length, name);
+   }
+
+   return path;
+}
+
+static Rom_Library_Entry_t* rom_library_find_entry(const Rom_Library_List_t* list, const char* path)
+{
+   if (list->count == 0)
+   {
+      return NULL;
+   }
+
+   Rom_Library_Entry_t key = { .path = (char*) path };
+   return bsearch(&key, list->entries, list->count, sizeof(Rom_Library_Entry_t), rom_library_compare_entries);
+}
+
+static const Rom_Library_Fixup_t* rom_library_find_fixup(uint32_t crc32)
+{
+   if (fixup_count == 0)
+   {
+      return NULL;
+   }
+
+   Rom_Library_Fixup_t key = { .crc32 = crc32 };
+   return bsearch(&key, fixups, fixup_count, sizeof(Rom_Library_Fixup_t), rom_library_compare_fixups);
+}
+
+/**
+ * Writes the fields a fix-up gives into a copy of the rom's header and decodes that copy, so a fixed
+ * header gets its ram sizes from the same rules as any other. iNES 1.0 headers have no room for a
+ * submapper or a mapper above 255, those fields are only fixed in NES 2.0 headers.
+ * @param iNES_header first 16 bytes of the rom's file
+ * @param header decoded from iNES_header, replaced by the fixed header
+ * @returns true if the header was changed
+*/
+static bool rom_library_apply_fixup(const Rom_Library_Fixup_t* fixup, const uint8_t* iNES_header, nes_header_t* header)
+{
+   uint8_t fixed[16];
+   memcpy(fixed, iNES_header, sizeof(fixed));
+   bool is_nes20 = rom_image_is_nes20(fixed);
+
+   if (fixup->mapper_id != ROM_LIBRARY_KEEP && (is_nes20 || fixup->mapper_id <= 0xFF))
+   {
+      uint16_t mapper_id = (uint16_t) fixup->mapper_id;
+      fixed[6] = (uint8_t) ( (fixed[6] & 0x0F) | ((mapper_id & 0x0F) << 4) );
+      fixed[7] = (uint8_t) ( (fixed[7] & 0x0F) | (mapper_id & 0xF0) );
+      if (is_nes20)
+      {
+         fixed[8] = (uint8_t) ( (fixed[8] & 0xF0) | (mapper_id >> 8) );
+      }
+      else
+      {
+         memset(fixed + 12, 0, 4); // load_iNES10 ignores byte 7 when the padding holds text
+      }
+   }
+   if (fixup->submapper_id != ROM_LIBRARY_KEEP && is_nes20)
+   {
+      fixed[8] = (uint8_t) ( (fixed[8] & 0x0F) | (fixup->submapper_id << 4) );
+   }
+   if (fixup->nametable_arrangement != ROM_LIBRARY_KEEP)
+   {
+      fixed[6] = (uint8_t) ( (fixed[6] & ~0x01) | fixup->nametable_arrangement );
+   }
+   if (fixup->battery_backed_ram != ROM_LIBRARY_KEEP)
+   {
+      fixed[6] = (uint8_t) ( (fixed[6] & ~0x02) | (fixup->battery_backed_ram << 1) );
+   }
+
+   nes_header_t fixed_header;
+   if (memcmp(fixed, iNES_header, sizeof(fixed)) == 0 || !rom_image_parse_header(fixed, &fixed_header))
+   {
+      return false;
+   }
+
+   bool is_changed = fixed_header.mapper_id != header->mapper_id ||
+                     fixed_header.submapper_id != header->submapper_id ||
+                     fixed_header.nametable_arrangement != header->nametable_arrangement ||
+                     fixed_header.battery_backed_ram != header->battery_backed_ram ||
+                     fixed_header.prg_ram_bytes != header->prg_ram_bytes ||
+                     fixed_header.prg_nvram_bytes != header->prg_nvram_bytes;
+
+   *header = fixed_header;
+   return is_changed;
+}
+
+/**
+ * Decodes the header of an entry again and applies the current fix-ups to it.
+*/
+static void rom_library_update_entry(Rom_Library_Entry_t* entry)
+{
+   entry->is_header_fixed = false;
+   entry->is_mapper_supported = false;
+
+   if (!entry->is_valid || !rom_image_parse_header(entry->iNES_header, &entry->header))
+   {
+      entry->is_valid = false;
+      memset(&entry->header, 0, sizeof(nes_header_t));
+      return;
+   }
+
+   const Rom_Library_Fixup_t* fixup = rom_library_find_fixup(entry->crc32);
+   if (fixup != NULL)
+   {
+      entry->is_header_fixed = rom_library_apply_fixup(fixup, entry->iNES_header, &entry->header);
+   }
+
+   entry->is_mapper_supported = mapper_is_supported(entry->header.mapper_id);
+}
+
+/**
+ * Validates a rom file and hashes its prg-rom and chr-rom. The entry stays invalid if the file cannot
+ * be read or is not a rom.
+*/
+static void rom_library_read_rom(Rom_Library_Entry_t* entry)
+{
+   size_t size = 0;
+   const uint8_t* file = rom_image_map_file(entry->path, &size);
+   if (file == NULL)
+   {
+      return;
+   }
+
+   memcpy(entry->iNES_header, file, sizeof(entry->iNES_header));
+
+   Rom_Image_t image;
+   if (rom_image_parse(file, size, &image))
+   {
+      // chr-rom follows prg-rom in the file, so both are hashed as one block
+      const uint8_t* data = image.prg_rom;
+      size_t remaining = image.prg_rom_size + image.chr_rom_size;
+
+      uint32_t crc = 0;
+      Sha1_Context_t sha1;
+      sha1_init(&sha1);
+
+      while (remaining > 0)
+      {
+         size_t chunk = (remaining < ROM_LIBRARY_HASH_CHUNK) ? remaining : ROM_LIBRARY_HASH_CHUNK;
+         crc = crc32_update(crc, data, chunk);
+         sha1_update(&sha1, data, chunk);
+         data += chunk;
+         remaining -= chunk;
+      }
+
+      entry->crc32 = crc;
+      sha1_final(&sha1, entry->sha1);
+      entry->is_valid = true;
+   }
+
+   rom_image_unmap_file(file, size);
+}
+
+/**
+ * Decodes count bytes from exactly count * 2 hex digits.
+ * @returns false if hex is not that
+*/
+static bool rom_library_read_hex(const char* hex, uint8_t* bytes, size_t count)
+{
+   if (strlen(hex) != count * 2)
+   {
+      return false;
+   }
+
+   for (size_t i = 0; i < count; ++i)
+   {
+      uint8_t byte = 0;
+      for (int k = 0; k < 2; ++k)
+      {
+         char c = (char) tolower( (unsigned char) hex[i * 2 + k] );
+         if (c >= '0' && c <= '9')
+         {
+            byte = (uint8_t) (byte << 4 | (c - '0'));
+         }
+         else if (c >= 'a' && c <= 'f')
+         {
+            byte = (uint8_t) (byte << 4 | (c - 'a' + 10));
+         }
+         else
+         {
+            return false;
+         }
+      }
+      bytes[i] = byte;
+   }
+
+   return true;
+}
+
+/**
+ * Reads a number between 0 and max, or - for ROM_LIBRARY_KEEP.
+ * @returns false if text is neither
+*/
+static bool rom_library_read_fixup_field(const char* text, int32_t max, int32_t* value)
+{
+   if (strcmp(text, "-") == 0)
+   {
+      *value = ROM_LIBRARY_KEEP;
+      return true;
+   }
+
+   char* end = NULL;
+   long number = strtol(text, &end, 10);
+   if (end == text || *end != '\0' || number < 0 || number > max)
+   {
+      return false;
+   }
+
+   *value = (int32_t) number;
+   return true;
+}
+
+static int rom_library_compare_entries(const void* a, const void* b)
+{
+   return strcmp( ((const Rom_Library_Entry_t*) a)->path, ((const Rom_Library_Entry_t*) b)->path );
+}
+
+static int rom_library_compare_fixups(const void* a, const void* b)
+{
+   uint32_t crc_a = ((const Rom_Library_Fixup_t*) a)->crc32;
+   uint32_t crc_b = ((const Rom_Library_Fixup_t*) b)->crc32;
+   return (crc_a > crc_b) - (crc_a < crc_b);
+}
+
+/**
+ * Reads pending files until none are left, every claim takes the next one so the threads of a scan
+ * never wait on each other. A file is only touched by the thread that claimed it.
+*/
+static void rom_library_scan_work(void* data)
+{
+   (void) data;
+
+   while (true)
+   {
+      uint32_t claim = thread_counter_claim(&scan_next);
+      if (claim >= scan_pending_count)
+      {
+         break;
+      }
+
+      rom_library_read_rom(&scan_entries[scan_pending[claim]]);
+   }
+}
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "savestate.h"
+#include "cpu.h"
+#include "bus.h"
+#include "ppu.h"
+#include "apu.h"
+#include "cartridge.h"
+#include "controllers.h"
+
+#define STATE_MAGIC       "BNST"
+#define STATE_HEADER_SIZE 8 // magic + version
+#define CHUNK_HEADER_SIZE 8 // tag + payload length
+
+typedef struct State_Chunk_t
+{
+   char tag[4];
+   void (*save)     (State_Buffer_t* buffer);
+   void (*load)     (State_Buffer_t* buffer);
+   bool (*validate) (State_Buffer_t* buffer); // optional, checks a chunk belongs to the running machine before anything is loaded
+} State_Chunk_t;
+
+// chunks are loaded in this order, the cartridge goes first so the page tables are in place for everything else
+static const State_Chunk_t state_chunks[] =
+{
+   { {'C','A','R','T'}, &cartridge_save_state,   &cartridge_load_state,   &cartridge_validate_state },
+   { {'R','A','M',' '}, &bus_save_state,         &bus_load_state,         NULL },
+   { {'P','P','U',' '}, &ppu_save_state,         &ppu_load_state,         NULL },
+   { {'A','P','U',' '}, &apu_save_state,         &apu_load_state,         NULL },
+   { {'C','T','R','L'}, &controllers_save_state, &controllers_load_state, NULL },
+   { {'C','P','U',' '}, &cpu_save_state,         &cpu_load_state,         NULL },
+};
+
+#define STATE_CHUNK_COUNT (sizeof(state_chunks) / sizeof(state_chunks[0]))
+
+static bool state_find_chunk(const State_Buffer_t* buffer, const char tag[4], State_Buffer_t* chunk);
+
+bool state_save(State_Buffer_t* buffer)
+{
+   buffer->size = 0;
+   buffer->error = false;
+
+   uint32_t version = STATE_VERSION;
+   state_write(buffer, STATE_MAGIC, 4);
+   state_write(buffer, &version, sizeof(version));
+
+   for (size_t i = 0; i < STATE_CHUNK_COUNT; ++i)
+   {
+      uint32_t length = 0;
+      buffer->chunk_start = buffer->size;
+      state_write(buffer, state_chunks[i].tag, 4);
+      state_write(buffer, &length, sizeof(length)); // patched once the payload is written
+
+      state_chunks[i].save(buffer);
+
+      if (!buffer->measure && !buffer->error)
+      {
+         length = (uint32_t) (buffer->size - buffer->chunk_start - CHUNK_HEADER_SIZE);
+         memcpy(buffer->data + buffer->chunk_start + 4, &length, sizeof(length));
+      }
+   }
+
+   if (buffer->error)
+   {
+      printf("Failed to save state!\n");
+      return false;
+   }
+
+   return true;
+}
+
+bool state_load(const State_Buffer_t* buffer)
+{
+   uint32_t version = 0;
+   if (buffer->size < STATE_HEADER_SIZE || memcmp(buffer->data, STATE_MAGIC, 4) != 0)
+   {
+      printf("Invalid save state!\n");
+      return false;
+   }
+
+   memcpy(&version, buffer->data + 4, sizeof(version));
+   if (version != STATE_VERSION)
+   {
+      printf("Save state version %u is not supported!\n", version);
+      return false;
+   }
+
+   // every chunk has to be present with the length the running build and cartridge would write,
+   // which is counted by a save that only measures
+   State_Buffer_t chunks[STATE_CHUNK_COUNT];
+   for (size_t i = 0; i < STATE_CHUNK_COUNT; ++i)
+   {
+      State_Buffer_t expected = { .measure = true };
+      state_chunks[i].save(&expected);
+
+      if ( !state_find_chunk(buffer, state_chunks[i].tag, &chunks[i]) || chunks[i].size != expected.size )
+      {
+         printf("Save state chunk %.4s is missing or does not match this build!\n", state_chunks[i].tag);
+         return false;
+      }
+
+      if (state_chunks[i].validate != NULL && !state_chunks[i].validate(&chunks[i]))
+      {
+         printf("Save state was made for a different cartridge!\n");
+         return false;
+      }
+      chunks[i].position = 0;
+   }
+
+   for (size_t i = 0; i < STATE_CHUNK_COUNT; ++i)
+   {
+      state_chunks[i].load(&chunks[i]);
+   }
+
+   return true;
+}
+
+void state_buffer_free(State_Buffer_t* buffer)
+{
+   free(buffer->data);
+   buffer->data = NULL;
+   buffer->size = 0;
+   buffer->capacity = 0;
+}
+
+void state_write(State_Buffer_t* buffer, const void* data, size_t size)
+{
+   if (buffer->measure)
+   {
+      buffer->size += size;
+      return;
+   }
+
+   if (buffer->error)
+   {
+      return;
+   }
+
+   if (buffer->size + size > buffer->capacity)
+   {
+      size_t capacity = (buffer->capacity != 0) ? buffer->capacity : 64 * 1024;
+      while (capacity < buffer->size + size)
+      {
+         capacity *= 2;
+      }
+
+      uint8_t* data_grown = realloc(buffer->data, capacity);
+      if (data_grown == NULL)
+      {
+         buffer->error = true;
+         return;
+      }
+
+      buffer->data = data_grown;
+      buffer->capacity = capacity;
+   }
+
+   memcpy(buffer->data + buffer->size, data, size);
+   buffer->size += size;
+}
+
+bool state_read(State_Buffer_t* buffer, void* data, size_t size)
+{
+   if (buffer->position + size > buffer->size)
+   {
+      buffer->error = true;
+      return false;
+   }
+
+   memcpy(data, buffer->data + buffer->position, size);
+   buffer->position += size;
+   return true;
+}
+
+/**
+ * Looks up a chunk by tag and returns a read only view of its payload.
+ * @param buffer whole save state
+ * @param tag 4 byte tag of the chunk
+ * @param chunk set to a view over the chunk's payload
+ * @returns false if the chunk is missing or runs past the end of the state
+*/
+static bool state_find_chunk(const State_Buffer_t* buffer, const char tag[4], State_Buffer_t* chunk)
+{
+   size_t offset = STATE_HEADER_SIZE;
+   while (offset + CHUNK_HEADER_SIZE <= buffer->size)
+   {
+      uint32_t length = 0;
+      memcpy(&length, buffer->data + offset + 4, sizeof(length));
+
+      size_t payload = offset + CHUNK_HEADER_SIZE;
+      if (length > buffer->size - payload)
+      {
+         return false;
+      }
+
+      if (memcmp(buffer->data + offset, tag, 4) == 0)
+      {
+         memset(chunk, 0, sizeof(State_Buffer_t));
+         chunk->data = buffer->data + payload;
+         chunk->size = length;
+         chunk->capacity = length;
+         return true;
+      }
+
+      offset = payload + length;
+   }
+
+   return false;
+}
@@ -0,0 +1,174 @@
+#define _POSIX_C_SOURCE 200809L // sysconf under strict c11
+
+#include <stdlib.h>
+
+#if !_WIN32
+#include <unistd.h>
+#endif
+
+#include "thread.h"
+
+/**
+ * Function and argument handed to a new thread, freed by the thread once it has read them.
+*/
+typedef struct Thread_Start_t
+{
+   void (*function)(void* data);
+   void* data;
+} Thread_Start_t;
+
+#if _WIN32
+static DWORD WINAPI thread_main(LPVOID start_data)
+#else
+static void* thread_main(void* start_data)
+#endif
+{
+   Thread_Start_t start = *(Thread_Start_t*) start_data;
+   free(start_data);
+
+   start.function(start.data);
+
+#if _WIN32
+   return 0;
+#else
+   return NULL;
+#endif
+}
+
+uint32_t thread_host_cores(void)
+{
+#if _WIN32
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   long cores = (long) info.dwNumberOfProcessors;
+#else
+   long cores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+   return (cores > 0) ? (uint32_t) cores : 1;
+}
+
+bool thread_start(Thread_t* thread, void (*function)(void* data), void* data)
+{
+   Thread_Start_t* start = malloc(sizeof(Thread_Start_t));
+   if (start == NULL)
+   {
+      return false;
+   }
+   start->function = function;
+   start->data = data;
+
+#if _WIN32
+   *thread = CreateThread(NULL, 0, thread_main, start, 0, NULL);
+   bool is_started = *thread != NULL;
+#else
+   bool is_started = pthread_create(thread, NULL, thread_main, start) == 0;
+#endif
+
+   if (!is_started)
+   {
+      free(start);
+   }
+
+   return is_started;
+}
+
+void thread_join(Thread_t thread)
+{
+#if _WIN32
+   WaitForSingleObject(thread, INFINITE);
+   CloseHandle(thread);
+#else
+   pthread_join(thread, NULL);
+#endif
+}
+
+void thread_lock_init(Thread_Lock_t* lock)
+{
+#if _WIN32
+   InitializeSRWLock(lock);
+#else
+   pthread_mutex_init(lock, NULL);
+#endif
+}
+
+void thread_lock_destroy(Thread_Lock_t* lock)
+{
+#if _WIN32
+   (void) lock; // slim reader/writer locks hold no resources
+#else
+   pthread_mutex_destroy(lock);
+#endif
+}
+
+void thread_lock(Thread_Lock_t* lock)
+{
+#if _WIN32
+   AcquireSRWLockExclusive(lock);
+#else
+   pthread_mutex_lock(lock);
+#endif
+}
+
+void thread_unlock(Thread_Lock_t* lock)
+{
+#if _WIN32
+   ReleaseSRWLockExclusive(lock);
+#else
+   pthread_mutex_unlock(lock);
+#endif
+}
+
+void thread_condition_init(Thread_Condition_t* condition)
+{
+#if _WIN32
+   InitializeConditionVariable(condition);
+#else
+   pthread_cond_init(condition, NULL);
+#endif
+}
+
+void thread_condition_destroy(Thread_Condition_t* condition)
+{
+#if _WIN32
+   (void) condition; // condition variables hold no resources
+#else
+   pthread_cond_destroy(condition);
+#endif
+}
+
+void thread_wait(Thread_Condition_t* condition, Thread_Lock_t* lock)
+{
+#if _WIN32
+   SleepConditionVariableSRW(condition, lock, INFINITE, 0);
+#else
+   pthread_cond_wait(condition, lock);
+#endif
+}
+
+void thread_wake_all(Thread_Condition_t* condition)
+{
+#if _WIN32
+   WakeAllConditionVariable(condition);
+#else
+   pthread_cond_broadcast(condition);
+#endif
+}
+
+void thread_counter_set(Thread_Counter_t* counter, uint32_t value)
+{
+#if _WIN32
+   *counter = (LONG) value;
+#else
+   atomic_store(counter, value);
+#endif
+}
+
+uint32_t thread_counter_claim(Thread_Counter_t* counter)
+{
+#if _WIN32
+   return (uint32_t) InterlockedIncrement(counter) - 1;
+#else
+   return atomic_fetch_add(counter, 1);
+#endif
+}